@@ -329,56 +329,207 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
   bgp_adj_out_free (adj);
 }
 
+/* Adj-RIB-In entries and slot bytes, over all peers, for "show memory". */
+static unsigned long adj_in_count;
+static unsigned long adj_in_bytes;
+
+/* Fibonacci hashing of the route node pointer into 2^bits slots. */
+static inline unsigned long
+bgp_adj_in_hash (const struct bgp_node *rn, u_char bits)
+{
+  return (unsigned long)
+    (((uint64_t) (uintptr_t) rn * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static struct bgp_adj_in *
+bgp_adj_in_slot (struct bgp_adj_in_table *ait, struct bgp_node *rn)
+{
+  unsigned long mask = BGP_ADJ_IN_SLOTS (ait) - 1;
+  unsigned long i;
+
+  for (i = bgp_adj_in_hash (rn, ait->bits); ait->slots[i].rn; i = (i + 1) & mask)
+    if (ait->slots[i].rn == rn)
+      break;
+
+  return &ait->slots[i];
+}
+
+static void
+bgp_adj_in_resize (struct bgp_adj_in_table *ait, u_char bits)
+{
+  struct bgp_adj_in *old = ait->slots;
+  unsigned long size = BGP_ADJ_IN_SLOTS (ait);
+  unsigned long i;
+
+  adj_in_bytes -= size * sizeof (struct bgp_adj_in);
+
+  ait->bits = bits;
+  ait->slots = XCALLOC (MTYPE_BGP_ADJ_IN,
+			BGP_ADJ_IN_SLOTS (ait) * sizeof (struct bgp_adj_in));
+  adj_in_bytes += BGP_ADJ_IN_SLOTS (ait) * sizeof (struct bgp_adj_in);
+
+  for (i = 0; i < size; i++)
+    if (old[i].rn)
+      *bgp_adj_in_slot (ait, old[i].rn) = old[i];
+
+  XFREE (MTYPE_BGP_ADJ_IN, old);
+}
+
+static struct bgp_adj_in_table *
+bgp_adj_in_table_new (void)
+{
+  struct bgp_adj_in_table *ait;
+
+  ait = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in_table));
+  ait->bits = BGP_ADJ_IN_MIN_BITS;
+  ait->slots = XCALLOC (MTYPE_BGP_ADJ_IN,
+			BGP_ADJ_IN_SLOTS (ait) * sizeof (struct bgp_adj_in));
+  adj_in_bytes += sizeof (struct bgp_adj_in_table)
+                  + BGP_ADJ_IN_SLOTS (ait) * sizeof (struct bgp_adj_in);
+  return ait;
+}
+
+static void
+bgp_adj_in_table_free (struct bgp_adj_in_table *ait)
+{
+  adj_in_bytes -= sizeof (struct bgp_adj_in_table)
+                  + BGP_ADJ_IN_SLOTS (ait) * sizeof (struct bgp_adj_in);
+  XFREE (MTYPE_BGP_ADJ_IN, ait->slots);
+  XFREE (MTYPE_BGP_ADJ_IN, ait);
+}
+
 void
 bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
 {
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_adj_in_table *ait;
   struct bgp_adj_in *adj;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
+  ait = peer->adj_in[table->afi][table->safi];
+  if (! ait)
+    ait = peer->adj_in[table->afi][table->safi] = bgp_adj_in_table_new ();
+
+  adj = bgp_adj_in_slot (ait, rn);
+  if (adj->rn)
     {
-      if (adj->peer == peer)
+      if (adj->attr != attr)
 	{
-	  if (adj->attr != attr)
-	    {
-	      bgp_attr_unintern (&adj->attr);
-	      adj->attr = bgp_attr_intern (attr);
-	    }
-	  return;
+	  bgp_attr_unintern (&adj->attr);
+	  adj->attr = bgp_attr_intern (attr);
 	}
+      return;
     }
-  adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
-  adj->peer = peer_lock (peer); /* adj_in peer reference */
-  adj->attr = bgp_attr_intern (attr);
-  BGP_ADJ_IN_ADD (rn, adj);
-  bgp_lock_node (rn);
-}
 
-void
-bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
-{
-  bgp_attr_unintern (&bai->attr);
-  BGP_ADJ_IN_DEL (rn, bai);
-  peer_unlock (bai->peer); /* adj_in peer reference */
-  XFREE (MTYPE_BGP_ADJ_IN, bai);
+  /* Keep the table at most 3/4 full. */
+  if ((ait->count + 1) * 4 > BGP_ADJ_IN_SLOTS (ait) * 3)
+    {
+      bgp_adj_in_resize (ait, ait->bits + 1);
+      adj = bgp_adj_in_slot (ait, rn);
+    }
+
+  adj->rn = bgp_lock_node (rn);
+  adj->attr = bgp_attr_intern (attr);
+  ait->count++;
+  adj_in_count++;
 }
 
 int
 bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer)
 {
-  struct bgp_adj_in *adj;
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_adj_in_table *ait;
+  struct bgp_adj_in *slots;
+  unsigned long mask, i, j, k;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
+  ait = peer->adj_in[table->afi][table->safi];
+  if (! ait)
+    return 0;
 
-  if (! adj)
+  slots = ait->slots;
+  i = bgp_adj_in_slot (ait, rn) - slots;
+  if (! slots[i].rn)
     return 0;
 
-  bgp_adj_in_remove (rn, adj);
+  bgp_attr_unintern (&slots[i].attr);
+
+  /* Shift back the entries that probed past the freed slot, so lookups
+     never need to skip over deleted entries. */
+  mask = BGP_ADJ_IN_SLOTS (ait) - 1;
+  for (j = (i + 1) & mask; slots[j].rn; j = (j + 1) & mask)
+    {
+      k = bgp_adj_in_hash (slots[j].rn, ait->bits);
+      if (((j - k) & mask) >= ((j - i) & mask))
+	{
+	  slots[i] = slots[j];
+	  i = j;
+	}
+    }
+  slots[i].rn = NULL;
+  slots[i].attr = NULL;
+
+  ait->count--;
+  adj_in_count--;
+
+  if (ait->count == 0)
+    {
+      bgp_adj_in_table_free (ait);
+      peer->adj_in[table->afi][table->safi] = NULL;
+    }
+  else if (ait->bits > BGP_ADJ_IN_MIN_BITS
+	   && ait->count * 8 < BGP_ADJ_IN_SLOTS (ait))
+    bgp_adj_in_resize (ait, ait->bits - 1);
+
   bgp_unlock_node (rn);
   return 1;
 }
 
+/* Return the peer's Adj-RIB-In entry for the route node, or NULL.  The
+   entry is only valid until the peer's table is next changed. */
+struct bgp_adj_in *
+bgp_adj_in_lookup (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_adj_in_table *ait;
+  struct bgp_adj_in *adj;
+
+  ait = peer->adj_in[table->afi][table->safi];
+  if (! ait)
+    return NULL;
+
+  adj = bgp_adj_in_slot (ait, rn);
+  return adj->rn ? adj : NULL;
+}
+
+/* Drop the peer's whole Adj-RIB-In for an AFI/SAFI. */
+void
+bgp_adj_in_free (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_table *ait = peer->adj_in[afi][safi];
+  unsigned long i;
+
+  if (! ait)
+    return;
+
+  peer->adj_in[afi][safi] = NULL;
+
+  for (i = 0; i < BGP_ADJ_IN_SLOTS (ait); i++)
+    if (ait->slots[i].rn)
+      {
+	bgp_attr_unintern (&ait->slots[i].attr);
+	bgp_unlock_node (ait->slots[i].rn);
+      }
+
+  adj_in_count -= ait->count;
+  bgp_adj_in_table_free (ait);
+}
+
+void
+bgp_adj_in_stats (unsigned long *count, unsigned long *bytes)
+{
+  *count = adj_in_count;
+  *bytes = adj_in_bytes;
+}
+
 void
 bgp_sync_init (struct peer *peer)
 {
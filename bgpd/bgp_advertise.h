@@ -75,20 +75,35 @@ struct bgp_adj_out
   struct bgp_advertise *adv;
 };
 
-/* BGP adjacency in. */
+/* BGP adjacency in.  One slot of a peer's Adj-RIB-In table, empty when
+   rn is NULL. */
 struct bgp_adj_in
 {
-  /* Linked list pointer.  */
-  struct bgp_adj_in *next;
-  struct bgp_adj_in *prev;
-
-  /* Received peer.  */
-  struct peer *peer;
+  /* Route node of the received prefix, locked while the entry exists.  */
+  struct bgp_node *rn;
 
   /* Received attribute.  */
   struct attr *attr;
 };
 
+/* Adj-RIB-In of one peer for one AFI/SAFI, kept for soft reconfiguration
+   inbound.  Open addressed on the route node pointer with linear probing,
+   so a peer's entries can be walked without touching the rest of the
+   RIB. */
+struct bgp_adj_in_table
+{
+  struct bgp_adj_in *slots;
+
+  /* Log2 of the number of slots. */
+  u_char bits;
+
+  /* Number of used slots. */
+  unsigned long count;
+};
+
+#define BGP_ADJ_IN_MIN_BITS    4
+#define BGP_ADJ_IN_SLOTS(T)    (1UL << (T)->bits)
+
 /* BGP advertisement list.  */
 struct bgp_synchronize
 {
@@ -119,8 +134,6 @@ struct bgp_synchronize
       (N)->TYPE = (A)->next;                          \
   } while (0)
 
-#define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
-#define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
 #define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
 #define BGP_ADJ_OUT_DEL(N,A)   BGP_INFO_DEL(N,A,adj_out)
 
@@ -136,7 +149,10 @@ extern int bgp_adj_out_lookup (struct peer *, struct prefix *, afi_t, safi_t,
 
 extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *);
 extern int bgp_adj_in_unset (struct bgp_node *, struct peer *);
-extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
+extern struct bgp_adj_in *bgp_adj_in_lookup (struct bgp_node *,
+					     const struct peer *);
+extern void bgp_adj_in_free (struct peer *, afi_t, safi_t);
+extern void bgp_adj_in_stats (unsigned long *, unsigned long *);
 
 extern struct bgp_advertise *
 bgp_advertise_clean (struct peer *, struct bgp_adj_out *, afi_t, safi_t);
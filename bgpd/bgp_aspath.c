@@ -1881,7 +1881,7 @@ aspath_cmp (const void *arg1, const void *arg2)
 void
 aspath_init (void)
 {
-  ashash = hash_create_size (32768, aspath_key_make, aspath_cmp);
+  ashash = hash_create_open (32768, aspath_key_make, aspath_cmp);
 }
 
 void
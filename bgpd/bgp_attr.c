@@ -563,7 +563,8 @@ attrhash_cmp (const void *p1, const void *p2)
 static void
 attrhash_init (void)
 {
-  attrhash = hash_create (attrhash_key_make, attrhash_cmp);
+  attrhash = hash_create_open (HASH_INITIAL_SIZE, attrhash_key_make,
+                               attrhash_cmp);
 }
 
 /*
@@ -678,6 +679,34 @@ bgp_attr_intern (struct attr *attr)
   return find;
 }
 
+/* Take another reference on an interned attribute.  Same as interning an
+   identical attribute again, without hashing it.  */
+struct attr *
+bgp_attr_ref (struct attr *attr)
+{
+  assert (attr->refcnt);
+
+  if (attr->aspath)
+    attr->aspath->refcnt++;
+  if (attr->community)
+    attr->community->refcnt++;
+  if (attr->extra)
+    {
+      struct attr_extra *attre = attr->extra;
+
+      if (attre->ecommunity)
+        attre->ecommunity->refcnt++;
+      if (attre->cluster)
+        attre->cluster->refcnt++;
+      if (attre->transit)
+        attre->transit->refcnt++;
+    }
+
+  attr->refcnt++;
+
+  return attr;
+}
+
 
 /* Make network statement's attribute. */
 struct attr *
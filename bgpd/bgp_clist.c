@@ -48,6 +48,189 @@ community_list_master_lookup (struct community_list_handler *ch, int master)
   return NULL;
 }
 
+/* Community-list result cache, direct mapped by community serial.  */
+#define COMMUNITY_LIST_CACHE_SIZE      256
+
+struct community_list_cache
+{
+  unsigned long serial;
+
+  /* COMMUNITY_LIST_CACHE_* bits.  */
+  u_char flags;
+#define COMMUNITY_LIST_CACHE_MATCH_VALID   (1 << 0)
+#define COMMUNITY_LIST_CACHE_MATCH         (1 << 1)
+#define COMMUNITY_LIST_CACHE_EXACT_VALID   (1 << 2)
+#define COMMUNITY_LIST_CACHE_EXACT         (1 << 3)
+};
+
+static void
+community_list_cache_flush (struct community_list *list)
+{
+  if (list->cache)
+    memset (list->cache, 0,
+            sizeof (struct community_list_cache) * COMMUNITY_LIST_CACHE_SIZE);
+}
+
+/* Lookup the cached result of an exact (or not) match of com against
+   list.  Return 1 and set *result if there is one.  */
+static int
+community_list_cache_get (struct community_list *list, struct community *com,
+                          int exact, int *result)
+{
+  struct community_list_cache *slot;
+  u_char valid, match;
+
+  if (! com || ! com->serial || ! list->cache)
+    return 0;
+
+  valid = exact ? COMMUNITY_LIST_CACHE_EXACT_VALID
+                : COMMUNITY_LIST_CACHE_MATCH_VALID;
+  match = exact ? COMMUNITY_LIST_CACHE_EXACT : COMMUNITY_LIST_CACHE_MATCH;
+
+  slot = &list->cache[com->serial & (COMMUNITY_LIST_CACHE_SIZE - 1)];
+  if (slot->serial != com->serial || ! (slot->flags & valid))
+    return 0;
+
+  *result = (slot->flags & match) ? 1 : 0;
+  return 1;
+}
+
+static void
+community_list_cache_set (struct community_list *list, struct community *com,
+                          int exact, int result)
+{
+  struct community_list_cache *slot;
+
+  if (! com || ! com->serial)
+    return;
+
+  if (! list->cache)
+    list->cache = XCALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+                           sizeof (struct community_list_cache)
+                           * COMMUNITY_LIST_CACHE_SIZE);
+
+  slot = &list->cache[com->serial & (COMMUNITY_LIST_CACHE_SIZE - 1)];
+  if (slot->serial != com->serial)
+    {
+      slot->serial = com->serial;
+      slot->flags = 0;
+    }
+
+  if (exact)
+    slot->flags |= COMMUNITY_LIST_CACHE_EXACT_VALID
+                   | (result ? COMMUNITY_LIST_CACHE_EXACT : 0);
+  else
+    slot->flags |= COMMUNITY_LIST_CACHE_MATCH_VALID
+                   | (result ? COMMUNITY_LIST_CACHE_MATCH : 0);
+}
+
+/* Bitmap of the hashed community values.  A community can only include
+   another if its bitmap covers the other's.  */
+static u_int32_t
+community_list_sig (struct community *com)
+{
+  u_int32_t sig = 0;
+  int i;
+
+  if (com)
+    for (i = 0; i < com->size; i++)
+      sig |= 1U << ((community_val_get (com, i) * 2654435761U) >> 27);
+
+  return sig;
+}
+
+/* Compile an expanded community-list regexp into a pattern, if it is of
+   the simple form described with struct community_pattern.  */
+static void
+community_pattern_compile (struct community_pattern *pat, const char *str)
+{
+  size_t len = strlen (str);
+  const char *end = str + len;
+  const char *p;
+  u_char anchor = 0;
+
+  memset (pat, 0, sizeof (struct community_pattern));
+
+  if (len && (*str == '^' || *str == '_'))
+    {
+      anchor |= COMMUNITY_PATTERN_HEAD;
+      if (*str == '^')
+        anchor |= COMMUNITY_PATTERN_FIRST;
+      str++;
+    }
+  if (end > str && (end[-1] == '$' || end[-1] == '_'))
+    {
+      anchor |= COMMUNITY_PATTERN_TAIL;
+      if (end[-1] == '$')
+        anchor |= COMMUNITY_PATTERN_LAST;
+      end--;
+    }
+
+  if (end <= str || (size_t)(end - str) >= sizeof (pat->literal))
+    return;
+  for (p = str; p < end; p++)
+    if (! isdigit ((int) *p) && *p != ':')
+      return;
+
+  pat->anchor = anchor;
+  pat->len = end - str;
+  memcpy (pat->literal, str, pat->len);
+}
+
+/* Match a pattern against the i-th of size community values.  */
+static int
+community_pattern_match_val (struct community_pattern *pat, u_int32_t comval,
+                             int i, int size)
+{
+  char buf[sizeof ("65535:65535")];
+  int len;
+
+  if ((pat->anchor & COMMUNITY_PATTERN_FIRST) && i != 0)
+    return 0;
+  if ((pat->anchor & COMMUNITY_PATTERN_LAST) && i != size - 1)
+    return 0;
+
+  /* Well-known communities are shown as words, see community_com2str().  */
+  switch (comval)
+    {
+    case COMMUNITY_INTERNET:
+    case COMMUNITY_NO_EXPORT:
+    case COMMUNITY_NO_ADVERTISE:
+    case COMMUNITY_LOCAL_AS:
+      return 0;
+    }
+
+  len = snprintf (buf, sizeof (buf), "%u:%d",
+                  (comval >> 16) & 0xFFFF, comval & 0xFFFF);
+  if (len < pat->len)
+    return 0;
+
+  switch (pat->anchor & (COMMUNITY_PATTERN_HEAD | COMMUNITY_PATTERN_TAIL))
+    {
+    case COMMUNITY_PATTERN_HEAD | COMMUNITY_PATTERN_TAIL:
+      return len == pat->len && memcmp (buf, pat->literal, len) == 0;
+    case COMMUNITY_PATTERN_HEAD:
+      return memcmp (buf, pat->literal, pat->len) == 0;
+    case COMMUNITY_PATTERN_TAIL:
+      return memcmp (buf + len - pat->len, pat->literal, pat->len) == 0;
+    default:
+      return strstr (buf, pat->literal) != NULL;
+    }
+}
+
+static int
+community_pattern_match (struct community_pattern *pat, struct community *com)
+{
+  int i;
+
+  if (com)
+    for (i = 0; i < com->size; i++)
+      if (community_pattern_match_val (pat, community_val_get (com, i),
+                                       i, com->size))
+        return 1;
+  return 0;
+}
+
 /* Allocate a new community list entry.  */
 static struct community_entry *
 community_entry_new (void)
@@ -96,6 +279,8 @@ community_list_new (void)
 static void
 community_list_free (struct community_list *list)
 {
+  if (list->cache)
+    XFREE (MTYPE_COMMUNITY_LIST_CACHE, list->cache);
   if (list->name)
     XFREE (MTYPE_COMMUNITY_LIST_NAME, list->name);
   XFREE (MTYPE_COMMUNITY_LIST, list);
@@ -277,6 +462,8 @@ community_list_entry_add (struct community_list *list,
   else
     list->head = entry;
   list->tail = entry;
+
+  community_list_cache_flush (list);
 }
 
 /* Delete community-list entry from the list.  */
@@ -295,6 +482,7 @@ community_list_entry_delete (struct community_list *list,
     list->head = entry->next;
 
   community_entry_free (entry);
+  community_list_cache_flush (list);
 
   if (community_list_empty_p (list))
     community_list_delete (list);
@@ -400,23 +588,28 @@ community_str_get (struct community *com, int i)
 /* Internal function to perform regular expression match for
  *  * a single community. */
 static int
-community_regexp_include (regex_t * reg, struct community *com, int i)
+community_regexp_include (struct community_entry *entry,
+                          struct community *com, int i)
 {
-  const char *str;
+  char *str;
+  int ret;
 
   /* When there is no communities attribute it is treated as empty
  *      string.  */
   if (com == NULL || com->size == 0)
-    str = "";
-  else
-    str = community_str_get (com, i);
+    return regexec (entry->reg, "", 0, NULL, 0) == 0;
+
+  if (entry->pattern.len)
+    return community_pattern_match_val (&entry->pattern,
+                                        community_val_get (com, i), 0, 1);
+
+  str = community_str_get (com, i);
 
   /* Regular expression match.  */
-  if (regexec (reg, str, 0, NULL, 0) == 0)
-    return 1;
+  ret = (regexec (entry->reg, str, 0, NULL, 0) == 0);
 
-  /* No match.  */
-  return 0;
+  XFREE (MTYPE_COMMUNITY_STR, str);
+  return ret;
 }
 
 /* Internal function to perform regular expression match for community
@@ -461,12 +654,14 @@ ecommunity_regexp_match (struct ecommunity *ecom, regex_t * reg)
   return 0;
 }
 
-/* When given community attribute matches to the community-list return
-   1 else return 0.  */
-int
-community_list_match (struct community *com, struct community_list *list)
+/* Walk the community-list for a community_list_match(), or with exact set a
+   community_list_exact_match().  */
+static int
+community_list_match_entries (struct community *com,
+                              struct community_list *list, int exact)
 {
   struct community_entry *entry;
+  u_int32_t sig = community_list_sig (com);
 
   for (entry = list->head; entry; entry = entry->next)
     {
@@ -475,21 +670,47 @@ community_list_match (struct community *com, struct community_list *list)
 
       if (entry->style == COMMUNITY_LIST_STANDARD)
         {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
+          if (entry->internet)
             return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
 
-          if (community_match (com, entry->u.com))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+          if (exact)
+            {
+              if (sig == entry->sig && community_cmp (com, entry->u.com))
+                return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+            }
+          else
+            {
+              if ((entry->sig & ~sig) == 0
+                  && community_match (com, entry->u.com))
+                return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+            }
         }
       else if (entry->style == COMMUNITY_LIST_EXPANDED)
         {
-          if (community_regexp_match (com, entry->reg))
+          if (entry->pattern.len
+              ? community_pattern_match (&entry->pattern, com)
+              : community_regexp_match (com, entry->reg))
             return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
         }
     }
   return 0;
 }
 
+/* When given community attribute matches to the community-list return
+   1 else return 0.  */
+int
+community_list_match (struct community *com, struct community_list *list)
+{
+  int ret;
+
+  if (! community_list_cache_get (list, com, 0, &ret))
+    {
+      ret = community_list_match_entries (com, list, 0);
+      community_list_cache_set (list, com, 0, ret);
+    }
+  return ret;
+}
+
 int
 ecommunity_list_match (struct ecommunity *ecom, struct community_list *list)
 {
@@ -520,28 +741,14 @@ int
 community_list_exact_match (struct community *com,
                             struct community_list *list)
 {
-  struct community_entry *entry;
+  int ret;
 
-  for (entry = list->head; entry; entry = entry->next)
+  if (! community_list_cache_get (list, com, 1, &ret))
     {
-      if (entry->any)
-        return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-
-      if (entry->style == COMMUNITY_LIST_STANDARD)
-        {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-
-          if (community_cmp (com, entry->u.com))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-      else if (entry->style == COMMUNITY_LIST_EXPANDED)
-        {
-          if (community_regexp_match (com, entry->reg))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
+      ret = community_list_match_entries (com, list, 1);
+      community_list_cache_set (list, com, 1, ret);
     }
-  return 0;
+  return ret;
 }
 
 /* Delete all permitted communities in the list from com.  */
@@ -576,7 +783,7 @@ community_list_match_delete (struct community *com,
             }
 
           else if ((entry->style == COMMUNITY_LIST_STANDARD)
-                   && (community_include (entry->u.com, COMMUNITY_INTERNET)
+                   && (entry->internet
                        || community_include (entry->u.com, val) ))
             {
               if (entry->direct == COMMUNITY_PERMIT)
@@ -588,7 +795,7 @@ community_list_match_delete (struct community *com,
             }
 
           else if ((entry->style == COMMUNITY_LIST_EXPANDED)
-                   && community_regexp_include (entry->reg, com, i))
+                   && community_regexp_include (entry, com, i))
             {
               if (entry->direct == COMMUNITY_PERMIT)
                 {
@@ -600,10 +807,11 @@ community_list_match_delete (struct community *com,
          }
      }
 
-  /* Delete all of the communities we flagged for deletion */
+  /* Delete all of the communities we flagged for deletion.
+     community_del_val() takes the value as stored, in network order.  */
   for (i = delete_index-1; i >= 0; i--)
     {
-      val = community_val_get (com, com_index_to_delete[i]);
+      val = htonl (community_val_get (com, com_index_to_delete[i]));
       community_del_val (com, &val);
     }
 
@@ -702,6 +910,13 @@ community_list_set (struct community_list_handler *ch,
   entry->u.com = com;
   entry->reg = regex;
   entry->config = (regex ? XSTRDUP (MTYPE_COMMUNITY_LIST_CONFIG, str) : NULL);
+  if (com)
+    {
+      entry->internet = community_include (com, COMMUNITY_INTERNET);
+      entry->sig = community_list_sig (com);
+    }
+  if (regex)
+    community_pattern_compile (&entry->pattern, str);
 
   /* Do not put duplicated community entry.  */
   if (community_list_dup_check (list, entry))
@@ -58,6 +58,29 @@ struct community_list
   /* Community-list entry in this community-list.  */
   struct community_entry *head;
   struct community_entry *tail;
+
+  /* Results of community_list_match() and community_list_exact_match()
+     by interned community, flushed whenever an entry changes.  */
+  struct community_list_cache *cache;
+};
+
+/* Expanded community-list regular expression of the simple form
+   [^_]LITERAL[_$], LITERAL made of digits and ':' only ("^65000:",
+   "_65000:100_", ":100$").  It can only match within a single "AS:VAL"
+   word of the community string, so it is matched value by value without
+   the regex engine.  */
+struct community_pattern
+{
+  /* COMMUNITY_PATTERN_* anchors.  */
+  u_char anchor;
+#define COMMUNITY_PATTERN_HEAD         (1 << 0) /* Start of a value.  */
+#define COMMUNITY_PATTERN_TAIL         (1 << 1) /* End of a value.  */
+#define COMMUNITY_PATTERN_FIRST        (1 << 2) /* First value only.  */
+#define COMMUNITY_PATTERN_LAST         (1 << 3) /* Last value only.  */
+
+  /* Literal length, 0 when the regexp is not of this form.  */
+  u_char len;
+  char literal[sizeof ("65535:65535")];
 };
 
 /* Each entry in community-list.  */
@@ -87,6 +110,15 @@ struct community_entry
 
   /* Expanded community-list regular expression.  */
   regex_t *reg;
+
+  /* Expanded community-list: the same regexp compiled as a pattern, when
+     it is simple enough.  */
+  struct community_pattern pattern;
+
+  /* Standard community-list: whether the values include "internet",
+     which matches anything, and a bitmap of the hashed values.  */
+  u_char internet;
+  u_int32_t sig;
 };
 
 /* Linked list of community-list.  */
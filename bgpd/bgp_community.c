@@ -308,6 +308,14 @@ community_intern (struct community *com)
      hash, it should be freed.  */
   if (find != com)
     community_free (com);
+  else
+    {
+      static unsigned long serial;
+
+      if (++serial == 0)
+        serial++;
+      find->serial = serial;
+    }
 
   /* Increment refrence counter.  */
   find->refcnt++;
@@ -36,6 +36,10 @@ struct community
   /* String of community attribute.  This sring is used by vty output
      and expanded community-list for regular expression match.  */
   char *str;
+
+  /* Unique non-zero number given when interned, so community-lists can
+     cache their results without keeping a reference.  */
+  unsigned long serial;
 };
 
 /* Well-known communities value.  */
@@ -27,6 +27,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "thread.h"
 #include "filter.h"
+#include "linklist.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_damp.h"
@@ -35,10 +36,6 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_attr.h" 
 #include "bgpd/bgp_advertise.h"
 
-/* Global variable to access damping configuration */
-struct bgp_damp_config bgp_damp_cfg;
-static struct bgp_damp_config *damp = &bgp_damp_cfg;
-
 /* Utility macro to add and delete BGP dampening information to no
    used list.  */
 #define BGP_DAMP_LIST_ADD(N,A)  BGP_INFO_ADD(N,A,no_reuse_list)
@@ -46,12 +43,16 @@ static struct bgp_damp_config *damp = &bgp_damp_cfg;
 
 /* Calculate reuse list index by penalty value.  */
 static int
-bgp_reuse_index (int penalty)
+bgp_reuse_index (struct bgp_damp_config *damp, unsigned int penalty)
 {
   unsigned int i;
   int index;
 
-  i = (int)(((double) penalty / damp->reuse_limit - 1.0) * damp->scale_factor);
+  if (penalty <= damp->reuse_limit)
+    i = 0;
+  else
+    i = (((u_int64_t) (penalty - damp->reuse_limit) * damp->reuse_scale_factor)
+         / damp->reuse_limit) >> BGP_DAMP_REUSE_SHIFT;
   
   if ( i >= damp->reuse_index_size )
     i = damp->reuse_index_size - 1;
@@ -65,9 +66,10 @@ bgp_reuse_index (int penalty)
 static void 
 bgp_reuse_list_add (struct bgp_damp_info *bdi)
 {
+  struct bgp_damp_config *damp = bdi->config;
   int index;
 
-  index = bdi->index = bgp_reuse_index (bdi->penalty);
+  index = bdi->index = bgp_reuse_index (damp, bdi->penalty);
 
   bdi->prev = NULL;
   bdi->next = damp->reuse_list[index];
@@ -80,6 +82,8 @@ bgp_reuse_list_add (struct bgp_damp_info *bdi)
 static void
 bgp_reuse_list_delete (struct bgp_damp_info *bdi)
 {
+  struct bgp_damp_config *damp = bdi->config;
+
   if (bdi->next)
     bdi->next->prev = bdi->prev;
   if (bdi->prev)
@@ -90,11 +94,11 @@ bgp_reuse_list_delete (struct bgp_damp_info *bdi)
 
 /* Return decayed penalty value.  */
 int 
-bgp_damp_decay (time_t tdiff, int penalty)
+bgp_damp_decay (struct bgp_damp_config *damp, time_t tdiff, int penalty)
 {
   unsigned int i;
 
-  i = (int) ((double) tdiff / DELTA_T);
+  i = tdiff / DELTA_T;
 
   if (i == 0)
     return penalty; 
@@ -102,7 +106,7 @@ bgp_damp_decay (time_t tdiff, int penalty)
   if (i >= damp->decay_array_size)
     return 0;
 
-  return (int) (penalty * damp->decay_array[i]);
+  return ((u_int64_t) penalty * damp->decay_array[i]) >> BGP_DAMP_DECAY_SHIFT;
 }
 
 /* Handler of reuse timer event.  Each route in the current reuse-list
@@ -110,37 +114,53 @@ bgp_damp_decay (time_t tdiff, int penalty)
 static int
 bgp_reuse_timer (struct thread *t)
 {
+  struct bgp_damp_config *damp = THREAD_ARG (t);
   struct bgp_damp_info *bdi;
   struct bgp_damp_info *next;
-  time_t t_now, t_diff;
+  struct bgp_damp_info *due = NULL;
+  struct bgp_damp_info *reuse = NULL;
+  time_t t_now;
+  unsigned int n;
     
   damp->t_reuse = NULL;
-  damp->t_reuse =
-    thread_add_timer (bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
 
   t_now = bgp_clock ();
 
   /* 1.  save a pointer to the current zeroth queue head and zero the
-     list head entry.  */
-  bdi = damp->reuse_list[damp->reuse_offset];
-  damp->reuse_list[damp->reuse_offset] = NULL;
+     list head entry.
+     2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
+     rotating the circular queue of list-heads.
+     Do this for every list which has come due, so rotations missed
+     while the daemon was busy are caught up rather than delaying every
+     later reuse.  */
+  for (n = 0; damp->reuse_time <= t_now && n < damp->reuse_list_size; n++)
+    {
+      for (bdi = damp->reuse_list[damp->reuse_offset]; bdi; bdi = next)
+	{
+	  next = bdi->next;
+	  bdi->next = due;
+	  due = bdi;
+	}
+      damp->reuse_list[damp->reuse_offset] = NULL;
+      damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+      damp->reuse_time += DELTA_REUSE;
+    }
+  if (damp->reuse_time <= t_now)
+    damp->reuse_time = t_now + DELTA_REUSE;
 
-  /* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
-     rotating the circular queue of list-heads.  */
-  damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+  damp->t_reuse = thread_add_timer (bm->master, bgp_reuse_timer, damp,
+				    damp->reuse_time - t_now);
 
-  /* 3. if ( the saved list head pointer is non-empty ) */
-  for (; bdi; bdi = next)
+  /* 3. if ( the saved list head pointer is non-empty ).  Decay all the
+     due routes first, and set aside those which can be reused.  */
+  for (bdi = due; bdi; bdi = next)
     {
-      struct bgp *bgp = bdi->binfo->peer->bgp;
-      
       next = bdi->next;
 
-      /* Set t-diff = t-now - t-updated.  */
-      t_diff = t_now - bdi->t_updated;
-
-      /* Set figure-of-merit = figure-of-merit * decay-array-ok [t-diff] */
-      bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty);   
+      /* Set figure-of-merit = figure-of-merit * decay-array-ok [t-diff],
+	 with t-diff = t-now - t-updated.  */
+      bdi->penalty = bgp_damp_decay (damp, t_now - bdi->t_updated,
+				     bdi->penalty);
 
       /* Set t-updated = t-now.  */
       bdi->t_updated = t_now;
@@ -148,39 +168,68 @@ bgp_reuse_timer (struct thread *t)
       /* if (figure-of-merit < reuse).  */
       if (bdi->penalty < damp->reuse_limit)
 	{
-	  /* Reuse the route.  */
-	  bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_DAMPED);
-	  bdi->suppress_time = 0;
-
-	  if (bdi->lastrecord == BGP_RECORD_UPDATE)
-	    {
-	      bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_HISTORY);
-	      bgp_aggregate_increment (bgp, &bdi->rn->p, bdi->binfo,
-				       bdi->afi, bdi->safi);   
-	      bgp_process (bgp, bdi->rn, bdi->afi, bdi->safi);
-	    }
-
-	  if (bdi->penalty <= damp->reuse_limit / 2.0)
-	    bgp_damp_info_free (bdi, 1);
-	  else
-	    BGP_DAMP_LIST_ADD (damp, bdi);
+	  bdi->next = reuse;
+	  reuse = bdi;
 	}
       else
 	/* Re-insert into another list (See RFC2439 Section 4.8.6).  */
 	bgp_reuse_list_add (bdi);
     }
 
+  /* Then reuse them in one go.  bgp_process() queues each node once,
+     however many of its routes are reused.  */
+  for (bdi = reuse; bdi; bdi = next)
+    {
+      next = bdi->next;
+
+      bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_DAMPED);
+      bdi->suppress_time = 0;
+
+      if (bdi->lastrecord == BGP_RECORD_UPDATE)
+	{
+	  bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_HISTORY);
+	  bgp_aggregate_increment (damp->bgp, &bdi->rn->p, bdi->binfo,
+				   damp->afi, damp->safi);   
+	  bgp_process (damp->bgp, bdi->rn, damp->afi, damp->safi);
+	}
+
+      if (bdi->penalty <= damp->reuse_limit / 2)
+	{
+	  /* bgp_damp_info_free() unlinks it from the no-reuse list.  */
+	  BGP_DAMP_LIST_ADD (damp, bdi);
+	  bgp_damp_info_free (bdi, 1);
+	}
+      else
+	BGP_DAMP_LIST_ADD (damp, bdi);
+    }
+
   return 0;
 }
 
+/* Parameter set which applies to routes from the peer: its peer-group's
+   profile if there is one, else the BGP instance's.  NULL if routes from
+   the peer are not dampened.  */
+struct bgp_damp_config *
+bgp_damp_config_lookup (struct peer *peer, afi_t afi, safi_t safi)
+{
+  if (peer->af_group[afi][safi] && peer->group->damp[afi][safi])
+    return peer->group->damp[afi][safi];
+
+  if (CHECK_FLAG (peer->bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
+    return peer->bgp->damp[afi][safi];
+
+  return NULL;
+}
+
 /* A route becomes unreachable (RFC2439 Section 4.8.2).  */
 int
 bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
 		   afi_t afi, safi_t safi, int attr_change)
 {
   time_t t_now;
+  struct bgp_damp_config *damp;
   struct bgp_damp_info *bdi = NULL;
-  double last_penalty = 0;
+  unsigned int last_penalty = 0;
   
   t_now = bgp_clock ();
 
@@ -197,26 +246,30 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
          2. set figure-of-merit = 1.
          3. withdraw the route.  */
 
+      damp = bgp_damp_config_lookup (binfo->peer, afi, safi);
+      if (! damp)
+	return BGP_DAMP_NONE;
+
       bdi =  XCALLOC (MTYPE_BGP_DAMP_INFO, sizeof (struct bgp_damp_info));
       bdi->binfo = binfo;
       bdi->rn = rn;
+      bdi->config = damp;
       bdi->penalty = (attr_change ? DEFAULT_PENALTY / 2 : DEFAULT_PENALTY);
       bdi->flap = 1;
       bdi->start_time = t_now;
       bdi->suppress_time = 0;
       bdi->index = -1;
-      bdi->afi = afi;
-      bdi->safi = safi;
       (bgp_info_extra_get (binfo))->damp_info = bdi;
       BGP_DAMP_LIST_ADD (damp, bdi);
     }
   else
     {
+      damp = bdi->config;
       last_penalty = bdi->penalty;
 
       /* 1. Set t-diff = t-now - t-updated.  */
       bdi->penalty = 
-	(bgp_damp_decay (t_now - bdi->t_updated, bdi->penalty) 
+	(bgp_damp_decay (damp, t_now - bdi->t_updated, bdi->penalty) 
 	 + (attr_change ? DEFAULT_PENALTY / 2 : DEFAULT_PENALTY));
 
       if (bdi->penalty > damp->ceiling)
@@ -263,17 +316,19 @@ bgp_damp_update (struct bgp_info *binfo, struct bgp_node *rn,
 		 afi_t afi, safi_t safi)
 {
   time_t t_now;
+  struct bgp_damp_config *damp;
   struct bgp_damp_info *bdi;
   int status;
 
   if (!binfo->extra || !((bdi = binfo->extra->damp_info)))
     return BGP_DAMP_USED;
 
+  damp = bdi->config;
   t_now = bgp_clock ();
   bgp_info_unset_flag (rn, binfo, BGP_INFO_HISTORY);
 
   bdi->lastrecord = BGP_RECORD_UPDATE;
-  bdi->penalty = bgp_damp_decay (t_now - bdi->t_updated, bdi->penalty);
+  bdi->penalty = bgp_damp_decay (damp, t_now - bdi->t_updated, bdi->penalty);
 
   if (! CHECK_FLAG (bdi->binfo->flags, BGP_INFO_DAMPED)
       && (bdi->penalty < damp->suppress_value))
@@ -290,7 +345,7 @@ bgp_damp_update (struct bgp_info *binfo, struct bgp_node *rn,
   else
     status = BGP_DAMP_SUPPRESSED;  
 
-  if (bdi->penalty > damp->reuse_limit / 2.0)
+  if (bdi->penalty > damp->reuse_limit / 2)
     bdi->t_updated = t_now;
   else
     bgp_damp_info_free (bdi, 0);
@@ -303,12 +358,14 @@ int
 bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
 {
   time_t t_now, t_diff;
+  struct bgp_damp_config *damp;
   struct bgp_damp_info *bdi;
   
   assert (binfo->extra && binfo->extra->damp_info);
   
   t_now = bgp_clock ();
   bdi = binfo->extra->damp_info;
+  damp = bdi->config;
  
   if (CHECK_FLAG (binfo->flags, BGP_INFO_DAMPED))
     {
@@ -333,9 +390,9 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
   else
     {
       t_diff = t_now - bdi->t_updated;
-      bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty);
+      bdi->penalty = bgp_damp_decay (damp, t_diff, bdi->penalty);
 
-      if (bdi->penalty <= damp->reuse_limit / 2.0)
+      if (bdi->penalty <= damp->reuse_limit / 2)
         {
           /* release the bdi, bdi->binfo. */  
           bgp_damp_info_free (bdi, 1);
@@ -350,11 +407,13 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
 void
 bgp_damp_info_free (struct bgp_damp_info *bdi, int withdraw)
 {
+  struct bgp_damp_config *damp;
   struct bgp_info *binfo;
 
   if (! bdi)
     return;
 
+  damp = bdi->config;
   binfo = bdi->binfo;
   binfo->extra->damp_info = NULL;
 
@@ -372,9 +431,12 @@ bgp_damp_info_free (struct bgp_damp_info *bdi, int withdraw)
 }
 
 static void
-bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
+bgp_damp_parameter_set (struct bgp_damp_config *damp, int hlife, int reuse,
+			int sup, int maxsup)
 {
   double reuse_max_ratio;
+  double ceiling;
+  double scale_factor;
   unsigned int i;
   double j;
 	
@@ -386,18 +448,25 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
   /* Initialize params per bgp_damp_config. */
   damp->reuse_index_size = REUSE_ARRAY_SIZE;
 
-  damp->ceiling = (int)(damp->reuse_limit * (pow(2, (double)damp->max_suppress_time/damp->half_life))); 
+  /* Keep the ceiling, plus one more penalty, within an int. */
+  ceiling = damp->reuse_limit * pow (2, (double)damp->max_suppress_time/damp->half_life);
+  if (ceiling > INT_MAX - DEFAULT_PENALTY)
+    ceiling = INT_MAX - DEFAULT_PENALTY;
+  damp->ceiling = ceiling;
 
-  /* Decay-array computations */
+  /* Decay-array computations, in fixed point so that decaying a
+     penalty is an integer multiply and shift. */
   damp->decay_array_size = ceil ((double) damp->max_suppress_time / DELTA_T);
+  if (damp->decay_array_size < 2)
+    damp->decay_array_size = 2;
   damp->decay_array = XMALLOC (MTYPE_BGP_DAMP_ARRAY,
-			       sizeof(double) * (damp->decay_array_size));
-  damp->decay_array[0] = 1.0;
-  damp->decay_array[1] = exp ((1.0/((double)damp->half_life/DELTA_T)) * log(0.5));
+			       sizeof(u_int32_t) * (damp->decay_array_size));
 
   /* Calculate decay values for all possible times */
-  for (i = 2; i < damp->decay_array_size; i++)
-    damp->decay_array[i] = damp->decay_array[i-1] * damp->decay_array[1];
+  for (i = 0; i < damp->decay_array_size; i++)
+    damp->decay_array[i] =
+      pow (0.5, (double) i * DELTA_T / damp->half_life)
+      * (1 << BGP_DAMP_DECAY_SHIFT) + 0.5;
 	
   /* Reuse-list computations */
   i = ceil ((double)damp->max_suppress_time / DELTA_REUSE) + 1;
@@ -418,57 +487,52 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
   if ( reuse_max_ratio > j && j != 0 )
     reuse_max_ratio = j;
 
-  damp->scale_factor = (double)damp->reuse_index_size/(reuse_max_ratio - 1);
+  scale_factor = (double)damp->reuse_index_size/(reuse_max_ratio - 1);
+  damp->reuse_scale_factor = scale_factor * (1 << BGP_DAMP_REUSE_SHIFT);
 
   for (i = 0; i < damp->reuse_index_size; i++)
     {
       damp->reuse_index[i] = 
 	(int)(((double)damp->half_life / DELTA_REUSE)
-	      * log10 (1.0 / (damp->reuse_limit * ( 1.0 + ((double)i/damp->scale_factor)))) / log10(0.5));
+	      * log10 (1.0 / (damp->reuse_limit * ( 1.0 + ((double)i/scale_factor)))) / log10(0.5));
     }
 }
 
-int
-bgp_damp_enable (struct bgp *bgp, afi_t afi, safi_t safi, time_t half,
-		 unsigned int reuse, unsigned int suppress, time_t max)
+static struct bgp_damp_config *
+bgp_damp_config_new (struct bgp *bgp, struct peer_group *group,
+		     afi_t afi, safi_t safi, time_t half, unsigned int reuse,
+		     unsigned int suppress, time_t max)
 {
-  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
-    {
-      if (damp->half_life == half
-	  && damp->reuse_limit == reuse
-	  && damp->suppress_value == suppress
-	  && damp->max_suppress_time == max)
-	return 0;
-      bgp_damp_disable (bgp, afi, safi);
-    }
+  struct bgp_damp_config *damp;
 
-  SET_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
-  bgp_damp_parameter_set (half, reuse, suppress, max);
+  damp = XCALLOC (MTYPE_BGP_DAMP_CONFIG, sizeof (struct bgp_damp_config));
+  damp->bgp = bgp;
+  damp->group = group;
+  damp->afi = afi;
+  damp->safi = safi;
+  bgp_damp_parameter_set (damp, half, reuse, suppress, max);
 
   /* Register reuse timer.  */
-  if (! damp->t_reuse)
-    damp->t_reuse = 
-      thread_add_timer (bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
+  damp->reuse_time = bgp_clock () + DELTA_REUSE;
+  damp->t_reuse = 
+    thread_add_timer (bm->master, bgp_reuse_timer, damp, DELTA_REUSE);
 
-  return 0;
+  return damp;
 }
 
-static void
-bgp_damp_config_clean (struct bgp_damp_config *damp)
+static int
+bgp_damp_config_same (struct bgp_damp_config *damp, time_t half,
+		      unsigned int reuse, unsigned int suppress, time_t max)
 {
-  /* Free decay array */
-  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->decay_array);
-
-  /* Free reuse index array */
-  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->reuse_index);
-
-  /* Free reuse list array. */
-  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->reuse_list);
+  return (damp->half_life == half
+	  && damp->reuse_limit == reuse
+	  && damp->suppress_value == suppress
+	  && damp->max_suppress_time == max);
 }
 
 /* Clean all the bgp_damp_info stored in reuse_list. */
-void
-bgp_damp_info_clean (void)
+static void
+bgp_damp_config_info_clean (struct bgp_damp_config *damp)
 {
   unsigned int i;
   struct bgp_damp_info *bdi, *next;
@@ -496,61 +560,165 @@ bgp_damp_info_clean (void)
   damp->no_reuse_list = NULL;
 }
 
-int
-bgp_damp_disable (struct bgp *bgp, afi_t afi, safi_t safi)
+static void
+bgp_damp_config_free (struct bgp_damp_config *damp)
 {
-  /* If it wasn't enabled, there's nothing to do. */
-  if (! CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
-    return 0;
-
   /* Cancel reuse thread. */
   if (damp->t_reuse )
     thread_cancel (damp->t_reuse);
   damp->t_reuse = NULL;
 
   /* Clean BGP dampening information.  */
-  bgp_damp_info_clean ();
+  bgp_damp_config_info_clean (damp);
 
-  /* Clear configuration */
-  bgp_damp_config_clean (&bgp_damp_cfg);
+  /* Free decay array */
+  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->decay_array);
+
+  /* Free reuse index array */
+  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->reuse_index);
+
+  /* Free reuse list array. */
+  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->reuse_list);
+
+  XFREE (MTYPE_BGP_DAMP_CONFIG, damp);
+}
+
+int
+bgp_damp_enable (struct bgp *bgp, afi_t afi, safi_t safi, time_t half,
+		 unsigned int reuse, unsigned int suppress, time_t max)
+{
+  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
+    {
+      if (bgp_damp_config_same (bgp->damp[afi][safi],
+				half, reuse, suppress, max))
+	return 0;
+      bgp_damp_disable (bgp, afi, safi);
+    }
+
+  SET_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
+  bgp->damp[afi][safi] = bgp_damp_config_new (bgp, NULL, afi, safi,
+					      half, reuse, suppress, max);
+  return 0;
+}
+
+int
+bgp_damp_disable (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  /* If it wasn't enabled, there's nothing to do. */
+  if (! CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
+    return 0;
+
+  bgp_damp_config_free (bgp->damp[afi][safi]);
+  bgp->damp[afi][safi] = NULL;
 
   UNSET_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
   return 0;
 }
 
+/* Dampening profile for the members of a peer-group.  Routes which
+   already have a flap history keep the parameter set they started
+   with. */
+int
+bgp_damp_group_enable (struct peer_group *group, afi_t afi, safi_t safi,
+		       time_t half, unsigned int reuse, unsigned int suppress,
+		       time_t max)
+{
+  if (group->damp[afi][safi])
+    {
+      if (bgp_damp_config_same (group->damp[afi][safi],
+				half, reuse, suppress, max))
+	return 0;
+      bgp_damp_group_disable (group, afi, safi);
+    }
+
+  group->damp[afi][safi] = bgp_damp_config_new (group->bgp, group, afi, safi,
+						half, reuse, suppress, max);
+  return 0;
+}
+
+int
+bgp_damp_group_disable (struct peer_group *group, afi_t afi, safi_t safi)
+{
+  if (! group->damp[afi][safi])
+    return 0;
+
+  bgp_damp_config_free (group->damp[afi][safi]);
+  group->damp[afi][safi] = NULL;
+  return 0;
+}
+
+/* Clean the dampening information of an AFI/SAFI, under the BGP
+   instance's parameters and every peer-group profile. */
 void
-bgp_config_write_damp (struct vty *vty)
+bgp_damp_info_clean (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  struct peer_group *group;
+  struct listnode *node, *nnode;
+
+  if (bgp->damp[afi][safi])
+    bgp_damp_config_info_clean (bgp->damp[afi][safi]);
+
+  for (ALL_LIST_ELEMENTS (bgp->group, node, nnode, group))
+    if (group->damp[afi][safi])
+      bgp_damp_config_info_clean (group->damp[afi][safi]);
+}
+
+static void
+bgp_config_write_damp_config (struct vty *vty, struct bgp_damp_config *damp,
+			      const char *who)
 {
-  if (bgp_damp_cfg.half_life == DEFAULT_HALF_LIFE*60
-      && bgp_damp_cfg.reuse_limit == DEFAULT_REUSE
-      && bgp_damp_cfg.suppress_value == DEFAULT_SUPPRESS
-      && bgp_damp_cfg.max_suppress_time == bgp_damp_cfg.half_life*4)
-    vty_out (vty, " bgp dampening%s", VTY_NEWLINE);
-  else if (bgp_damp_cfg.half_life != DEFAULT_HALF_LIFE*60
-	   && bgp_damp_cfg.reuse_limit == DEFAULT_REUSE
-	   && bgp_damp_cfg.suppress_value == DEFAULT_SUPPRESS
-	   && bgp_damp_cfg.max_suppress_time == bgp_damp_cfg.half_life*4)
-    vty_out (vty, " bgp dampening %lld%s",
-	     bgp_damp_cfg.half_life/60LL,
+  if (damp->half_life == DEFAULT_HALF_LIFE*60
+      && damp->reuse_limit == DEFAULT_REUSE
+      && damp->suppress_value == DEFAULT_SUPPRESS
+      && damp->max_suppress_time == damp->half_life*4)
+    vty_out (vty, " %s dampening%s", who, VTY_NEWLINE);
+  else if (damp->half_life != DEFAULT_HALF_LIFE*60
+	   && damp->reuse_limit == DEFAULT_REUSE
+	   && damp->suppress_value == DEFAULT_SUPPRESS
+	   && damp->max_suppress_time == damp->half_life*4)
+    vty_out (vty, " %s dampening %lld%s", who,
+	     damp->half_life/60LL,
 	     VTY_NEWLINE);
   else
-    vty_out (vty, " bgp dampening %lld %d %d %lld%s",
-	     bgp_damp_cfg.half_life/60LL,
-	     bgp_damp_cfg.reuse_limit,
-	     bgp_damp_cfg.suppress_value,
-	     bgp_damp_cfg.max_suppress_time/60LL,
+    vty_out (vty, " %s dampening %lld %d %d %lld%s", who,
+	     damp->half_life/60LL,
+	     damp->reuse_limit,
+	     damp->suppress_value,
+	     damp->max_suppress_time/60LL,
 	     VTY_NEWLINE);
 }
 
+void
+bgp_config_write_damp (struct vty *vty, struct bgp *bgp, afi_t afi,
+		       safi_t safi)
+{
+  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
+    bgp_config_write_damp_config (vty, bgp->damp[afi][safi], "bgp");
+}
+
+void
+bgp_config_write_damp_group (struct vty *vty, struct peer_group *group,
+			     afi_t afi, safi_t safi)
+{
+  char who[BUFSIZ];
+
+  if (! group->damp[afi][safi])
+    return;
+
+  snprintf (who, sizeof (who), "neighbor %s", group->name);
+  bgp_config_write_damp_config (vty, group->damp[afi][safi], who);
+}
+
 static const char *
-bgp_get_reuse_time (unsigned int penalty, char *buf, size_t len)
+bgp_get_reuse_time (struct bgp_damp_config *damp, unsigned int penalty,
+		    char *buf, size_t len)
 {
   time_t reuse_time = 0;
   struct tm *tm = NULL;
 
   if (penalty > damp->reuse_limit)
     {
-      reuse_time = (int) (DELTA_T * ((log((double)damp->reuse_limit/penalty))/(log(damp->decay_array[1])))); 
+      reuse_time = (int) (damp->half_life * log ((double) penalty / damp->reuse_limit) / log (2.0));
 
       if (reuse_time > damp->max_suppress_time)
 	reuse_time = damp->max_suppress_time;
@@ -592,15 +760,14 @@ bgp_damp_info_vty (struct vty *vty, struct bgp_info *binfo)
   /* BGP dampening information.  */
   bdi = binfo->extra->damp_info;
 
-  /* If dampening is not enabled or there is no dampening information,
-     return immediately.  */
-  if (! damp || ! bdi)
+  /* If there is no dampening information, return immediately.  */
+  if (! bdi)
     return;
 
   /* Calculate new penalty.  */
   t_now = bgp_clock ();
   t_diff = t_now - bdi->t_updated;
-  penalty = bgp_damp_decay (t_diff, bdi->penalty);
+  penalty = bgp_damp_decay (bdi->config, t_diff, bdi->penalty);
 
   vty_out (vty, "      Dampinfo: penalty %d, flapped %d times in %s",
            penalty, bdi->flap,
@@ -609,7 +776,8 @@ bgp_damp_info_vty (struct vty *vty, struct bgp_info *binfo)
   if (CHECK_FLAG (binfo->flags, BGP_INFO_DAMPED)
       && ! CHECK_FLAG (binfo->flags, BGP_INFO_HISTORY))
     vty_out (vty, ", reuse in %s",
-	     bgp_get_reuse_time (penalty, timebuf, BGP_UPTIME_LEN));
+	     bgp_get_reuse_time (bdi->config, penalty, timebuf,
+				 BGP_UPTIME_LEN));
 
   vty_out (vty, "%s", VTY_NEWLINE);
 }
@@ -628,23 +796,41 @@ bgp_damp_reuse_time_vty (struct vty *vty, struct bgp_info *binfo,
   /* BGP dampening information.  */
   bdi = binfo->extra->damp_info;
 
-  /* If dampening is not enabled or there is no dampening information,
-     return immediately.  */
-  if (! damp || ! bdi)
+  /* If there is no dampening information, return immediately.  */
+  if (! bdi)
     return NULL;
 
   /* Calculate new penalty.  */
   t_now = bgp_clock ();
   t_diff = t_now - bdi->t_updated;
-  penalty = bgp_damp_decay (t_diff, bdi->penalty);
+  penalty = bgp_damp_decay (bdi->config, t_diff, bdi->penalty);
 
-  return  bgp_get_reuse_time (penalty, timebuf, len);
+  return  bgp_get_reuse_time (bdi->config, penalty, timebuf, len);
+}
+
+static void
+bgp_show_dampening_config (struct vty *vty, struct bgp_damp_config *damp)
+{
+  vty_out (vty, "Half-life time: %ld min%s",
+                damp->half_life / 60, VTY_NEWLINE);
+  vty_out (vty, "Reuse penalty: %d%s",
+                damp->reuse_limit, VTY_NEWLINE);
+  vty_out (vty, "Suppress penalty: %d%s",
+                damp->suppress_value, VTY_NEWLINE);
+  vty_out (vty, "Max suppress time: %ld min%s",
+                damp->max_suppress_time / 60, VTY_NEWLINE);
+  vty_out (vty, "Max supress penalty: %u%s",
+                damp->ceiling, VTY_NEWLINE);
+  vty_out (vty, "%s", VTY_NEWLINE);
 }
 
 int
 bgp_show_dampening_parameters (struct vty *vty, afi_t afi, safi_t safi)
 {
   struct bgp *bgp;
+  struct peer_group *group;
+  struct listnode *node, *nnode;
+
   bgp = bgp_get_default();
 
   if (bgp == NULL)
@@ -654,22 +840,17 @@ bgp_show_dampening_parameters (struct vty *vty, afi_t afi, safi_t safi)
     }
 
   if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
-    {
-      vty_out (vty, "Half-life time: %ld min%s",
-                    damp->half_life / 60, VTY_NEWLINE);
-      vty_out (vty, "Reuse penalty: %d%s",
-                    damp->reuse_limit, VTY_NEWLINE);
-      vty_out (vty, "Suppress penalty: %d%s",
-                    damp->suppress_value, VTY_NEWLINE);
-      vty_out (vty, "Max suppress time: %ld min%s",
-                    damp->max_suppress_time / 60, VTY_NEWLINE);
-      vty_out (vty, "Max supress penalty: %u%s",
-                    damp->ceiling, VTY_NEWLINE);
-      vty_out (vty, "%s", VTY_NEWLINE);
-    }
+    bgp_show_dampening_config (vty, bgp->damp[afi][safi]);
   else
     vty_out (vty, "dampening not enabled for %s%s",
                   afi == AFI_IP ? "IPv4" : "IPv6", VTY_NEWLINE);
 
+  for (ALL_LIST_ELEMENTS (bgp->group, node, nnode, group))
+    if (group->damp[afi][safi])
+      {
+        vty_out (vty, "Peer-group %s:%s", group->name, VTY_NEWLINE);
+        bgp_show_dampening_config (vty, group->damp[afi][safi]);
+      }
+
   return CMD_SUCCESS;
 }
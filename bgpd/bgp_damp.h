@@ -50,6 +50,9 @@ struct bgp_damp_info
   /* Back reference to bgp_node. */
   struct bgp_node *rn;
 
+  /* Parameter set the route is dampened with. */
+  struct bgp_damp_config *config;
+
   /* Current index in the reuse_list. */
   int index;
 
@@ -57,9 +60,6 @@ struct bgp_damp_info
   u_char lastrecord;
 #define BGP_RECORD_UPDATE	1U
 #define BGP_RECORD_WITHDRAW	2U
-
-  afi_t afi;
-  safi_t safi;
 };
 
 /* Specified parameter set configuration. */
@@ -90,11 +90,11 @@ struct bgp_damp_config
   unsigned int ceiling;			/* Max value a penalty can attain */
   unsigned int decay_rate_per_tick;	/* Calculated from half-life */
   unsigned int decay_array_size; /* Calculated using config parameters */
-  double scale_factor;
-  unsigned int reuse_scale_factor; 
+  unsigned int reuse_scale_factor; /* Fixed point, BGP_DAMP_REUSE_SHIFT */
          
-  /* Decay array per-set based. */ 
-  double *decay_array;	
+  /* Decay array per-set based, fixed point with BGP_DAMP_DECAY_SHIFT
+     fractional bits. */ 
+  u_int32_t *decay_array;	
 
   /* Reuse index array per-set based. */ 
   int *reuse_index;
@@ -102,12 +102,22 @@ struct bgp_damp_config
   /* Reuse list array per-set based. */  
   struct bgp_damp_info **reuse_list;
   int reuse_offset;
+
+  /* Time the list at reuse_offset becomes due. */
+  time_t reuse_time;
         
   /* All dampening information which is not on reuse list.  */
   struct bgp_damp_info *no_reuse_list;
 
   /* Reuse timer thread per-set base. */
   struct thread* t_reuse;
+
+  /* Owner of the set: the BGP instance's AFI/SAFI, or a peer-group's
+     profile for it. */
+  struct bgp *bgp;
+  struct peer_group *group;
+  afi_t afi;
+  safi_t safi;
 };
 
 #define BGP_DAMP_NONE           0
@@ -120,6 +130,10 @@ struct bgp_damp_config
 /* Time granularity for decay arrays */
 #define DELTA_T 	           5
 
+/* Fractional bits of decay array entries and of the reuse index scale. */
+#define BGP_DAMP_DECAY_SHIFT      24
+#define BGP_DAMP_REUSE_SHIFT      16
+
 #define DEFAULT_PENALTY         1000
 
 #define DEFAULT_HALF_LIFE         15
@@ -132,14 +146,21 @@ struct bgp_damp_config
 extern int bgp_damp_enable (struct bgp *, afi_t, safi_t, time_t, unsigned int, 
                      unsigned int, time_t);
 extern int bgp_damp_disable (struct bgp *, afi_t, safi_t);
+extern int bgp_damp_group_enable (struct peer_group *, afi_t, safi_t, time_t,
+                                  unsigned int, unsigned int, time_t);
+extern int bgp_damp_group_disable (struct peer_group *, afi_t, safi_t);
+extern struct bgp_damp_config *bgp_damp_config_lookup (struct peer *,
+                                                       afi_t, safi_t);
 extern int bgp_damp_withdraw (struct bgp_info *, struct bgp_node *,
 		       afi_t, safi_t, int);
 extern int bgp_damp_update (struct bgp_info *, struct bgp_node *, afi_t, safi_t);
 extern int bgp_damp_scan (struct bgp_info *, afi_t, safi_t);
 extern void bgp_damp_info_free (struct bgp_damp_info *, int);
-extern void bgp_damp_info_clean (void);
-extern int bgp_damp_decay (time_t, int);
-extern void bgp_config_write_damp (struct vty *);
+extern void bgp_damp_info_clean (struct bgp *, afi_t, safi_t);
+extern int bgp_damp_decay (struct bgp_damp_config *, time_t, int);
+extern void bgp_config_write_damp (struct vty *, struct bgp *, afi_t, safi_t);
+extern void bgp_config_write_damp_group (struct vty *, struct peer_group *,
+                                         afi_t, safi_t);
 extern void bgp_damp_info_vty (struct vty *, struct bgp_info *);
 extern const char * bgp_damp_reuse_time_vty (struct vty *, struct bgp_info *,
                                              char *, size_t);
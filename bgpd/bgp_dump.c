@@ -28,12 +28,22 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "thread.h"
 #include "linklist.h"
 #include "filter.h"
+#include "memory.h"
+#include "network.h"
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_debug.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
 
 enum bgp_dump_type
 {
@@ -87,6 +97,9 @@ struct bgp_dump
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* Routes dump in progress. */
+  struct bgp_dump_walk *walk;
 };
 
 static int bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump);
@@ -221,8 +234,392 @@ bgp_dump_set_size (struct stream *s, int type)
   stream_putl_at (s, 8, stream_get_endp (s) - BGP_DUMP_HEADER_SIZE);
 }
 
+/* Output of a routes dump.  Records are gathered in large chunks, and
+ * written out, compressed if wanted, by a thread of its own.  This way
+ * neither encoding nor the disk holds up the event loop for long.  A
+ * chunk belongs to the event loop from 'head' up to the ones queued
+ * from 'tail', which belong to the writer thread.
+ */
+#define BGP_DUMP_CHUNK_SIZE	(1024 * 1024)
+#define BGP_DUMP_CHUNK_MAX	4
+
+struct bgp_dump_writer
+{
+  int fd;
+#ifdef HAVE_ZLIB
+  gzFile gz;
+#endif /* HAVE_ZLIB */
+
+  u_char *chunk[BGP_DUMP_CHUNK_MAX];
+  size_t len[BGP_DUMP_CHUNK_MAX];
+  int head;
+  int tail;
+
+  /* Number of chunks queued for writing, whether the writer is to finish
+     once they are written, and whether it has.  Under 'mutex'. */
+  int queued;
+  int closing;
+  int done;
+
+  /* errno of the first failed write. */
+  int error;
+
+#ifdef HAVE_PTHREAD
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  /* The writer thread wakes the event loop through this pipe whenever a
+     chunk is free again, and when it is done. */
+  int wakeup[2];
+  struct thread *t_wakeup;
+#endif /* HAVE_PTHREAD */
+};
+
+/* A routes dump in progress. */
+struct bgp_dump_walk
+{
+  afi_t afi;
+  unsigned int seq;
+  bgp_table_iter_t iter;
+  struct thread *t_walk;
+
+  /* Peers in the index table, locked for the duration of the dump.  Paths
+     of peers configured since are left out. */
+  struct peer **peers;
+  int peer_count;
+
+  struct bgp_dump_writer *writer;
+  struct timeval started;
+  unsigned long prefixes;
+};
+
+/* Prefixes encoded per event loop quantum. */
+#define BGP_DUMP_ROUTES_QUANTUM	1000
+
+static int bgp_dump_routes_walk (struct thread *);
+static void bgp_dump_routes_end (struct bgp_dump *);
+
+/* Write out one chunk.  Runs in the writer thread, so it must not use
+   anything of libzebra. */
+static void
+bgp_dump_writer_flush (struct bgp_dump_writer *w, int i)
+{
+  u_char *p = w->chunk[i];
+  size_t left = w->len[i];
+  ssize_t n;
+
+  w->len[i] = 0;
+  if (w->error)
+    return;
+
+#ifdef HAVE_ZLIB
+  if (w->gz)
+    {
+      if (left && gzwrite (w->gz, p, left) <= 0)
+	w->error = EIO;
+      return;
+    }
+#endif /* HAVE_ZLIB */
+
+  while (left)
+    {
+      n = write (w->fd, p, left);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  w->error = errno;
+	  return;
+	}
+      p += n;
+      left -= n;
+    }
+}
+
+static void
+bgp_dump_writer_close_file (struct bgp_dump_writer *w)
+{
+#ifdef HAVE_ZLIB
+  if (w->gz)
+    {
+      if (gzclose (w->gz) != Z_OK && ! w->error)
+	w->error = EIO;
+      w->gz = NULL;
+      w->fd = -1;
+      return;
+    }
+#endif /* HAVE_ZLIB */
+
+  if (close (w->fd) < 0 && ! w->error)
+    w->error = errno;
+  w->fd = -1;
+}
+
+#ifdef HAVE_PTHREAD
+/* Wake the main thread up.  Nothing to do if that fails: the pipe is
+   only full when a wakeup is pending already. */
+static void
+bgp_dump_writer_signal (struct bgp_dump_writer *w)
+{
+  char c = 0;
+
+  if (write (w->wakeup[1], &c, 1) < 0)
+    {
+      /* ignore */
+    }
+}
+
+static void *
+bgp_dump_writer_run (void *arg)
+{
+  struct bgp_dump_writer *w = arg;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&w->mutex);
+      while (! w->queued && ! w->closing)
+	pthread_cond_wait (&w->cond, &w->mutex);
+      if (! w->queued)
+	{
+	  pthread_mutex_unlock (&w->mutex);
+	  break;
+	}
+      pthread_mutex_unlock (&w->mutex);
+
+      bgp_dump_writer_flush (w, w->tail);
+      w->tail = (w->tail + 1) % BGP_DUMP_CHUNK_MAX;
+
+      pthread_mutex_lock (&w->mutex);
+      w->queued--;
+      pthread_mutex_unlock (&w->mutex);
+      bgp_dump_writer_signal (w);
+    }
+
+  bgp_dump_writer_close_file (w);
+
+  pthread_mutex_lock (&w->mutex);
+  w->done = 1;
+  pthread_mutex_unlock (&w->mutex);
+  bgp_dump_writer_signal (w);
+  return NULL;
+}
+
+/* The writer thread freed a chunk or finished: resume the walk, or wrap
+   up the dump. */
+static int
+bgp_dump_writer_wakeup (struct thread *t)
+{
+  struct bgp_dump *bgp_dump = THREAD_ARG (t);
+  struct bgp_dump_walk *walk = bgp_dump->walk;
+  struct bgp_dump_writer *w = walk->writer;
+  char buf[64];
+  int done;
+
+  w->t_wakeup = thread_add_read (bm->master, bgp_dump_writer_wakeup,
+				 bgp_dump, w->wakeup[0]);
+  while (read (w->wakeup[0], buf, sizeof (buf)) > 0)
+    ;
+
+  pthread_mutex_lock (&w->mutex);
+  done = w->done;
+  pthread_mutex_unlock (&w->mutex);
+
+  if (done)
+    bgp_dump_routes_end (bgp_dump);
+  else if (walk->iter.table && ! walk->t_walk)
+    walk->t_walk = thread_add_background (bm->master, bgp_dump_routes_walk,
+					  bgp_dump, 0);
+  return 0;
+}
+#endif /* HAVE_PTHREAD */
+
+static struct bgp_dump_writer *
+bgp_dump_writer_new (struct bgp_dump *bgp_dump, FILE *fp, int compress)
+{
+  struct bgp_dump_writer *w;
+  int i;
+#ifdef HAVE_PTHREAD
+  sigset_t mask, oldmask;
+  int ret;
+#endif /* HAVE_PTHREAD */
+
+  w = XCALLOC (MTYPE_BGP_DUMP, sizeof (struct bgp_dump_writer));
+  w->fd = dup (fileno (fp));
+  fclose (fp);
+  if (w->fd < 0)
+    {
+      zlog_warn ("bgp_dump_writer_new: dup: %s", safe_strerror (errno));
+      XFREE (MTYPE_BGP_DUMP, w);
+      return NULL;
+    }
+
+#ifdef HAVE_ZLIB
+  if (compress && (w->gz = gzdopen (w->fd, "wb")) == NULL)
+    {
+      zlog_warn ("bgp_dump_writer_new: gzdopen failed");
+      close (w->fd);
+      XFREE (MTYPE_BGP_DUMP, w);
+      return NULL;
+    }
+#endif /* HAVE_ZLIB */
+
+  for (i = 0; i < BGP_DUMP_CHUNK_MAX; i++)
+    w->chunk[i] = XMALLOC (MTYPE_BGP_DUMP, BGP_DUMP_CHUNK_SIZE);
+
+#ifdef HAVE_PTHREAD
+  w->wakeup[0] = w->wakeup[1] = -1;
+  if (pipe (w->wakeup) < 0)
+    {
+      zlog_warn ("bgp_dump_writer_new: pipe: %s", safe_strerror (errno));
+      return w;
+    }
+  set_nonblocking (w->wakeup[0]);
+  set_nonblocking (w->wakeup[1]);
+
+  pthread_mutex_init (&w->mutex, NULL);
+  pthread_cond_init (&w->cond, NULL);
+
+  /* Signals are for the event loop to handle. */
+  sigfillset (&mask);
+  pthread_sigmask (SIG_SETMASK, &mask, &oldmask);
+  ret = pthread_create (&w->thread, NULL, bgp_dump_writer_run, w);
+  pthread_sigmask (SIG_SETMASK, &oldmask, NULL);
+
+  if (ret)
+    {
+      zlog_warn ("bgp_dump_writer_new: pthread_create: %s",
+		 safe_strerror (ret));
+      pthread_mutex_destroy (&w->mutex);
+      pthread_cond_destroy (&w->cond);
+      close (w->wakeup[0]);
+      close (w->wakeup[1]);
+      w->wakeup[0] = w->wakeup[1] = -1;
+      return w;
+    }
+
+  w->t_wakeup = thread_add_read (bm->master, bgp_dump_writer_wakeup,
+				 bgp_dump, w->wakeup[0]);
+#endif /* HAVE_PTHREAD */
+
+  return w;
+}
+
+/* Whether the writer writes in a thread of its own, rather than when
+   chunks are handed to it. */
+static int
+bgp_dump_writer_threaded (struct bgp_dump_writer *w)
+{
+#ifdef HAVE_PTHREAD
+  return w->wakeup[0] >= 0;
+#else
+  return 0;
+#endif /* HAVE_PTHREAD */
+}
+
+/* Whether the chunk at 'head' is free to be filled. */
+static int
+bgp_dump_writer_ready (struct bgp_dump_writer *w)
+{
+#ifdef HAVE_PTHREAD
+  int ready;
+
+  if (bgp_dump_writer_threaded (w))
+    {
+      pthread_mutex_lock (&w->mutex);
+      ready = w->queued < BGP_DUMP_CHUNK_MAX;
+      pthread_mutex_unlock (&w->mutex);
+      return ready;
+    }
+#endif /* HAVE_PTHREAD */
+  return 1;
+}
+
+/* Hand the chunk at 'head' over for writing. */
+static void
+bgp_dump_writer_push (struct bgp_dump_writer *w)
+{
+  if (! w->len[w->head])
+    return;
+
+  if (! bgp_dump_writer_threaded (w))
+    {
+      bgp_dump_writer_flush (w, w->head);
+      return;
+    }
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock (&w->mutex);
+  w->queued++;
+  pthread_cond_signal (&w->cond);
+  pthread_mutex_unlock (&w->mutex);
+#endif /* HAVE_PTHREAD */
+  w->head = (w->head + 1) % BGP_DUMP_CHUNK_MAX;
+}
+
+/* Append an encoded record.  The caller made sure it fits. */
+static void
+bgp_dump_writer_put (struct bgp_dump_writer *w, struct stream *s)
+{
+  memcpy (w->chunk[w->head] + w->len[w->head], STREAM_DATA (s),
+	  stream_get_endp (s));
+  w->len[w->head] += stream_get_endp (s);
+}
+
+/* Whether a record of up to 'size' bytes fits the chunk at 'head'. */
+static int
+bgp_dump_writer_room (struct bgp_dump_writer *w, size_t size)
+{
+  return BGP_DUMP_CHUNK_SIZE - w->len[w->head] >= size;
+}
+
+/* Write out what is left and close the file.  With a writer thread this
+   only starts it, and bgp_dump_writer_wakeup () notices the end. */
+static void
+bgp_dump_writer_close (struct bgp_dump_writer *w)
+{
+  bgp_dump_writer_push (w);
+
+  if (! bgp_dump_writer_threaded (w))
+    {
+      bgp_dump_writer_close_file (w);
+      w->done = 1;
+      return;
+    }
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock (&w->mutex);
+  w->closing = 1;
+  pthread_cond_signal (&w->cond);
+  pthread_mutex_unlock (&w->mutex);
+#endif /* HAVE_PTHREAD */
+}
+
+/* Free the writer once closed, waiting for its thread if need be. */
+static void
+bgp_dump_writer_free (struct bgp_dump_writer *w)
+{
+  int i;
+
+#ifdef HAVE_PTHREAD
+  if (bgp_dump_writer_threaded (w))
+    {
+      THREAD_OFF (w->t_wakeup);
+      pthread_join (w->thread, NULL);
+      pthread_mutex_destroy (&w->mutex);
+      pthread_cond_destroy (&w->cond);
+      close (w->wakeup[0]);
+      close (w->wakeup[1]);
+    }
+#endif /* HAVE_PTHREAD */
+
+  for (i = 0; i < BGP_DUMP_CHUNK_MAX; i++)
+    XFREE (MTYPE_BGP_DUMP, w->chunk[i]);
+  XFREE (MTYPE_BGP_DUMP, w);
+}
+
 static void
-bgp_dump_routes_index_table(struct bgp *bgp)
+bgp_dump_routes_index_table (struct bgp_dump_walk *walk, struct bgp *bgp)
 {
   struct peer *peer;
   struct listnode *node;
@@ -253,6 +650,9 @@ bgp_dump_routes_index_table(struct bgp *bgp)
   /* Peer count */
   stream_putw (obuf, listcount(bgp->peer));
 
+  walk->peers = XCALLOC (MTYPE_BGP_DUMP,
+			 (listcount (bgp->peer) + 1) * sizeof (struct peer *));
+
   /* Walk down all peers */
   for(ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
     {
@@ -287,119 +687,261 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
       /* Store the peer number for this peer */
       peer->table_dump_index = peerno;
+      walk->peers[peerno] = peer_lock (peer);
       peerno++;
     }
+  walk->peer_count = peerno;
 
   bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
-  fflush (bgp_dump_routes.fp);
+  bgp_dump_writer_put (walk->writer, obuf);
 }
 
-
-/* Runs under child process. */
-static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+/* Encode the RIB entry of one prefix. */
+static void
+bgp_dump_routes_node (struct bgp_dump_walk *walk, struct bgp_node *rn)
 {
   struct stream *obuf;
   struct bgp_info *info;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct bgp_table *table;
+  struct peer *peer;
+  int sizep;
+  uint16_t entry_count = 0;
 
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
+  obuf = bgp_dump_obuf;
+  stream_reset(obuf);
 
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
+  /* MRT header */
+  if (walk->afi == AFI_IP)
+    bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST,
+		     BGP_DUMP_ROUTES);
+  else if (walk->afi == AFI_IP6)
+    bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST,
+		     BGP_DUMP_ROUTES);
 
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if(first_run)
-    bgp_dump_routes_index_table(bgp);
+  /* Sequence number */
+  stream_putl(obuf, walk->seq);
 
-  obuf = bgp_dump_obuf;
-  stream_reset(obuf);
+  /* Prefix length */
+  stream_putc (obuf, rn->p.prefixlen);
+
+  /* Prefix */
+  if (walk->afi == AFI_IP)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
+    }
+  else if (walk->afi == AFI_IP6)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
+    }
+
+  /* Save where we are now, so we can overwride the entry count later */
+  sizep = stream_get_endp(obuf);
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
+  /* Entry count, note that this is overwritten later */
+  stream_putw(obuf, 0);
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (info = rn->info; info; info = info->next)
     {
-      if(!rn->info)
-        continue;
+      peer = info->peer;
+      if (peer->table_dump_index >= walk->peer_count
+	  || walk->peers[peer->table_dump_index] != peer)
+	continue;
 
-      stream_reset(obuf);
+      entry_count++;
 
-      /* MRT header */
-      if (afi == AFI_IP)
-	bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST,
-			 BGP_DUMP_ROUTES);
-      else if (afi == AFI_IP6)
-	bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST,
-			 BGP_DUMP_ROUTES);
+      /* Peer index */
+      stream_putw(obuf, peer->table_dump_index);
 
-      /* Sequence number */
-      stream_putl(obuf, seq);
+      /* Originated */
+#ifdef HAVE_CLOCK_MONOTONIC
+      stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
+#else
+      stream_putl (obuf, info->uptime);
+#endif /* HAVE_CLOCK_MONOTONIC */
 
-      /* Prefix length */
-      stream_putc (obuf, rn->p.prefixlen);
+      /* Dump attribute. */
+      /* Skip prefix & AFI/SAFI for MP_NLRI */
+      bgp_dump_routes_attr (obuf, info->attr, &rn->p);
+    }
 
-      /* Prefix */
-      if (afi == AFI_IP)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
-        }
-      else if (afi == AFI_IP6)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
-        }
+  if (! entry_count)
+    return;
 
-      /* Save where we are now, so we can overwride the entry count later */
-      int sizep = stream_get_endp(obuf);
+  /* Overwrite the entry count, now that we know the right number */
+  stream_putw_at (obuf, sizep, entry_count);
 
-      /* Entry count */
-      uint16_t entry_count = 0;
+  walk->seq++;
+  walk->prefixes++;
 
-      /* Entry count, note that this is overwritten later */
-      stream_putw(obuf, 0);
+  bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
+  bgp_dump_writer_put (walk->writer, obuf);
+}
 
-      for (info = rn->info; info; info = info->next)
-        {
-          entry_count++;
+/* Dump the next stretch of the table, IPv4 then IPv6.  The walk pauses
+   after a quantum, and also while all chunks are with the writer. */
+static int
+bgp_dump_routes_walk (struct thread *t)
+{
+  struct bgp_dump *bgp_dump = THREAD_ARG (t);
+  struct bgp_dump_walk *walk = bgp_dump->walk;
+  struct bgp_dump_writer *w = walk->writer;
+  struct bgp_node *rn;
+  struct bgp *bgp;
+  int count = 0;
 
-          /* Peer index */
-          stream_putw(obuf, info->peer->table_dump_index);
+  walk->t_walk = NULL;
 
-          /* Originated */
-#ifdef HAVE_CLOCK_MONOTONIC
-          stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
-#else
-          stream_putl (obuf, info->uptime);
-#endif /* HAVE_CLOCK_MONOTONIC */
+  while (walk->iter.table)
+    {
+      /* A record is never larger than the scratch stream. */
+      if (! bgp_dump_writer_room (w, STREAM_SIZE (bgp_dump_obuf)))
+	{
+	  bgp_dump_writer_push (w);
+	  if (! bgp_dump_writer_ready (w))
+	    {
+	      /* bgp_dump_writer_wakeup () resumes once a chunk is free. */
+	      bgp_table_iter_pause (&walk->iter);
+	      return 0;
+	    }
+	}
 
-          /* Dump attribute. */
-          /* Skip prefix & AFI/SAFI for MP_NLRI */
-          bgp_dump_routes_attr (obuf, info->attr, &rn->p);
-        }
+      rn = bgp_table_iter_next (&walk->iter);
+      if (! rn)
+	{
+	  bgp_table_iter_cleanup (&walk->iter);
+	  bgp = bgp_get_default ();
+	  if (walk->afi == AFI_IP && bgp)
+	    {
+	      walk->afi = AFI_IP6;
+	      bgp_table_iter_init (&walk->iter, bgp->rib[AFI_IP6][SAFI_UNICAST]);
+	    }
+	  continue;
+	}
+
+      if (! rn->info)
+	continue;
+
+      bgp_dump_routes_node (walk, rn);
+
+      if (++count >= BGP_DUMP_ROUTES_QUANTUM)
+	{
+	  bgp_table_iter_pause (&walk->iter);
+	  walk->t_walk = thread_add_background (bm->master,
+						bgp_dump_routes_walk,
+						bgp_dump, 0);
+	  return 0;
+	}
+    }
+
+  bgp_dump_writer_close (w);
+
+  /* A writer thread is done only once it has written out the rest, and
+     then tells bgp_dump_writer_wakeup (). */
+  if (! bgp_dump_writer_threaded (w))
+    bgp_dump_routes_end (bgp_dump);
+  return 0;
+}
+
+static void
+bgp_dump_routes_free (struct bgp_dump *bgp_dump)
+{
+  struct bgp_dump_walk *walk = bgp_dump->walk;
+  int i;
+
+  THREAD_OFF (walk->t_walk);
+  if (walk->iter.table)
+    bgp_table_iter_cleanup (&walk->iter);
+  for (i = 0; i < walk->peer_count; i++)
+    peer_unlock (walk->peers[i]);
+  if (walk->peers)
+    XFREE (MTYPE_BGP_DUMP, walk->peers);
+  if (walk->writer)
+    bgp_dump_writer_free (walk->writer);
+
+  XFREE (MTYPE_BGP_DUMP, walk);
+  bgp_dump->walk = NULL;
+}
+
+/* The dump is written out. */
+static void
+bgp_dump_routes_end (struct bgp_dump *bgp_dump)
+{
+  struct bgp_dump_walk *walk = bgp_dump->walk;
+  struct timeval now;
 
-      /* Overwrite the entry count, now that we know the right number */
-      stream_putw_at (obuf, sizep, entry_count);
+  if (walk->writer->error)
+    zlog_warn ("bgp_dump_routes: %s: %s", bgp_dump->filename,
+	       safe_strerror (walk->writer->error));
+  else if (BGP_DEBUG (normal, NORMAL))
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+      zlog_debug ("bgp_dump_routes: %lu prefixes in %ld ms",
+		  walk->prefixes,
+		  (now.tv_sec - walk->started.tv_sec) * 1000
+		  + (now.tv_usec - walk->started.tv_usec) / 1000);
+    }
+
+  bgp_dump_routes_free (bgp_dump);
+}
+
+/* Abandon a dump in progress.  What has been encoded so far still gets
+   written out. */
+static void
+bgp_dump_routes_stop (struct bgp_dump *bgp_dump)
+{
+  struct bgp_dump_walk *walk = bgp_dump->walk;
 
-      seq++;
+  if (! walk)
+    return;
 
-      bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-      fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+  if (walk->writer)
+    bgp_dump_writer_close (walk->writer);
+  bgp_dump_routes_free (bgp_dump);
+}
 
+/* Start dumping the routing table into the file just opened.  The dump
+   is gzip compressed when the file name ends in ".gz". */
+static void
+bgp_dump_routes_start (struct bgp_dump *bgp_dump)
+{
+  struct bgp_dump_walk *walk;
+  struct bgp *bgp;
+  size_t len;
+  int compress = 0;
+
+  bgp = bgp_get_default ();
+  if (! bgp)
+    {
+      fclose (bgp_dump->fp);
+      bgp_dump->fp = NULL;
+      return;
+    }
+
+  len = strlen (bgp_dump->filename);
+  if (len > 3 && strcmp (bgp_dump->filename + len - 3, ".gz") == 0)
+    compress = 1;
+
+  walk = XCALLOC (MTYPE_BGP_DUMP, sizeof (struct bgp_dump_walk));
+  walk->writer = bgp_dump_writer_new (bgp_dump, bgp_dump->fp, compress);
+  bgp_dump->fp = NULL;
+  bgp_dump->walk = walk;
+  if (! walk->writer)
+    {
+      bgp_dump_routes_free (bgp_dump);
+      return;
     }
 
-  fflush (bgp_dump_routes.fp);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &walk->started);
 
-  return seq;
+  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers. */
+  bgp_dump_routes_index_table (walk, bgp);
+
+  walk->afi = AFI_IP;
+  bgp_table_iter_init (&walk->iter, bgp->rib[AFI_IP][SAFI_UNICAST]);
+  walk->t_walk = thread_add_background (bm->master, bgp_dump_routes_walk,
+					bgp_dump, 0);
 }
 
 static int
@@ -409,18 +951,19 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
+  /* A routes dump still being written keeps its file. */
+  if (bgp_dump->walk)
+    zlog_warn ("bgp_dump_routes: previous dump still in progress, "
+	       "skipping this one");
+
   /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
+  else if (bgp_dump_open_file (bgp_dump) != NULL)
     {
-      /* In case of bgp_dump_routes, we need special route dump function. */
+      /* In case of bgp_dump_routes, we need special route dump function.
+       * The file is handed over to the dump: for a RIB dump there's no
+       * point in leaving it open until the next scheduled dump starts. */
       if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
+	bgp_dump_routes_start (bgp_dump);
     }
 
   /* if interval is set reschedule */
@@ -668,6 +1211,9 @@ bgp_dump_set (struct vty *vty, struct bgp_dump *bgp_dump,
 static int
 bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
 {
+  /* Stopping a routes dump in progress. */
+  bgp_dump_routes_stop (bgp_dump);
+
   /* Removing file name. */
   if (bgp_dump->filename)
     {
@@ -853,6 +1399,8 @@ bgp_dump_init (void)
 void
 bgp_dump_finish (void)
 {
+  bgp_dump_routes_stop (&bgp_dump_routes);
+
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
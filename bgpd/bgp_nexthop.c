@@ -479,9 +479,7 @@ bgp_scan (afi_t afi, safi_t safi)
 		    }
 		}
 
-              if (CHECK_FLAG (bgp->af_flags[afi][SAFI_UNICAST],
-		  BGP_CONFIG_DAMPENING)
-                  &&  bi->extra && bi->extra->damp_info )
+              if (bi->extra && bi->extra->damp_info)
                 if (bgp_damp_scan (bi, afi, SAFI_UNICAST))
 		  bgp_aggregate_increment (bgp, &rn->p, bi,
 					   afi, SAFI_UNICAST);
@@ -1610,7 +1610,7 @@ bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
 }
 
 /* Parse BGP Update packet and make attribute object. */
-static int
+int
 bgp_update_receive (struct peer *peer, bgp_size_t size)
 {
   int ret, nlri_ret;
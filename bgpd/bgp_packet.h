@@ -52,6 +52,7 @@ extern void bgp_default_update_send (struct peer *, struct attr *,
 			      afi_t, safi_t, struct peer *);
 extern void bgp_default_withdraw_send (struct peer *, afi_t, safi_t);
 
+extern int bgp_update_receive (struct peer *, bgp_size_t);
 extern int bgp_capability_receive (struct peer *, bgp_size_t);
 
 extern int bgp_nlri_parse (struct peer *, struct attr *, struct bgp_nlri *);
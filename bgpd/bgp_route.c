@@ -571,9 +571,10 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
   return -1;
 }
 
+/* Inbound distribute-list and prefix-list, which look at the prefix.  */
 static enum filter_type
-bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
-		  afi_t afi, safi_t safi)
+bgp_input_filter_prefix (struct peer *peer, struct prefix *p,
+			 afi_t afi, safi_t safi)
 {
   struct bgp_filter *filter;
 
@@ -599,15 +600,29 @@ bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
       return FILTER_DENY;
   }
   
+  return FILTER_PERMIT;
+#undef FILTER_EXIST_WARN
+}
+
+/* Inbound filter-list, which only looks at the AS path.  */
+static enum filter_type
+bgp_input_filter_aspath (struct peer *peer, struct attr *attr,
+			 afi_t afi, safi_t safi)
+{
+  struct bgp_filter *filter;
+
+  filter = &peer->filter[afi][safi];
+
   if (FILTER_LIST_IN_NAME (filter)) {
-    FILTER_EXIST_WARN(FILTER_LIST, as, filter);
+    if (BGP_DEBUG (update, UPDATE_IN) && !FILTER_LIST_IN (filter))
+      plog_warn (peer->log, "%s: Could not find configured input as-list %s!",
+		 peer->host, FILTER_LIST_IN_NAME (filter));
     
     if (as_list_apply (FILTER_LIST_IN (filter), attr->aspath)== AS_FILTER_DENY)
       return FILTER_DENY;
   }
   
   return FILTER_PERMIT;
-#undef FILTER_EXIST_WARN
 }
 
 static enum filter_type
@@ -1870,7 +1885,7 @@ bgp_rib_withdraw (struct bgp_node *rn, struct bgp_info *ri, struct peer *peer,
   /* apply dampening, if result is suppressed, we'll be retaining 
    * the bgp_info in the RIB for historical reference.
    */
-  if (CHECK_FLAG (peer->bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING)
+  if (bgp_damp_config_lookup (peer, afi, safi)
       && peer->sort == BGP_PEER_EBGP)
     if ( (status = bgp_damp_withdraw (ri, rn, afi, safi, 0)) 
          == BGP_DAMP_SUPPRESSED)
@@ -2104,13 +2119,143 @@ bgp_withdraw_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
   bgp_unlock_node (rn);
 }
 
+/* Inbound policy for the path attributes of an UPDATE.  The parts that do
+   not depend on the prefix are worked out once by bgp_update_batch_start()
+   and shared by all the NLRI the UPDATE carries.  */
+struct bgp_update_batch
+{
+  /* Why every prefix is denied ahead of the per-prefix filters (AS path
+     loop, originator or cluster checks), or NULL.  */
+  const char *reason;
+
+  /* The AS path filter-list denies the attribute.  */
+  int aspath_deny;
+
+  /* An inbound route-map may match on the prefix, so with one configured
+     the post-policy attribute is worked out for each prefix.  */
+  int per_prefix;
+
+  /* Otherwise, why the post-policy attribute is denied, or the attribute
+     itself interned once for the batch.  */
+  const char *attr_reason;
+  struct attr new_attr;
+  struct attr_extra new_extra;
+  struct attr *attr_new;
+};
+
+/* AS path loop and route reflector checks on a received attribute.
+   Returns the reason it is denied, or NULL.  */
+static const char *
+bgp_update_loop_check (struct peer *peer, struct attr *attr,
+		       afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
+  int aspath_loop_count = 0;
+
+  /* AS path local-as loop check. */
+  if (peer->change_local_as)
+    {
+      if (! CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND))
+	aspath_loop_count = 1;
+
+      if (aspath_loop_check (attr->aspath, peer->change_local_as) > aspath_loop_count) 
+	return "as-path contains our own AS;";
+    }
+
+  /* AS path loop check. */
+  if (aspath_loop_check (attr->aspath, bgp->as) > peer->allowas_in[afi][safi]
+      || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)
+	  && aspath_loop_check(attr->aspath, bgp->confed_id)
+	  > peer->allowas_in[afi][safi]))
+    return "as-path contains our own AS;";
+
+  /* Route reflector originator ID check.  */
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
+      && IPV4_ADDR_SAME (&bgp->router_id, &attr->extra->originator_id))
+    return "originator is us;";
+
+  /* Route reflector cluster ID check.  */
+  if (bgp_cluster_filter (peer, attr))
+    return "reflected from the same cluster;";
+
+  return NULL;
+}
+
+/* Next hop checks on the post-policy attribute.  Returns the reason it is
+   denied, or NULL.  */
+static const char *
+bgp_update_nexthop_check (struct peer *peer, struct attr *attr,
+			  afi_t afi, safi_t safi)
+{
+  /* IPv4 unicast next hop check.  */
+  if (afi == AFI_IP && safi == SAFI_UNICAST)
+    {
+      /* If the peer is EBGP and nexthop is not on connected route,
+	 discard it.  */
+      if (peer->sort == BGP_PEER_EBGP && peer->ttl == 1
+	  && ! bgp_nexthop_onlink (afi, attr)
+	  && ! CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
+	return "non-connected next-hop;";
+
+      /* Next hop must not be 0.0.0.0 nor Class D/E address. Next hop
+	 must not be my own address.  */
+      if (attr->nexthop.s_addr == 0
+	  || IPV4_CLASS_DE (ntohl (attr->nexthop.s_addr))
+	  || bgp_nexthop_self (attr))
+	return "martian next-hop;";
+    }
+  return NULL;
+}
+
+static void
+bgp_update_batch_start (struct bgp_update_batch *batch, struct peer *peer,
+			struct attr *attr, afi_t afi, safi_t safi)
+{
+  memset (batch, 0, sizeof (struct bgp_update_batch));
+
+  batch->reason = bgp_update_loop_check (peer, attr, afi, safi);
+  if (batch->reason)
+    return;
+
+  if (bgp_input_filter_aspath (peer, attr, afi, safi) == FILTER_DENY)
+    {
+      batch->aspath_deny = 1;
+      return;
+    }
+
+  if (ROUTE_MAP_IN_NAME (&peer->filter[afi][safi]))
+    {
+      batch->per_prefix = 1;
+      return;
+    }
+
+  /* Without a route-map only the peer's weight is applied, the prefix is
+     not looked at.  */
+  batch->new_attr.extra = &batch->new_extra;
+  bgp_attr_dup (&batch->new_attr, attr);
+  bgp_input_modifier (peer, NULL, &batch->new_attr, afi, safi);
+
+  batch->attr_reason = bgp_update_nexthop_check (peer, &batch->new_attr,
+						 afi, safi);
+  if (! batch->attr_reason)
+    batch->attr_new = bgp_attr_intern (&batch->new_attr);
+}
+
+static void
+bgp_update_batch_finish (struct bgp_update_batch *batch)
+{
+  if (batch->attr_new)
+    bgp_attr_unintern (&batch->attr_new);
+  bgp_attr_flush (&batch->new_attr);
+}
+
 static int
 bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	    afi_t afi, safi_t safi, int type, int sub_type,
-	    struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+	    struct prefix_rd *prd, u_char *tag, int soft_reconfig,
+	    struct bgp_update_batch *batch)
 {
   int ret;
-  int aspath_loop_count = 0;
   struct bgp_node *rn;
   struct bgp *bgp;
   struct attr new_attr;
@@ -2138,92 +2283,55 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
     if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
       break;
 
-  /* AS path local-as loop check. */
-  if (peer->change_local_as)
-    {
-      if (! CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND))
-	aspath_loop_count = 1;
-
-      if (aspath_loop_check (attr->aspath, peer->change_local_as) > aspath_loop_count) 
-	{
-	  reason = "as-path contains our own AS;";
-	  goto filtered;
-	}
-    }
-
-  /* AS path loop check. */
-  if (aspath_loop_check (attr->aspath, bgp->as) > peer->allowas_in[afi][safi]
-      || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)
-	  && aspath_loop_check(attr->aspath, bgp->confed_id)
-	  > peer->allowas_in[afi][safi]))
+  /* AS path loop and route reflector checks.  */
+  if (batch->reason)
     {
-      reason = "as-path contains our own AS;";
+      reason = batch->reason;
       goto filtered;
     }
 
-  /* Route reflector originator ID check.  */
-  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
-      && IPV4_ADDR_SAME (&bgp->router_id, &attr->extra->originator_id))
-    {
-      reason = "originator is us;";
-      goto filtered;
-    }
-
-  /* Route reflector cluster ID check.  */
-  if (bgp_cluster_filter (peer, attr))
-    {
-      reason = "reflected from the same cluster;";
-      goto  filtered;
-    }
-
   /* Apply incoming filter.  */
-  if (bgp_input_filter (peer, p, attr, afi, safi) == FILTER_DENY)
+  if (bgp_input_filter_prefix (peer, p, afi, safi) == FILTER_DENY
+      || batch->aspath_deny)
     {
       reason = "filter;";
       goto filtered;
     }
 
-  new_attr.extra = &new_extra;
-  bgp_attr_dup (&new_attr, attr);
-
-  /* Apply incoming route-map.
-   * NB: new_attr may now contain newly allocated values from route-map "set"
-   * commands, so we need bgp_attr_flush in the error paths, until we intern
-   * the attr (which takes over the memory references) */
-  if (bgp_input_modifier (peer, p, &new_attr, afi, safi) == RMAP_DENY)
+  if (! batch->per_prefix)
     {
-      reason = "route-map;";
-      bgp_attr_flush (&new_attr);
-      goto filtered;
+      if (batch->attr_reason)
+	{
+	  reason = batch->attr_reason;
+	  goto filtered;
+	}
+      attr_new = bgp_attr_ref (batch->attr_new);
     }
-
-  /* IPv4 unicast next hop check.  */
-  if (afi == AFI_IP && safi == SAFI_UNICAST)
+  else
     {
-      /* If the peer is EBGP and nexthop is not on connected route,
-	 discard it.  */
-      if (peer->sort == BGP_PEER_EBGP && peer->ttl == 1
-	  && ! bgp_nexthop_onlink (afi, &new_attr)
-	  && ! CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
+      new_attr.extra = &new_extra;
+      bgp_attr_dup (&new_attr, attr);
+
+      /* Apply incoming route-map.
+       * NB: new_attr may now contain newly allocated values from route-map
+       * "set" commands, so we need bgp_attr_flush in the error paths, until
+       * we intern the attr (which takes over the memory references) */
+      if (bgp_input_modifier (peer, p, &new_attr, afi, safi) == RMAP_DENY)
 	{
-	  reason = "non-connected next-hop;";
+	  reason = "route-map;";
 	  bgp_attr_flush (&new_attr);
 	  goto filtered;
 	}
 
-      /* Next hop must not be 0.0.0.0 nor Class D/E address. Next hop
-	 must not be my own address.  */
-      if (new_attr.nexthop.s_addr == 0
-	  || IPV4_CLASS_DE (ntohl (new_attr.nexthop.s_addr))
-	  || bgp_nexthop_self (&new_attr))
+      reason = bgp_update_nexthop_check (peer, &new_attr, afi, safi);
+      if (reason)
 	{
-	  reason = "martian next-hop;";
 	  bgp_attr_flush (&new_attr);
 	  goto filtered;
 	}
-    }
 
-  attr_new = bgp_attr_intern (&new_attr);
+      attr_new = bgp_attr_intern (&new_attr);
+    }
 
   /* If the update is implicit withdraw. */
   if (ri)
@@ -2236,7 +2344,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	{
 	  bgp_info_unset_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
 
-	  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING)
+	  if (bgp_damp_config_lookup (peer, afi, safi)
 	      && peer->sort == BGP_PEER_EBGP
 	      && CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
 	    {
@@ -2307,7 +2415,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
       bgp_aggregate_decrement (bgp, p, ri, afi, safi);
       
       /* Update bgp route dampening information.  */
-      if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING)
+      if (bgp_damp_config_lookup (peer, afi, safi)
 	  && peer->sort == BGP_PEER_EBGP)
 	{
 	  /* This is implicit withdraw so we should update dampening
@@ -2327,7 +2435,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
       bgp_attr_flush (&new_attr);
 
       /* Update bgp route dampening information.  */
-      if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING)
+      if (bgp_damp_config_lookup (peer, afi, safi)
 	  && peer->sort == BGP_PEER_EBGP)
 	{
 	  /* Now we do normal update dampening.  */
@@ -2443,10 +2551,11 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
   return 0;
 }
 
-int
-bgp_update (struct peer *peer, struct prefix *p, struct attr *attr,
-            afi_t afi, safi_t safi, int type, int sub_type,
-            struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+static int
+bgp_update_batched (struct peer *peer, struct prefix *p, struct attr *attr,
+		    afi_t afi, safi_t safi, int type, int sub_type,
+		    struct prefix_rd *prd, u_char *tag, int soft_reconfig,
+		    struct bgp_update_batch *batch)
 {
   struct peer *rsclient;
   struct listnode *node, *nnode;
@@ -2454,7 +2563,7 @@ bgp_update (struct peer *peer, struct prefix *p, struct attr *attr,
   int ret;
 
   ret = bgp_update_main (peer, p, attr, afi, safi, type, sub_type, prd, tag,
-          soft_reconfig);
+          soft_reconfig, batch);
 
   bgp = peer->bgp;
 
@@ -2469,6 +2578,22 @@ bgp_update (struct peer *peer, struct prefix *p, struct attr *attr,
   return ret;
 }
 
+int
+bgp_update (struct peer *peer, struct prefix *p, struct attr *attr,
+            afi_t afi, safi_t safi, int type, int sub_type,
+            struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+{
+  struct bgp_update_batch batch;
+  int ret;
+
+  bgp_update_batch_start (&batch, peer, attr, afi, safi);
+  ret = bgp_update_batched (peer, p, attr, afi, safi, type, sub_type, prd,
+			    tag, soft_reconfig, &batch);
+  bgp_update_batch_finish (&batch);
+
+  return ret;
+}
+
 int
 bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr, 
 	     afi_t afi, safi_t safi, int type, int sub_type, 
@@ -2714,108 +2839,79 @@ bgp_announce_route_all (struct peer *peer)
       bgp_announce_route (peer, afi, safi);
 }
 
-static void
-bgp_soft_reconfig_table_rsclient (struct peer *rsclient, afi_t afi,
-        safi_t safi, struct bgp_table *table, struct prefix_rd *prd)
+/* Route distinguisher of a node in a VPN or ENCAP per-RD table. */
+static inline struct prefix_rd *
+bgp_node_prd (struct bgp_node *rn)
 {
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-
-  if (! table)
-    table = rsclient->bgp->rib[afi][safi];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-        struct bgp_info *ri = rn->info;
-        u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
-
-        bgp_update_rsclient (rsclient, afi, safi, ain->attr, ain->peer,
-                &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
-      }
+  return rn->prn ? (struct prefix_rd *) &rn->prn->p : NULL;
 }
 
 void
 bgp_soft_reconfig_rsclient (struct peer *rsclient, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
-  struct bgp_node *rn;
-  
-  if ((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP))
-    bgp_soft_reconfig_table_rsclient (rsclient, afi, safi, NULL, NULL);
+  struct peer *peer;
+  struct listnode *node, *nnode;
+  struct bgp_adj_in_table *ait;
+  unsigned long i;
 
-  else
-    for (rn = bgp_table_top (rsclient->bgp->rib[afi][safi]); rn;
-            rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
+  for (ALL_LIST_ELEMENTS (rsclient->bgp->peer, node, nnode, peer))
+    if ((ait = peer->adj_in[afi][safi]) != NULL)
+      for (i = 0; i < BGP_ADJ_IN_SLOTS (ait); i++)
         {
-          struct prefix_rd prd;
-          prd.family = AF_UNSPEC;
-          prd.prefixlen = 64;
-          memcpy(&prd.val, rn->p.u.val, 8);
-
-          bgp_soft_reconfig_table_rsclient (rsclient, afi, safi, table, &prd);
-        }
-}
-
-static void
-bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
-			 struct bgp_table *table, struct prefix_rd *prd)
-{
-  int ret;
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
+          struct bgp_adj_in *ain = &ait->slots[i];
+          struct bgp_node *rn = ain->rn;
+          struct bgp_info *ri;
+          u_char *tag;
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+          if (! rn)
+            continue;
 
-	    ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
-			      ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1);
+          ri = rn->info;
+          tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	    continue;
-	  }
-      }
+          bgp_update_rsclient (rsclient, afi, safi, ain->attr, peer,
+                  &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+                  bgp_node_prd (rn), tag);
+        }
 }
 
+/* Run the peer's Adj-RIB-In through inbound policy again.  Only the peer's
+   own table is walked; bgp_update() with soft_reconfig set does not
+   change it. */
 void
 bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
+  int ret;
+  struct bgp_adj_in_table *ait;
+  unsigned long i;
 
   if (peer->status != Established)
     return;
 
-  if ((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP))
-    bgp_soft_reconfig_table (peer, afi, safi, NULL, NULL);
-  else
-    for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-	 rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
-        {
-          struct prefix_rd prd;
-          prd.family = AF_UNSPEC;
-          prd.prefixlen = 64;
-          memcpy(&prd.val, rn->p.u.val, 8);
+  if ((ait = peer->adj_in[afi][safi]) == NULL)
+    return;
 
-          bgp_soft_reconfig_table (peer, afi, safi, table, &prd);
-        }
-}
+  for (i = 0; i < BGP_ADJ_IN_SLOTS (ait); i++)
+    {
+      struct bgp_adj_in *ain = &ait->slots[i];
+      struct bgp_node *rn = ain->rn;
+      struct bgp_info *ri;
+      u_char *tag;
+
+      if (! rn)
+	continue;
+
+      ri = rn->info;
+      tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
+      ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
+			ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+			bgp_node_prd (rn), tag, 1);
+
+      if (ret < 0)
+	return;
+    }
+}
 
 struct bgp_clear_node_queue
 {
@@ -2915,7 +3011,6 @@ bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     {
       struct bgp_info *ri;
-      struct bgp_adj_in *ain;
       struct bgp_adj_out *aout;
 
       /* XXX:TODO: This is suboptimal, every non-empty route_node is
@@ -2949,13 +3044,6 @@ bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
        * this may actually be achievable. It doesn't seem to be a huge
        * problem at this time,
        */
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_in_remove (rn, ain);
-            bgp_unlock_node (rn);
-            break;
-          }
       for (aout = rn->adj_out; aout; aout = aout->next)
         if (aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
           {
@@ -3017,6 +3105,8 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   switch (purpose)
     {
     case BGP_CLEAR_ROUTE_NORMAL:
+      bgp_adj_in_free (peer, afi, safi);
+
       if ((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP))
         bgp_clear_route_table (peer, afi, safi, NULL, NULL, purpose);
       else
@@ -3116,20 +3206,7 @@ bgp_process_queues_drain_immediate(void)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-
-  table = peer->bgp->rib[afi][safi];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+  bgp_adj_in_free (peer, afi, safi);
 }
 
 void
@@ -3226,11 +3303,10 @@ bgp_reset (void)
   prefix_list_reset ();
 }
 
-/* Parse NLRI stream.  Withdraw NLRI is recognized by NULL attr
-   value. */
-int
-bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
-                   struct bgp_nlri *packet)
+static int
+bgp_nlri_parse_ip_prefixes (struct peer *peer, struct attr *attr,
+			    struct bgp_nlri *packet,
+			    struct bgp_update_batch *batch)
 {
   u_char *pnt;
   u_char *lim;
@@ -3238,10 +3314,6 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
   int psize;
   int ret;
 
-  /* Check peer status. */
-  if (peer->status != Established)
-    return 0;
-  
   pnt = packet->nlri;
   lim = pnt + packet->length;
 
@@ -3340,8 +3412,9 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
 
       /* Normal process. */
       if (attr)
-	ret = bgp_update (peer, &p, attr, packet->afi, packet->safi, 
-			  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0);
+	ret = bgp_update_batched (peer, &p, attr, packet->afi, packet->safi,
+				  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL,
+				  0, batch);
       else
 	ret = bgp_withdraw (peer, &p, attr, packet->afi, packet->safi, 
 			    ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL);
@@ -3365,6 +3438,30 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
   return 0;
 }
 
+/* Parse NLRI stream.  Withdraw NLRI is recognized by NULL attr
+   value.  The attribute policy of an update is worked out once for all
+   of its NLRI. */
+int
+bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
+                   struct bgp_nlri *packet)
+{
+  struct bgp_update_batch batch;
+  int ret;
+
+  /* Check peer status. */
+  if (peer->status != Established)
+    return 0;
+
+  if (! attr)
+    return bgp_nlri_parse_ip_prefixes (peer, NULL, packet, NULL);
+
+  bgp_update_batch_start (&batch, peer, attr, packet->afi, packet->safi);
+  ret = bgp_nlri_parse_ip_prefixes (peer, attr, packet, &batch);
+  bgp_update_batch_finish (&batch);
+
+  return ret;
+}
+
 static struct bgp_static *
 bgp_static_new (void)
 {
@@ -11965,12 +12062,10 @@ bgp_peer_count_walker (struct thread *t)
   
   for (rn = bgp_table_top (pc->table); rn; rn = bgp_route_next (rn))
     {
-      struct bgp_adj_in *ain;
       struct bgp_info *ri;
       
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
-          pc->count[PCOUNT_ADJ_IN]++;
+      if (bgp_adj_in_lookup (rn, peer))
+        pc->count[PCOUNT_ADJ_IN]++;
 
       for (ri = rn->info; ri; ri = ri->next)
         {
@@ -12276,27 +12371,26 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     if (in)
       {
-	for (ain = rn->adj_in; ain; ain = ain->next)
-	  if (ain->peer == peer)
-	    {
-	      if (header1)
-		{
-		  vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  header1 = 0;
-		}
-	      if (header2)
-		{
-		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		  header2 = 0;
-		}
-	      if (ain->attr)
-		{ 
-		  route_vty_out_tmp (vty, &rn->p, ain->attr, safi);
-		  output_count++;
-		}
-	    }
+	if ((ain = bgp_adj_in_lookup (rn, peer)) != NULL)
+	  {
+	    if (header1)
+	      {
+		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
+		vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		header1 = 0;
+	      }
+	    if (header2)
+	      {
+		vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+		header2 = 0;
+	      }
+	    if (ain->attr)
+	      { 
+		route_vty_out_tmp (vty, &rn->p, ain->attr, safi);
+		output_count++;
+	      }
+	  }
       }
     else
       {
@@ -15178,6 +15272,117 @@ ALIAS (bgp_damp_unset,
        "Value to start suppressing a route\n"
        "Maximum duration to suppress a stable route\n")
 
+DEFUN (neighbor_damp_set,
+       neighbor_damp_set_cmd,
+       "neighbor WORD dampening <1-45> <1-20000> <1-20000> <1-255>",
+       NEIGHBOR_STR
+       "Neighbor tag\n"
+       "Enable route-flap dampening with a peer-group profile\n"
+       "Half-life time for the penalty\n"
+       "Value to start reusing a route\n"
+       "Value to start suppressing a route\n"
+       "Maximum duration to suppress a stable route\n")
+{
+  struct bgp *bgp;
+  struct peer_group *group;
+  afi_t afi = bgp_node_afi (vty);
+  safi_t safi = bgp_node_safi (vty);
+  int half = DEFAULT_HALF_LIFE * 60;
+  int reuse = DEFAULT_REUSE;
+  int suppress = DEFAULT_SUPPRESS;
+  int max = 4 * half;
+
+  if (argc == 5)
+    {
+      half = atoi (argv[1]) * 60;
+      reuse = atoi (argv[2]);
+      suppress = atoi (argv[3]);
+      max = atoi (argv[4]) * 60;
+    }
+  else if (argc == 2)
+    {
+      half = atoi (argv[1]) * 60;
+      max = 4 * half;
+    }
+
+  bgp = vty->index;
+
+  group = peer_group_lookup (bgp, argv[0]);
+  if (! group)
+    {
+      vty_out (vty, "%% Configure the peer-group first%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  if (! (afi == AFI_IP && safi == SAFI_UNICAST)
+      && ! group->conf->afc[afi][safi])
+    {
+      vty_out (vty, "%% Activate the peer-group for the address family first%s",
+               VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  if (suppress < reuse)
+    {
+      vty_out (vty, "Suppress value cannot be less than reuse value %s",
+                    VTY_NEWLINE);
+      return 0;
+    }
+
+  return bgp_damp_group_enable (group, afi, safi, half, reuse, suppress, max);
+}
+
+ALIAS (neighbor_damp_set,
+       neighbor_damp_set2_cmd,
+       "neighbor WORD dampening <1-45>",
+       NEIGHBOR_STR
+       "Neighbor tag\n"
+       "Enable route-flap dampening with a peer-group profile\n"
+       "Half-life time for the penalty\n")
+
+ALIAS (neighbor_damp_set,
+       neighbor_damp_set3_cmd,
+       "neighbor WORD dampening",
+       NEIGHBOR_STR
+       "Neighbor tag\n"
+       "Enable route-flap dampening with a peer-group profile\n")
+
+DEFUN (no_neighbor_damp_set,
+       no_neighbor_damp_set_cmd,
+       "no neighbor WORD dampening",
+       NO_STR
+       NEIGHBOR_STR
+       "Neighbor tag\n"
+       "Enable route-flap dampening with a peer-group profile\n")
+{
+  struct bgp *bgp;
+  struct peer_group *group;
+
+  bgp = vty->index;
+
+  group = peer_group_lookup (bgp, argv[0]);
+  if (! group)
+    {
+      vty_out (vty, "%% Configure the peer-group first%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  return bgp_damp_group_disable (group, bgp_node_afi (vty),
+                                 bgp_node_safi (vty));
+}
+
+ALIAS (no_neighbor_damp_set,
+       no_neighbor_damp_set2_cmd,
+       "no neighbor WORD dampening <1-45> <1-20000> <1-20000> <1-255>",
+       NO_STR
+       NEIGHBOR_STR
+       "Neighbor tag\n"
+       "Enable route-flap dampening with a peer-group profile\n"
+       "Half-life time for the penalty\n"
+       "Value to start reusing a route\n"
+       "Value to start suppressing a route\n"
+       "Maximum duration to suppress a stable route\n")
+
 DEFUN (show_ip_bgp_dampened_paths,
        show_ip_bgp_dampened_paths_cmd,
        "show ip bgp dampened-paths",
@@ -15466,7 +15671,11 @@ DEFUN (clear_ip_bgp_dampening,
        BGP_STR
        "Clear route flap dampening information\n")
 {
-  bgp_damp_info_clean ();
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (bgp)
+    bgp_damp_info_clean (bgp, AFI_IP, SAFI_UNICAST);
   return CMD_SUCCESS;
 }
 
@@ -16264,6 +16473,46 @@ bgp_route_init (void)
   install_element (BGP_IPV4_NODE, &bgp_damp_set3_cmd);
   install_element (BGP_IPV4_NODE, &bgp_damp_unset_cmd);
   install_element (BGP_IPV4_NODE, &bgp_damp_unset2_cmd);
+  install_element (BGP_IPV4M_NODE, &bgp_damp_set_cmd);
+  install_element (BGP_IPV4M_NODE, &bgp_damp_set2_cmd);
+  install_element (BGP_IPV4M_NODE, &bgp_damp_set3_cmd);
+  install_element (BGP_IPV4M_NODE, &bgp_damp_unset_cmd);
+  install_element (BGP_IPV4M_NODE, &bgp_damp_unset2_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_set_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_set2_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_set3_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_unset_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_unset2_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_set_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_set2_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_set3_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_unset_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_unset2_cmd);
+  install_element (BGP_NODE, &neighbor_damp_set_cmd);
+  install_element (BGP_NODE, &neighbor_damp_set2_cmd);
+  install_element (BGP_NODE, &neighbor_damp_set3_cmd);
+  install_element (BGP_NODE, &no_neighbor_damp_set_cmd);
+  install_element (BGP_NODE, &no_neighbor_damp_set2_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_damp_set_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_damp_set2_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_damp_set3_cmd);
+  install_element (BGP_IPV4_NODE, &no_neighbor_damp_set_cmd);
+  install_element (BGP_IPV4_NODE, &no_neighbor_damp_set2_cmd);
+  install_element (BGP_IPV4M_NODE, &neighbor_damp_set_cmd);
+  install_element (BGP_IPV4M_NODE, &neighbor_damp_set2_cmd);
+  install_element (BGP_IPV4M_NODE, &neighbor_damp_set3_cmd);
+  install_element (BGP_IPV4M_NODE, &no_neighbor_damp_set_cmd);
+  install_element (BGP_IPV4M_NODE, &no_neighbor_damp_set2_cmd);
+  install_element (BGP_IPV6_NODE, &neighbor_damp_set_cmd);
+  install_element (BGP_IPV6_NODE, &neighbor_damp_set2_cmd);
+  install_element (BGP_IPV6_NODE, &neighbor_damp_set3_cmd);
+  install_element (BGP_IPV6_NODE, &no_neighbor_damp_set_cmd);
+  install_element (BGP_IPV6_NODE, &no_neighbor_damp_set2_cmd);
+  install_element (BGP_IPV6M_NODE, &neighbor_damp_set_cmd);
+  install_element (BGP_IPV6M_NODE, &neighbor_damp_set2_cmd);
+  install_element (BGP_IPV6M_NODE, &neighbor_damp_set3_cmd);
+  install_element (BGP_IPV6M_NODE, &no_neighbor_damp_set_cmd);
+  install_element (BGP_IPV6M_NODE, &no_neighbor_damp_set2_cmd);
   
   /* Deprecated AS-Pathlimit commands */
   install_element (BGP_NODE, &bgp_network_ttl_cmd);
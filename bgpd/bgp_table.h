@@ -59,8 +59,6 @@ struct bgp_node
 
   struct bgp_adj_out *adj_out;
 
-  struct bgp_adj_in *adj_in;
-
   struct bgp_node *prn;
 
   u_char flags;
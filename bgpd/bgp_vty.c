@@ -7110,6 +7110,7 @@ DEFUN (show_bgp_memory,
 {
   char memstrbuf[MTYPE_MEMSTR_LEN];
   unsigned long count;
+  unsigned long bytes;
   
   /* RIB related usage stats */
   count = mtype_stats_alloc (MTYPE_BGP_NODE);
@@ -7136,10 +7137,10 @@ DEFUN (show_bgp_memory,
              VTY_NEWLINE);
   
   /* Adj-In/Out */
-  if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_IN)))
+  bgp_adj_in_stats (&count, &bytes);
+  if (count)
     vty_out (vty, "%ld Adj-In entries, using %s of memory%s", count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct bgp_adj_in)),
+             mtype_memstr (memstrbuf, sizeof (memstrbuf), bytes),
              VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT)))
     vty_out (vty, "%ld Adj-Out entries, using %s of memory%s", count,
@@ -100,7 +100,7 @@ bgp_interface_delete (int command, struct zclient *zclient,
 
   s = zclient->ibuf;
   ifp = zebra_interface_state_read (s, vrf_id);
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   if (BGP_DEBUG(zebra, ZEBRA))
     zlog_debug("Zebra rcvd: interface delete %s", ifp->name);
@@ -711,8 +711,16 @@ peer_sort (struct peer *peer)
 static void
 peer_free (struct peer *peer)
 {
+  afi_t afi;
+  safi_t safi;
+
   assert (peer->status == Deleted);
 
+  /* Normally already dropped when the session was cleared. */
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_adj_in_free (peer, afi, safi);
+
   bgp_unlock(peer->bgp);
 
   /* this /ought/ to have been done already through bgp_stop earlier,
@@ -1766,6 +1774,8 @@ peer_group_delete (struct peer_group *group)
   struct bgp *bgp;
   struct peer *peer;
   struct listnode *node, *nnode;
+  afi_t afi;
+  safi_t safi;
 
   bgp = group->bgp;
 
@@ -1778,6 +1788,10 @@ peer_group_delete (struct peer_group *group)
   free (group->name);
   group->name = NULL;
 
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_damp_group_disable (group, afi, safi);
+
   group->conf->group = NULL;
   peer_delete (group->conf);
 
@@ -2174,6 +2188,7 @@ bgp_delete (struct bgp *bgp)
   struct listnode *node, *pnode;
   struct listnode *next, *pnext;
   afi_t afi;
+  safi_t safi;
   int i;
 
   SET_FLAG(bgp->flags, BGP_FLAG_DELETING);
@@ -2213,6 +2228,10 @@ bgp_delete (struct bgp *bgp)
       peer_group_delete (group);
     }
 
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_damp_disable (bgp, afi, safi);
+
   assert (listcount (bgp->rsclient) == 0);
 
   if (bgp->peer_self) {
@@ -5225,6 +5244,10 @@ bgp_config_write_peer (struct vty *vty, struct bgp *bgp,
     vty_out (vty, " neighbor %s soft-reconfiguration inbound%s", addr,
 	     VTY_NEWLINE);
 
+  /* Peer-group dampening profile. */
+  if (CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP))
+    bgp_config_write_damp_group (vty, peer->group, afi, safi);
+
   /* maximum-prefix. */
   if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX))
     if (! peer->af_group[afi][safi]
@@ -5341,6 +5364,12 @@ bgp_config_write_family (struct vty *vty, struct bgp *bgp, afi_t afi,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
+    {
+      bgp_config_write_family_header (vty, afi, safi, &write);
+      bgp_config_write_damp (vty, bgp, afi, safi);
+    }
+
   bgp_config_write_network (vty, bgp, afi, safi, &write);
 
   bgp_config_write_redistribute (vty, bgp, afi, safi, &write);
@@ -5514,9 +5543,7 @@ bgp_config_write (struct vty *vty)
       bgp_config_write_scan_time (vty);
 
       /* BGP flag dampening. */
-      if (CHECK_FLAG (bgp->af_flags[AFI_IP][SAFI_UNICAST],
-	  BGP_CONFIG_DAMPENING))
-	bgp_config_write_damp (vty);
+      bgp_config_write_damp (vty, bgp, AFI_IP, SAFI_UNICAST);
 
       /* BGP static route configuration. */
       bgp_config_write_network (vty, bgp, AFI_IP, SAFI_UNICAST, &write);
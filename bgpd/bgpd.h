@@ -129,6 +129,9 @@ struct bgp
   u_int16_t af_flags[AFI_MAX][SAFI_MAX];
 #define BGP_CONFIG_DAMPENING              (1 << 0)
 
+  /* Route flap dampening parameters and state.  */
+  struct bgp_damp_config *damp[AFI_MAX][SAFI_MAX];
+
   /* Static route configuration.  */
   struct bgp_table *route[AFI_MAX][SAFI_MAX];
 
@@ -189,6 +192,9 @@ struct peer_group
 
   /* Peer-group config */
   struct peer *conf;
+
+  /* Dampening profiles overriding the BGP instance's for members.  */
+  struct bgp_damp_config *damp[AFI_MAX][SAFI_MAX];
 };
 
 /* BGP Notify message format. */
@@ -503,6 +509,9 @@ struct peer
   u_int32_t established;	/* Established */
   u_int32_t dropped;		/* Dropped */
 
+  /* Adj-RIB-In for soft reconfiguration inbound.  */
+  struct bgp_adj_in_table *adj_in[AFI_MAX][SAFI_MAX];
+
   /* Syncronization list and time.  */
   struct bgp_synchronize *sync[AFI_MAX][SAFI_MAX];
   time_t synctime;
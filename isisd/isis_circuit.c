@@ -835,6 +835,9 @@ isis_circuit_down (struct isis_circuit *circuit)
   /* close the socket */
   if (circuit->fd)
     {
+#ifdef GNU_LINUX
+      isis_sock_ring_free (circuit);
+#endif
       close (circuit->fd);
       circuit->fd = 0;
     }
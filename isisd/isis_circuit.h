@@ -69,6 +69,7 @@ struct isis_circuit
   struct isis_area *area;	/* back pointer to the area */
   struct interface *interface;	/* interface info from z */
   int fd;			/* IS-IS l1/2 socket */
+  struct isis_rx_ring *rx_ring;	/* PF_PACKET mmap receive ring, if any */
   int sap_length;		/* SAP length for DLPI */
   struct nlpids nlpids;
   /*
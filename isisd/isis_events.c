@@ -85,6 +85,7 @@ area_resign_level (struct isis_area *area, int level)
       lsp_db_destroy (area->lspdb[level - 1]);
       area->lspdb[level - 1] = NULL;
     }
+  lsp_frags_free (area, level);
   if (area->spftree[level - 1])
     {
       isis_spftree_del (area->spftree[level - 1]);
@@ -37,6 +37,7 @@
 #include "checksum.h"
 #include "md5.h"
 #include "table.h"
+#include "jhash.h"
 
 #include "isisd/dict.h"
 #include "isisd/isis_constants.h"
@@ -415,6 +416,7 @@ lsp_inc_seqnum (struct isis_lsp *lsp, u_int32_t seq_num)
     newseq = seq_num + 1;
 
   lsp->lsp_header->seq_num = htonl (newseq);
+  lsp->changed = 0;
 
   /* Recompute authentication and checksum information */
   lsp_auth_update (lsp);
@@ -1041,6 +1043,7 @@ lsp_print_all (struct vty *vty, dict_t * lspdb, char detail, char dynhost)
 #define FRAG_NEEDED(S,T,I) \
   (STREAM_SIZE(S)-STREAM_REMAIN(S)+(I) > FRAG_THOLD(S,T))
 
+#ifdef TOPOLOGY_GENERATE
 /* FIXME: It shouldn't be necessary to pass tlvsize here, TLVs can have
  * variable length (TE TLVs, sub TLVs). */
 static void
@@ -1090,6 +1093,7 @@ lsp_tlv_fit (struct isis_lsp *lsp, struct list **from, struct list **to,
   lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
   return;
 }
+#endif /* TOPOLOGY_GENERATE */
 
 static u_int16_t
 lsp_rem_lifetime (struct isis_area *area, int level)
@@ -1274,8 +1278,408 @@ lsp_build_ext_reach (struct isis_lsp *lsp, struct isis_area *area,
 }
 
 /*
- * Builds the LSP data part. This func creates a new frag whenever 
- * area->lsp_frag_threshold is exceeded.
+ * Placement of the neighbor and prefix entries of our own LSP over its
+ * fragments.  Each entry remembers the fragment it was put in and stays
+ * there on later rebuilds as long as that fragment has room, so that a
+ * change only alters the fragments holding the entries concerned, and
+ * lsp_regenerate() reissues just those.
+ */
+#define LSP_FRAG_MAX	256
+#define LSP_FRAG_NONE	-1
+#define LSP_FRAG_KEY_LEN 17	/* IPv6 prefix length and prefix */
+
+struct lsp_frag_entry
+{
+  u_char tlv;			/* TLV type the entry goes in */
+  u_char len;
+  u_char key[LSP_FRAG_KEY_LEN];	/* neighbor ID or prefix */
+  u_char seen;			/* still there in this build */
+  int frag;			/* fragment number or LSP_FRAG_NONE */
+};
+
+/* An entry of this build and where it goes */
+struct lsp_frag_item
+{
+  void *data;
+  struct lsp_frag_entry *fe;
+  unsigned int t;		/* index in lsp_frag_tlvs */
+  int frag;
+};
+
+/* Placed TLVs, in the order they appear in a fragment. */
+static const struct
+{
+  u_char tlv;
+  int entry_len;		/* the longest an entry can get */
+  int (*build) (struct list *, struct stream *);
+} lsp_frag_tlvs[] =
+{
+  { IPV4_INT_REACHABILITY, IPV4_REACH_LEN, tlv_add_ipv4_int_reachs },
+  { IPV4_EXT_REACHABILITY, IPV4_REACH_LEN, tlv_add_ipv4_ext_reachs },
+  /* Metric, control and prefix: 9 bytes at most, no sub-TLVs are written */
+  { TE_IPV4_REACHABILITY,  TE_IPV4_REACH_LEN, tlv_add_te_ipv4_reachs },
+#ifdef HAVE_IPV6
+  { IPV6_REACHABILITY,     IPV6_REACH_LEN, tlv_add_ipv6_reachs },
+#endif /* HAVE_IPV6 */
+  { IS_NEIGHBOURS,         IS_NEIGHBOURS_LEN, tlv_add_is_neighs },
+  { TE_IS_NEIGHBOURS,      IS_NEIGHBOURS_LEN, tlv_add_te_is_neighs },
+};
+#define LSP_FRAG_TLVS (sizeof (lsp_frag_tlvs) / sizeof (lsp_frag_tlvs[0]))
+
+static struct list **
+lsp_frag_list (struct tlvs *tlvs, u_char tlv)
+{
+  switch (tlv)
+    {
+    case IPV4_INT_REACHABILITY:
+      return &tlvs->ipv4_int_reachs;
+    case IPV4_EXT_REACHABILITY:
+      return &tlvs->ipv4_ext_reachs;
+    case TE_IPV4_REACHABILITY:
+      return &tlvs->te_ipv4_reachs;
+#ifdef HAVE_IPV6
+    case IPV6_REACHABILITY:
+      return &tlvs->ipv6_reachs;
+#endif /* HAVE_IPV6 */
+    case IS_NEIGHBOURS:
+      return &tlvs->is_neighs;
+    case TE_IS_NEIGHBOURS:
+      return &tlvs->te_is_neighs;
+    }
+  assert (0);
+  return NULL;
+}
+
+/* Identity of an entry: what it is about, not its metric. */
+static void
+lsp_frag_key (struct lsp_frag_entry *key, u_char tlv, void *data)
+{
+  struct ipv4_reachability *ipreach;
+  struct te_ipv4_reachability *te_ipreach;
+#ifdef HAVE_IPV6
+  struct ipv6_reachability *ip6reach;
+#endif /* HAVE_IPV6 */
+
+  memset (key, 0, sizeof (struct lsp_frag_entry));
+  key->tlv = tlv;
+
+  switch (tlv)
+    {
+    case IPV4_INT_REACHABILITY:
+    case IPV4_EXT_REACHABILITY:
+      ipreach = data;
+      memcpy (key->key, &ipreach->prefix, IPV4_MAX_BYTELEN);
+      memcpy (key->key + IPV4_MAX_BYTELEN, &ipreach->mask, IPV4_MAX_BYTELEN);
+      key->len = 2 * IPV4_MAX_BYTELEN;
+      break;
+    case TE_IPV4_REACHABILITY:
+      te_ipreach = data;
+      key->key[0] = te_ipreach->control & 0x3F;
+      memcpy (key->key + 1, &te_ipreach->prefix_start, PSIZE (key->key[0]));
+      key->len = 1 + PSIZE (key->key[0]);
+      break;
+#ifdef HAVE_IPV6
+    case IPV6_REACHABILITY:
+      ip6reach = data;
+      key->key[0] = ip6reach->prefix_len;
+      memcpy (key->key + 1, ip6reach->prefix, IPV6_MAX_BYTELEN);
+      key->len = 1 + IPV6_MAX_BYTELEN;
+      break;
+#endif /* HAVE_IPV6 */
+    case IS_NEIGHBOURS:
+      memcpy (key->key, ((struct is_neigh *) data)->neigh_id,
+	      ISIS_SYS_ID_LEN + 1);
+      key->len = ISIS_SYS_ID_LEN + 1;
+      break;
+    case TE_IS_NEIGHBOURS:
+      memcpy (key->key, ((struct te_is_neigh *) data)->neigh_id,
+	      ISIS_SYS_ID_LEN + 1);
+      key->len = ISIS_SYS_ID_LEN + 1;
+      break;
+    }
+}
+
+static unsigned int
+lsp_frag_entry_hash (void *arg)
+{
+  struct lsp_frag_entry *fe = arg;
+
+  return jhash (fe->key, fe->len, fe->tlv);
+}
+
+static int
+lsp_frag_entry_cmp (const void *a, const void *b)
+{
+  const struct lsp_frag_entry *fa = a, *fb = b;
+
+  return fa->tlv == fb->tlv && fa->len == fb->len
+    && memcmp (fa->key, fb->key, fa->len) == 0;
+}
+
+static void *
+lsp_frag_entry_alloc (void *arg)
+{
+  struct lsp_frag_entry *fe;
+
+  fe = XMALLOC (MTYPE_ISIS_LSP_FRAG, sizeof (struct lsp_frag_entry));
+  memcpy (fe, arg, sizeof (struct lsp_frag_entry));
+  fe->frag = LSP_FRAG_NONE;
+  return fe;
+}
+
+static void
+lsp_frag_entry_free (void *arg)
+{
+  XFREE (MTYPE_ISIS_LSP_FRAG, arg);
+}
+
+/* Forget entries which are gone, and reset the mark on the others. */
+static void
+lsp_frag_entry_sweep (struct hash_backet *hb, void *arg)
+{
+  struct lsp_frag_entry *fe = hb->data;
+
+  if (fe->seen)
+    fe->seen = 0;
+  else
+    lsp_frag_entry_free (hash_release (arg, fe));
+}
+
+void
+lsp_frags_free (struct isis_area *area, int level)
+{
+  if (area->lsp_frags[level - 1] == NULL)
+    return;
+
+  hash_clean (area->lsp_frags[level - 1], lsp_frag_entry_free);
+  hash_free (area->lsp_frags[level - 1]);
+  area->lsp_frags[level - 1] = NULL;
+}
+
+/* Bytes the next entry of TLV t takes in a fragment already holding n
+ * of them: a new TLV is started every so many entries. */
+static int
+lsp_frag_cost (unsigned int t, unsigned int n)
+{
+  unsigned int per_tlv = (MAX_TLV_LEN - 1) / lsp_frag_tlvs[t].entry_len;
+
+  return lsp_frag_tlvs[t].entry_len + ((n % per_tlv) ? 0 : 3);
+}
+
+/* Did the TLVs of the LSP change since the old copy of its pdu? */
+static int
+lsp_tlvs_changed (struct isis_lsp *lsp, struct stream *old)
+{
+  size_t start = ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN;
+
+  if (old == NULL || stream_get_endp (old) != stream_get_endp (lsp->pdu))
+    return 1;
+
+  return memcmp (STREAM_DATA (old) + start, STREAM_DATA (lsp->pdu) + start,
+		 stream_get_endp (old) - start) != 0;
+}
+
+/*
+ * Spread the neighbor and prefix entries collected in tlv_data over
+ * the fragments of lsp0, whose own TLVs are already in its pdu.  Entries
+ * are taken out of tlv_data.  Every fragment touched gets its changed
+ * flag set if its contents differ from before; old0 is the previous pdu
+ * of lsp0.
+ */
+static void
+lsp_build_frags (struct isis_lsp *lsp0, struct isis_area *area,
+		 struct tlvs *tlv_data, struct stream *old0)
+{
+  int level = lsp0->level;
+  struct hash *map;
+  struct lsp_frag_item *items;
+  struct lsp_frag_entry key, *fe;
+  struct isis_lsp *lsp, *lsps[LSP_FRAG_MAX];
+  struct stream *old[LSP_FRAG_MAX];
+  struct listnode *node;
+  struct list **list;
+  u_char frag_id[ISIS_SYS_ID_LEN + 2];
+  int used[LSP_FRAG_MAX];
+  u_int16_t entries[LSP_FRAG_MAX][LSP_FRAG_TLVS];
+  unsigned int t, i, count, dropped = 0;
+  int frag, last, limit;
+  void *data;
+  struct tlvs tlvs;
+  uint32_t expected = 0, found = 0;
+  int retval;
+
+  if (area->lsp_frags[level - 1] == NULL)
+    area->lsp_frags[level - 1] = hash_create (lsp_frag_entry_hash,
+					      lsp_frag_entry_cmp);
+  map = area->lsp_frags[level - 1];
+
+  limit = FRAG_THOLD (lsp0->pdu, area->lsp_frag_threshold);
+  used[0] = stream_get_endp (lsp0->pdu);
+  for (frag = 1; frag < LSP_FRAG_MAX; frag++)
+    used[frag] = ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN;
+  memset (entries, 0, sizeof (entries));
+
+  count = 0;
+  for (t = 0; t < LSP_FRAG_TLVS; t++)
+    if (*(list = lsp_frag_list (tlv_data, lsp_frag_tlvs[t].tlv)))
+      count += listcount (*list);
+  items = XCALLOC (MTYPE_TMP, (count + 1) * sizeof (struct lsp_frag_item));
+
+  /* Entries we had before keep their fragment while it has room... */
+  i = 0;
+  for (t = 0; t < LSP_FRAG_TLVS; t++)
+    {
+      if (*(list = lsp_frag_list (tlv_data, lsp_frag_tlvs[t].tlv)) == NULL)
+	continue;
+      for (ALL_LIST_ELEMENTS_RO (*list, node, data))
+	{
+	  lsp_frag_key (&key, lsp_frag_tlvs[t].tlv, data);
+	  fe = hash_get (map, &key, lsp_frag_entry_alloc);
+	  fe->seen = 1;
+
+	  items[i].data = data;
+	  items[i].fe = fe;
+	  items[i].t = t;
+	  items[i].frag = LSP_FRAG_NONE;
+	  frag = fe->frag;
+	  if (frag != LSP_FRAG_NONE
+	      && used[frag] + lsp_frag_cost (t, entries[frag][t]) <= limit)
+	    {
+	      used[frag] += lsp_frag_cost (t, entries[frag][t]++);
+	      items[i].frag = frag;
+	    }
+	  i++;
+	}
+    }
+
+  /* ...new ones, and those pushed out, go to the first one with room. */
+  for (i = 0; i < count; i++)
+    {
+      if (items[i].frag != LSP_FRAG_NONE)
+	continue;
+      t = items[i].t;
+      fe = items[i].fe;
+
+      frag = fe->frag;
+      if (frag == LSP_FRAG_NONE
+	  || used[frag] + lsp_frag_cost (t, entries[frag][t]) > limit)
+	for (frag = 0; frag < LSP_FRAG_MAX; frag++)
+	  if (used[frag] + lsp_frag_cost (t, entries[frag][t]) <= limit)
+	    break;
+
+      if (frag == LSP_FRAG_MAX)
+	{
+	  fe->frag = LSP_FRAG_NONE;
+	  dropped++;
+	  continue;
+	}
+      used[frag] += lsp_frag_cost (t, entries[frag][t]++);
+      items[i].frag = fe->frag = frag;
+    }
+
+  if (dropped)
+    zlog_warn ("ISIS (%s): L%d LSP is full, %u entries left out",
+	       area->area_tag, level, dropped);
+
+  hash_iterate (map, lsp_frag_entry_sweep, map);
+
+  /* Fragments to rebuild: all holding entries, and all existing ones so
+   * that those left empty are emptied. */
+  last = 0;
+  for (frag = 0; frag < LSP_FRAG_MAX; frag++)
+    for (t = 0; t < LSP_FRAG_TLVS; t++)
+      if (entries[frag][t])
+	last = frag;
+  for (ALL_LIST_ELEMENTS_RO (lsp0->lspu.frags, node, lsp))
+    if (LSP_FRAGMENT (lsp->lsp_header->lsp_id) > last)
+      last = LSP_FRAGMENT (lsp->lsp_header->lsp_id);
+
+  memset (lsps, 0, sizeof (lsps));
+  memset (old, 0, sizeof (old));
+  lsps[0] = lsp0;
+  old[0] = old0;
+  memcpy (frag_id, lsp0->lsp_header->lsp_id, ISIS_SYS_ID_LEN + 1);
+  for (frag = 1; frag <= last; frag++)
+    {
+      LSP_FRAGMENT (frag_id) = frag;
+      lsp = lsp_search (frag_id, area->lspdb[level - 1]);
+      if (lsp)
+	old[frag] = stream_dup (lsp->pdu);
+      else
+	{
+	  for (t = 0; t < LSP_FRAG_TLVS; t++)
+	    if (entries[frag][t])
+	      break;
+	  if (t == LSP_FRAG_TLVS)
+	    continue;
+	}
+      lsps[frag] = lsp_next_frag (frag, lsp0, area, level);
+      stream_reset (lsps[frag]->pdu);
+      stream_forward_endp (lsps[frag]->pdu,
+			   ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
+    }
+
+  /* Hand the entries over to the tlv_data of their fragment */
+  for (i = 0; i < count; i++)
+    {
+      if (items[i].frag == LSP_FRAG_NONE)
+	{
+	  free_tlv (items[i].data);
+	  continue;
+	}
+      list = lsp_frag_list (&lsps[items[i].frag]->tlv_data,
+			    lsp_frag_tlvs[items[i].t].tlv);
+      if (*list == NULL)
+	{
+	  *list = list_new ();
+	  (*list)->del = free_tlv;
+	}
+      listnode_add (*list, items[i].data);
+    }
+  XFREE (MTYPE_TMP, items);
+
+  for (t = 0; t < LSP_FRAG_TLVS; t++)
+    if (*(list = lsp_frag_list (tlv_data, lsp_frag_tlvs[t].tlv)))
+      {
+	(*list)->del = NULL;
+	list_delete (*list);
+	*list = NULL;
+      }
+
+  for (frag = 0; frag <= last; frag++)
+    {
+      if ((lsp = lsps[frag]) == NULL)
+	continue;
+
+      for (t = 0; t < LSP_FRAG_TLVS; t++)
+	if (*(list = lsp_frag_list (&lsp->tlv_data, lsp_frag_tlvs[t].tlv)))
+	  lsp_frag_tlvs[t].build (*list, lsp->pdu);
+      lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
+
+      if (lsp_tlvs_changed (lsp, old[frag]))
+	{
+	  lsp->changed = 1;
+
+	  /* Validate the LSP */
+	  memset (&tlvs, 0, sizeof (struct tlvs));
+	  retval = parse_tlvs (area->area_tag, STREAM_DATA (lsp->pdu) +
+			       ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN,
+			       stream_get_endp (lsp->pdu) -
+			       ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN,
+			       &expected, &found, &tlvs, NULL);
+	  assert (retval == ISIS_OK);
+	  free_tlvs (&tlvs);
+	}
+
+      if (frag > 0 && old[frag])
+	stream_free (old[frag]);
+    }
+}
+
+/*
+ * Builds the LSP data part.  The neighbor and prefix entries are spread
+ * over the fragments by lsp_build_frags(), each fragment being filled up
+ * to area->lsp_frag_threshold.
  */
 static void
 lsp_build (struct isis_lsp *lsp, struct isis_area *area)
@@ -1294,12 +1698,10 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
   struct ipv6_reachability *ip6reach;
 #endif /* HAVE_IPV6 */
   struct tlvs tlv_data;
-  struct isis_lsp *lsp0 = lsp;
   struct in_addr *routerid;
-  uint32_t expected = 0, found = 0;
+  struct stream *old;
   uint32_t metric;
   u_char zero_id[ISIS_SYS_ID_LEN + 1];
-  int retval = ISIS_OK;
   char buf[BUFSIZ];
 
   lsp_debug("ISIS (%s): Constructing local system LSP for level %d", area->area_tag, level);
@@ -1309,6 +1711,9 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
    */
   memset (zero_id, 0, ISIS_SYS_ID_LEN + 1);
 
+  /* Keep what we had, to tell whether it changes */
+  old = stream_dup (lsp->pdu);
+
   /* Reset stream endp. Stream is always there and on every LSP refresh only
    * TLV part of it is overwritten. So we must seek past header we will not
    * touch. */
@@ -1692,98 +2097,11 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
 
   lsp_debug("ISIS (%s): LSP construction is complete. Serializing...", area->area_tag);
 
-  while (tlv_data.ipv4_int_reachs && listcount (tlv_data.ipv4_int_reachs))
-    {
-      if (lsp->tlv_data.ipv4_int_reachs == NULL)
-	lsp->tlv_data.ipv4_int_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv4_int_reachs,
-		   &lsp->tlv_data.ipv4_int_reachs,
-		   IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv4_int_reachs);
-      if (tlv_data.ipv4_int_reachs && listcount (tlv_data.ipv4_int_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  while (tlv_data.ipv4_ext_reachs && listcount (tlv_data.ipv4_ext_reachs))
-    {
-      if (lsp->tlv_data.ipv4_ext_reachs == NULL)
-	lsp->tlv_data.ipv4_ext_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv4_ext_reachs,
-		   &lsp->tlv_data.ipv4_ext_reachs,
-		   IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv4_ext_reachs);
-      if (tlv_data.ipv4_ext_reachs && listcount (tlv_data.ipv4_ext_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  /* FIXME: We pass maximum te_ipv4_reachability length to the lsp_tlv_fit()
-   * for now. lsp_tlv_fit() needs to be fixed to deal with variable length
-   * TLVs (sub TLVs!). */
-  while (tlv_data.te_ipv4_reachs && listcount (tlv_data.te_ipv4_reachs))
-    {
-      if (lsp->tlv_data.te_ipv4_reachs == NULL)
-	lsp->tlv_data.te_ipv4_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.te_ipv4_reachs,
-		   &lsp->tlv_data.te_ipv4_reachs,
-		   TE_IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_te_ipv4_reachs);
-      if (tlv_data.te_ipv4_reachs && listcount (tlv_data.te_ipv4_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-#ifdef  HAVE_IPV6
-  while (tlv_data.ipv6_reachs && listcount (tlv_data.ipv6_reachs))
-    {
-      if (lsp->tlv_data.ipv6_reachs == NULL)
-	lsp->tlv_data.ipv6_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv6_reachs,
-		   &lsp->tlv_data.ipv6_reachs,
-		   IPV6_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv6_reachs);
-      if (tlv_data.ipv6_reachs && listcount (tlv_data.ipv6_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-#endif /* HAVE_IPV6 */
-
-  while (tlv_data.is_neighs && listcount (tlv_data.is_neighs))
-    {
-      if (lsp->tlv_data.is_neighs == NULL)
-	lsp->tlv_data.is_neighs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.is_neighs,
-		   &lsp->tlv_data.is_neighs,
-		   IS_NEIGHBOURS_LEN, area->lsp_frag_threshold,
-		   tlv_add_is_neighs);
-      if (tlv_data.is_neighs && listcount (tlv_data.is_neighs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  while (tlv_data.te_is_neighs && listcount (tlv_data.te_is_neighs))
-    {
-      if (lsp->tlv_data.te_is_neighs == NULL)
-	lsp->tlv_data.te_is_neighs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.te_is_neighs, &lsp->tlv_data.te_is_neighs,
-		   IS_NEIGHBOURS_LEN, area->lsp_frag_threshold,
-		   tlv_add_te_is_neighs);
-      if (tlv_data.te_is_neighs && listcount (tlv_data.te_is_neighs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-  lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
+  lsp_build_frags (lsp, area, &tlv_data, old);
 
   free_tlvs (&tlv_data);
-
-  /* Validate the LSP */
-  retval = parse_tlvs (area->area_tag, STREAM_DATA (lsp->pdu) +
-                       ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN,
-                       stream_get_endp (lsp->pdu) -
-                       ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN,
-                       &expected, &found, &tlv_data, NULL);
-  assert (retval == ISIS_OK);
+  if (old)
+    stream_free (old);
 
   return;
 }
@@ -1858,6 +2176,39 @@ lsp_generate (struct isis_area *area, int level)
   return ISIS_OK;
 }
 
+/*
+ * Issue a new instance of one of our LSP fragments if lsp_build()
+ * changed it.  An unchanged one is left alone until past half its
+ * refresh time, and *refresh_time is lowered to when it is due, i.e.
+ * 300 seconds before it expires as in lsp_refresh_time().  Returns
+ * whether it issued one.
+ */
+static int
+lsp_reissue (struct isis_lsp *lsp, u_int8_t lsp_bits,
+             u_int16_t rem_lifetime, u_int16_t *refresh_time)
+{
+  u_int16_t remaining = ntohs (lsp->lsp_header->rem_lifetime);
+
+  if (!lsp->changed && lsp->lsp_header->lsp_bits == lsp_bits
+      && lsp->lsp_header->seq_num != 0
+      && remaining > 300 + lsp->area->lsp_refresh[lsp->level - 1] / 2)
+    {
+      if (remaining - 300 < *refresh_time)
+        *refresh_time = remaining - 300;
+      return 0;
+    }
+
+  lsp->lsp_header->lsp_bits = lsp_bits;
+  /* Set the lifetime values of all the fragments to the same value,
+   * so that no fragment expires before the lsp is refreshed.
+   */
+  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
+  lsp_inc_seqnum (lsp, 0);
+  lsp_set_all_srmflags (lsp);
+
+  return 1;
+}
+
 /*
  * Search own LSPs, update holding time and set SRM
  */
@@ -1869,6 +2220,8 @@ lsp_regenerate (struct isis_area *area, int level)
   struct listnode *node;
   u_char lspid[ISIS_SYS_ID_LEN + 2];
   u_int16_t rem_lifetime, refresh_time;
+  u_int8_t lsp_bits;
+  int reissued;
 
   if ((area == NULL) || (area->is_type & level) != level)
     return ISIS_ERROR;
@@ -1889,27 +2242,16 @@ lsp_regenerate (struct isis_area *area, int level)
 
   lsp_clear_data (lsp);
   lsp_build (lsp, area);
-  lsp->lsp_header->lsp_bits = lsp_bits_generate (level, area->overload_bit,
-                                                 area->attached_bit);
+  lsp_bits = lsp_bits_generate (level, area->overload_bit,
+                                area->attached_bit);
   rem_lifetime = lsp_rem_lifetime (area, level);
-  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
-  lsp_seqnum_update (lsp);
+  refresh_time = lsp_refresh_time (lsp, rem_lifetime);
 
+  reissued = lsp_reissue (lsp, lsp_bits, rem_lifetime, &refresh_time);
   lsp->last_generated = time (NULL);
-  lsp_set_all_srmflags (lsp);
   for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
-    {
-      frag->lsp_header->lsp_bits = lsp_bits_generate (level,
-                                                      area->overload_bit,
-                                                      area->attached_bit);
-      /* Set the lifetime values of all the fragments to the same value,
-       * so that no fragment expires before the lsp is refreshed.
-       */
-      frag->lsp_header->rem_lifetime = htons (rem_lifetime);
-      lsp_set_all_srmflags (frag);
-    }
+    reissued += lsp_reissue (frag, lsp_bits, rem_lifetime, &refresh_time);
 
-  refresh_time = lsp_refresh_time (lsp, rem_lifetime);
   if (level == IS_LEVEL_1)
     THREAD_TIMER_ON (master, area->t_lsp_refresh[level - 1],
                      lsp_l1_refresh, area, refresh_time);
@@ -1929,6 +2271,9 @@ lsp_regenerate (struct isis_area *area, int level)
                   ntohs (lsp->lsp_header->checksum),
                   ntohs (lsp->lsp_header->rem_lifetime),
                   refresh_time);
+      zlog_debug ("ISIS-Upd (%s): Reissued %d of %d L%d LSP fragments",
+                  area->area_tag, reissued,
+                  listcount (lsp->lspu.frags) + 1, level);
     }
   sched_debug("ISIS (%s): Rebuilt L%d LSP. Set triggered regenerate to non-pending.",
               area->area_tag, level);
@@ -46,6 +46,7 @@ struct isis_lsp
   time_t installed;
   time_t last_generated;
   int own_lsp;
+  int changed;			/* own LSP: rebuilt different, to reissue */
 #ifdef TOPOLOGY_GENERATE
   int from_topology;
   struct thread *t_lsp_top_ref;
@@ -61,6 +62,7 @@ void lsp_db_destroy (dict_t * lspdb);
 int lsp_tick (struct thread *thread);
 
 int lsp_generate (struct isis_area *area, int level);
+void lsp_frags_free (struct isis_area *area, int level);
 int lsp_regenerate_schedule (struct isis_area *area, int level,
                              int all_pseudo);
 int lsp_generate_pseudo (struct isis_circuit *circuit, int level);
@@ -2130,12 +2130,16 @@ isis_handle_pdu (struct isis_circuit *circuit, u_char * ssnpa)
 }
 
 #ifdef GNU_LINUX
+/* PDUs handled per read wakeup, see isis_receive() */
+#define ISIS_RX_BATCH 64
+
 int
 isis_receive (struct thread *thread)
 {
   struct isis_circuit *circuit;
   u_char ssnpa[ETH_ALEN];
   int retval;
+  int count = 0;
 
   /*
    * Get the circuit 
@@ -2143,13 +2147,22 @@ isis_receive (struct thread *thread)
   circuit = THREAD_ARG (thread);
   assert (circuit);
 
-  isis_circuit_stream(circuit, &circuit->rcv_stream);
-
-  retval = circuit->rx (circuit, ssnpa);
   circuit->t_read = NULL;
 
-  if (retval == ISIS_OK)
-    retval = isis_handle_pdu (circuit, ssnpa);
+  /*
+   * With a receive ring, handle what is already there in one go, up to
+   * a batch so a flooded circuit can't starve the other threads.
+   */
+  do
+    {
+      isis_circuit_stream(circuit, &circuit->rcv_stream);
+
+      retval = circuit->rx (circuit, ssnpa);
+
+      if (retval == ISIS_OK)
+        retval = isis_handle_pdu (circuit, ssnpa);
+    }
+  while (++count < ISIS_RX_BATCH && isis_sock_pending (circuit));
 
   /* 
    * prepare for next packet. 
@@ -23,9 +23,11 @@
 #include <zebra.h>
 #if ISIS_METHOD == ISIS_METHOD_PFPACKET
 #include <net/ethernet.h>	/* the L2 protocols */
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>	/* for the TPACKET_V2 ring */
+#include <sys/mman.h>
 
 #include "log.h"
+#include "memory.h"
 #include "network.h"
 #include "stream.h"
 #include "if.h"
@@ -58,6 +60,53 @@ u_char ALL_ESS[6] = { 0x09, 0x00, 0x2B, 0x00, 0x00, 0x04 };
 static uint8_t discard_buff[8192];
 static uint8_t sock_buff[8192];
 
+/*
+ * Socket filter for broadcast circuits, run by the kernel before a frame
+ * is queued to us.  It passes only frames which were not sent by this
+ * host, carry the ISO LLC header (0xFE 0xFE 0x03) and are addressed to
+ * AllL1ISs, AllL2ISs or AllISs (RFC 5309).  The socket is SOCK_DGRAM so
+ * offset 0 is the LLC; the destination MAC is read from the link layer
+ * header through SKF_LL_OFF.
+ */
+static struct sock_filter isis_bcast_filter[] =
+{
+  BPF_STMT (BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 13, 0),
+  BPF_STMT (BPF_LD | BPF_H | BPF_ABS, 0),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0xFEFE, 0, 11),
+  BPF_STMT (BPF_LD | BPF_B | BPF_ABS, 2),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0x03, 0, 9),
+  BPF_STMT (BPF_LD | BPF_W | BPF_ABS, SKF_LL_OFF),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0x0180C200, 0, 3),
+  BPF_STMT (BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 4),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0x0014, 4, 0),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0x0015, 3, 4),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0x09002B00, 0, 3),
+  BPF_STMT (BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 4),
+  BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, 0x0005, 0, 1),
+  BPF_STMT (BPF_RET | BPF_K, 0xFFFFFFFF),
+  BPF_STMT (BPF_RET | BPF_K, 0),
+};
+
+/*
+ * PACKET_RX_RING state of a broadcast circuit.  The kernel copies
+ * frames straight into the mapped ring and flips their status to
+ * TP_STATUS_USER; we hand each back with TP_STATUS_KERNEL once its PDU
+ * is in the receive stream, so draining the ring needs no syscalls.
+ */
+#ifdef TPACKET2_HDRLEN
+#define ISIS_RX_RING_FRAMES	128
+
+struct isis_rx_ring
+{
+  u_char *map;
+  size_t size;
+  unsigned int frame_size;
+  unsigned int frame_nr;
+  unsigned int frame;		/* next frame to be read */
+};
+#endif /* TPACKET2_HDRLEN */
+
 /*
  * if level is 0 we are joining p2p multicast
  * FIXME: and the p2p multicast being ???
@@ -104,6 +153,114 @@ isis_multicast_join (int fd, int registerto, int if_num)
   return ISIS_OK;
 }
 
+static void
+isis_attach_filter (struct isis_circuit *circuit)
+{
+  struct sock_fprog prog;
+
+  prog.len = sizeof (isis_bcast_filter) / sizeof (isis_bcast_filter[0]);
+  prog.filter = isis_bcast_filter;
+
+  /* Not fatal: isis_recv_pdu_bcast() does the same checks itself. */
+  if (setsockopt (circuit->fd, SOL_SOCKET, SO_ATTACH_FILTER,
+		  &prog, sizeof (prog)) < 0)
+    zlog_warn ("%s: could not attach socket filter on %s: %s", __func__,
+	       circuit->interface->name, safe_strerror (errno));
+}
+
+#ifdef TPACKET2_HDRLEN
+static void
+isis_rx_ring_init (struct isis_circuit *circuit)
+{
+  struct isis_rx_ring *ring;
+  struct tpacket_req req;
+  unsigned int frame_size, block_size, mtu;
+  int version = TPACKET_V2;
+  void *map;
+
+  /* Frame header, sockaddr_ll and the 16 bytes of link layer header
+   * the kernel reserves in front of the network header, then the data. */
+  mtu = MAX (circuit->interface->mtu, 1500);
+  frame_size = TPACKET_ALIGN (TPACKET2_HDRLEN + 16) + mtu;
+  for (block_size = TPACKET_ALIGNMENT; block_size < frame_size; )
+    block_size <<= 1;
+  frame_size = block_size;
+  block_size = MAX (frame_size, (unsigned int) getpagesize ());
+
+  memset (&req, 0, sizeof (req));
+  req.tp_block_size = block_size;
+  req.tp_frame_size = frame_size;
+  req.tp_block_nr = MAX (ISIS_RX_RING_FRAMES / (block_size / frame_size), 1);
+  req.tp_frame_nr = req.tp_block_nr * (block_size / frame_size);
+
+  if (setsockopt (circuit->fd, SOL_PACKET, PACKET_VERSION,
+		  &version, sizeof (version)) < 0
+      || setsockopt (circuit->fd, SOL_PACKET, PACKET_RX_RING,
+		     &req, sizeof (req)) < 0)
+    {
+      zlog_warn ("%s: no receive ring on %s, using recvfrom(): %s",
+		 __func__, circuit->interface->name, safe_strerror (errno));
+      return;
+    }
+
+  map = mmap (NULL, (size_t) block_size * req.tp_block_nr,
+	      PROT_READ | PROT_WRITE, MAP_SHARED, circuit->fd, 0);
+  if (map == MAP_FAILED)
+    {
+      zlog_warn ("%s: could not map receive ring on %s: %s", __func__,
+		 circuit->interface->name, safe_strerror (errno));
+      /* Drop the ring again, or recvfrom() gets nothing */
+      memset (&req, 0, sizeof (req));
+      setsockopt (circuit->fd, SOL_PACKET, PACKET_RX_RING,
+		  &req, sizeof (req));
+      return;
+    }
+
+  ring = XCALLOC (MTYPE_ISIS_RX_RING, sizeof (struct isis_rx_ring));
+  ring->map = map;
+  ring->size = (size_t) block_size * req.tp_block_nr;
+  ring->frame_size = frame_size;
+  ring->frame_nr = req.tp_frame_nr;
+  circuit->rx_ring = ring;
+}
+
+static inline struct tpacket2_hdr *
+isis_rx_ring_frame (struct isis_rx_ring *ring)
+{
+  return (struct tpacket2_hdr *)
+    (ring->map + (size_t) ring->frame * ring->frame_size);
+}
+#endif /* TPACKET2_HDRLEN */
+
+/* Unmap the receive ring, called before the circuit socket is closed. */
+void
+isis_sock_ring_free (struct isis_circuit *circuit)
+{
+#ifdef TPACKET2_HDRLEN
+  struct isis_rx_ring *ring = circuit->rx_ring;
+
+  if (ring == NULL)
+    return;
+
+  munmap (ring->map, ring->size);
+  XFREE (MTYPE_ISIS_RX_RING, ring);
+  circuit->rx_ring = NULL;
+#endif /* TPACKET2_HDRLEN */
+}
+
+/* Is another frame already waiting in the receive ring? */
+int
+isis_sock_pending (struct isis_circuit *circuit)
+{
+#ifdef TPACKET2_HDRLEN
+  struct isis_rx_ring *ring = circuit->rx_ring;
+
+  if (ring != NULL)
+    return (isis_rx_ring_frame (ring)->tp_status & TP_STATUS_USER) != 0;
+#endif /* TPACKET2_HDRLEN */
+  return 0;
+}
+
 static int
 open_packet_socket (struct isis_circuit *circuit)
 {
@@ -153,6 +310,11 @@ open_packet_socket (struct isis_circuit *circuit)
       /* joining ALL_ISS (used in RFC 5309 p2p-over-lan as well) */
       retval |= isis_multicast_join (circuit->fd, 3,
                                     circuit->interface->ifindex);
+
+      isis_attach_filter (circuit);
+#ifdef TPACKET2_HDRLEN
+      isis_rx_ring_init (circuit);
+#endif /* TPACKET2_HDRLEN */
     }
   else
     {
@@ -216,68 +378,107 @@ llc_check (u_char * llc)
   return 1;
 }
 
+/*
+ * Checks common to both receive paths.  Filtering by llc field, discard
+ * packets sent by this host (other circuit).  The socket filter already
+ * did most of this but is not guaranteed to be attached.
+ */
+static int
+isis_recv_check (struct isis_circuit *circuit, struct sockaddr_ll *s_addr,
+		 u_char *data, size_t len)
+{
+  if (s_addr->sll_ifindex != (int)circuit->interface->ifindex)
+    {
+      zlog_warn("packet is received on multiple interfaces: "
+                "socket interface %d, circuit interface %d, "
+                "packet type %u",
+                s_addr->sll_ifindex, circuit->interface->ifindex,
+                s_addr->sll_pkttype);
+      return ISIS_WARNING;
+    }
+
+  if (len < LLC_LEN || !llc_check (data)
+      || s_addr->sll_pkttype == PACKET_OUTGOING)
+    return ISIS_WARNING;
+
+  return ISIS_OK;
+}
+
+#ifdef TPACKET2_HDRLEN
+/* Take the next frame off the receive ring. */
+static int
+isis_recv_pdu_ring (struct isis_circuit *circuit, u_char * ssnpa)
+{
+  struct isis_rx_ring *ring = circuit->rx_ring;
+  struct tpacket2_hdr *hdr;
+  struct sockaddr_ll *s_addr;
+  u_char *data;
+  int retval;
+
+  hdr = isis_rx_ring_frame (ring);
+  if (!(hdr->tp_status & TP_STATUS_USER))
+    return ISIS_WARNING;
+
+  s_addr = (struct sockaddr_ll *)
+    ((u_char *) hdr + TPACKET_ALIGN (sizeof (struct tpacket2_hdr)));
+  data = (u_char *) hdr + hdr->tp_net;
+
+  retval = isis_recv_check (circuit, s_addr, data, hdr->tp_snaplen);
+  if (retval == ISIS_OK && hdr->tp_snaplen < hdr->tp_len)
+    {
+      zlog_warn ("isis_recv_pdu_bcast(): %s: frame of %u bytes truncated "
+		 "in receive ring", circuit->interface->name, hdr->tp_len);
+      retval = ISIS_WARNING;
+    }
+
+  if (retval == ISIS_OK)
+    {
+      /* lose the LLC on the way */
+      stream_write (circuit->rcv_stream, data + LLC_LEN,
+		    hdr->tp_snaplen - LLC_LEN);
+      memcpy (ssnpa, &s_addr->sll_addr, s_addr->sll_halen);
+    }
+
+  /* hand the frame back to the kernel only once we're done with it */
+  __sync_synchronize ();
+  hdr->tp_status = TP_STATUS_KERNEL;
+  if (++ring->frame == ring->frame_nr)
+    ring->frame = 0;
+
+  return retval;
+}
+#endif /* TPACKET2_HDRLEN */
+
 int
 isis_recv_pdu_bcast (struct isis_circuit *circuit, u_char * ssnpa)
 {
   int bytesread, addr_len;
   struct sockaddr_ll s_addr;
-  u_char llc[LLC_LEN];
+
+#ifdef TPACKET2_HDRLEN
+  if (circuit->rx_ring)
+    return isis_recv_pdu_ring (circuit, ssnpa);
+#endif /* TPACKET2_HDRLEN */
 
   addr_len = sizeof (s_addr);
 
   memset (&s_addr, 0, sizeof (struct sockaddr_ll));
 
-  bytesread = recvfrom (circuit->fd, (void *) &llc,
-			LLC_LEN, MSG_PEEK,
-			(struct sockaddr *) &s_addr, (socklen_t *) &addr_len);
-
-  if ((bytesread < 0) || (s_addr.sll_ifindex != (int)circuit->interface->ifindex))
-    {
-      if (bytesread < 0)
-        {
-          zlog_warn ("isis_recv_packet_bcast(): ifname %s, fd %d, "
-                     "bytesread %d, recvfrom(): %s",
-                     circuit->interface->name, circuit->fd, bytesread,
-                     safe_strerror (errno));
-        }
-      if (s_addr.sll_ifindex != (int)circuit->interface->ifindex)
-        {
-          zlog_warn("packet is received on multiple interfaces: "
-                    "socket interface %d, circuit interface %d, "
-                    "packet type %u",
-                    s_addr.sll_ifindex, circuit->interface->ifindex,
-                    s_addr.sll_pkttype);
-        }
-
-      /* get rid of the packet */
-      bytesread = recvfrom (circuit->fd, discard_buff, sizeof (discard_buff),
-                            MSG_DONTWAIT, (struct sockaddr *) &s_addr,
-                            (socklen_t *) &addr_len);
-      return ISIS_WARNING;
-    }
-  /*
-   * Filtering by llc field, discard packets sent by this host (other circuit)
-   */
-  if (!llc_check (llc) || s_addr.sll_pkttype == PACKET_OUTGOING)
-    {
-      /*  Read the packet into discard buff */
-      bytesread = recvfrom (circuit->fd, discard_buff, sizeof (discard_buff),
-                            MSG_DONTWAIT, (struct sockaddr *) &s_addr,
-                            (socklen_t *) &addr_len);
-      if (bytesread < 0)
-	zlog_warn ("isis_recv_pdu_bcast(): recvfrom() failed");
-      return ISIS_WARNING;
-    }
-
   /* on lan we have to read to the static buff first */
   bytesread = recvfrom (circuit->fd, sock_buff, sizeof (sock_buff), MSG_DONTWAIT,
 			(struct sockaddr *) &s_addr, (socklen_t *) &addr_len);
   if (bytesread < 0)
     {
-      zlog_warn ("isis_recv_pdu_bcast(): recvfrom() failed");
+      zlog_warn ("isis_recv_packet_bcast(): ifname %s, fd %d, "
+                 "bytesread %d, recvfrom(): %s",
+                 circuit->interface->name, circuit->fd, bytesread,
+                 safe_strerror (errno));
       return ISIS_WARNING;
     }
 
+  if (isis_recv_check (circuit, &s_addr, sock_buff, bytesread) != ISIS_OK)
+    return ISIS_WARNING;
+
   /* then we lose the LLC */
   stream_write (circuit->rcv_stream, sock_buff + LLC_LEN, bytesread - LLC_LEN);
 
@@ -250,6 +250,8 @@ isis_area_destroy (struct vty *vty, const char *area_tag)
       lsp_db_destroy (area->lspdb[1]);
       area->lspdb[1] = NULL;
     }
+  lsp_frags_free (area, IS_LEVEL_1);
+  lsp_frags_free (area, IS_LEVEL_2);
 
   spftree_area_del (area);
 
@@ -82,6 +82,8 @@ struct isis_area
    * be delayed until the next regular refresh.
    */
   int lsp_regenerate_pending[ISIS_LEVELS];
+  /* fragment each entry of our LSPs was put in, see lsp_build_frags() */
+  struct hash *lsp_frags[ISIS_LEVELS];
 
   /*
    * Configurables 
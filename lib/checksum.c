@@ -12,35 +12,54 @@
 int			/* return checksum in low-order 16 bits */
 in_cksum(void *parg, int nbytes)
 {
-	u_short *ptr = parg;
-	register long		sum;		/* assumes long == 32 bits */
-	u_short			oddbyte;
+	u_char *ptr = parg;
+	u_int64_t		sum;
+	u_int32_t		w0, w1, w2, w3;
+	u_short			word, oddbyte;
 	register u_short	answer;		/* assumes u_short == 16 bits */
 
 	/*
-	 * Our algorithm is simple, using a 32-bit accumulator (sum),
-	 * we add sequential 16-bit words to it, and at the end, fold back
-	 * all the carry bits from the top 16 bits into the lower 16 bits.
+	 * The ones-complement sum does not depend on the width of the
+	 * words being added (RFC 1071, section 2), so we add 32-bit words
+	 * into a 64-bit accumulator, four at a time, and fold the carries
+	 * back at the end.  A 64-bit accumulator cannot overflow for any
+	 * length that fits in an int.  The words are fetched with memcpy
+	 * so that callers need not hand us an aligned buffer.
 	 */
 
 	sum = 0;
+	while (nbytes >= 16)  {
+		memcpy (&w0, ptr, 4);
+		memcpy (&w1, ptr + 4, 4);
+		memcpy (&w2, ptr + 8, 4);
+		memcpy (&w3, ptr + 12, 4);
+		sum += (u_int64_t) w0 + w1;
+		sum += (u_int64_t) w2 + w3;
+		ptr += 16;
+		nbytes -= 16;
+	}
 	while (nbytes > 1)  {
-		sum += *ptr++;
+		memcpy (&word, ptr, 2);
+		sum += word;
+		ptr += 2;
 		nbytes -= 2;
 	}
 
 				/* mop up an odd byte, if necessary */
 	if (nbytes == 1) {
 		oddbyte = 0;		/* make sure top half is zero */
-		*((u_char *) &oddbyte) = *(u_char *)ptr;   /* one byte only */
+		*((u_char *) &oddbyte) = *ptr;	/* one byte only */
 		sum += oddbyte;
 	}
 
 	/*
-	 * Add back carry outs from top 16 bits to low 16 bits.
+	 * Add back carry outs, 64 bits down to 32 and then to 16.
 	 */
 
+	sum  = (sum >> 32) + (sum & 0xffffffff);
+	sum  = (sum >> 32) + (sum & 0xffffffff);
 	sum  = (sum >> 16) + (sum & 0xffff);	/* add high-16 to low-16 */
+	sum  = (sum >> 16) + (sum & 0xffff);
 	sum += (sum >> 16);			/* add carry */
 	answer = ~sum;		/* ones-complement, then truncate to 16 bits */
 	return(answer);
@@ -56,11 +75,12 @@ in_cksum(void *parg, int nbytes)
 u_int16_t
 fletcher_checksum(u_char * buffer, const size_t len, const uint16_t offset)
 {
-  u_int8_t *p;
+  u_int8_t *p, *ep;
   int x, y, c0, c1;
+  u_int32_t a0, a1;
   u_int16_t checksum;
   u_int16_t *csum;
-  size_t partial_len, i, left = len;
+  size_t partial_len, left = len;
   
   checksum = 0;
 
@@ -74,24 +94,37 @@ fletcher_checksum(u_char * buffer, const size_t len, const uint16_t offset)
     }
 
   p = buffer;
-  c0 = 0;
-  c1 = 0;
+  a0 = 0;
+  a1 = 0;
 
   while (left != 0)
     {
       partial_len = MIN(left, MODX);
+      ep = p + partial_len;
 
-      for (i = 0; i < partial_len; i++)
+      /* Eight bytes at a time: each byte is added once to c0 and, through
+         c0, as many times to c1 as there are bytes left in the group. */
+      while (ep - p >= 8)
+	{
+	  a1 += 8 * a0
+	        + 8 * p[0] + 7 * p[1] + 6 * p[2] + 5 * p[3]
+	        + 4 * p[4] + 3 * p[5] + 2 * p[6] + p[7];
+	  a0 += p[0] + p[1] + p[2] + p[3] + p[4] + p[5] + p[6] + p[7];
+	  p += 8;
+	}
+      while (p < ep)
 	{
-	  c0 = c0 + *(p++);
-	  c1 += c0;
+	  a0 += *(p++);
+	  a1 += a0;
 	}
 
-      c0 = c0 % 255;
-      c1 = c1 % 255;
+      a0 = a0 % 255;
+      a1 = a1 % 255;
 
       left -= partial_len;
     }
+  c0 = a0;
+  c1 = a1;
 
   /* The cast is important, to ensure the mod is taken as a signed value. */
   x = (int)((len - offset - 1) * c0 - c1) % 255;
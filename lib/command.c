@@ -212,6 +212,186 @@ argv_concat (const char **argv, int argc, int shift)
   return str;
 }
 
+/* Trie of a node's commands, keyed by their leading tokens.  Every
+   token which consumes exactly one input word (literals, variables,
+   ranges, addresses, options and "(a|b)" multiples) is an edge, and
+   commands sharing the same leading tokens share the same path.  A
+   command is stored at the node where it ends or where it continues
+   with a "{...}" keyword list or a vararg, which can consume any
+   number of words and are left to the full matcher.  Executing a
+   command line then only has to look at the edges its words select,
+   instead of at every command installed in the node. */
+struct cmd_trie
+{
+  /* Token leading to this node, NULL at the root. */
+  struct cmd_token *token;
+
+  /* Children reached through a literal word, sorted by that word so
+     that abbreviations can be looked up by prefix. */
+  vector literal;
+
+  /* Children reached through any other one word token. */
+  vector other;
+
+  /* Commands which can't be followed further down the trie. */
+  vector rest;
+};
+
+static struct cmd_trie *
+cmd_trie_new (struct cmd_token *token)
+{
+  struct cmd_trie *trie;
+
+  trie = XCALLOC (MTYPE_CMD_TRIE, sizeof (struct cmd_trie));
+  trie->token = token;
+  return trie;
+}
+
+static void
+cmd_trie_free (struct cmd_trie *trie)
+{
+  unsigned int i;
+
+  if (trie->literal)
+    {
+      for (i = 0; i < vector_active (trie->literal); i++)
+	cmd_trie_free (vector_slot (trie->literal, i));
+      vector_free (trie->literal);
+    }
+  if (trie->other)
+    {
+      for (i = 0; i < vector_active (trie->other); i++)
+	cmd_trie_free (vector_slot (trie->other, i));
+      vector_free (trie->other);
+    }
+  if (trie->rest)
+    vector_free (trie->rest);
+  XFREE (MTYPE_CMD_TRIE, trie);
+}
+
+/* Can the token be an edge of the trie, i.e. does the matcher always
+   consume exactly one word for it? */
+static int
+cmd_trie_edge_token (struct cmd_token *token)
+{
+  switch (token->type)
+    {
+    case TOKEN_TERMINAL:
+      return token->terminal != TERMINAL_VARARG;
+    case TOKEN_MULTIPLE:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+/* Do two tokens match exactly the same words? */
+static int
+cmd_trie_token_same (struct cmd_token *a, struct cmd_token *b)
+{
+  unsigned int i;
+
+  if (a->type != b->type)
+    return 0;
+
+  if (a->type == TOKEN_MULTIPLE)
+    {
+      if (vector_active (a->multiple) != vector_active (b->multiple))
+	return 0;
+      for (i = 0; i < vector_active (a->multiple); i++)
+	if (! cmd_trie_token_same (vector_slot (a->multiple, i),
+				   vector_slot (b->multiple, i)))
+	  return 0;
+      return 1;
+    }
+
+  return a->terminal == b->terminal && strcmp (a->cmd, b->cmd) == 0;
+}
+
+/* Index of the first literal child whose word is not less than str. */
+static unsigned int
+cmd_trie_literal_bound (struct cmd_trie *trie, const char *str)
+{
+  unsigned int low, high, mid;
+  struct cmd_trie *child;
+
+  low = 0;
+  high = vector_active (trie->literal);
+  while (low < high)
+    {
+      mid = (low + high) / 2;
+      child = vector_slot (trie->literal, mid);
+      if (strcmp (child->token->cmd, str) < 0)
+	low = mid + 1;
+      else
+	high = mid;
+    }
+  return low;
+}
+
+/* Find or add the child of trie reached through token. */
+static struct cmd_trie *
+cmd_trie_child (struct cmd_trie *trie, struct cmd_token *token)
+{
+  unsigned int i;
+  struct cmd_trie *child;
+
+  if (token->type == TOKEN_TERMINAL && token->terminal == TERMINAL_LITERAL)
+    {
+      if (! trie->literal)
+	trie->literal = vector_init (VECTOR_MIN_SIZE);
+
+      i = cmd_trie_literal_bound (trie, token->cmd);
+      if (i < vector_active (trie->literal))
+	{
+	  child = vector_slot (trie->literal, i);
+	  if (strcmp (child->token->cmd, token->cmd) == 0)
+	    return child;
+	}
+
+      /* Open a slot at i. */
+      vector_set (trie->literal, NULL);
+      memmove (&trie->literal->index[i + 1], &trie->literal->index[i],
+	       (vector_active (trie->literal) - i - 1) * sizeof (void *));
+      child = cmd_trie_new (token);
+      vector_slot (trie->literal, i) = child;
+      return child;
+    }
+
+  if (! trie->other)
+    trie->other = vector_init (VECTOR_MIN_SIZE);
+
+  for (i = 0; i < vector_active (trie->other); i++)
+    {
+      child = vector_slot (trie->other, i);
+      if (cmd_trie_token_same (child->token, token))
+	return child;
+    }
+
+  child = cmd_trie_new (token);
+  vector_set (trie->other, child);
+  return child;
+}
+
+static void
+cmd_trie_insert (struct cmd_trie *trie, struct cmd_element *cmd)
+{
+  unsigned int i;
+  struct cmd_token *token;
+
+  for (i = 0; cmd->tokens && i < vector_active (cmd->tokens); i++)
+    {
+      token = vector_slot (cmd->tokens, i);
+      if (! cmd_trie_edge_token (token))
+	break;
+      trie = cmd_trie_child (trie, token);
+    }
+
+  if (! trie->rest)
+    trie->rest = vector_init (VECTOR_MIN_SIZE);
+  vector_set (trie->rest, cmd);
+}
+
 /* Install top node of command vector. */
 void
 install_node (struct cmd_node *node, 
@@ -220,6 +400,7 @@ install_node (struct cmd_node *node,
   vector_set_index (cmdvec, node->node, node);
   node->func = func;
   node->cmd_vector = vector_init (VECTOR_MIN_SIZE);
+  node->cmd_trie = cmd_trie_new (NULL);
 }
 
 /* Breaking up string into each command piece. I assume given
@@ -622,6 +803,7 @@ install_element (enum node_type ntype, struct cmd_element *cmd)
   vector_set (cnode->cmd_vector, cmd);
   if (cmd->tokens == NULL)
     cmd->tokens = cmd_parse_format(cmd->string, cmd->doc);
+  cmd_trie_insert (cnode->cmd_trie, cmd);
 }
 
 static const unsigned char itoa64[] =
@@ -2609,65 +2791,230 @@ node_parent ( enum node_type node )
   return ret;
 }
 
-/* Execute command by argument vline vector. */
-static int
-cmd_execute_command_real (vector vline,
-			  enum filter_type filter,
-			  struct vty *vty,
-			  struct cmd_element **cmd)
+/* Append all commands stored at or below trie to commands. */
+static void
+cmd_trie_collect (struct cmd_trie *trie, vector commands)
 {
   unsigned int i;
+
+  if (trie->rest)
+    for (i = 0; i < vector_active (trie->rest); i++)
+      vector_set (commands, vector_slot (trie->rest, i));
+  if (trie->literal)
+    for (i = 0; i < vector_active (trie->literal); i++)
+      cmd_trie_collect (vector_slot (trie->literal, i), commands);
+  if (trie->other)
+    for (i = 0; i < vector_active (trie->other); i++)
+      cmd_trie_collect (vector_slot (trie->other, i), commands);
+}
+
+/* Match word against the edge leading to child, recording the
+   matching tokens the way cmd_matcher_match_terminal() and
+   cmd_matcher_match_multiple() do for each command below it. */
+static enum match_type
+cmd_trie_word_match (struct cmd_trie *child, enum filter_type filter,
+		     const char *word, vector *match)
+{
+  unsigned int i;
+  struct cmd_token *token;
+  enum match_type best_match;
+  enum match_type word_match;
+
+  *match = NULL;
+
+  if (child->token->type == TOKEN_TERMINAL)
+    {
+      best_match = cmd_word_match (child->token, filter, word);
+      if (best_match != no_match)
+	{
+	  *match = vector_init (VECTOR_MIN_SIZE);
+	  vector_set (*match, child->token);
+	}
+      return best_match;
+    }
+
+  best_match = no_match;
+  for (i = 0; i < vector_active (child->token->multiple); i++)
+    {
+      token = vector_slot (child->token->multiple, i);
+      word_match = cmd_word_match (token, filter, word);
+      if (word_match == no_match)
+	continue;
+
+      if (! *match)
+	*match = vector_init (VECTOR_MIN_SIZE);
+      vector_set (*match, token);
+      if (word_match > best_match)
+	best_match = word_match;
+    }
+  return best_match;
+}
+
+/**
+ * Find the commands of a node which are still candidates after
+ * filtering them word by word against a commandline.
+ *
+ * This is what cmd_vector_filter() and is_cmd_ambiguous() do over all
+ * of the node's commands, but all commands below a trie edge match
+ * each word in the same way and are handled as one.  Only the edges
+ * selected by each word and the commands which leave the trie are
+ * looked at, so the cost no longer grows with the size of the node.
+ *
+ * @param root The trie of the node.
+ * @param filter Either FILTER_RELAXED or FILTER_STRICT.
+ * @param vline The tokenized commandline.
+ * @param commands Where to store the vector of candidate commands,
+ *                 on success.
+ * @return CMD_SUCCESS, or the error the commandline is rejected with.
+ */
+static int
+cmd_trie_filter (struct cmd_trie *root, enum filter_type filter,
+		 vector vline, vector *commands)
+{
   unsigned int index;
-  vector cmd_vector;
-  struct cmd_element *cmd_element;
-  struct cmd_element *matched_element;
-  unsigned int matched_count, incomplete_count;
-  int argc;
-  const char *argv[CMD_ARGC_MAX];
-  enum match_type match = 0;
-  char *command;
-  int ret;
+  unsigned int i, j;
+  unsigned int first;
+  vector nodes;
+  vector units;
   vector matches;
+  vector match;
+  struct cmd_trie *trie;
+  struct cmd_trie *child;
+  enum match_type best_match;
+  enum match_type word_match;
+  const char *command;
+  int ret = CMD_SUCCESS;
+  int vararg = 0;
 
-  /* Make copy of command elements. */
-  cmd_vector = vector_copy (cmd_node_vector (cmdvec, vty->node));
+  nodes = vector_init (VECTOR_MIN_SIZE);
+  vector_set (nodes, root);
 
-  for (index = 0; index < vector_active (vline); index++)
+  /* Commands which have left the trie come first in units, followed
+     by the trie children still matching the commandline. */
+  units = vector_init (VECTOR_MIN_SIZE);
+
+  for (index = 0; index < vector_active (vline) && ! vararg; index++)
     {
       command = vector_slot (vline, index);
-      ret = cmd_vector_filter(cmd_vector,
-			      filter,
-			      vline, index,
-			      &match,
-			      &matches);
 
-      if (ret != CMD_SUCCESS)
+      for (i = 0; i < vector_active (nodes); i++)
 	{
-	  cmd_matches_free(&matches);
-	  return ret;
+	  trie = vector_slot (nodes, i);
+	  if (trie->rest)
+	    for (j = 0; j < vector_active (trie->rest); j++)
+	      vector_set (units, vector_slot (trie->rest, j));
 	}
+      first = vector_active (units);
 
-      if (match == vararg_match)
+      ret = cmd_vector_filter (units, filter, vline, index,
+			       &best_match, &matches);
+      if (ret != CMD_SUCCESS)
 	{
-	  cmd_matches_free(&matches);
+	  cmd_matches_free (&matches);
 	  break;
 	}
 
-      ret = is_cmd_ambiguous (cmd_vector, command, matches, match);
-      cmd_matches_free(&matches);
+      for (i = 0; i < vector_active (nodes); i++)
+	{
+	  trie = vector_slot (nodes, i);
+
+	  if (trie->literal)
+	    for (j = command ? cmd_trie_literal_bound (trie, command) : 0;
+		 j < vector_active (trie->literal); j++)
+	      {
+		child = vector_slot (trie->literal, j);
+		if (command && strncmp (child->token->cmd, command,
+					strlen (command)) != 0)
+		  break;
+		word_match = cmd_trie_word_match (child, filter, command, &match);
+		if (word_match == no_match)
+		  continue;
+		vector_set_index (matches, vector_active (units), match);
+		vector_set_index (units, vector_active (units), child);
+		if (word_match > best_match)
+		  best_match = word_match;
+	      }
+
+	  if (trie->other)
+	    for (j = 0; j < vector_active (trie->other); j++)
+	      {
+		child = vector_slot (trie->other, j);
+		word_match = cmd_trie_word_match (child, filter, command, &match);
+		if (word_match == no_match)
+		  continue;
+		vector_set_index (matches, vector_active (units), match);
+		vector_set_index (units, vector_active (units), child);
+		if (word_match > best_match)
+		  best_match = word_match;
+	      }
+	}
+
+      if (best_match == vararg_match)
+	vararg = 1;
+      else
+	ret = is_cmd_ambiguous (units, command, matches, best_match);
+      cmd_matches_free (&matches);
+
+      /* Move the children which are left on to the next word. */
+      vector_free (nodes);
+      nodes = vector_init (VECTOR_MIN_SIZE);
+      for (i = vector_active (units); i > first; i--)
+	{
+	  if ((child = vector_slot (units, i - 1)) != NULL)
+	    vector_set (nodes, child);
+	  vector_unset (units, i - 1);
+	}
 
       if (ret == 1)
 	{
-	  vector_free(cmd_vector);
-	  return CMD_ERR_AMBIGUOUS;
+	  ret = CMD_ERR_AMBIGUOUS;
+	  break;
 	}
       else if (ret == 2)
 	{
-	  vector_free(cmd_vector);
-	  return CMD_ERR_NO_MATCH;
+	  ret = CMD_ERR_NO_MATCH;
+	  break;
 	}
     }
 
+  if (ret == CMD_SUCCESS)
+    {
+      *commands = vector_init (VECTOR_MIN_SIZE);
+      for (i = 0; i < vector_active (units); i++)
+	if (vector_slot (units, i) != NULL)
+	  vector_set (*commands, vector_slot (units, i));
+      for (i = 0; i < vector_active (nodes); i++)
+	cmd_trie_collect (vector_slot (nodes, i), *commands);
+    }
+
+  vector_free (units);
+  vector_free (nodes);
+  return ret;
+}
+
+/* Execute command by argument vline vector. */
+static int
+cmd_execute_command_real (vector vline,
+			  enum filter_type filter,
+			  struct vty *vty,
+			  struct cmd_element **cmd)
+{
+  unsigned int i;
+  struct cmd_node *cnode;
+  vector cmd_vector;
+  struct cmd_element *cmd_element;
+  struct cmd_element *matched_element;
+  unsigned int matched_count, incomplete_count;
+  int argc;
+  const char *argv[CMD_ARGC_MAX];
+  int ret;
+
+  /* Find the commands which match all words so far. */
+  cnode = vector_slot (cmdvec, vty->node);
+  ret = cmd_trie_filter (cnode->cmd_trie, filter, vline, &cmd_vector);
+  if (ret != CMD_SUCCESS)
+    return ret;
+
   /* Check matched count. */
   matched_element = NULL;
   matched_count = 0;
@@ -4322,6 +4669,12 @@ cmd_terminate ()
                 cmd_terminate_element(cmd_element);
 
             vector_free (cmd_node_v);
+
+            if (cmd_node->cmd_trie)
+              {
+                cmd_trie_free (cmd_node->cmd_trie);
+                cmd_node->cmd_trie = NULL;
+              }
           }
 
       vector_free (cmdvec);
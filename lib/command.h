@@ -110,6 +110,8 @@ enum node_type
   VTY_NODE,			/* Vty node. */
 };
 
+struct cmd_trie;
+
 /* Node which has some commands and prompt string and configuration
    function pointer . */
 struct cmd_node 
@@ -128,6 +130,9 @@ struct cmd_node
 
   /* Vector of this node's command list. */
   vector cmd_vector;	
+
+  /* The same commands indexed by their leading tokens. */
+  struct cmd_trie *cmd_trie;
 };
 
 enum
@@ -610,11 +610,39 @@ ALIAS (no_distribute_list_prefix, no_ipv6_distribute_list_prefix_cmd,
        "Filter outgoing routing updates\n"
        "Interface name\n")
 
+struct distribute_iterate_arg
+{
+  struct vty *vty;
+  int type;
+  int write;
+};
+
+static void
+config_show_distribute_iterator (struct hash_backet *mp, void *arg)
+{
+  struct distribute_iterate_arg *iter = arg;
+  struct vty *vty = iter->vty;
+  int type = iter->type;
+  struct distribute *dist = mp->data;
+
+  if (dist->ifname)
+    if (dist->list[type] || dist->prefix[type])
+      {
+	vty_out (vty, "    %s filtered by", dist->ifname);
+	if (dist->list[type])
+	  vty_out (vty, " %s", dist->list[type]);
+	if (dist->prefix[type])
+	  vty_out (vty, "%s (prefix-list) %s",
+		   dist->list[type] ? "," : "",
+		   dist->prefix[type]);
+	vty_out (vty, "%s", VTY_NEWLINE);
+      }
+}
+
 int
 config_show_distribute (struct vty *vty)
 {
-  unsigned int i;
-  struct hash_backet *mp;
+  struct distribute_iterate_arg arg;
   struct distribute *dist;
 
   /* Output filter configuration. */
@@ -633,23 +661,9 @@ config_show_distribute (struct vty *vty)
   else
     vty_out (vty, "  Outgoing update filter list for all interface is not set%s", VTY_NEWLINE);
 
-  for (i = 0; i < disthash->size; i++)
-    for (mp = disthash->index[i]; mp; mp = mp->next)
-      {
-	dist = mp->data;
-	if (dist->ifname)
-	  if (dist->list[DISTRIBUTE_OUT] || dist->prefix[DISTRIBUTE_OUT])
-	    {
-	      vty_out (vty, "    %s filtered by", dist->ifname);
-	      if (dist->list[DISTRIBUTE_OUT])
-		vty_out (vty, " %s", dist->list[DISTRIBUTE_OUT]);
-	      if (dist->prefix[DISTRIBUTE_OUT])
-		vty_out (vty, "%s (prefix-list) %s",
-			 dist->list[DISTRIBUTE_OUT] ? "," : "",
-			 dist->prefix[DISTRIBUTE_OUT]);
-	      vty_out (vty, "%s", VTY_NEWLINE);
-	    }
-      }
+  arg.vty = vty;
+  arg.type = DISTRIBUTE_OUT;
+  hash_iterate (disthash, config_show_distribute_iterator, &arg);
 
 
   /* Input filter configuration. */
@@ -668,79 +682,66 @@ config_show_distribute (struct vty *vty)
   else
     vty_out (vty, "  Incoming update filter list for all interface is not set%s", VTY_NEWLINE);
 
-  for (i = 0; i < disthash->size; i++)
-    for (mp = disthash->index[i]; mp; mp = mp->next)
-      {
-	dist = mp->data;
-	if (dist->ifname)
-	  if (dist->list[DISTRIBUTE_IN] || dist->prefix[DISTRIBUTE_IN])
-	    {
-	      vty_out (vty, "    %s filtered by", dist->ifname);
-	      if (dist->list[DISTRIBUTE_IN])
-		vty_out (vty, " %s", dist->list[DISTRIBUTE_IN]);
-	      if (dist->prefix[DISTRIBUTE_IN])
-		vty_out (vty, "%s (prefix-list) %s",
-			 dist->list[DISTRIBUTE_IN] ? "," : "",
-			 dist->prefix[DISTRIBUTE_IN]);
-	      vty_out (vty, "%s", VTY_NEWLINE);
-	    }
-      }
+  arg.type = DISTRIBUTE_IN;
+  hash_iterate (disthash, config_show_distribute_iterator, &arg);
   return 0;
 }
 
+static void
+config_write_distribute_iterator (struct hash_backet *mp, void *arg)
+{
+  struct distribute_iterate_arg *iter = arg;
+  struct vty *vty = iter->vty;
+  struct distribute *dist = mp->data;
+
+  if (dist->list[DISTRIBUTE_IN])
+    {
+      vty_out (vty, " distribute-list %s in %s%s", 
+	       dist->list[DISTRIBUTE_IN],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      iter->write++;
+    }
+
+  if (dist->list[DISTRIBUTE_OUT])
+    {
+      vty_out (vty, " distribute-list %s out %s%s", 
+
+	       dist->list[DISTRIBUTE_OUT],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      iter->write++;
+    }
+
+  if (dist->prefix[DISTRIBUTE_IN])
+    {
+      vty_out (vty, " distribute-list prefix %s in %s%s",
+	       dist->prefix[DISTRIBUTE_IN],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      iter->write++;
+    }
+
+  if (dist->prefix[DISTRIBUTE_OUT])
+    {
+      vty_out (vty, " distribute-list prefix %s out %s%s",
+	       dist->prefix[DISTRIBUTE_OUT],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      iter->write++;
+    }
+}
+
 /* Configuration write function. */
 int
 config_write_distribute (struct vty *vty)
 {
-  unsigned int i;
-  struct hash_backet *mp;
-  int write = 0;
+  struct distribute_iterate_arg arg;
 
-  for (i = 0; i < disthash->size; i++)
-    for (mp = disthash->index[i]; mp; mp = mp->next)
-      {
-	struct distribute *dist;
-
-	dist = mp->data;
-
-	if (dist->list[DISTRIBUTE_IN])
-	  {
-	    vty_out (vty, " distribute-list %s in %s%s", 
-		     dist->list[DISTRIBUTE_IN],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-
-	if (dist->list[DISTRIBUTE_OUT])
-	  {
-	    vty_out (vty, " distribute-list %s out %s%s", 
-
-		     dist->list[DISTRIBUTE_OUT],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-
-	if (dist->prefix[DISTRIBUTE_IN])
-	  {
-	    vty_out (vty, " distribute-list prefix %s in %s%s",
-		     dist->prefix[DISTRIBUTE_IN],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-
-	if (dist->prefix[DISTRIBUTE_OUT])
-	  {
-	    vty_out (vty, " distribute-list prefix %s out %s%s",
-		     dist->prefix[DISTRIBUTE_OUT],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-      }
-  return write;
+  arg.vty = vty;
+  arg.write = 0;
+  hash_iterate (disthash, config_write_distribute_iterator, &arg);
+  return arg.write;
 }
 
 /* Clear all distribute list. */
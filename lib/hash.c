@@ -32,7 +32,7 @@ hash_create_size (unsigned int size, unsigned int (*hash_key) (void *),
   struct hash *hash;
 
   assert ((size & (size-1)) == 0);
-  hash = XMALLOC (MTYPE_HASH, sizeof (struct hash));
+  hash = XCALLOC (MTYPE_HASH, sizeof (struct hash));
   hash->index = XCALLOC (MTYPE_HASH_INDEX,
 			 sizeof (struct hash_backet *) * size);
   hash->size = size;
@@ -52,6 +52,29 @@ hash_create (unsigned int (*hash_key) (void *),
   return hash_create_size (HASH_INITIAL_SIZE, hash_key, hash_cmp);
 }
 
+/* Allocate a new open addressed hash of initial size.  Entries are stored in one array
+   with their full hash key, so a lookup compares keys in adjacent slots
+   rather than chasing a chain of separately allocated backets.  Better
+   suited to large tables with a good hash function.  The hash_backet
+   passed to hash_iterate() functions is only valid during the call, and
+   those functions may release entries but not add any. */
+struct hash *
+hash_create_open (unsigned int size, unsigned int (*hash_key) (void *),
+                  int (*hash_cmp) (const void *, const void *))
+{
+  struct hash *hash;
+
+  assert ((size & (size-1)) == 0);
+  hash = XCALLOC (MTYPE_HASH, sizeof (struct hash));
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_backet) * size);
+  hash->size = size;
+  hash->hash_key = hash_key;
+  hash->hash_cmp = hash_cmp;
+
+  return hash;
+}
+
 /* Utility function for hash_get().  When this function is specified
    as alloc_func, return arugment as it is.  This function is used for
    intern already allocated value.  */
@@ -61,50 +84,320 @@ hash_alloc_intern (void *arg)
   return arg;
 }
 
-/* Expand hash if the chain length exceeds the threshold. */
+/* Chain head where the backet for key lives, in the old index if its
+   old backet has not been moved yet.  */
+static struct hash_backet **
+hash_chain (struct hash *hash, unsigned int key)
+{
+  if (hash->old_index)
+    {
+      unsigned int old = key & (hash->old_size - 1);
+
+      if (old >= hash->migrate)
+	return &hash->old_index[old];
+    }
+  return &hash->index[key & (hash->size - 1)];
+}
+
+/* Count overlong chains in a backet of the new index, once every
+   backet that will be moved into it has been. */
+static void
+hash_expand_check (struct hash *hash, unsigned int i)
+{
+  struct hash_backet *hb;
+  unsigned int len = 0;
+
+  for (hb = hash->index[i]; hb; hb = hb->next)
+    {
+      if (++len > HASH_THRESHOLD/2)
+	++hash->losers;
+      if (len >= HASH_THRESHOLD)
+	hash->no_expand = 1;
+    }
+}
+
+/* Move up to n backets of the old index to the new one. */
+static void
+hash_migrate (struct hash *hash, unsigned int n)
+{
+  struct hash_backet *hb, *hbnext;
+
+  while (hash->old_index && n--)
+    {
+      unsigned int i = hash->migrate;
+
+      for (hb = hash->old_index[i]; hb; hb = hbnext)
+	{
+	  unsigned int h = hb->key & (hash->size - 1);
+
+	  hbnext = hb->next;
+	  hb->next = hash->index[h];
+	  hash->index[h] = hb;
+	}
+      hash->old_index[i] = NULL;
+      hash->migrate++;
+
+      hash_expand_check (hash, i);
+      hash_expand_check (hash, i + hash->old_size);
+
+      if (hash->migrate == hash->old_size)
+	{
+	  XFREE (MTYPE_HASH_INDEX, hash->old_index);
+	  hash->old_index = NULL;
+	  hash->old_size = hash->migrate = 0;
+
+	  /* Ideally, new index should have chains half as long as the
+	     original.  If expansion didn't help, then not worth expanding
+	     again, the problem is the hash function. */
+	  if (hash->losers > hash->count / 2)
+	    hash->no_expand = 1;
+	}
+    }
+}
+
+/* Expand hash if the chain length exceeds the threshold.  Backets are
+   moved to the new index incrementally by hash_migrate(), so that
+   expanding a large table does not stall the caller. */
 static void hash_expand (struct hash *hash)
 {
-  unsigned int i, new_size, losers;
-  struct hash_backet *hb, *hbnext, **new_index;
+  unsigned int new_size;
+  struct hash_backet **new_index;
 
   new_size = hash->size * 2;
   new_index = XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_backet *) * new_size);
   if (new_index == NULL)
     return;
 
-  for (i = 0; i < hash->size; i++)
-    for (hb = hash->index[i]; hb; hb = hbnext)
-      {
-	unsigned int h = hb->key & (new_size - 1);
+  hash->old_index = hash->index;
+  hash->old_size = hash->size;
+  hash->migrate = 0;
+  hash->losers = 0;
+  hash->index = new_index;
+  hash->size = new_size;
+}
 
-	hbnext = hb->next;
-	hb->next = new_index[h];
-	new_index[h] = hb;
+/* Distance of slot i of an open addressed table from its home slot. */
+#define HASH_OPEN_DIST(SLOTS,SIZE,I) \
+  (((I) - ((SLOTS)[(I)].key & ((SIZE) - 1))) & ((SIZE) - 1))
+
+/* Marks an entry released from the old slots of an expanding open
+   addressed table, which are otherwise left untouched, or released from
+   the slots while iterating. */
+static char hash_open_released;
+
+/* Find the slot holding data in an open addressed table, or -1.  Slots
+   below skip are ignored, but probed through. */
+static long
+hash_open_find (struct hash *hash, struct hash_backet *slots,
+		unsigned int size, unsigned int skip,
+		unsigned int key, void *data)
+{
+  unsigned int mask = size - 1;
+  unsigned int i, dist;
+
+  for (i = key & mask, dist = 0; slots[i].data; i = (i + 1) & mask, dist++)
+    {
+      /* Entries further on are closer to home than data would be. */
+      if (HASH_OPEN_DIST (slots, size, i) < dist)
+	break;
+      if (slots[i].key == key && i >= skip
+	  && slots[i].data != &hash_open_released
+	  && (*hash->hash_cmp) (slots[i].data, data))
+	return i;
+    }
+  return -1;
+}
+
+/* Robin Hood insertion: take the slot of any entry closer to its home
+   than the one being placed, and carry on placing that one. */
+static void
+hash_open_insert (struct hash *hash, unsigned int key, void *data)
+{
+  unsigned int mask = hash->size - 1;
+  unsigned int i, dist, d;
+  struct hash_backet carry, tmp;
+
+  carry.key = key;
+  carry.data = data;
+  carry.next = NULL;
+
+  for (i = key & mask, dist = 0; hash->slots[i].data; i = (i + 1) & mask, dist++)
+    if ((d = HASH_OPEN_DIST (hash->slots, hash->size, i)) < dist)
+      {
+	tmp = hash->slots[i];
+	hash->slots[i] = carry;
+	carry = tmp;
+	dist = d;
       }
+  hash->slots[i] = carry;
+}
 
-  /* Switch to new table */
-  XFREE(MTYPE_HASH_INDEX, hash->index);
-  hash->size = new_size;
-  hash->index = new_index;
+/* Move up to n of the old slots to the new ones.  Old slots stay in
+   place until all are moved, so that probing them still works. */
+static void
+hash_open_migrate (struct hash *hash, unsigned int n)
+{
+  struct hash_backet *slot;
 
-  /* Ideally, new index should have chains half as long as the original.
-     If expansion didn't help, then not worth expanding again,
-     the problem is the hash function. */
-  losers = 0;
-  for (i = 0; i < hash->size; i++)
+  while (hash->old_slots && n--)
     {
-      unsigned int len = 0;
-      for (hb = hash->index[i]; hb; hb = hb->next)
+      slot = &hash->old_slots[hash->migrate++];
+      if (slot->data && slot->data != &hash_open_released)
+	hash_open_insert (hash, slot->key, slot->data);
+
+      if (hash->migrate == hash->old_size)
 	{
-	  if (++len > HASH_THRESHOLD/2)
-	    ++losers;
-	  if (len >= HASH_THRESHOLD)
-	    hash->no_expand = 1;
+	  XFREE (MTYPE_HASH_INDEX, hash->old_slots);
+	  hash->old_slots = NULL;
+	  hash->old_size = hash->migrate = 0;
 	}
     }
+}
+
+/* Double an open addressed table.  Like chained tables, entries are
+   moved over by later operations. */
+static void
+hash_open_expand (struct hash *hash)
+{
+  /* Still moving from a previous expansion, finish that first. */
+  if (hash->old_slots)
+    hash_open_migrate (hash, hash->old_size);
+
+  hash->old_slots = hash->slots;
+  hash->old_size = hash->size;
+  hash->migrate = 0;
+  hash->size *= 2;
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_backet) * hash->size);
+}
 
-  if (losers > hash->count / 2)
-    hash->no_expand = 1;
+/* Find data in an open addressed table, returning its slot or NULL. */
+static struct hash_backet *
+hash_open_lookup (struct hash *hash, unsigned int key, void *data)
+{
+  long i;
+
+  if ((i = hash_open_find (hash, hash->slots, hash->size, 0, key, data)) >= 0)
+    return &hash->slots[i];
+  if (hash->old_slots
+      && (i = hash_open_find (hash, hash->old_slots, hash->old_size,
+			      hash->migrate, key, data)) >= 0)
+    return &hash->old_slots[i];
+  return NULL;
+}
+
+static void *
+hash_open_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
+{
+  unsigned int key;
+  struct hash_backet *slot;
+  void *newdata;
+
+  if (hash->old_slots && ! hash->iterating)
+    hash_open_migrate (hash, HASH_MIGRATE_STEP);
+
+  key = (*hash->hash_key) (data);
+  if ((slot = hash_open_lookup (hash, key, data)) != NULL)
+    return slot->data;
+
+  if (alloc_func)
+    {
+      newdata = (*alloc_func) (data);
+      if (newdata == NULL)
+	return NULL;
+
+      /* Placing it could move entries hash_iterate() has yet to see. */
+      assert (! hash->iterating);
+
+      /* Always leave a free slot, hash_open_purge() and lookups rely on
+	 it. */
+      if ((hash->count + 1) * 16 > hash->size * HASH_OPEN_LOAD)
+	hash_open_expand (hash);
+
+      hash_open_insert (hash, key, newdata);
+      hash->count++;
+      return newdata;
+    }
+  return NULL;
+}
+
+/* Empty slot i by shifting back the following entries which are away
+   from their home slot, so that no tombstone is needed. */
+static void
+hash_open_remove (struct hash *hash, unsigned int i)
+{
+  unsigned int mask = hash->size - 1;
+  unsigned int next;
+
+  for (next = (i + 1) & mask;
+       hash->slots[next].data
+	 && HASH_OPEN_DIST (hash->slots, hash->size, next) > 0;
+       i = next, next = (next + 1) & mask)
+    hash->slots[i] = hash->slots[next];
+  memset (&hash->slots[i], 0, sizeof (struct hash_backet));
+}
+
+/* Remove the entries released while iterating.  Start after a free
+   slot, so that no run of entries wraps around the start. */
+static void
+hash_open_purge (struct hash *hash)
+{
+  unsigned int mask = hash->size - 1;
+  unsigned int start, n, i;
+
+  for (start = 0; start < hash->size; start++)
+    if (! hash->slots[start].data)
+      break;
+
+  for (n = 1; n < hash->size && hash->released; n++)
+    {
+      i = (start + n) & mask;
+      while (hash->slots[i].data == &hash_open_released)
+	{
+	  hash_open_remove (hash, i);
+	  hash->released--;
+	}
+    }
+}
+
+/* Release from an open addressed table.  While iterating, the entry is
+   only marked, hash_open_purge() removes it afterwards. */
+static void *
+hash_open_release (struct hash *hash, void *data)
+{
+  unsigned int key;
+  long found;
+  void *ret;
+
+  if (hash->old_slots && ! hash->iterating)
+    hash_open_migrate (hash, HASH_MIGRATE_STEP);
+
+  key = (*hash->hash_key) (data);
+  found = hash_open_find (hash, hash->slots, hash->size, 0, key, data);
+  if (found < 0)
+    {
+      /* Not moved yet, just mark it in the old slots. */
+      if (! hash->old_slots
+	  || (found = hash_open_find (hash, hash->old_slots, hash->old_size,
+				      hash->migrate, key, data)) < 0)
+	return NULL;
+      ret = hash->old_slots[found].data;
+      hash->old_slots[found].data = &hash_open_released;
+      hash->count--;
+      return ret;
+    }
+
+  ret = hash->slots[found].data;
+  if (hash->iterating)
+    {
+      hash->slots[found].data = &hash_open_released;
+      hash->released++;
+    }
+  else
+    hash_open_remove (hash, found);
+  hash->count--;
+
+  return ret;
 }
 
 /* Lookup and return hash backet in hash.  If there is no
@@ -114,16 +407,22 @@ void *
 hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
 {
   unsigned int key;
-  unsigned int index;
+  struct hash_backet **chain;
   void *newdata;
   unsigned int len;
   struct hash_backet *backet;
 
+  if (hash->slots)
+    return hash_open_get (hash, data, alloc_func);
+
+  if (hash->old_index && ! hash->iterating)
+    hash_migrate (hash, HASH_MIGRATE_STEP);
+
   key = (*hash->hash_key) (data);
-  index = key & (hash->size - 1);
+  chain = hash_chain (hash, key);
   len = 0;
 
-  for (backet = hash->index[index]; backet != NULL; backet = backet->next)
+  for (backet = *chain; backet != NULL; backet = backet->next)
     {
       if (backet->key == key && (*hash->hash_cmp) (backet->data, data))
 	return backet->data;
@@ -136,17 +435,18 @@ hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
       if (newdata == NULL)
 	return NULL;
 
-      if (len > HASH_THRESHOLD && !hash->no_expand)
+      if (len > HASH_THRESHOLD && !hash->no_expand
+	  && !hash->old_index && !hash->iterating)
 	{
 	  hash_expand (hash);
-	  index = key & (hash->size - 1);
+	  chain = hash_chain (hash, key);
 	}
 
       backet = XMALLOC (MTYPE_HASH_BACKET, sizeof (struct hash_backet));
       backet->data = newdata;
       backet->key = key;
-      backet->next = hash->index[index];
-      hash->index[index] = backet;
+      backet->next = *chain;
+      *chain = backet;
       hash->count++;
       return backet->data;
     }
@@ -179,19 +479,25 @@ hash_release (struct hash *hash, void *data)
 {
   void *ret;
   unsigned int key;
-  unsigned int index;
+  struct hash_backet **chain;
   struct hash_backet *backet;
   struct hash_backet *pp;
 
+  if (hash->slots)
+    return hash_open_release (hash, data);
+
+  if (hash->old_index && ! hash->iterating)
+    hash_migrate (hash, HASH_MIGRATE_STEP);
+
   key = (*hash->hash_key) (data);
-  index = key & (hash->size - 1);
+  chain = hash_chain (hash, key);
 
-  for (backet = pp = hash->index[index]; backet; backet = backet->next)
+  for (backet = pp = *chain; backet; backet = backet->next)
     {
       if (backet->key == key && (*hash->hash_cmp) (backet->data, data)) 
 	{
 	  if (backet == pp) 
-	    hash->index[index] = backet->next;
+	    *chain = backet->next;
 	  else 
 	    pp->next = backet->next;
 
@@ -205,17 +511,16 @@ hash_release (struct hash *hash, void *data)
   return NULL;
 }
 
-/* Iterator function for hash.  */
-void
-hash_iterate (struct hash *hash, 
-	      void (*func) (struct hash_backet *, void *), void *arg)
+static void
+hash_iterate_index (struct hash_backet **index, unsigned int size,
+		    void (*func) (struct hash_backet *, void *), void *arg)
 {
   unsigned int i;
   struct hash_backet *hb;
   struct hash_backet *hbnext;
 
-  for (i = 0; i < hash->size; i++)
-    for (hb = hash->index[i]; hb; hb = hbnext)
+  for (i = 0; i < size; i++)
+    for (hb = index[i]; hb; hb = hbnext)
       {
 	/* get pointer to next hash backet here, in case (*func)
 	 * decides to delete hb by calling hash_release
@@ -225,17 +530,57 @@ hash_iterate (struct hash *hash,
       }
 }
 
-/* Clean up hash.  */
+/* Iterate over an open addressed hash.  Nothing moves meanwhile: (*func)
+   cannot add entries, and those it releases are only marked. */
+static void
+hash_iterate_open (struct hash *hash,
+		   void (*func) (struct hash_backet *, void *), void *arg)
+{
+  unsigned int i;
+
+  for (i = 0; i < hash->size; i++)
+    if (hash->slots[i].data
+	&& hash->slots[i].data != &hash_open_released)
+      (*func) (&hash->slots[i], arg);
+
+  if (hash->old_slots)
+    for (i = hash->migrate; i < hash->old_size; i++)
+      if (hash->old_slots[i].data
+	  && hash->old_slots[i].data != &hash_open_released)
+	(*func) (&hash->old_slots[i], arg);
+}
+
+/* Iterator function for hash.  */
 void
-hash_clean (struct hash *hash, void (*free_func) (void *))
+hash_iterate (struct hash *hash, 
+	      void (*func) (struct hash_backet *, void *), void *arg)
+{
+  hash->iterating++;
+
+  if (hash->slots)
+    hash_iterate_open (hash, func, arg);
+  else
+    {
+      hash_iterate_index (hash->index, hash->size, func, arg);
+      if (hash->old_index)
+	hash_iterate_index (hash->old_index, hash->old_size, func, arg);
+    }
+
+  if (--hash->iterating == 0 && hash->released)
+    hash_open_purge (hash);
+}
+
+static void
+hash_clean_index (struct hash *hash, struct hash_backet **index,
+		  unsigned int size, void (*free_func) (void *))
 {
   unsigned int i;
   struct hash_backet *hb;
   struct hash_backet *next;
 
-  for (i = 0; i < hash->size; i++)
+  for (i = 0; i < size; i++)
     {
-      for (hb = hash->index[i]; hb; hb = next)
+      for (hb = index[i]; hb; hb = next)
 	{
 	  next = hb->next;
 	      
@@ -245,7 +590,38 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
 	  XFREE (MTYPE_HASH_BACKET, hb);
 	  hash->count--;
 	}
-      hash->index[i] = NULL;
+      index[i] = NULL;
+    }
+}
+
+/* Clean up hash.  */
+void
+hash_clean (struct hash *hash, void (*free_func) (void *))
+{
+  unsigned int i;
+
+  if (hash->slots)
+    {
+      /* Move everything over first, so entries are only seen once. */
+      hash_open_migrate (hash, hash->old_size);
+      for (i = 0; i < hash->size; i++)
+	if (hash->slots[i].data)
+	  {
+	    if (free_func)
+	      (*free_func) (hash->slots[i].data);
+	    memset (&hash->slots[i], 0, sizeof (struct hash_backet));
+	    hash->count--;
+	  }
+      return;
+    }
+
+  hash_clean_index (hash, hash->index, hash->size, free_func);
+  if (hash->old_index)
+    {
+      hash_clean_index (hash, hash->old_index, hash->old_size, free_func);
+      XFREE (MTYPE_HASH_INDEX, hash->old_index);
+      hash->old_index = NULL;
+      hash->old_size = hash->migrate = 0;
     }
 }
 
@@ -254,6 +630,13 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
 void
 hash_free (struct hash *hash)
 {
-  XFREE (MTYPE_HASH_INDEX, hash->index);
+  if (hash->slots)
+    XFREE (MTYPE_HASH_INDEX, hash->slots);
+  if (hash->old_slots)
+    XFREE (MTYPE_HASH_INDEX, hash->old_slots);
+  if (hash->old_index)
+    XFREE (MTYPE_HASH_INDEX, hash->old_index);
+  if (hash->index)
+    XFREE (MTYPE_HASH_INDEX, hash->index);
   XFREE (MTYPE_HASH, hash);
 }
@@ -24,6 +24,11 @@ Boston, MA 02111-1307, USA.  */
 /* Default hash table size.  */ 
 #define HASH_INITIAL_SIZE     256	/* initial number of backets. */
 #define HASH_THRESHOLD	      10	/* expand when backet. */
+#define HASH_MIGRATE_STEP     8		/* backets moved per operation
+					   while expanding. */
+
+/* Open addressed tables grow when more than HASH_OPEN_LOAD/16 full. */
+#define HASH_OPEN_LOAD        12
 
 struct hash_backet
 {
@@ -48,6 +53,31 @@ struct hash
   /* If expansion failed. */
   int no_expand;
 
+  /* While expanding, the previous backet index.  Its backets below
+     migrate have been moved to index already, the others are moved a
+     few at a time by later operations.  */
+  struct hash_backet **old_index;
+  unsigned int old_size;
+  unsigned int migrate;
+
+  /* Overlong chains seen in the moved backets, see hash_expand().  */
+  unsigned long losers;
+
+  /* Open addressed table from hash_create_open(), used instead of
+     index.  Slots are kept in Robin Hood order of their distance from
+     the home slot, an empty slot has NULL data, next is unused.  While
+     expanding, old_slots (with old_size and migrate as above) holds the
+     previous slots.  */
+  struct hash_backet *slots;
+  struct hash_backet *old_slots;
+
+  /* Number of hash_iterate() calls in progress.  Meanwhile, chained
+     tables are neither expanded nor migrated, and open addressed ones
+     may not be added to; entries released from their slots are marked,
+     and counted in released, until the last call is over.  */
+  int iterating;
+  unsigned int released;
+
   /* Key make function. */
   unsigned int (*hash_key) (void *);
 
@@ -62,6 +92,8 @@ extern struct hash *hash_create (unsigned int (*) (void *),
 				 int (*) (const void *, const void *));
 extern struct hash *hash_create_size (unsigned int, unsigned int (*) (void *), 
                                              int (*) (const void *, const void *));
+extern struct hash *hash_create_open (unsigned int, unsigned int (*) (void *),
+				      int (*) (const void *, const void *));
 
 extern void *hash_get (struct hash *, void *, void * (*) (void *));
 extern void *hash_alloc_intern (void *);
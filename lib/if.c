@@ -36,6 +36,7 @@
 #include "buffer.h"
 #include "str.h"
 #include "log.h"
+#include "hash.h"
 
 /* List of interfaces in only the default VRF */
 struct list *iflist;
@@ -112,6 +113,288 @@ if_cmp_func (struct interface *ifp1, struct interface *ifp2)
   return 0;
 }
 
+/* Per-VRF lookup indexes for the interface list.  The list itself stays
+ * the authoritative (sorted) store; these only accelerate the lookups
+ * below, which otherwise scan every interface and connected address.
+ */
+struct if_vrf_index
+{
+  /* Interfaces by ifindex, IFINDEX_INTERNAL excluded. */
+  struct hash *by_ifindex;
+
+  /* Number of interfaces whose ifindex is held by another interface
+     (e.g. across a rename), so not present in by_ifindex. */
+  unsigned long shadowed;
+
+  /* Interfaces by name. */
+  struct hash *by_name;
+
+  /* Connected addresses by masked prefix, each node holding a list of
+     struct connected. */
+  struct route_table *addr[AFI_MAX];
+};
+
+/* if_vrf_index by vrf_id. */
+static vector if_vrf_indexes;
+
+static struct if_vrf_index *
+if_vrf_index_lookup (vrf_id_t vrf_id)
+{
+  if (! if_vrf_indexes || vrf_id >= vector_active (if_vrf_indexes))
+    return NULL;
+  return vector_slot (if_vrf_indexes, vrf_id);
+}
+
+static unsigned int
+if_index_hash_key (void *arg)
+{
+  struct interface *ifp = arg;
+
+  return ifp->ifindex;
+}
+
+static int
+if_index_hash_cmp (const void *a, const void *b)
+{
+  const struct interface *ifp1 = a;
+  const struct interface *ifp2 = b;
+
+  return ifp1->ifindex == ifp2->ifindex;
+}
+
+static unsigned int
+if_name_hash_key (void *arg)
+{
+  struct interface *ifp = arg;
+
+  return string_hash_make (ifp->name);
+}
+
+static int
+if_name_hash_cmp (const void *a, const void *b)
+{
+  const struct interface *ifp1 = a;
+  const struct interface *ifp2 = b;
+
+  return strcmp (ifp1->name, ifp2->name) == 0;
+}
+
+static void
+if_vrf_index_new (vrf_id_t vrf_id)
+{
+  struct if_vrf_index *idx;
+
+  if (! if_vrf_indexes)
+    if_vrf_indexes = vector_init (1);
+
+  idx = XCALLOC (MTYPE_IF_INDEX, sizeof (struct if_vrf_index));
+  idx->by_ifindex = hash_create (if_index_hash_key, if_index_hash_cmp);
+  idx->by_name = hash_create (if_name_hash_key, if_name_hash_cmp);
+  idx->addr[AFI_IP] = route_table_init ();
+  idx->addr[AFI_IP6] = route_table_init ();
+  vector_set_index (if_vrf_indexes, vrf_id, idx);
+}
+
+static void
+if_vrf_index_free (vrf_id_t vrf_id)
+{
+  struct if_vrf_index *idx = if_vrf_index_lookup (vrf_id);
+
+  if (! idx)
+    return;
+
+  /* All interfaces, hence all connected addresses, are gone by now. */
+  hash_free (idx->by_ifindex);
+  hash_free (idx->by_name);
+  route_table_finish (idx->addr[AFI_IP]);
+  route_table_finish (idx->addr[AFI_IP6]);
+  XFREE (MTYPE_IF_INDEX, idx);
+  vector_unset (if_vrf_indexes, vrf_id);
+
+  if (vector_count (if_vrf_indexes) == 0)
+    {
+      vector_free (if_vrf_indexes);
+      if_vrf_indexes = NULL;
+    }
+}
+
+/* Add ifp to the ifindex hash.  If another interface already holds the
+   ifindex it keeps it, and ifp is counted as shadowed. */
+static void
+if_index_hash_add (struct if_vrf_index *idx, struct interface *ifp)
+{
+  if (ifp->ifindex == IFINDEX_INTERNAL)
+    return;
+
+  if (hash_get (idx->by_ifindex, ifp, hash_alloc_intern) != ifp)
+    idx->shadowed++;
+}
+
+static void
+if_index_hash_del (struct if_vrf_index *idx, struct interface *ifp)
+{
+  struct listnode *node;
+  struct interface *oifp;
+
+  if (ifp->ifindex == IFINDEX_INTERNAL)
+    return;
+
+  if (hash_lookup (idx->by_ifindex, ifp) != ifp)
+    {
+      if (idx->shadowed)
+        idx->shadowed--;
+      return;
+    }
+  hash_release (idx->by_ifindex, ifp);
+
+  /* Hand the ifindex over to a shadowed interface, if there is one. */
+  if (idx->shadowed)
+    for (ALL_LIST_ELEMENTS_RO (vrf_iflist (ifp->vrf_id), node, oifp))
+      if (oifp != ifp && oifp->ifindex == ifp->ifindex)
+        {
+          hash_get (idx->by_ifindex, oifp, hash_alloc_intern);
+          idx->shadowed--;
+          break;
+        }
+}
+
+/* Is ifp the interface indexed under its name, i.e. in the VRF list? */
+static int
+if_indexed (struct if_vrf_index *idx, struct interface *ifp)
+{
+  return idx && hash_lookup (idx->by_name, ifp) == ifp;
+}
+
+static struct route_table *
+connected_index_table (struct if_vrf_index *idx, struct prefix *p)
+{
+  if (! idx || ! p)
+    return NULL;
+
+  switch (p->family)
+    {
+    case AF_INET:
+      return idx->addr[AFI_IP];
+    case AF_INET6:
+      return idx->addr[AFI_IP6];
+    default:
+      return NULL;
+    }
+}
+
+static struct route_node *
+connected_index_node_add (struct route_table *table, struct prefix *p,
+                          struct connected *ifc)
+{
+  struct prefix key;
+  struct route_node *rn;
+
+  prefix_copy (&key, p);
+  apply_mask (&key);
+
+  rn = route_node_get (table, &key);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = list_new ();
+  listnode_add (rn->info, ifc);
+
+  return rn;
+}
+
+static void
+connected_index_node_del (struct route_node *rn, struct connected *ifc)
+{
+  listnode_delete (rn->info, ifc);
+  if (listcount ((struct list *) rn->info) == 0)
+    {
+      list_delete (rn->info);
+      rn->info = NULL;
+      route_unlock_node (rn);
+    }
+}
+
+/* Index a connected address under its own prefix and, if it covers
+   different space, its peer/broadcast prefix.  Lookups re-check every
+   candidate against the live connected data, so a key only needs to
+   contain whatever the connected address can match. */
+static void
+connected_index_add (struct connected *ifc)
+{
+  struct if_vrf_index *idx = if_vrf_index_lookup (ifc->ifp->vrf_id);
+  struct route_table *table;
+
+  if (! if_indexed (idx, ifc->ifp)
+      || ! (table = connected_index_table (idx, ifc->address)))
+    return;
+
+  ifc->index_node[0] = connected_index_node_add (table, ifc->address, ifc);
+
+  if (ifc->destination
+      && ifc->destination->family == ifc->address->family)
+    {
+      struct prefix key;
+
+      prefix_copy (&key, ifc->destination);
+      apply_mask (&key);
+      if (! prefix_same (&key, &ifc->index_node[0]->p))
+        ifc->index_node[1] = connected_index_node_add (table, &key, ifc);
+    }
+}
+
+static void
+connected_index_del (struct connected *ifc)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+    if (ifc->index_node[i])
+      {
+        connected_index_node_del (ifc->index_node[i], ifc);
+        ifc->index_node[i] = NULL;
+      }
+}
+
+/* Walk every indexed prefix containing p, and return the interface of the
+   connected address scoring highest under match (negative: no match).
+   Ties go to the interface sorting first, as with a scan of the list. */
+static struct interface *
+connected_index_match (vrf_id_t vrf_id, struct prefix *p,
+                       int (*match) (struct connected *, struct prefix *))
+{
+  struct route_table *table;
+  struct route_node *rn, *node;
+  struct listnode *cnode;
+  struct connected *c;
+  struct interface *best = NULL;
+  int bestscore = -1;
+  int score;
+
+  table = connected_index_table (if_vrf_index_lookup (vrf_id), p);
+  if (! table || ! (rn = route_node_match (table, p)))
+    return NULL;
+
+  for (node = rn; node; node = node->parent)
+    {
+      if (! node->info)
+        continue;
+      for (ALL_LIST_ELEMENTS_RO ((struct list *) node->info, cnode, c))
+        {
+          score = match (c, p);
+          if (score < 0 || score < bestscore)
+            continue;
+          if (score > bestscore || if_cmp_func (c->ifp, best) < 0)
+            {
+              best = c->ifp;
+              bestscore = score;
+            }
+        }
+    }
+  route_unlock_node (rn);
+
+  return best;
+}
+
 /* Create new interface structure. */
 struct interface *
 if_create_vrf (const char *name, int namelen, vrf_id_t vrf_id)
@@ -128,7 +411,13 @@ if_create_vrf (const char *name, int namelen, vrf_id_t vrf_id)
   ifp->name[namelen] = '\0';
   ifp->vrf_id = vrf_id;
   if (if_lookup_by_name_vrf (ifp->name, vrf_id) == NULL)
-    listnode_add_sort (intf_list, ifp);
+    {
+      struct if_vrf_index *idx = if_vrf_index_lookup (vrf_id);
+
+      listnode_add_sort (intf_list, ifp);
+      if (idx)
+        hash_get (idx->by_name, ifp, hash_alloc_intern);
+    }
   else
     zlog_err("if_create(%s): corruption detected -- interface with this "
              "name exists already in VRF %u!", ifp->name, vrf_id);
@@ -154,7 +443,7 @@ if_delete_retain (struct interface *ifp)
   if (if_master.if_delete_hook)
     (*if_master.if_delete_hook) (ifp);
 
-  /* Free connected address list */
+  /* Free connected address list, connected_free() unindexes them. */
   list_delete_all_node (ifp->connected);
 }
 
@@ -162,6 +451,13 @@ if_delete_retain (struct interface *ifp)
 void
 if_delete (struct interface *ifp)
 {
+  struct if_vrf_index *idx = if_vrf_index_lookup (ifp->vrf_id);
+
+  if (if_indexed (idx, ifp))
+    {
+      if_index_hash_del (idx, ifp);
+      hash_release (idx->by_name, ifp);
+    }
   listnode_delete (vrf_iflist (ifp->vrf_id), ifp);
 
   if_delete_retain(ifp);
@@ -187,12 +483,38 @@ if_add_hook (int type, int (*func)(struct interface *ifp))
   }
 }
 
+void
+if_set_index (struct interface *ifp, ifindex_t ifindex)
+{
+  struct if_vrf_index *idx = if_vrf_index_lookup (ifp->vrf_id);
+  int indexed;
+
+  if (ifp->ifindex == ifindex)
+    return;
+
+  indexed = if_indexed (idx, ifp);
+  if (indexed)
+    if_index_hash_del (idx, ifp);
+  ifp->ifindex = ifindex;
+  if (indexed)
+    if_index_hash_add (idx, ifp);
+}
+
 /* Interface existance check by index. */
 struct interface *
 if_lookup_by_index_vrf (ifindex_t ifindex, vrf_id_t vrf_id)
 {
   struct listnode *node;
   struct interface *ifp;
+  struct if_vrf_index *idx = if_vrf_index_lookup (vrf_id);
+
+  if (idx && ifindex != IFINDEX_INTERNAL)
+    {
+      struct interface key;
+
+      key.ifindex = ifindex;
+      return hash_lookup (idx->by_ifindex, &key);
+    }
 
   for (ALL_LIST_ELEMENTS_RO (vrf_iflist (vrf_id), node, ifp))
     {
@@ -242,15 +564,8 @@ ifname2ifindex (const char *name)
 struct interface *
 if_lookup_by_name_vrf (const char *name, vrf_id_t vrf_id)
 {
-  struct listnode *node;
-  struct interface *ifp;
-  
   if (name)
-    for (ALL_LIST_ELEMENTS_RO (vrf_iflist (vrf_id), node, ifp))
-      {
-        if (strcmp(name, ifp->name) == 0)
-          return ifp;
-      }
+    return if_lookup_by_name_len_vrf (name, strlen (name), vrf_id);
   return NULL;
 }
 
@@ -265,10 +580,20 @@ if_lookup_by_name_len_vrf (const char *name, size_t namelen, vrf_id_t vrf_id)
 {
   struct listnode *node;
   struct interface *ifp;
+  struct if_vrf_index *idx = if_vrf_index_lookup (vrf_id);
 
   if (namelen > INTERFACE_NAMSIZ)
     return NULL;
 
+  if (idx)
+    {
+      struct interface key;
+
+      memcpy (key.name, name, namelen);
+      key.name[namelen] = '\0';
+      return hash_lookup (idx->by_name, &key);
+    }
+
   for (ALL_LIST_ELEMENTS_RO (vrf_iflist (vrf_id), node, ifp))
     {
       if (!memcmp(name, ifp->name, namelen) && (ifp->name[namelen] == '\0'))
@@ -283,30 +608,26 @@ if_lookup_by_name_len(const char *name, size_t namelen)
   return if_lookup_by_name_len_vrf (name, namelen, VRF_DEFAULT);
 }
 
+static int
+if_match_exact_address (struct connected *c, struct prefix *addr)
+{
+  struct prefix *p = c->address;
+
+  return (p && p->family == AF_INET &&
+          IPV4_ADDR_SAME (&p->u.prefix4, &addr->u.prefix4)) ? 0 : -1;
+}
+
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_exact_address_vrf (struct in_addr src, vrf_id_t vrf_id)
 {
-  struct listnode *node;
-  struct listnode *cnode;
-  struct interface *ifp;
-  struct prefix *p;
-  struct connected *c;
+  struct prefix addr;
 
-  for (ALL_LIST_ELEMENTS_RO (vrf_iflist (vrf_id), node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
-	{
-	  p = c->address;
+  addr.family = AF_INET;
+  addr.u.prefix4 = src;
+  addr.prefixlen = IPV4_MAX_BITLEN;
 
-	  if (p && p->family == AF_INET)
-	    {
-	      if (IPV4_ADDR_SAME (&p->u.prefix4, &src))
-		return ifp;
-	    }	      
-	}
-    }
-  return NULL;
+  return connected_index_match (vrf_id, &addr, if_match_exact_address);
 }
 
 struct interface *
@@ -315,38 +636,27 @@ if_lookup_exact_address (struct in_addr src)
   return if_lookup_exact_address_vrf (src, VRF_DEFAULT);
 }
 
+static int
+if_match_address (struct connected *c, struct prefix *addr)
+{
+  if (c->address && (c->address->family == AF_INET) &&
+      prefix_match(CONNECTED_PREFIX(c), addr) &&
+      (c->address->prefixlen > 0))
+    return c->address->prefixlen;
+  return -1;
+}
+
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_address_vrf (struct in_addr src, vrf_id_t vrf_id)
 {
-  struct listnode *node;
   struct prefix addr;
-  int bestlen = 0;
-  struct listnode *cnode;
-  struct interface *ifp;
-  struct connected *c;
-  struct interface *match;
 
   addr.family = AF_INET;
   addr.u.prefix4 = src;
   addr.prefixlen = IPV4_MAX_BITLEN;
 
-  match = NULL;
-
-  for (ALL_LIST_ELEMENTS_RO (vrf_iflist (vrf_id), node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
-	{
-	  if (c->address && (c->address->family == AF_INET) &&
-	      prefix_match(CONNECTED_PREFIX(c), &addr) &&
-	      (c->address->prefixlen > bestlen))
-	    {
-	      bestlen = c->address->prefixlen;
-	      match = ifp;
-	    }
-	}
-    }
-  return match;
+  return connected_index_match (vrf_id, &addr, if_match_address);
 }
 
 struct interface *
@@ -355,6 +665,12 @@ if_lookup_address (struct in_addr src)
   return if_lookup_address_vrf (src, VRF_DEFAULT);
 }
 
+static int
+if_match_prefix (struct connected *c, struct prefix *prefix)
+{
+  return (prefix_cmp(c->address, prefix) == 0) ? 0 : -1;
+}
+
 /* Lookup interface by prefix */
 struct interface *
 if_lookup_prefix_vrf (struct prefix *prefix, vrf_id_t vrf_id)
@@ -364,6 +680,9 @@ if_lookup_prefix_vrf (struct prefix *prefix, vrf_id_t vrf_id)
   struct interface *ifp;
   struct connected *c;
 
+  if (prefix->family == AF_INET || prefix->family == AF_INET6)
+    return connected_index_match (vrf_id, prefix, if_match_prefix);
+
   for (ALL_LIST_ELEMENTS_RO (vrf_iflist (vrf_id), node, ifp))
     {
       for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
@@ -797,6 +1116,8 @@ connected_new (void)
 void
 connected_free (struct connected *connected)
 {
+  connected_index_del (connected);
+
   if (connected->address)
     prefix_free (connected->address);
 
@@ -853,6 +1174,20 @@ connected_same_prefix (struct prefix *p1, struct prefix *p2)
   return 0;
 }
 
+void
+connected_add (struct interface *ifp, struct connected *ifc)
+{
+  listnode_add (ifp->connected, ifc);
+  connected_index_add (ifc);
+}
+
+void
+connected_delete (struct interface *ifp, struct connected *ifc)
+{
+  connected_index_del (ifc);
+  listnode_delete (ifp->connected, ifc);
+}
+
 struct connected *
 connected_delete_by_prefix (struct interface *ifp, struct prefix *p)
 {
@@ -868,7 +1203,7 @@ connected_delete_by_prefix (struct interface *ifp, struct prefix *p)
 
       if (connected_same_prefix (ifc->address, p))
 	{
-	  listnode_delete (ifp->connected, ifc);
+	  connected_delete (ifp, ifc);
 	  return ifc;
 	}
     }
@@ -923,7 +1258,7 @@ connected_add_by_prefix (struct interface *ifp, struct prefix *p,
     }
 
   /* Add connected address to the interface. */
-  listnode_add (ifp->connected, ifc);
+  connected_add (ifp, ifc);
   return ifc;
 }
 
@@ -951,93 +1286,12 @@ if_indextoname (ifindex_t ifindex, char *name)
 }
 #endif
 
-#if 0 /* this route_table of struct connected's is unused
-       * however, it would be good to use a route_table rather than
-       * a list..
-       */
-/* Interface looking up by interface's address. */
-/* Interface's IPv4 address reverse lookup table. */
-struct route_table *ifaddr_ipv4_table;
-/* struct route_table *ifaddr_ipv6_table; */
-
-static void
-ifaddr_ipv4_add (struct in_addr *ifaddr, struct interface *ifp)
-{
-  struct route_node *rn;
-  struct prefix_ipv4 p;
-
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = *ifaddr;
-
-  rn = route_node_get (ifaddr_ipv4_table, (struct prefix *) &p);
-  if (rn)
-    {
-      route_unlock_node (rn);
-      zlog_info ("ifaddr_ipv4_add(): address %s is already added",
-		 inet_ntoa (*ifaddr));
-      return;
-    }
-  rn->info = ifp;
-}
-
-static void
-ifaddr_ipv4_delete (struct in_addr *ifaddr, struct interface *ifp)
-{
-  struct route_node *rn;
-  struct prefix_ipv4 p;
-
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = *ifaddr;
-
-  rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &p);
-  if (! rn)
-    {
-      zlog_info ("ifaddr_ipv4_delete(): can't find address %s",
-		 inet_ntoa (*ifaddr));
-      return;
-    }
-  rn->info = NULL;
-  route_unlock_node (rn);
-  route_unlock_node (rn);
-}
-
-/* Lookup interface by interface's IP address or interface index. */
-static struct interface *
-ifaddr_ipv4_lookup (struct in_addr *addr, ifindex_t ifindex)
-{
-  struct prefix_ipv4 p;
-  struct route_node *rn;
-  struct interface *ifp;
-
-  if (addr)
-    {
-      p.family = AF_INET;
-      p.prefixlen = IPV4_MAX_PREFIXLEN;
-      p.prefix = *addr;
-
-      rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &p);
-      if (! rn)
-	return NULL;
-      
-      ifp = rn->info;
-      route_unlock_node (rn);
-      return ifp;
-    }
-  else
-    return if_lookup_by_index(ifindex);
-}
-#endif /* ifaddr_ipv4_table */
-
 /* Initialize interface list. */
 void
 if_init (vrf_id_t vrf_id, struct list **intf_list)
 {
   *intf_list = list_new ();
-#if 0
-  ifaddr_ipv4_table = route_table_init ();
-#endif /* ifaddr_ipv4_table */
+  if_vrf_index_new (vrf_id);
 
   (*intf_list)->cmp = (int (*)(void *, void *))if_cmp_func;
 
@@ -1061,6 +1315,7 @@ if_terminate (vrf_id_t vrf_id, struct list **intf_list)
 
   list_delete (*intf_list);
   *intf_list = NULL;
+  if_vrf_index_free (vrf_id);
 
   if (vrf_id == VRF_DEFAULT)
     iflist = NULL;
@@ -238,6 +238,10 @@ struct connected
 
   /* Label for Linux 2.2.X and upper. */
   char *label;
+
+  /* Nodes holding this address (and peer/broadcast) in the per-VRF
+     connected address index, see connected_add(). */
+  struct route_node *index_node[2];
 };
 
 /* Does the destination field contain a peer address? */
@@ -312,6 +316,11 @@ extern struct interface *if_lookup_address_vrf (struct in_addr,
 extern struct interface *if_lookup_prefix_vrf (struct prefix *prefix,
                                 vrf_id_t vrf_id);
 
+/* Change the ifindex of an interface.  Always use this rather than
+   assigning ifp->ifindex directly, so the ifindex lookup index stays
+   consistent. */
+extern void if_set_index (struct interface *, ifindex_t);
+
 /* These 2 functions are to be used when the ifname argument is terminated
    by a '\0' character: */
 extern struct interface *if_lookup_by_name (const char *ifname);
@@ -373,7 +382,12 @@ extern ifindex_t ifname2ifindex_vrf(const char *ifname, vrf_id_t vrf_id);
 /* Connected address functions. */
 extern struct connected *connected_new (void);
 extern void connected_free (struct connected *);
+/* Attach/detach a connected address to/from ifp->connected.  These keep
+   the address index used by if_lookup_*address*() up to date, so the
+   connected list must not be modified directly.  connected_delete() does
+   not free the structure. */
 extern void connected_add (struct interface *, struct connected *);
+extern void connected_delete (struct interface *, struct connected *);
 extern struct connected  *connected_add_by_prefix (struct interface *,
                                             struct prefix *,
                                             struct prefix *);
@@ -159,6 +159,8 @@ static struct
 {
   const char *name;
   long alloc;
+  long peak;
+  unsigned long total;
   unsigned long t_malloc;
   unsigned long c_malloc;
   unsigned long t_calloc;
@@ -246,6 +248,8 @@ static struct
 {
   char *name;
   long alloc;
+  long peak;
+  unsigned long total;
 } mstat [MTYPE_MAX];
 #endif /* MEMORY_LOG */
 
@@ -253,7 +257,9 @@ static struct
 static void
 alloc_inc (int type)
 {
-  mstat[type].alloc++;
+  mstat[type].total++;
+  if (++mstat[type].alloc > mstat[type].peak)
+    mstat[type].peak = mstat[type].alloc;
 }
 
 /* Decrement allocation counter. */
@@ -484,3 +490,15 @@ mtype_stats_alloc (int type)
 {
   return mstat[type].alloc;
 }
+
+unsigned long
+mtype_stats_peak (int type)
+{
+  return mstat[type].peak;
+}
+
+unsigned long
+mtype_stats_total (int type)
+{
+  return mstat[type].total;
+}
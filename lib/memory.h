@@ -89,6 +89,10 @@ extern void log_memstats_stderr (const char *);
 
 /* return number of allocations outstanding for the type */
 extern unsigned long mtype_stats_alloc (int);
+/* highest number of allocations outstanding at any time for the type */
+extern unsigned long mtype_stats_peak (int);
+/* number of allocations ever made for the type */
+extern unsigned long mtype_stats_total (int);
 
 /* Human friendly string for given byte count */
 #define MTYPE_MEMSTR_LEN 20
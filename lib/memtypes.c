@@ -27,6 +27,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_IF,			"Interface"			},
   { MTYPE_CONNECTED,		"Connected" 			},
   { MTYPE_CONNECTED_LABEL,	"Connected interface label"	},
+  { MTYPE_IF_INDEX,		"Interface lookup index"	},
   { MTYPE_BUFFER,		"Buffer"			},
   { MTYPE_BUFFER_DATA,		"Buffer data"			},
   { MTYPE_STREAM,		"Stream"			},
@@ -55,6 +56,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_ROUTE_MAP_RULE_STR,	"Route map rule str"		},
   { MTYPE_ROUTE_MAP_COMPILED,	"Route map compiled"		},
   { MTYPE_CMD_TOKENS,		"Command desc"			},
+  { MTYPE_CMD_TRIE,		"Command trie"			},
   { MTYPE_KEY,			"Key"				},
   { MTYPE_KEYCHAIN,		"Key chain"			},
   { MTYPE_IF_RMAP,		"Interface route map"		},
@@ -85,6 +87,8 @@ struct memory_list memory_list_zebra[] =
   { MTYPE_STATIC_ROUTE,		"Static route"			},
   { MTYPE_RIB_DEST,		"RIB destination"		},
   { MTYPE_RIB_TABLE_INFO,	"RIB table info"		},
+  { MTYPE_RIB_NHCACHE,		"RIB nexthop resolution cache"	},
+  { MTYPE_NHG,			"Nexthop group"			},
   { MTYPE_NETLINK_NAME,	"Netlink name"			},
   { -1, NULL },
 };
@@ -135,6 +139,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_COMMUNITY_LIST_ENTRY,	"community-list entry"		},
   { MTYPE_COMMUNITY_LIST_CONFIG,  "community-list config"	},
   { MTYPE_COMMUNITY_LIST_HANDLER, "community-list handler"	},
+  { MTYPE_COMMUNITY_LIST_CACHE,	"community-list cache"		},
   { 0, NULL },
   { MTYPE_CLUSTER,		"Cluster list"			},
   { MTYPE_CLUSTER_VAL,		"Cluster list val"		},
@@ -151,9 +156,11 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_UPDATE_SOURCE,	"BGP peer update interface"	},
   { MTYPE_BGP_DAMP_INFO,	"Dampening info"		},
   { MTYPE_BGP_DAMP_ARRAY,	"BGP Dampening array"		},
+  { MTYPE_BGP_DAMP_CONFIG,	"BGP Dampening config"		},
   { MTYPE_BGP_REGEXP,		"BGP regexp"			},
   { MTYPE_BGP_AGGREGATE,	"BGP aggregate"			},
   { MTYPE_BGP_ADDR,		"BGP own address"		},
+  { MTYPE_BGP_DUMP,		"BGP MRT dump"			},
   { MTYPE_ENCAP_TLV,		"ENCAP TLV",			},
   { -1, NULL }
 };
@@ -166,6 +173,7 @@ struct memory_list memory_list_rip[] =
   { MTYPE_RIP_PEER,           "RIP peer"			},
   { MTYPE_RIP_OFFSET_LIST,    "RIP offset list"			},
   { MTYPE_RIP_DISTANCE,       "RIP distance"			},
+  { MTYPE_RIP_OUTPUT_CACHE,   "RIP output cache"		},
   { -1, NULL }
 };
 
@@ -243,6 +251,7 @@ struct memory_list memory_list_isis[] =
   { MTYPE_ISIS_TMP,           "ISIS TMP"			},
   { MTYPE_ISIS_CIRCUIT,       "ISIS circuit"			},
   { MTYPE_ISIS_LSP,           "ISIS LSP"			},
+  { MTYPE_ISIS_LSP_FRAG,      "ISIS LSP fragment entry"		},
   { MTYPE_ISIS_ADJACENCY,     "ISIS adjacency"			},
   { MTYPE_ISIS_AREA,          "ISIS area"			},
   { MTYPE_ISIS_AREA_ADDR,     "ISIS area address"		},
@@ -255,6 +264,7 @@ struct memory_list memory_list_isis[] =
   { MTYPE_ISIS_NEXTHOP6,      "ISIS nexthop6"			},
   { MTYPE_ISIS_DICT,          "ISIS dictionary"			},
   { MTYPE_ISIS_DICT_NODE,     "ISIS dictionary node"		},
+  { MTYPE_ISIS_RX_RING,       "ISIS receive ring"		},
   { -1, NULL },
 };
 
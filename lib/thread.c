@@ -539,6 +539,8 @@ thread_master_create ()
   rv->timer->cmp = rv->background->cmp = thread_timer_cmp;
   rv->timer->update = rv->background->update = thread_timer_update;
 
+  thread_master_timer_wheel (rv, 1);
+
   return rv;
 }
 
@@ -573,6 +575,143 @@ thread_list_delete (struct thread_list *list, struct thread *thread)
   return thread;
 }
 
+static uint64_t
+thread_wheel_tick (struct timeval *tv)
+{
+  return ((uint64_t) tv->tv_sec * 1000 + tv->tv_usec / 1000)
+         / THREAD_WHEEL_TICK;
+}
+
+/* Queue a foreground timer: in the wheel slot its expiry falls into,
+   or in the timer heap if it is due within the current tick or beyond
+   what the wheel covers. */
+static void
+thread_timer_enqueue (struct thread_master *m, struct thread *thread)
+{
+  struct thread_wheel *wheel = m->wheel;
+  struct thread_list *slot;
+  uint64_t expires;
+  uint64_t delta;
+  int level;
+
+  thread->slot = NULL;
+
+  if (wheel)
+    {
+      expires = thread_wheel_tick (&thread->u.sands);
+      delta = expires > wheel->now ? expires - wheel->now : 0;
+
+      for (level = 0; delta && level < THREAD_WHEEL_LEVELS; level++)
+        if (delta < (uint64_t) 1 << (THREAD_WHEEL_BITS * (level + 1)))
+          {
+            slot = &wheel->slot[level][(expires >> (THREAD_WHEEL_BITS * level))
+                                       & (THREAD_WHEEL_SLOTS - 1)];
+            thread_list_add (slot, thread);
+            thread->slot = slot;
+            wheel->count++;
+            return;
+          }
+    }
+
+  pqueue_enqueue (thread, m->timer);
+}
+
+/* Move all timers out of a wheel slot and queue them again, which puts
+   them a level further down or into the heap. */
+static void
+thread_wheel_cascade (struct thread_master *m, struct thread_list *slot)
+{
+  struct thread *thread;
+
+  while ((thread = slot->head) != NULL)
+    {
+      thread_list_delete (slot, thread);
+      m->wheel->count--;
+      thread_timer_enqueue (m, thread);
+    }
+}
+
+/* Turn the wheel up to the current time, one tick at a time. */
+static void
+thread_wheel_advance (struct thread_master *m, struct timeval *timenow)
+{
+  struct thread_wheel *wheel = m->wheel;
+  uint64_t tick;
+  int level;
+  unsigned int index;
+
+  if (! wheel)
+    return;
+
+  tick = thread_wheel_tick (timenow);
+
+  while (wheel->now < tick)
+    {
+      if (! wheel->count)
+        {
+          wheel->now = tick;
+          break;
+        }
+
+      wheel->now++;
+
+      /* Whenever a level wraps round, bring down the next slot of the
+         level above. */
+      for (level = 1; level < THREAD_WHEEL_LEVELS; level++)
+        {
+          if (wheel->now & ((1 << (THREAD_WHEEL_BITS * level)) - 1))
+            break;
+          index = (wheel->now >> (THREAD_WHEEL_BITS * level))
+                  & (THREAD_WHEEL_SLOTS - 1);
+          thread_wheel_cascade (m, &wheel->slot[level][index]);
+        }
+
+      thread_wheel_cascade (m, &wheel->slot[0][wheel->now
+                                               & (THREAD_WHEEL_SLOTS - 1)]);
+    }
+}
+
+/* Earliest time at which the wheel has to be turned: the next tick
+   with a level 0 slot in use, or the next time a slot in use on a
+   higher level comes round. */
+static struct timeval *
+thread_wheel_wait (struct thread_wheel *wheel, struct timeval *timer_val)
+{
+  uint64_t next;
+  uint64_t tick;
+  unsigned int shift;
+  unsigned int index;
+  unsigned int i;
+  int level;
+  struct timeval wakeup;
+
+  if (! wheel || ! wheel->count)
+    return NULL;
+
+  next = 0;
+  for (level = 0; level < THREAD_WHEEL_LEVELS; level++)
+    {
+      shift = THREAD_WHEEL_BITS * level;
+      index = (wheel->now >> shift) & (THREAD_WHEEL_SLOTS - 1);
+      for (i = 1; i <= THREAD_WHEEL_SLOTS; i++)
+        if (wheel->slot[level][(index + i) & (THREAD_WHEEL_SLOTS - 1)].head)
+          {
+            tick = ((wheel->now >> shift) + i) << shift;
+            if (! next || tick < next)
+              next = tick;
+            break;
+          }
+    }
+
+  wakeup.tv_sec = next * THREAD_WHEEL_TICK / 1000;
+  wakeup.tv_usec = (next * THREAD_WHEEL_TICK % 1000) * 1000;
+  if (timeval_cmp (wakeup, relative_time) <= 0)
+    timer_val->tv_sec = timer_val->tv_usec = 0;
+  else
+    *timer_val = timeval_subtract (wakeup, relative_time);
+  return timer_val;
+}
+
 /* Move thread to unuse list. */
 static void
 thread_add_unuse (struct thread_master *m, struct thread *thread)
@@ -612,12 +751,45 @@ thread_queue_free (struct thread_master *m, struct pqueue *queue)
   pqueue_delete(queue);
 }
 
+/* Choose whether foreground timers are kept in a timer wheel in front
+   of the timer heap, or in the heap alone.  The wheel makes adding and
+   cancelling a timer O(1) and moves timers into the heap a tick's
+   worth at a time; the heap keeps the order and precision of expiry.
+   Only to be switched while no timers are scheduled. */
+void
+thread_master_timer_wheel (struct thread_master *m, int enable)
+{
+  assert (m->timer->size == 0);
+  assert (! m->wheel || ! m->wheel->count);
+
+  if (enable && ! m->wheel)
+    {
+      m->wheel = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_wheel));
+      quagga_get_relative (NULL);
+      m->wheel->now = thread_wheel_tick (&relative_time);
+    }
+  else if (! enable && m->wheel)
+    {
+      XFREE (MTYPE_THREAD_MASTER, m->wheel);
+      m->wheel = NULL;
+    }
+}
+
 /* Stop thread scheduler. */
 void
 thread_master_free (struct thread_master *m)
 {
+  int level, i;
+
   thread_list_free (m, &m->read);
   thread_list_free (m, &m->write);
+  if (m->wheel)
+    {
+      for (level = 0; level < THREAD_WHEEL_LEVELS; level++)
+        for (i = 0; i < THREAD_WHEEL_SLOTS; i++)
+          thread_list_free (m, &m->wheel->slot[level][i]);
+      XFREE (MTYPE_THREAD_MASTER, m->wheel);
+    }
   thread_queue_free (m, m->timer);
   thread_list_free (m, &m->event);
   thread_list_free (m, &m->ready);
@@ -691,6 +863,7 @@ thread_get (struct thread_master *m, u_char type,
   thread->func = func;
   thread->arg = arg;
   thread->index = -1;
+  thread->slot = NULL;
 
   thread->funcname = funcname;
   thread->schedfrom = schedfrom;
@@ -756,7 +929,6 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
 				  debugargdef)
 {
   struct thread *thread;
-  struct pqueue *queue;
   struct timeval alarm_time;
 
   assert (m != NULL);
@@ -764,7 +936,6 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
   assert (type == THREAD_TIMER || type == THREAD_BACKGROUND);
   assert (time_relative);
   
-  queue = ((type == THREAD_TIMER) ? m->timer : m->background);
   thread = thread_get (m, type, func, arg, debugargpass);
 
   /* Do we need jitter here? */
@@ -773,7 +944,10 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
   alarm_time.tv_usec = relative_time.tv_usec + time_relative->tv_usec;
   thread->u.sands = timeval_adjust(alarm_time);
 
-  pqueue_enqueue(thread, queue);
+  if (type == THREAD_TIMER)
+    thread_timer_enqueue (m, thread);
+  else
+    pqueue_enqueue(thread, m->background);
   return thread;
 }
 
@@ -877,7 +1051,14 @@ thread_cancel (struct thread *thread)
       list = &thread->master->write;
       break;
     case THREAD_TIMER:
-      queue = thread->master->timer;
+      if (thread->slot)
+        {
+          list = thread->slot;
+          thread->slot = NULL;
+          thread->master->wheel->count--;
+        }
+      else
+        queue = thread->master->timer;
       break;
     case THREAD_EVENT:
       list = &thread->master->event;
@@ -1054,8 +1235,10 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
   fd_set exceptfd;
   struct timeval timer_val = { .tv_sec = 0, .tv_usec = 0 };
   struct timeval timer_val_bg;
+  struct timeval timer_val_wheel;
   struct timeval *timer_wait = &timer_val;
   struct timeval *timer_wait_bg;
+  struct timeval *timer_wait_wheel;
 
   while (1)
     {
@@ -1093,7 +1276,12 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
         {
           quagga_get_relative (NULL);
           timer_wait = thread_timer_wait (m->timer, &timer_val);
+          timer_wait_wheel = thread_wheel_wait (m->wheel, &timer_val_wheel);
           timer_wait_bg = thread_timer_wait (m->background, &timer_val_bg);
+
+          if (timer_wait_wheel &&
+              (!timer_wait || (timeval_cmp (*timer_wait, *timer_wait_wheel) > 0)))
+            timer_wait = timer_wait_wheel;
           
           if (timer_wait_bg &&
               (!timer_wait || (timeval_cmp (*timer_wait, *timer_wait_bg) > 0)))
@@ -1149,6 +1337,7 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
          priority than I/O threads, so let's push them onto the ready
 	 list in front of the I/O threads. */
       quagga_get_relative (NULL);
+      thread_wheel_advance (m, &relative_time);
       thread_timer_process (m->timer, &relative_time);
       
       /* Got IO, process it */
@@ -45,6 +45,26 @@ struct thread_list
 
 struct pqueue;
 
+/* Hierarchical timer wheel.  Level 0 has a slot per tick, each slot of
+   the next level covers all the slots of the level below it.  Timers
+   are moved down a level as their slot comes round, and into the timer
+   heap once they are due within the current tick. */
+#define THREAD_WHEEL_TICK      10	/* msec */
+#define THREAD_WHEEL_BITS       6
+#define THREAD_WHEEL_SLOTS     (1 << THREAD_WHEEL_BITS)
+#define THREAD_WHEEL_LEVELS     4
+
+struct thread_wheel
+{
+  /* Tick the wheel has been advanced to. */
+  uint64_t now;
+
+  /* Number of timers in the slots. */
+  unsigned long count;
+
+  struct thread_list slot[THREAD_WHEEL_LEVELS][THREAD_WHEEL_SLOTS];
+};
+
 /* Master of the theads. */
 struct thread_master
 {
@@ -55,6 +75,7 @@ struct thread_master
   struct thread_list ready;
   struct thread_list unuse;
   struct pqueue *background;
+  struct thread_wheel *wheel;	/* in front of timer, if enabled */
   fd_set readfd;
   fd_set writefd;
   fd_set exceptfd;
@@ -79,6 +100,7 @@ struct thread
     struct timeval sands;	/* rest of time sands value. */
   } u;
   int index;			/* used for timers to store position in queue */
+  struct thread_list *slot;	/* timer wheel slot holding the timer */
   struct timeval real;
   struct cpu_thread_history *hist; /* cache pointer to cpu_history */
   const char *funcname;
@@ -178,6 +200,7 @@ enum quagga_clkid {
 /* Prototypes. */
 extern struct thread_master *thread_master_create (void);
 extern void thread_master_free (struct thread_master *);
+extern void thread_master_timer_wheel (struct thread_master *, int);
 
 extern struct thread *funcname_thread_add_read (struct thread_master *, 
 				                int (*)(struct thread *),
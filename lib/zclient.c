@@ -804,7 +804,7 @@ void
 zebra_interface_if_set_value (struct stream *s, struct interface *ifp)
 {
   /* Read interface's index. */
-  ifp->ifindex = stream_getl (s);
+  if_set_index (ifp, stream_getl (s));
   ifp->status = stream_getc (s);
 
   /* Read interface's value. */
@@ -866,8 +866,9 @@ zebra_interface_address_read (int type, struct stream *s, vrf_id_t vrf_id)
   
   zclient_stream_get_prefix (s, &p);
 
-  /* Fetch destination address. */
+  /* Fetch destination address, which shares the address' prefix length. */
   stream_get (&d.u.prefix, s, plen);
+  d.prefixlen = p.prefixlen;
   
   /* N.B. NULL destination pointers are encoded as all zeroes */
   dp = memconstant(&d.u.prefix,0,plen) ? NULL : &d;
@@ -879,9 +880,7 @@ zebra_interface_address_read (int type, struct stream *s, vrf_id_t vrf_id)
        if (ifc != NULL)
 	 {
 	   ifc->flags = ifc_flags;
-	   if (ifc->destination)
-	     ifc->destination->prefixlen = ifc->address->prefixlen;
-	   else if (CHECK_FLAG(ifc->flags, ZEBRA_IFA_PEER))
+	   if (! ifc->destination && CHECK_FLAG(ifc->flags, ZEBRA_IFA_PEER))
 	     {
 	       /* carp interfaces on OpenBSD with 0.0.0.0/0 as "peer" */
 	       char buf[PREFIX_STRLEN];
@@ -1460,6 +1460,113 @@ ospf6_intra_route_calculation (struct ospf6_area *oa)
     zlog_debug ("Re-examin intra-routes for area %s: Done", oa->name);
 }
 
+/* Re-examine the Intra-Area-Prefix-LSAs referring to the SPF vertex
+   VERTEX: their routes are removed if the vertex is no longer reachable,
+   otherwise they are re-added with its new cost and nexthops. */
+static void
+ospf6_intra_prefix_lsa_reexamine (struct ospf6_route *vertex, int removed,
+                                  struct ospf6_area *oa)
+{
+  u_int16_t type = htons (OSPF6_LSTYPE_INTRA_PREFIX);
+  u_int32_t adv_router = vertex->path.origin.adv_router;
+  u_int32_t ref_id;
+  struct ospf6_lsa *lsa;
+  struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
+
+  if (vertex->path.origin.type == htons (OSPF6_LSTYPE_ROUTER))
+    ref_id = htonl (0);
+  else
+    ref_id = vertex->path.origin.id;
+
+  for (lsa = ospf6_lsdb_type_router_head (type, adv_router, oa->lsdb); lsa;
+       lsa = ospf6_lsdb_type_router_next (type, adv_router, lsa))
+    {
+      intra_prefix_lsa = (struct ospf6_intra_prefix_lsa *)
+        OSPF6_LSA_HEADER_END (lsa->header);
+      if (intra_prefix_lsa->ref_type != vertex->path.origin.type ||
+          intra_prefix_lsa->ref_adv_router != adv_router ||
+          intra_prefix_lsa->ref_id != ref_id)
+        continue;
+
+      if (removed)
+        ospf6_intra_prefix_lsa_remove (lsa);
+      else
+        ospf6_intra_prefix_lsa_add (lsa);
+    }
+}
+
+#define ospf6_spf_vertex_is_same(a, b) \
+  ((a)->path.origin.type == (b)->path.origin.type && \
+   (a)->path.cost == (b)->path.cost && \
+   memcmp (&(a)->nexthop, &(b)->nexthop, \
+           sizeof (struct ospf6_nexthop) * OSPF6_MULTI_PATH_LIMIT) == 0)
+
+/* Bring the intra-area routes up to date after an SPF calculation which
+   replaced OLD_SPF by oa->spf_table.  Changes of the Intra-Area-Prefix-LSAs
+   themselves are already applied by the LSDB hooks, so only the LSAs
+   referring to vertices which appeared, disappeared or got a different
+   cost or nexthops need to be looked at again.  When the root moved or
+   most of the tree changed, the full re-examination is cheaper. */
+void
+ospf6_intra_route_update (struct ospf6_area *oa,
+                          struct ospf6_route_table *old_spf)
+{
+  struct ospf6_route *vertex, *old;
+  struct prefix root;
+  unsigned int changed = 0;
+
+  ospf6_linkstate_prefix (oa->ospf6->router_id, htonl (0), &root);
+  vertex = ospf6_route_lookup (&root, oa->spf_table);
+  old = ospf6_route_lookup (&root, old_spf);
+  if (vertex == NULL || old == NULL || ! ospf6_spf_vertex_is_same (vertex, old))
+    {
+      ospf6_intra_route_calculation (oa);
+      return;
+    }
+
+  for (vertex = ospf6_route_head (oa->spf_table); vertex;
+       vertex = ospf6_route_next (vertex))
+    {
+      old = ospf6_route_lookup (&vertex->prefix, old_spf);
+      if (old == NULL || ! ospf6_spf_vertex_is_same (vertex, old))
+        changed++;
+    }
+  for (old = ospf6_route_head (old_spf); old; old = ospf6_route_next (old))
+    if (ospf6_route_lookup (&old->prefix, oa->spf_table) == NULL)
+      changed++;
+
+  if (changed * 2 > oa->spf_table->count)
+    {
+      if (IS_OSPF6_DEBUG_EXAMIN (INTRA_PREFIX))
+        zlog_debug ("%u of %u vertices changed in area %s",
+                    changed, oa->spf_table->count, oa->name);
+      ospf6_intra_route_calculation (oa);
+      return;
+    }
+
+  if (IS_OSPF6_DEBUG_EXAMIN (INTRA_PREFIX))
+    zlog_debug ("Update intra-routes for area %s: %u vertices changed",
+                oa->name, changed);
+
+  /* Our own prefixes also depend on the interfaces they are on. */
+  ospf6_intra_prefix_lsa_reexamine (ospf6_route_lookup (&root, oa->spf_table),
+                                    0, oa);
+  if (changed == 0)
+    return;
+
+  for (old = ospf6_route_head (old_spf); old; old = ospf6_route_next (old))
+    if (ospf6_route_lookup (&old->prefix, oa->spf_table) == NULL)
+      ospf6_intra_prefix_lsa_reexamine (old, 1, oa);
+
+  for (vertex = ospf6_route_head (oa->spf_table); vertex;
+       vertex = ospf6_route_next (vertex))
+    {
+      old = ospf6_route_lookup (&vertex->prefix, old_spf);
+      if (old == NULL || ! ospf6_spf_vertex_is_same (vertex, old))
+        ospf6_intra_prefix_lsa_reexamine (vertex, 0, oa);
+    }
+}
+
 static void
 ospf6_brouter_debug_print (struct ospf6_route *brouter)
 {
@@ -222,6 +222,8 @@ extern void ospf6_intra_prefix_lsa_add (struct ospf6_lsa *lsa);
 extern void ospf6_intra_prefix_lsa_remove (struct ospf6_lsa *lsa);
 
 extern void ospf6_intra_route_calculation (struct ospf6_area *oa);
+extern void ospf6_intra_route_update (struct ospf6_area *oa,
+                                      struct ospf6_route_table *old_spf);
 extern void ospf6_intra_brouter_calculation (struct ospf6_area *oa);
 
 extern void ospf6_intra_init (void);
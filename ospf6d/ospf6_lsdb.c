@@ -318,9 +318,9 @@ ospf6_lsdb_next (struct ospf6_lsa *lsa)
   return next;
 }
 
-struct ospf6_lsa *
-ospf6_lsdb_type_router_head (u_int16_t type, u_int32_t adv_router,
-                             struct ospf6_lsdb *lsdb)
+static struct ospf6_lsa *
+ospf6_lsdb_table_type_router_head (u_int16_t type, u_int32_t adv_router,
+                                   struct route_table *table)
 {
   struct route_node *node;
   struct prefix_ipv6 key;
@@ -330,7 +330,7 @@ ospf6_lsdb_type_router_head (u_int16_t type, u_int32_t adv_router,
   ospf6_lsdb_set_key (&key, &type, sizeof (type));
   ospf6_lsdb_set_key (&key, &adv_router, sizeof (adv_router));
 
-  node = lsdb->table->top;
+  node = table->top;
 
   /* Walk down tree. */
   while (node && node->p.prefixlen <= key.prefixlen &&
@@ -345,8 +345,12 @@ ospf6_lsdb_type_router_head (u_int16_t type, u_int32_t adv_router,
   if (node == NULL)
     return NULL;
 
+  /* Nothing under the key, drop the lock on the node past it.  */
   if (! prefix_match ((struct prefix *) &key, &node->p))
-    return NULL;
+    {
+      route_unlock_node (node);
+      return NULL;
+    }
 
   lsa = node->info;
   ospf6_lsa_lock (lsa);
@@ -354,6 +358,13 @@ ospf6_lsdb_type_router_head (u_int16_t type, u_int32_t adv_router,
   return lsa;
 }
 
+struct ospf6_lsa *
+ospf6_lsdb_type_router_head (u_int16_t type, u_int32_t adv_router,
+                             struct ospf6_lsdb *lsdb)
+{
+  return ospf6_lsdb_table_type_router_head (type, adv_router, lsdb->table);
+}
+
 struct ospf6_lsa *
 ospf6_lsdb_type_router_next (u_int16_t type, u_int32_t adv_router,
                              struct ospf6_lsa *lsa)
@@ -374,6 +385,103 @@ ospf6_lsdb_type_router_next (u_int16_t type, u_int32_t adv_router,
   return next;
 }
 
+/* Find the first LSA whose type is TYPE (host byte order) or above.
+   The key starts with the type, so this is a lower bound search in the
+   table: remember the last subtree to the right of the path, and stop
+   at the first node which is entirely above or below the searched key. */
+static struct ospf6_lsa *
+ospf6_lsdb_type_lower_bound (u_int16_t type, struct route_table *table)
+{
+  struct route_node *node, *right = NULL;
+  struct prefix_ipv6 key;
+  u_int16_t t = htons (type);
+
+  memset (&key, 0, sizeof (key));
+  ospf6_lsdb_set_key (&key, &t, sizeof (t));
+
+  node = table->top;
+  while (node)
+    {
+      if (node->p.prefixlen >= key.prefixlen)
+        {
+          if (! prefix_match ((struct prefix *) &key, &node->p) &&
+              memcmp (&node->p.u.prefix6, &key.prefix,
+                      sizeof (struct in6_addr)) < 0)
+            node = right;
+          break;
+        }
+      if (! prefix_match (&node->p, (struct prefix *) &key))
+        {
+          if (memcmp (&node->p.u.prefix6, &key.prefix,
+                      sizeof (struct in6_addr)) < 0)
+            node = right;
+          break;
+        }
+      if (prefix6_bit (&key.prefix, node->p.prefixlen) == 0 && node->link[1])
+        right = node->link[1];
+      node = node->link[prefix6_bit (&key.prefix, node->p.prefixlen)];
+      if (node == NULL)
+        node = right;
+    }
+
+  if (node)
+    route_lock_node (node);
+  while (node && node->info == NULL)
+    node = route_next (node);
+  if (node == NULL)
+    return NULL;
+
+  ospf6_lsa_lock ((struct ospf6_lsa *) node->info);
+  return (struct ospf6_lsa *) node->info;
+}
+
+/* The first LSA of ADV_ROUTER with a type of TYPE (host byte order) or
+   above.  Only the subtree of that router is visited under each type. */
+static struct ospf6_lsa *
+ospf6_lsdb_router_seek (u_int32_t type, u_int32_t adv_router,
+                        struct route_table *table)
+{
+  struct ospf6_lsa *lsa;
+  u_int16_t t;
+
+  while (type <= 0xffff)
+    {
+      lsa = ospf6_lsdb_type_lower_bound (type, table);
+      if (lsa == NULL)
+        return NULL;
+      t = lsa->header->type;
+      ospf6_lsdb_lsa_unlock (lsa);
+
+      lsa = ospf6_lsdb_table_type_router_head (t, adv_router, table);
+      if (lsa)
+        return lsa;
+      type = ntohs (t) + 1;
+    }
+
+  return NULL;
+}
+
+/* Iterate over the LSAs originated by ADV_ROUTER, whatever their type. */
+struct ospf6_lsa *
+ospf6_lsdb_router_head (u_int32_t adv_router, struct ospf6_lsdb *lsdb)
+{
+  return ospf6_lsdb_router_seek (0, adv_router, lsdb->table);
+}
+
+struct ospf6_lsa *
+ospf6_lsdb_router_next (u_int32_t adv_router, struct ospf6_lsa *lsa)
+{
+  struct route_table *table = lsa->rn->table;
+  u_int16_t type = lsa->header->type;
+  struct ospf6_lsa *next;
+
+  next = ospf6_lsdb_type_router_next (type, adv_router, lsa);
+  if (next)
+    return next;
+
+  return ospf6_lsdb_router_seek (ntohs (type) + 1, adv_router, table);
+}
+
 struct ospf6_lsa *
 ospf6_lsdb_type_head (u_int16_t type, struct ospf6_lsdb *lsdb)
 {
@@ -398,8 +506,12 @@ ospf6_lsdb_type_head (u_int16_t type, struct ospf6_lsdb *lsdb)
   if (node == NULL)
     return NULL;
 
+  /* Nothing under the key, drop the lock on the node past it.  */
   if (! prefix_match ((struct prefix *) &key, &node->p))
-    return NULL;
+    {
+      route_unlock_node (node);
+      return NULL;
+    }
 
   lsa = node->info;
   ospf6_lsa_lock (lsa);
@@ -528,6 +640,8 @@ ospf6_lsdb_show (struct vty *vty, enum ospf_lsdb_show_level level,
     lsa = ospf6_lsdb_type_router_head (*type, *adv_router, lsdb);
   else if (type)
     lsa = ospf6_lsdb_type_head (*type, lsdb);
+  else if (adv_router)
+    lsa = ospf6_lsdb_router_head (*adv_router, lsdb);
   else
     lsa = ospf6_lsdb_head (lsdb);
   while (lsa)
@@ -540,6 +654,8 @@ ospf6_lsdb_show (struct vty *vty, enum ospf_lsdb_show_level level,
         lsa = ospf6_lsdb_type_router_next (*type, *adv_router, lsa);
       else if (type)
         lsa = ospf6_lsdb_type_next (*type, lsa);
+      else if (adv_router)
+        lsa = ospf6_lsdb_router_next (*adv_router, lsa);
       else
         lsa = ospf6_lsdb_next (lsa);
     }
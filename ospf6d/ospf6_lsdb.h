@@ -58,6 +58,11 @@ extern struct ospf6_lsa *ospf6_lsdb_type_router_next (u_int16_t type,
                                                u_int32_t adv_router,
                                                struct ospf6_lsa *lsa);
 
+extern struct ospf6_lsa *ospf6_lsdb_router_head (u_int32_t adv_router,
+                                                 struct ospf6_lsdb *lsdb);
+extern struct ospf6_lsa *ospf6_lsdb_router_next (u_int32_t adv_router,
+                                                 struct ospf6_lsa *lsa);
+
 extern struct ospf6_lsa *ospf6_lsdb_type_head (u_int16_t type,
                                                struct ospf6_lsdb *lsdb);
 extern struct ospf6_lsa *ospf6_lsdb_type_next (u_int16_t type,
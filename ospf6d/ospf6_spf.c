@@ -542,6 +542,24 @@ ospf6_spf_log_database (struct ospf6_area *oa)
   zlog_debug ("%s", buffer);
 }
 
+/* Calculate the SPF tree of an area into a fresh table and update the
+   intra-area routes from the differences to the previous tree. */
+static void
+ospf6_spf_calculation_area (struct ospf6 *ospf6, struct ospf6_area *oa)
+{
+  struct ospf6_route_table *old_spf = oa->spf_table;
+
+  oa->spf_table = OSPF6_ROUTE_TABLE_CREATE (AREA, SPF_RESULTS);
+  oa->spf_table->scope = oa;
+
+  ospf6_spf_calculation (ospf6->router_id, oa->spf_table, oa);
+  ospf6_intra_route_update (oa, old_spf);
+  ospf6_intra_brouter_calculation (oa);
+
+  ospf6_spf_table_finish (old_spf);
+  ospf6_route_table_delete (old_spf);
+}
+
 static int
 ospf6_spf_calculation_thread (struct thread *t)
 {
@@ -570,9 +588,7 @@ ospf6_spf_calculation_thread (struct thread *t)
       if (IS_OSPF6_DEBUG_SPF (DATABASE))
 	ospf6_spf_log_database (oa);
 
-      ospf6_spf_calculation (ospf6->router_id, oa->spf_table, oa);
-      ospf6_intra_route_calculation (oa);
-      ospf6_intra_brouter_calculation (oa);
+      ospf6_spf_calculation_area (ospf6, oa);
 
       areas_processed++;
     }
@@ -585,10 +601,7 @@ ospf6_spf_calculation_thread (struct thread *t)
       if (IS_OSPF6_DEBUG_SPF (DATABASE))
 	ospf6_spf_log_database(ospf6->backbone);
 
-      ospf6_spf_calculation(ospf6->router_id, ospf6->backbone->spf_table,
-			    ospf6->backbone);
-      ospf6_intra_route_calculation(ospf6->backbone);
-      ospf6_intra_brouter_calculation(ospf6->backbone);
+      ospf6_spf_calculation_area (ospf6, ospf6->backbone);
       areas_processed++;
     }
 
@@ -421,6 +421,26 @@ out:
   return rc;
 }
 
+/*
+ * Synchronous request to get LSA notifications in batches.
+ */
+int
+ospf_apiclient_register_batch (struct ospf_apiclient *oclient,
+			       u_int16_t flush_interval,
+			       u_int16_t max_pending, u_char *opaque_types)
+{
+  struct msg *msg;
+
+  msg = new_msg_register_batch (ospf_apiclient_get_seqnr (), flush_interval,
+				max_pending, opaque_types);
+  if (!msg)
+    {
+      fprintf (stderr, "new_msg_register_batch failed\n");
+      return -1;
+    }
+  return ospf_apiclient_send_request (oclient, msg);
+}
+
 /* 
  * Synchronous request to originate or update an LSA.
  */
@@ -573,65 +593,96 @@ ospf_apiclient_handle_nsm_change (struct ospf_apiclient *oclient,
 }
 
 static void
-ospf_apiclient_handle_lsa_update (struct ospf_apiclient *oclient,
-				  struct msg *msg)
+ospf_apiclient_handle_lsa_change (struct ospf_apiclient *oclient,
+				  u_char msgtype,
+				  struct msg_lsa_change_notify *cn)
 {
-  struct msg_lsa_change_notify *cn;
   struct lsa_header *lsa;
   int lsalen;
 
-  cn = (struct msg_lsa_change_notify *) STREAM_DATA (msg->s);
-
   /* Extract LSA from message */
   lsalen = ntohs (cn->data.length);
   lsa = XMALLOC (MTYPE_OSPF_APICLIENT, lsalen);
   if (!lsa)
     {
-      fprintf (stderr, "LSA update: Cannot allocate memory for LSA\n");
+      fprintf (stderr, "LSA %s: Cannot allocate memory for LSA\n",
+	       msgtype == MSG_LSA_UPDATE_NOTIFY ? "update" : "delete");
       return;
     }
   memcpy (lsa, &(cn->data), lsalen);
 
-  /* Invoke registered update callback function */
-  if (oclient->update_notify)
+  /* Invoke registered update or delete callback function */
+  if (msgtype == MSG_LSA_UPDATE_NOTIFY && oclient->update_notify)
     {
       (oclient->update_notify) (cn->ifaddr, cn->area_id, 
 				cn->is_self_originated, lsa);
     }
+  else if (msgtype == MSG_LSA_DELETE_NOTIFY && oclient->delete_notify)
+    {
+      (oclient->delete_notify) (cn->ifaddr, cn->area_id, 
+				cn->is_self_originated, lsa);
+    }
 
   /* free memory allocated by ospf apiclient library */
   XFREE (MTYPE_OSPF_APICLIENT, lsa);
 }
 
 static void
-ospf_apiclient_handle_lsa_delete (struct ospf_apiclient *oclient,
+ospf_apiclient_handle_lsa_update (struct ospf_apiclient *oclient,
 				  struct msg *msg)
 {
-  struct msg_lsa_change_notify *cn;
-  struct lsa_header *lsa;
-  int lsalen;
+  ospf_apiclient_handle_lsa_change
+    (oclient, MSG_LSA_UPDATE_NOTIFY,
+     (struct msg_lsa_change_notify *) STREAM_DATA (msg->s));
+}
 
-  cn = (struct msg_lsa_change_notify *) STREAM_DATA (msg->s);
+static void
+ospf_apiclient_handle_lsa_delete (struct ospf_apiclient *oclient,
+				  struct msg *msg)
+{
+  ospf_apiclient_handle_lsa_change
+    (oclient, MSG_LSA_DELETE_NOTIFY,
+     (struct msg_lsa_change_notify *) STREAM_DATA (msg->s));
+}
 
-  /* Extract LSA from message */
-  lsalen = ntohs (cn->data.length);
-  lsa = XMALLOC (MTYPE_OSPF_APICLIENT, lsalen);
-  if (!lsa)
-    {
-      fprintf (stderr, "LSA delete: Cannot allocate memory for LSA\n");
-      return;
+/* Hand every notification of a batch frame to the callbacks. */
+static void
+ospf_apiclient_handle_lsa_batch (struct ospf_apiclient *oclient,
+				 struct msg *msg)
+{
+  struct msg_lsa_change_batch_entry *entry;
+  u_char *p = STREAM_DATA (msg->s);
+  u_char *end = p + ntohs (msg->hdr.msglen);
+  u_int16_t len;
+
+  while (p + sizeof (*entry) <= end)
+    {
+      entry = (struct msg_lsa_change_batch_entry *) p;
+      len = ntohs (entry->len);
+      p += sizeof (*entry);
+
+      if (len < sizeof (struct msg_lsa_change_notify) || p + len > end)
+	{
+	  fprintf (stderr, "LSA batch: Malformed entry\n");
+	  return;
+	}
+      ospf_apiclient_handle_lsa_change (oclient, entry->msgtype,
+					(struct msg_lsa_change_notify *) p);
+      p += (len + 3) & ~3;
     }
-  memcpy (lsa, &(cn->data), lsalen);
+}
+
+static void
+ospf_apiclient_handle_resync (struct ospf_apiclient *oclient,
+			      struct msg *msg)
+{
+  struct msg_resync_required *rn;
 
-  /* Invoke registered update callback function */
-  if (oclient->delete_notify)
+  rn = (struct msg_resync_required *) STREAM_DATA (msg->s);
+  if (oclient->resync_required)
     {
-      (oclient->delete_notify) (cn->ifaddr, cn->area_id, 
-				cn->is_self_originated, lsa);
+      (oclient->resync_required) (ntohl (rn->dropped));
     }
-
-  /* free memory allocated by ospf apiclient library */
-  XFREE (MTYPE_OSPF_APICLIENT, lsa);
 }
 
 static void
@@ -661,6 +712,12 @@ ospf_apiclient_msghandle (struct ospf_apiclient *oclient, struct msg *msg)
     case MSG_LSA_DELETE_NOTIFY:
       ospf_apiclient_handle_lsa_delete (oclient, msg);
       break;
+    case MSG_LSA_CHANGE_BATCH:
+      ospf_apiclient_handle_lsa_batch (oclient, msg);
+      break;
+    case MSG_RESYNC_REQUIRED:
+      ospf_apiclient_handle_resync (oclient, msg);
+      break;
     default:
       fprintf (stderr, "ospf_apiclient_read: Unknown message type: %d\n",
 	       msg->hdr.msgtype);
@@ -717,6 +774,16 @@ ospf_apiclient_register_callback (struct ospf_apiclient *oclient,
   oclient->delete_notify = delete_notify;
 }
 
+void
+ospf_apiclient_register_resync_callback (struct ospf_apiclient *oclient,
+					 void (*resync_required)
+					 (u_int32_t dropped))
+{
+  assert (oclient);
+
+  oclient->resync_required = resync_required;
+}
+
 /* -----------------------------------------------------------
  * Asynchronous message handling
  * -----------------------------------------------------------
@@ -48,6 +48,7 @@ struct ospf_apiclient
   void (*delete_notify) (struct in_addr ifaddr, struct in_addr area_id,
 			 u_char self_origin,
 			 struct lsa_header * lsa);
+  void (*resync_required) (u_int32_t dropped);
 };
 
 
@@ -110,9 +111,23 @@ void ospf_apiclient_register_callback (struct ospf_apiclient *oclient,
 							      lsa_header *
 							      lsa));
 
+/* Register callback function for MSG_RESYNC_REQUIRED: LSA notifications
+   were dropped, the LSDB has to be synchronized again. */
+void ospf_apiclient_register_resync_callback (struct ospf_apiclient *oclient,
+					      void (*resync_required)
+					      (u_int32_t dropped));
+
 /* Synchronous request to synchronize LSDB. */
 int ospf_apiclient_sync_lsdb (struct ospf_apiclient *oclient);
 
+/* Synchronous request to receive LSA notifications in batches, sent
+   every flush_interval msec and coalesced per LSA.  opaque_types is a
+   32 octet bitmap of the opaque types of interest, or NULL for any. */
+int ospf_apiclient_register_batch (struct ospf_apiclient *oclient,
+				   u_int16_t flush_interval,
+				   u_int16_t max_pending,
+				   u_char *opaque_types);
+
 /* Synchronous request to originate or update opaque LSA. */
 int
 ospf_apiclient_lsa_originate(struct ospf_apiclient *oclient,
@@ -142,6 +142,7 @@ ospf_api_typename (int msgtype)
     { MSG_SYNC_LSDB,             "Sync LSDB",              },
     { MSG_ORIGINATE_REQUEST,     "Originate request",      },
     { MSG_DELETE_REQUEST,        "Delete request",         },
+    { MSG_REGISTER_BATCH,        "Register batch",         },
     { MSG_REPLY,                 "Reply",                  },
     { MSG_READY_NOTIFY,          "Ready notify",           },
     { MSG_LSA_UPDATE_NOTIFY,     "LSA update notify",      },
@@ -150,6 +151,8 @@ ospf_api_typename (int msgtype)
     { MSG_DEL_IF,                "Del interface",          },
     { MSG_ISM_CHANGE,            "ISM change",             },
     { MSG_NSM_CHANGE,            "NSM change",             },
+    { MSG_LSA_CHANGE_BATCH,      "LSA change batch",       },
+    { MSG_RESYNC_REQUIRED,       "Resync required",        },
   };
 
   int i, n = array_size(NameTab);
@@ -341,7 +344,7 @@ msg_read (int fd)
 {
   struct msg *msg;
   struct apimsghdr hdr;
-  u_char buf[OSPF_API_MAX_MSG_SIZE];
+  u_char buf[OSPF_API_MAX_FRAME_SIZE];
   int bodylen;
   int rlen;
 
@@ -373,6 +376,11 @@ msg_read (int fd)
 
   /* Determine body length. */
   bodylen = ntohs (hdr.msglen);
+  if (bodylen > (int) sizeof (buf))
+    {
+      zlog_warn ("msg_read: Message body too long (%d)", bodylen);
+      return NULL;
+    }
   if (bodylen > 0)
     {
 
@@ -404,7 +412,7 @@ msg_read (int fd)
 int
 msg_write (int fd, struct msg *msg)
 {
-  u_char buf[OSPF_API_MAX_MSG_SIZE];
+  u_char buf[sizeof (struct apimsghdr) + OSPF_API_MAX_FRAME_SIZE];
   int l;
   int wlen;
 
@@ -533,6 +541,23 @@ new_msg_delete_request (u_int32_t seqnum,
 		  sizeof (struct msg_delete_request));
 }
 
+struct msg *
+new_msg_register_batch (u_int32_t seqnum, u_int16_t flush_interval,
+			u_int16_t max_pending, u_char *opaque_types)
+{
+  struct msg_register_batch bmsg;
+
+  bmsg.flush_interval = htons (flush_interval);
+  bmsg.max_pending = htons (max_pending);
+  if (opaque_types)
+    memcpy (bmsg.opaque_types, opaque_types, sizeof (bmsg.opaque_types));
+  else
+    memset (bmsg.opaque_types, 0, sizeof (bmsg.opaque_types));
+
+  return msg_new (MSG_REGISTER_BATCH, &bmsg, seqnum,
+		  sizeof (struct msg_register_batch));
+}
+
 
 struct msg *
 new_msg_reply (u_int32_t seqnr, u_char rc)
@@ -646,4 +671,15 @@ new_msg_lsa_change_notify (u_char msgtype,
   return msg_new (msgtype, nmsg, seqnum, len);
 }
 
+struct msg *
+new_msg_resync_required (u_int32_t seqnum, u_int32_t dropped)
+{
+  struct msg_resync_required rmsg;
+
+  rmsg.dropped = htonl (dropped);
+
+  return msg_new (MSG_RESYNC_REQUIRED, &rmsg, seqnum,
+		  sizeof (struct msg_resync_required));
+}
+
 #endif /* SUPPORT_OSPF_API */
@@ -116,6 +116,7 @@ extern void msg_fifo_free (struct msg_fifo *fifo);
 #define MSG_SYNC_LSDB             4
 #define MSG_ORIGINATE_REQUEST     5
 #define MSG_DELETE_REQUEST        6
+#define MSG_REGISTER_BATCH        7
 
 /* Messages from OSPF daemon. */
 #define MSG_REPLY                10
@@ -126,6 +127,8 @@ extern void msg_fifo_free (struct msg_fifo *fifo);
 #define MSG_DEL_IF               15
 #define MSG_ISM_CHANGE           16
 #define MSG_NSM_CHANGE           17
+#define MSG_LSA_CHANGE_BATCH     18
+#define MSG_RESYNC_REQUIRED      19
 
 struct msg_register_opaque_type
 {
@@ -182,6 +185,18 @@ struct msg_sync_lsdb
   struct lsa_filter_type filter;
 };
 
+/* Ask for LSA update/delete notifications to be coalesced and sent in
+   MSG_LSA_CHANGE_BATCH frames.  The filter set by MSG_REGISTER_EVENT
+   still applies. */
+struct msg_register_batch
+{
+  u_int16_t flush_interval;	/* milliseconds, 0 for the default */
+  u_int16_t max_pending;	/* LSAs held before giving up and sending
+				   MSG_RESYNC_REQUIRED, 0 for the default */
+  u_char opaque_types[32];	/* bitmap of the opaque types of interest
+				   for LSA types 9-11, all zero for any */
+};
+
 struct msg_originate_request
 {
   /* Used for LSA type 9 otherwise ignored */
@@ -274,6 +289,24 @@ struct msg_nsm_change
   u_char pad[3];
 };
 
+/* A MSG_LSA_CHANGE_BATCH frame is a sequence of the records below,
+   each followed by a msg_lsa_change_notify of "len" octets and padded
+   to four octets. */
+struct msg_lsa_change_batch_entry
+{
+  u_char msgtype;		/* MSG_LSA_UPDATE_NOTIFY or
+				   MSG_LSA_DELETE_NOTIFY */
+  u_char pad;
+  u_int16_t len;		/* length of the notification */
+};
+
+/* Notifications were dropped because the client did not keep up.  No
+   more are sent until it asks for MSG_SYNC_LSDB again. */
+struct msg_resync_required
+{
+  u_int32_t dropped;		/* number of notifications dropped */
+};
+
 /* We make use of a union to define a structure that covers all
    possible API messages. This allows us to find out how much memory
    needs to be reserved for the largest API message. */
@@ -294,12 +327,17 @@ struct apimsg
     struct msg_ism_change ism_change;
     struct msg_nsm_change nsm_change;
     struct msg_lsa_change_notify lsa_change_notify;
+    struct msg_register_batch register_batch;
+    struct msg_resync_required resync_required;
   }
   u;
 };
 
 #define OSPF_API_MAX_MSG_SIZE (sizeof(struct apimsg) + OSPF_MAX_LSA_SIZE)
 
+/* Largest body of a MSG_LSA_CHANGE_BATCH frame, and so of any message. */
+#define OSPF_API_MAX_FRAME_SIZE 16384
+
 /* -----------------------------------------------------------
  * Prototypes for specific messages
  * -----------------------------------------------------------
@@ -324,6 +362,10 @@ extern struct msg *new_msg_delete_request (u_int32_t seqnum,
 					   u_char lsa_type,
 					   u_char opaque_type,
 					   u_int32_t opaque_id);
+extern struct msg *new_msg_register_batch (u_int32_t seqnum,
+					   u_int16_t flush_interval,
+					   u_int16_t max_pending,
+					   u_char *opaque_types);
 
 /* Messages sent by OSPF daemon */
 extern struct msg *new_msg_reply (u_int32_t seqnum, u_char rc);
@@ -354,6 +396,9 @@ extern struct msg *new_msg_lsa_change_notify (u_char msgtype,
 					      u_char is_self_originated,
 					      struct lsa_header *data);
 
+extern struct msg *new_msg_resync_required (u_int32_t seqnum,
+					    u_int32_t dropped);
+
 /* string printing functions */
 extern const char *ospf_api_errname (int errcode);
 extern const char *ospf_api_typename (int msgtype);
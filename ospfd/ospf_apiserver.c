@@ -35,6 +35,7 @@
 #include "log.h"
 #include "thread.h"
 #include "hash.h"
+#include "jhash.h"
 #include "sockunion.h"		/* for inet_aton() */
 #include "buffer.h"
 
@@ -291,6 +292,8 @@ ospf_apiserver_new (int fd_sync, int fd_async)
   new->filter->origin = ANY_ORIGIN;
   new->filter->num_areas = 0;
 
+  new->batch = NULL;
+
   return new;
 }
 
@@ -330,6 +333,8 @@ ospf_apiserver_event (enum event event, int fd,
     }
 }
 
+static void apiserver_batch_free (struct ospf_apiserver_batch *batch);
+
 /* Free instance. First unregister all opaque types used by
    application, flush opaque LSAs injected by application 
    from network and close connection. */
@@ -382,6 +387,10 @@ ospf_apiserver_free (struct ospf_apiserver *apiserv)
       close (apiserv->fd_async);
     }
 
+  /* Drop notifications not sent yet. */
+  if (apiserv->batch)
+    apiserver_batch_free (apiserv->batch);
+
   /* Free fifos */
   msg_fifo_free (apiserv->out_sync_fifo);
   msg_fifo_free (apiserv->out_async_fifo);
@@ -789,6 +798,8 @@ ospf_apiserver_send_msg (struct ospf_apiserver *apiserv, struct msg *msg)
     case MSG_DEL_IF:
     case MSG_ISM_CHANGE:
     case MSG_NSM_CHANGE:
+    case MSG_LSA_CHANGE_BATCH:
+    case MSG_RESYNC_REQUIRED:
       fifo = apiserv->out_async_fifo;
       fd = apiserv->fd_async;
       event = OSPF_APISERVER_ASYNC_WRITE;
@@ -866,6 +877,9 @@ ospf_apiserver_handle_msg (struct ospf_apiserver *apiserv, struct msg *msg)
     case MSG_DELETE_REQUEST:
       rc = ospf_apiserver_handle_delete_request (apiserv, msg);
       break;
+    case MSG_REGISTER_BATCH:
+      rc = ospf_apiserver_handle_register_batch (apiserv, msg);
+      break;
     default:
       zlog_warn ("ospf_apiserver_handle_msg: Unknown message type: %d",
 		 msg->hdr.msgtype);
@@ -1262,6 +1276,306 @@ ospf_apiserver_handle_register_event (struct ospf_apiserver *apiserv,
 }
 
 
+
+/* -----------------------------------------------------------
+ * Followings are functions for batched LSA change notifications.
+ * -----------------------------------------------------------
+ */
+
+/* A notification waiting to be sent.  There is at most one per LSA,
+   a newer one replaces it. */
+struct apiserver_pending
+{
+  struct msg *msg;		/* MSG_LSA_{UPDATE,DELETE}_NOTIFY */
+};
+
+#define APISERVER_PENDING_NOTIFY(P) \
+  ((struct msg_lsa_change_notify *) STREAM_DATA ((P)->msg->s))
+
+static unsigned int
+apiserver_pending_hash_key (void *arg)
+{
+  struct msg_lsa_change_notify *cn = APISERVER_PENDING_NOTIFY
+    ((struct apiserver_pending *) arg);
+
+  return jhash_3words (cn->data.id.s_addr, cn->data.adv_router.s_addr,
+		       cn->area_id.s_addr ^ cn->ifaddr.s_addr,
+		       cn->data.type);
+}
+
+static int
+apiserver_pending_hash_cmp (const void *arg1, const void *arg2)
+{
+  struct msg_lsa_change_notify *cn1 = APISERVER_PENDING_NOTIFY
+    ((const struct apiserver_pending *) arg1);
+  struct msg_lsa_change_notify *cn2 = APISERVER_PENDING_NOTIFY
+    ((const struct apiserver_pending *) arg2);
+
+  return (cn1->data.type == cn2->data.type
+	  && cn1->data.id.s_addr == cn2->data.id.s_addr
+	  && cn1->data.adv_router.s_addr == cn2->data.adv_router.s_addr
+	  && cn1->area_id.s_addr == cn2->area_id.s_addr
+	  && cn1->ifaddr.s_addr == cn2->ifaddr.s_addr);
+}
+
+static void *
+apiserver_pending_alloc (void *arg)
+{
+  struct apiserver_pending *pend;
+
+  pend = XMALLOC (MTYPE_OSPF_APISERVER_BATCH,
+		  sizeof (struct apiserver_pending));
+  pend->msg = ((struct apiserver_pending *) arg)->msg;
+  return pend;
+}
+
+static void
+apiserver_pending_free (void *arg)
+{
+  struct apiserver_pending *pend = arg;
+
+  msg_free (pend->msg);
+  XFREE (MTYPE_OSPF_APISERVER_BATCH, pend);
+}
+
+/* Forget the notifications not sent yet. */
+static void
+apiserver_batch_clear (struct ospf_apiserver_batch *batch)
+{
+  hash_clean (batch->pending_hash, NULL);
+  list_delete_all_node (batch->pending);
+}
+
+static void
+apiserver_batch_free (struct ospf_apiserver_batch *batch)
+{
+  THREAD_OFF (batch->t_flush);
+  apiserver_batch_clear (batch);
+  hash_free (batch->pending_hash);
+  list_delete (batch->pending);
+  XFREE (MTYPE_OSPF_APISERVER_BATCH, batch);
+}
+
+/* Whether the client asked for the opaque type of LSA, if it is one. */
+static int
+apiserver_batch_opaque_match (struct ospf_apiserver_batch *batch,
+			      struct lsa_header *lsah)
+{
+  u_char otype;
+
+  if (! batch->opaque_filter || ! IS_OPAQUE_LSA (lsah->type))
+    return 1;
+
+  otype = GET_OPAQUE_TYPE (ntohl (lsah->id.s_addr));
+  return CHECK_FLAG (batch->opaque_types[otype / 8], 1 << (otype % 8));
+}
+
+/* Queue the batch frame built in FRAME for writing. */
+static void
+apiserver_frame_send (struct ospf_apiserver *apiserv, struct stream *frame,
+		      u_int32_t seqnum)
+{
+  struct msg *msg;
+
+  if (stream_get_endp (frame) == 0)
+    return;
+
+  msg = msg_new (MSG_LSA_CHANGE_BATCH, STREAM_DATA (frame), seqnum,
+		 stream_get_endp (frame));
+  msg_fifo_push (apiserv->out_async_fifo, msg);
+  ospf_apiserver_event (OSPF_APISERVER_ASYNC_WRITE, apiserv->fd_async,
+			apiserv);
+
+  stream_reset (frame);
+}
+
+/* Append the notification MSG to the batch frame in FRAME, after
+   sending the frame if it is full. */
+static void
+apiserver_frame_put (struct ospf_apiserver *apiserv, struct stream *frame,
+		     struct msg *msg, u_int32_t seqnum)
+{
+  struct msg_lsa_change_batch_entry entry;
+  size_t len = ntohs (msg->hdr.msglen);
+  size_t padlen = ((len + 3) & ~3) - len;
+
+  if (STREAM_WRITEABLE (frame) < sizeof (entry) + len + padlen)
+    apiserver_frame_send (apiserv, frame, seqnum);
+
+  entry.msgtype = msg->hdr.msgtype;
+  entry.pad = 0;
+  entry.len = htons (len);
+  stream_put (frame, &entry, sizeof (entry));
+  stream_put (frame, STREAM_DATA (msg->s), len);
+  if (padlen)
+    stream_put (frame, NULL, padlen);
+}
+
+/* Send the pending notifications in as few frames as possible. */
+static void
+apiserver_batch_flush_pending (struct ospf_apiserver *apiserv)
+{
+  struct ospf_apiserver_batch *batch = apiserv->batch;
+  struct apiserver_pending *pend;
+  struct listnode *node;
+  struct stream *frame;
+
+  if (listcount (batch->pending) == 0)
+    return;
+
+  frame = stream_new (OSPF_API_MAX_FRAME_SIZE);
+  for (ALL_LIST_ELEMENTS_RO (batch->pending, node, pend))
+    apiserver_frame_put (apiserv, frame, pend->msg, 0);
+  apiserver_frame_send (apiserv, frame, 0);
+  stream_free (frame);
+
+  apiserver_batch_clear (batch);
+}
+
+static int
+apiserver_batch_flush (struct thread *thread)
+{
+  struct ospf_apiserver *apiserv = THREAD_ARG (thread);
+  struct ospf_apiserver_batch *batch = apiserv->batch;
+
+  batch->t_flush = NULL;
+
+  /* The client does not keep up: hold the notifications back, where
+     further changes to the same LSAs are coalesced. */
+  if (apiserv->out_async_fifo->count >= OSPF_APISERVER_BATCH_MAX_BACKLOG)
+    {
+      batch->t_flush = thread_add_timer_msec (master, apiserver_batch_flush,
+					      apiserv, batch->flush_interval);
+      return 0;
+    }
+
+  apiserver_batch_flush_pending (apiserv);
+  return 0;
+}
+
+/* Too many notifications are held back: drop them all and tell the
+   client, which has to sync the LSDB again. */
+static void
+apiserver_batch_overflow (struct ospf_apiserver *apiserv)
+{
+  struct ospf_apiserver_batch *batch = apiserv->batch;
+  struct msg *msg;
+
+  zlog_warn ("API: client %s/%u does not keep up, %u LSA notifications "
+	     "dropped", inet_ntoa (apiserv->peer_async.sin_addr),
+	     ntohs (apiserv->peer_async.sin_port),
+	     listcount (batch->pending) + 1);
+
+  batch->dropped = listcount (batch->pending) + 1;
+  batch->resync = 1;
+  THREAD_OFF (batch->t_flush);
+  apiserver_batch_clear (batch);
+
+  msg = new_msg_resync_required (0, batch->dropped);
+  if (msg)
+    {
+      ospf_apiserver_send_msg (apiserv, msg);
+      msg_free (msg);
+    }
+}
+
+/* Hold the notification MSG for the next batch. */
+static void
+apiserver_batch_add (struct ospf_apiserver *apiserv, struct msg *msg)
+{
+  struct ospf_apiserver_batch *batch = apiserv->batch;
+  struct apiserver_pending lookup;
+  struct apiserver_pending *pend;
+
+  if (! apiserver_batch_opaque_match
+        (batch, &((struct msg_lsa_change_notify *) STREAM_DATA (msg->s))->data))
+    return;
+
+  if (batch->resync)
+    {
+      batch->dropped++;
+      return;
+    }
+
+  lookup.msg = msg;
+  pend = hash_lookup (batch->pending_hash, &lookup);
+  if (pend)
+    {
+      /* Only the latest state of an LSA matters. */
+      msg_free (pend->msg);
+      pend->msg = msg_dup (msg);
+      return;
+    }
+
+  if (listcount (batch->pending) >= batch->max_pending)
+    {
+      apiserver_batch_overflow (apiserv);
+      return;
+    }
+
+  lookup.msg = msg_dup (msg);
+  pend = hash_get (batch->pending_hash, &lookup, apiserver_pending_alloc);
+  listnode_add (batch->pending, pend);
+
+  if (! batch->t_flush)
+    batch->t_flush = thread_add_timer_msec (master, apiserver_batch_flush,
+					    apiserv, batch->flush_interval);
+}
+
+int
+ospf_apiserver_handle_register_batch (struct ospf_apiserver *apiserv,
+				      struct msg *msg)
+{
+  struct msg_register_batch *bmsg;
+  struct ospf_apiserver_batch *batch;
+  u_int32_t seqnum;
+  unsigned int i;
+
+  bmsg = (struct msg_register_batch *) STREAM_DATA (msg->s);
+
+  /* Get request sequence number */
+  seqnum = msg_get_seq (msg);
+
+  if (ntohs (msg->hdr.msglen) < sizeof (struct msg_register_batch))
+    return ospf_apiserver_send_reply (apiserv, seqnum, OSPF_API_ERROR);
+
+  if ((batch = apiserv->batch) != NULL)
+    {
+      /* Send what was held under the previous settings. */
+      if (! batch->resync)
+	apiserver_batch_flush_pending (apiserv);
+      THREAD_OFF (batch->t_flush);
+    }
+  else
+    {
+      batch = XCALLOC (MTYPE_OSPF_APISERVER_BATCH,
+		       sizeof (struct ospf_apiserver_batch));
+      batch->pending = list_new ();
+      batch->pending->del = apiserver_pending_free;
+      batch->pending_hash = hash_create (apiserver_pending_hash_key,
+					 apiserver_pending_hash_cmp);
+      apiserv->batch = batch;
+    }
+
+  batch->flush_interval = ntohs (bmsg->flush_interval);
+  if (batch->flush_interval == 0)
+    batch->flush_interval = OSPF_APISERVER_BATCH_INTERVAL;
+  batch->max_pending = ntohs (bmsg->max_pending);
+  if (batch->max_pending == 0)
+    batch->max_pending = OSPF_APISERVER_BATCH_MAX_PENDING;
+
+  memcpy (batch->opaque_types, bmsg->opaque_types,
+	  sizeof (batch->opaque_types));
+  batch->opaque_filter = 0;
+  for (i = 0; i < sizeof (batch->opaque_types); i++)
+    if (batch->opaque_types[i])
+      batch->opaque_filter = 1;
+
+  /* Send a reply back to client with return code */
+  return ospf_apiserver_send_reply (apiserv, seqnum, OSPF_API_OK);
+}
+
+
 /* -----------------------------------------------------------
  * Followings are functions for LSDB synchronization.
  * -----------------------------------------------------------
@@ -1277,6 +1591,7 @@ apiserver_sync_callback (struct ospf_lsa *lsa, void *p_arg, int int_arg)
   {
     struct ospf_apiserver *apiserv;
     struct lsa_filter_type *filter;
+    struct stream *frame;
   }
    *param;
   int rc = -1;
@@ -1289,6 +1604,11 @@ apiserver_sync_callback (struct ospf_lsa *lsa, void *p_arg, int int_arg)
   apiserv = param->apiserv;
   seqnum = (u_int32_t) int_arg;
 
+  /* Opaque types a batched client is not interested in. */
+  if (apiserv->batch && ! apiserver_batch_opaque_match (apiserv->batch,
+							 lsa->data))
+    return 0;
+
   /* Check origin in filter. */
   if ((param->filter->origin == ANY_ORIGIN) ||
       (param->filter->origin == (lsa->flags & OSPF_LSA_SELF)))
@@ -1324,7 +1644,10 @@ apiserver_sync_callback (struct ospf_lsa *lsa, void *p_arg, int int_arg)
 	}
 
       /* Send LSA */
-      ospf_apiserver_send_msg (apiserv, msg);
+      if (param->frame)
+	apiserver_frame_put (apiserv, param->frame, msg, seqnum);
+      else
+	ospf_apiserver_send_msg (apiserv, msg);
       msg_free (msg);
     }
   rc = 0;
@@ -1345,6 +1668,7 @@ ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
   {
     struct ospf_apiserver *apiserv;
     struct lsa_filter_type *filter;
+    struct stream *frame;
   } param;
   u_int16_t mask;
   struct route_node *rn;
@@ -1362,6 +1686,21 @@ ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
   /* Set parameter struct. */
   param.apiserv = apiserv;
   param.filter = &smsg->filter;
+  param.frame = NULL;
+
+  /* Batched clients get the LSDB in batch frames, after the changes
+     still held back.  Asking for the LSDB ends a resync. */
+  if (apiserv->batch)
+    {
+      if (apiserv->batch->resync)
+	{
+	  apiserv->batch->resync = 0;
+	  apiserv->batch->dropped = 0;
+	}
+      else
+	apiserver_batch_flush_pending (apiserv);
+      param.frame = stream_new (OSPF_API_MAX_FRAME_SIZE);
+    }
 
   /* Remember mask. */
   mask = ntohs (smsg->filter.typemask);
@@ -1434,6 +1773,12 @@ ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
 	  apiserver_sync_callback(lsa, (void *) &param, seqnum);
     }
 
+  if (param.frame)
+    {
+      apiserver_frame_send (apiserv, param.frame, seqnum);
+      stream_free (param.frame);
+    }
+
   /* Send a reply back to client with return code */
   rc = ospf_apiserver_send_reply (apiserv, seqnum, rc);
   return rc;
@@ -2566,7 +2911,10 @@ apiserver_clients_lsa_change_notify (u_char msgtype, struct ospf_lsa *lsa)
 	      if ((filter->origin == ANY_ORIGIN) ||
 		  (filter->origin == IS_LSA_SELF (lsa)))
 		{
-		  ospf_apiserver_send_msg (apiserv, msg);
+		  if (apiserv->batch)
+		    apiserver_batch_add (apiserv, msg);
+		  else
+		    ospf_apiserver_send_msg (apiserv, msg);
 		}
 	    }
 	}
@@ -2585,13 +2933,6 @@ apiserver_clients_lsa_change_notify (u_char msgtype, struct ospf_lsa *lsa)
 static int
 apiserver_notify_clients_lsa (u_char msgtype, struct ospf_lsa *lsa)
 {
-  struct msg *msg;
-  /* default area for AS-External and Opaque11 LSAs */
-  struct in_addr area_id = { .s_addr = 0L };
-
-  /* default interface for non Opaque9 LSAs */
-  struct in_addr ifaddr = { .s_addr = 0L };
-
   /* Only notify this update if the LSA's age is smaller than
      MAXAGE. Otherwise clients would see LSA updates with max age just
      before they are deleted from the LSDB. LSA delete messages have
@@ -2600,28 +2941,9 @@ apiserver_notify_clients_lsa (u_char msgtype, struct ospf_lsa *lsa)
     return 0;
   }
 
-  if (lsa->area)
-    {
-      area_id = lsa->area->area_id;
-    }
-  if (lsa->data->type == OSPF_OPAQUE_LINK_LSA)
-    {
-      ifaddr = lsa->oi->address->u.prefix4;
-    }
-  msg = new_msg_lsa_change_notify (msgtype, 0L,	/* no sequence number */
-				   ifaddr, area_id,
-				   lsa->flags & OSPF_LSA_SELF, lsa->data);
-  if (!msg)
-    {
-      zlog_warn ("notify_clients_lsa: msg_new failed");
-      return -1;
-    }
   /* Notify all clients that new LSA is added/updated */
   apiserver_clients_lsa_change_notify (msgtype, lsa);
 
-  /* Clients made their own copies of msg so we can free msg here */
-  msg_free (msg);
-
   return 0;
 }
 
@@ -26,6 +26,15 @@
 /* MTYPE definition is not reflected to "memory.h". */
 #define MTYPE_OSPF_APISERVER MTYPE_TMP
 #define MTYPE_OSPF_APISERVER_MSGFILTER MTYPE_TMP
+#define MTYPE_OSPF_APISERVER_BATCH MTYPE_TMP
+
+/* Defaults for batched LSA change notifications. */
+#define OSPF_APISERVER_BATCH_INTERVAL     100	/* msec */
+#define OSPF_APISERVER_BATCH_MAX_PENDING  10000	/* LSAs */
+
+/* Frames that may wait in the async fifo before notifications are held
+   back and coalesced instead of being written out. */
+#define OSPF_APISERVER_BATCH_MAX_BACKLOG  64
 
 /* List of opaque types that application registered */
 struct registered_opaque_type
@@ -35,6 +44,26 @@ struct registered_opaque_type
 };
 
 
+/* Batched LSA change notifications of a client. */
+struct ospf_apiserver_batch
+{
+  unsigned int flush_interval;	/* msec */
+  unsigned int max_pending;
+  u_char opaque_types[32];	/* bitmap, all zero for any */
+  int opaque_filter;		/* a bit in opaque_types is set */
+
+  /* Notifications not sent yet, at most one per LSA: in arrival
+     order, and hashed on the LSA identity to coalesce updates. */
+  struct list *pending;
+  struct hash *pending_hash;
+
+  /* Notifications were dropped, waiting for the client to sync. */
+  int resync;
+  u_int32_t dropped;
+
+  struct thread *t_flush;
+};
+
 /* Server instance for each accepted client connection. */
 struct ospf_apiserver
 {
@@ -58,6 +87,9 @@ struct ospf_apiserver
   /* filter for LSA update/delete notifies */
   struct lsa_filter_type *filter;
 
+  /* Batched notifications, NULL unless MSG_REGISTER_BATCH was received */
+  struct ospf_apiserver_batch *batch;
+
   /* Fifo buffers for outgoing messages */
   struct msg_fifo *out_sync_fifo;
   struct msg_fifo *out_async_fifo;
@@ -144,6 +176,8 @@ extern int ospf_apiserver_handle_delete_request (struct ospf_apiserver *apiserv,
 					  struct msg *msg);
 extern int ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
 				     struct msg *msg);
+extern int ospf_apiserver_handle_register_batch (struct ospf_apiserver *apiserv,
+					  struct msg *msg);
 
 
 /* -----------------------------------------------------------
@@ -32,6 +32,7 @@
 #include "stream.h"
 #include "log.h"
 #include "sockopt.h"
+#include "network.h"
 #include "checksum.h"
 #include "md5.h"
 
@@ -628,95 +629,129 @@ ospf_write_frags (int fd, struct ospf_packet *op, struct ip *iph,
 }
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-static int
-ospf_write (struct thread *thread)
+/* Packets handed to the kernel per ospf_write() wakeup.  Interfaces on
+ * oi_write_q are served one packet at a time in round robin order until
+ * either the batch is full or every queue is empty.
+ */
+#define OSPF_WRITE_BATCH 32
+
+/* Multicast packets of a batch may leave through different interfaces.
+ * Where sendmmsg() is available the outgoing interface is pinned per
+ * message with IP_PKTINFO, so one call can carry the whole batch;
+ * elsewhere each packet is sent on its own after IP_MULTICAST_IF.
+ */
+#if defined (HAVE_SENDMMSG) && defined (IP_PKTINFO)
+#define OSPF_WRITE_MMSG
+#endif
+
+struct ospf_write_slot
 {
-  struct ospf *ospf = THREAD_ARG (thread);
   struct ospf_interface *oi;
   struct ospf_packet *op;
+  u_char type;
+  int flags;
+  int error;
   struct sockaddr_in sa_dst;
   struct ip iph;
-  struct msghdr msg;
   struct iovec iov[2];
-  u_char type;
-  int ret;
-  int flags = 0;
-  struct listnode *node;
-#ifdef WANT_OSPF_WRITE_FRAGMENT
-  static u_int16_t ipid = 0;
-  u_int16_t maxdatasize;
-#endif /* WANT_OSPF_WRITE_FRAGMENT */
-#define OSPF_WRITE_IPHL_SHIFT 2
-  
-  ospf->t_write = NULL;
+  struct msghdr msg;
+#ifdef OSPF_WRITE_MMSG
+  char cmsg[CMSG_SPACE (sizeof (struct in_pktinfo))];
+#endif /* OSPF_WRITE_MMSG */
+};
 
-  node = listhead (ospf->oi_write_q);
-  assert (node);
-  oi = listgetdata (node);
-  assert (oi);
+static int
+ospf_write_is_multicast (struct ospf_packet *op)
+{
+  return (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
+	  || op->dst.s_addr == htonl (OSPF_ALLDROUTERS));
+}
 
+/* Update the output counter of the interface for a packet sent. */
+static void
+ospf_write_count (struct ospf_interface *oi, u_char type)
+{
+  switch (type)
+    {
+    case OSPF_MSG_HELLO:
+      oi->hello_out++;
+      break;
+    case OSPF_MSG_DB_DESC:
+      oi->db_desc_out++;
+      break;
+    case OSPF_MSG_LS_REQ:
+      oi->ls_req_out++;
+      break;
+    case OSPF_MSG_LS_UPD:
+      oi->ls_upd_out++;
+      break;
+    case OSPF_MSG_LS_ACK:
+      oi->ls_ack_out++;
+      break;
+    }
+}
+
+/* Fill in the IP header and message of a slot for a packet already
+ * taken off the interface's output fifo. */
+static void
+ospf_write_prepare (struct ospf_write_slot *slot)
+{
+  struct ospf_interface *oi = slot->oi;
+  struct ospf_packet *op = slot->op;
+  struct ip *iph = &slot->iph;
 #ifdef WANT_OSPF_WRITE_FRAGMENT
+  static u_int16_t ipid = 0;
+
   /* seed ipid static with low order bits of time */
   if (ipid == 0)
     ipid = (time(NULL) & 0xffff);
-
-  /* convenience - max OSPF data per packet,
-   * and reliability - not more data, than our
-   * socket can accept
-   */
-  maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
-    sizeof (struct ip);
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
-  
-  /* Get one packet from queue. */
-  op = ospf_fifo_head (oi->obuf);
-  assert (op);
+#define OSPF_WRITE_IPHL_SHIFT 2
+
   assert (op->length >= OSPF_HEADER_SIZE);
 
-  if (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
-      || op->dst.s_addr == htonl (OSPF_ALLDROUTERS))
-      ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
-    
   /* Rewrite the md5 signature & update the seq */
   ospf_make_md5_digest (oi, op);
 
   /* Retrieve OSPF packet type. */
   stream_set_getp (op->s, 1);
-  type = stream_getc (op->s);
+  slot->type = stream_getc (op->s);
   
   /* reset get pointer */
   stream_set_getp (op->s, 0);
 
-  memset (&iph, 0, sizeof (struct ip));
-  memset (&sa_dst, 0, sizeof (sa_dst));
+  memset (iph, 0, sizeof (struct ip));
+  memset (&slot->sa_dst, 0, sizeof (slot->sa_dst));
   
-  sa_dst.sin_family = AF_INET;
+  slot->sa_dst.sin_family = AF_INET;
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
-  sa_dst.sin_len = sizeof(sa_dst);
+  slot->sa_dst.sin_len = sizeof(slot->sa_dst);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-  sa_dst.sin_addr = op->dst;
-  sa_dst.sin_port = htons (0);
+  slot->sa_dst.sin_addr = op->dst;
+  slot->sa_dst.sin_port = htons (0);
 
   /* Set DONTROUTE flag if dst is unicast. */
+  slot->flags = 0;
+  slot->error = 0;
   if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
     if (!IN_MULTICAST (htonl (op->dst.s_addr)))
-      flags = MSG_DONTROUTE;
+      slot->flags = MSG_DONTROUTE;
 
-  iph.ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
+  iph->ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
   /* it'd be very strange for header to not be 4byte-word aligned but.. */
   if ( sizeof (struct ip) 
-        > (unsigned int)(iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) )
-    iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
+        > (unsigned int)(iph->ip_hl << OSPF_WRITE_IPHL_SHIFT) )
+    iph->ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
   
-  iph.ip_v = IPVERSION;
-  iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
-  iph.ip_len = (iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
+  iph->ip_v = IPVERSION;
+  iph->ip_tos = IPTOS_PREC_INTERNETCONTROL;
+  iph->ip_len = (iph->ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
 
 #if defined(__DragonFly__)
   /*
    * DragonFly's raw socket expects ip_len/ip_off in network byte order.
    */
-  iph.ip_len = htons(iph.ip_len);
+  iph->ip_len = htons(iph->ip_len);
 #endif
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
@@ -724,79 +759,241 @@ ospf_write (struct thread *thread)
    * XXX: this presumes this is only programme sending OSPF packets 
    * otherwise, no guarantee ipid will be unique
    */
-  iph.ip_id = ++ipid;
+  iph->ip_id = ++ipid;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  iph.ip_off = 0;
+  iph->ip_off = 0;
   if (oi->type == OSPF_IFTYPE_VIRTUALLINK)
-    iph.ip_ttl = OSPF_VL_IP_TTL;
+    iph->ip_ttl = OSPF_VL_IP_TTL;
   else
-    iph.ip_ttl = OSPF_IP_TTL;
-  iph.ip_p = IPPROTO_OSPFIGP;
-  iph.ip_sum = 0;
-  iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
-  iph.ip_dst.s_addr = op->dst.s_addr;
-
-  memset (&msg, 0, sizeof (msg));
-  msg.msg_name = (caddr_t) &sa_dst;
-  msg.msg_namelen = sizeof (sa_dst); 
-  msg.msg_iov = iov;
-  msg.msg_iovlen = 2;
-  iov[0].iov_base = (char*)&iph;
-  iov[0].iov_len = iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
-  iov[1].iov_base = STREAM_PNT (op->s);
-  iov[1].iov_len = op->length;
-  
-  /* Sadly we can not rely on kernels to fragment packets because of either
-   * IP_HDRINCL and/or multicast destination being set.
-   */
+    iph->ip_ttl = OSPF_IP_TTL;
+  iph->ip_p = IPPROTO_OSPFIGP;
+  iph->ip_sum = 0;
+  iph->ip_src.s_addr = oi->address->u.prefix4.s_addr;
+  iph->ip_dst.s_addr = op->dst.s_addr;
+
+  memset (&slot->msg, 0, sizeof (slot->msg));
+  slot->msg.msg_name = (caddr_t) &slot->sa_dst;
+  slot->msg.msg_namelen = sizeof (slot->sa_dst); 
+  slot->msg.msg_iov = slot->iov;
+  slot->msg.msg_iovlen = 2;
+  slot->iov[0].iov_base = (char*)iph;
+  slot->iov[0].iov_len = iph->ip_hl << OSPF_WRITE_IPHL_SHIFT;
+  slot->iov[1].iov_base = STREAM_PNT (op->s);
+  slot->iov[1].iov_len = op->length;
+
+#ifdef OSPF_WRITE_MMSG
+  if (ospf_write_is_multicast (op))
+    {
+      struct cmsghdr *cmsg;
+      struct in_pktinfo *pktinfo;
+
+      memset (slot->cmsg, 0, sizeof (slot->cmsg));
+      slot->msg.msg_control = slot->cmsg;
+      slot->msg.msg_controllen = sizeof (slot->cmsg);
+      cmsg = CMSG_FIRSTHDR (&slot->msg);
+      cmsg->cmsg_level = IPPROTO_IP;
+      cmsg->cmsg_type = IP_PKTINFO;
+      cmsg->cmsg_len = CMSG_LEN (sizeof (struct in_pktinfo));
+      pktinfo = (struct in_pktinfo *) CMSG_DATA (cmsg);
+      pktinfo->ipi_ifindex = oi->ifp->ifindex;
+    }
+#endif /* OSPF_WRITE_MMSG */
+}
+
+/* Hand a batch of prepared packets to the kernel.  Per packet errors are
+ * recorded in the slot and reported by the caller. */
+static void
+ospf_write_flush (struct ospf *ospf, struct ospf_write_slot *slots, int count)
+{
+  int i;
+#ifdef OSPF_WRITE_MMSG
+  struct mmsghdr mmsg[OSPF_WRITE_BATCH];
+  int run, ret;
+  int multicast_set = 0;
+
+  for (i = 0; i < count; i++)
+    {
+      /* Loop and TTL are socket wide; the interface is in IP_PKTINFO. */
+      if (!multicast_set && ospf_write_is_multicast (slots[i].op))
+	{
+	  ospf_if_ipmulticast (ospf, slots[i].oi->address,
+			       slots[i].oi->ifp->ifindex);
+	  multicast_set = 1;
+	}
+      sockopt_iphdrincl_swab_htosys (&slots[i].iph);
+      mmsg[i].msg_hdr = slots[i].msg;
+      mmsg[i].msg_len = 0;
+    }
+
+  /* MSG_DONTROUTE applies to a whole call, so send runs of equal flags. */
+  for (i = 0; i < count; i += run)
+    {
+      for (run = 1; i + run < count; run++)
+	if (slots[i + run].flags != slots[i].flags)
+	  break;
+
+      ret = sendmmsg (ospf->fd, &mmsg[i], run, slots[i].flags);
+      if (ret < 0)
+	{
+	  /* The first message of the run failed; carry on after it. */
+	  slots[i].error = errno;
+	  run = 1;
+	}
+      else if (ret > 0)
+	run = ret;
+      else
+	{
+	  slots[i].error = EAGAIN;
+	  run = 1;
+	}
+    }
+
+  for (i = 0; i < count; i++)
+    sockopt_iphdrincl_swab_systoh (&slots[i].iph);
+#else
+  int ret;
+
+  for (i = 0; i < count; i++)
+    {
+      if (ospf_write_is_multicast (slots[i].op))
+	ospf_if_ipmulticast (ospf, slots[i].oi->address,
+			     slots[i].oi->ifp->ifindex);
+
+      sockopt_iphdrincl_swab_htosys (&slots[i].iph);
+      ret = sendmsg (ospf->fd, &slots[i].msg, slots[i].flags);
+      sockopt_iphdrincl_swab_systoh (&slots[i].iph);
+      if (ret < 0)
+	slots[i].error = errno;
+    }
+#endif /* OSPF_WRITE_MMSG */
+}
+
+/* Report the outcome of a flushed batch and release its packets. */
+static void
+ospf_write_complete (struct ospf_write_slot *slots, int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      struct ospf_write_slot *slot = &slots[i];
+      struct ospf_interface *oi = slot->oi;
+      struct ospf_packet *op = slot->op;
+
+      if (slot->error)
+	zlog_warn ("*** sendmsg in ospf_write failed to %s, "
+		   "id %d, off %d, len %d, interface %s, mtu %u: %s",
+		   inet_ntoa (slot->iph.ip_dst), slot->iph.ip_id,
+		   slot->iph.ip_off, slot->iph.ip_len,
+		   oi->ifp->name, oi->ifp->mtu, safe_strerror (slot->error));
+      else
+	ospf_write_count (oi, slot->type);
+
+      /* Show debug sending packet. */
+      if (IS_DEBUG_OSPF_PACKET (slot->type - 1, SEND))
+	{
+	  if (IS_DEBUG_OSPF_PACKET (slot->type - 1, DETAIL))
+	    {
+	      zlog_debug ("-----------------------------------------------------");
+	      ospf_ip_header_dump (&slot->iph);
+	      stream_set_getp (op->s, 0);
+	      ospf_packet_dump (op->s);
+	    }
+
+	  zlog_debug ("%s sent to [%s] via [%s].",
+		     LOOKUP (ospf_packet_type_str, slot->type),
+		     inet_ntoa (op->dst), IF_NAME (oi));
+
+	  if (IS_DEBUG_OSPF_PACKET (slot->type - 1, DETAIL))
+	    zlog_debug ("-----------------------------------------------------");
+	}
+
+      ospf_packet_free (op);
+    }
+}
+
+static int
+ospf_write (struct thread *thread)
+{
+  struct ospf *ospf = THREAD_ARG (thread);
+  struct ospf_interface *oi;
+  struct ospf_write_slot slots[OSPF_WRITE_BATCH];
+  struct ospf_write_slot *slot;
+  struct listnode *node;
+  int count = 0;
 #ifdef WANT_OSPF_WRITE_FRAGMENT
-  if ( op->length > maxdatasize )
-    ospf_write_frags (ospf->fd, op, &iph, &msg, maxdatasize, 
-                      oi->ifp->mtu, flags, type);
+  u_int16_t maxdatasize;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
-
-  /* send final fragment (could be first) */
-  sockopt_iphdrincl_swab_htosys (&iph);
-  ret = sendmsg (ospf->fd, &msg, flags);
-  sockopt_iphdrincl_swab_systoh (&iph);
   
-  if (ret < 0)
-    zlog_warn ("*** sendmsg in ospf_write failed to %s, "
-	       "id %d, off %d, len %d, interface %s, mtu %u: %s",
-	       inet_ntoa (iph.ip_dst), iph.ip_id, iph.ip_off, iph.ip_len,
-	       oi->ifp->name, oi->ifp->mtu, safe_strerror (errno));
+  ospf->t_write = NULL;
 
-  /* Show debug sending packet. */
-  if (IS_DEBUG_OSPF_PACKET (type - 1, SEND))
+  assert (listhead (ospf->oi_write_q));
+
+  while (count < OSPF_WRITE_BATCH
+	 && (node = listhead (ospf->oi_write_q)) != NULL)
     {
-      if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
+      oi = listgetdata (node);
+      assert (oi);
+
+      /* Get one packet from queue. */
+      slot = &slots[count];
+      slot->oi = oi;
+      slot->op = ospf_fifo_pop (oi->obuf);
+      assert (slot->op);
+
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+      /* convenience - max OSPF data per packet,
+       * and reliability - not more data, than our
+       * socket can accept
+       */
+      maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
+	sizeof (struct ip);
+
+      /* The leading fragments go out directly, so anything already
+       * batched must be sent first to keep the packets in order. */
+      if (slot->op->length > maxdatasize && count > 0)
 	{
-	  zlog_debug ("-----------------------------------------------------");
-	  ospf_ip_header_dump (&iph);
-	  stream_set_getp (op->s, 0);
-	  ospf_packet_dump (op->s);
+	  ospf_write_flush (ospf, slots, count);
+	  ospf_write_complete (slots, count);
+	  slots[0].oi = slot->oi;
+	  slots[0].op = slot->op;
+	  slot = &slots[0];
+	  count = 0;
 	}
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-      zlog_debug ("%s sent to [%s] via [%s].",
-		 LOOKUP (ospf_packet_type_str, type), inet_ntoa (op->dst),
-		 IF_NAME (oi));
+      ospf_write_prepare (slot);
 
-      if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
-	zlog_debug ("-----------------------------------------------------");
-    }
+      /* Sadly we can not rely on kernels to fragment packets because of
+       * either IP_HDRINCL and/or multicast destination being set.
+       */
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+      if (slot->op->length > maxdatasize)
+	{
+	  if (ospf_write_is_multicast (slot->op))
+	    ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
+	  ospf_write_frags (ospf->fd, slot->op, &slot->iph, &slot->msg,
+			    maxdatasize, oi->ifp->mtu, slot->flags,
+			    slot->type);
+	}
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  /* Now delete packet from queue. */
-  ospf_packet_delete (oi);
+      /* the final fragment (could be first) goes out with the batch */
+      count++;
 
-  /* Move this interface to the tail of write_q to
+      /* Move this interface to the tail of write_q to
 	 serve everyone in a round robin fashion */
-  listnode_move_to_tail (ospf->oi_write_q, node);
-  if (ospf_fifo_head (oi->obuf) == NULL)
-    {
-      oi->on_write_q = 0;
-      list_delete_node (ospf->oi_write_q, node);
+      listnode_move_to_tail (ospf->oi_write_q, node);
+      if (ospf_fifo_head (oi->obuf) == NULL)
+	{
+	  oi->on_write_q = 0;
+	  list_delete_node (ospf->oi_write_q, node);
+	}
     }
+
+  ospf_write_flush (ospf, slots, count);
+  ospf_write_complete (slots, count);
   
   /* If packets still remain in queue, call write thread. */
   if (!list_isempty (ospf->oi_write_q))
@@ -2101,30 +2298,16 @@ ospf_ls_ack (struct ip *iph, struct ospf_header *ospfh,
   return;
 }
 
+/* Check a raw packet received into ibuf and find the interface it
+ * arrived on. */
 static struct stream *
-ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
+ospf_recv_check (struct stream *ibuf, struct msghdr *msgh, int ret,
+		 struct interface **ifp)
 {
-  int ret;
   struct ip *iph;
   u_int16_t ip_len;
   ifindex_t ifindex = 0;
-  struct iovec iov;
-  /* Header and data both require alignment. */
-  char buff [CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
-  struct msghdr msgh;
 
-  memset (&msgh, 0, sizeof (struct msghdr));
-  msgh.msg_iov = &iov;
-  msgh.msg_iovlen = 1;
-  msgh.msg_control = (caddr_t) buff;
-  msgh.msg_controllen = sizeof (buff);
-  
-  ret = stream_recvmsg (ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE+1);
-  if (ret < 0)
-    {
-      zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
-      return NULL;
-    }
   if ((unsigned int)ret < sizeof(iph)) /* ret must be > 0 now */
     {
       zlog_warn("ospf_recv_packet: discarding runt packet of length %d "
@@ -2167,7 +2350,7 @@ ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
   ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
 #endif
 
-  ifindex = getsockopt_ifindex (AF_INET, &msgh);
+  ifindex = getsockopt_ifindex (AF_INET, msgh);
   
   *ifp = if_lookup_by_index (ifindex);
 
@@ -2181,6 +2364,33 @@ ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
   return ibuf;
 }
 
+#ifndef HAVE_RECVMMSG
+static struct stream *
+ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
+{
+  int ret;
+  struct iovec iov;
+  /* Header and data both require alignment. */
+  char buff [CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+  struct msghdr msgh;
+
+  memset (&msgh, 0, sizeof (struct msghdr));
+  msgh.msg_iov = &iov;
+  msgh.msg_iovlen = 1;
+  msgh.msg_control = (caddr_t) buff;
+  msgh.msg_controllen = sizeof (buff);
+  
+  ret = stream_recvmsg (ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE+1);
+  if (ret < 0)
+    {
+      zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
+      return NULL;
+    }
+
+  return ospf_recv_check (ibuf, &msgh, ret, ifp);
+}
+#endif /* HAVE_RECVMMSG */
+
 static struct ospf_interface *
 ospf_associate_packet_vl (struct ospf *ospf, struct interface *ifp, 
 			  struct ip *iph, struct ospf_header *ospfh)
@@ -2704,28 +2914,17 @@ ospf_verify_header (struct stream *ibuf, struct ospf_interface *oi,
   return 0;
 }
 
-/* Starting point of packet process function. */
-int
-ospf_read (struct thread *thread)
+/* Process one packet received into ibuf. */
+static int
+ospf_read_packet (struct ospf *ospf, struct stream *ibuf,
+		  struct interface *ifp)
 {
   int ret;
-  struct stream *ibuf;
-  struct ospf *ospf;
   struct ospf_interface *oi;
   struct ip *iph;
   struct ospf_header *ospfh;
   u_int16_t length;
-  struct interface *ifp;
 
-  /* first of all get interface pointer. */
-  ospf = THREAD_ARG (thread);
-
-  /* prepare for next packet. */
-  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
-
-  stream_reset(ospf->ibuf);
-  if (!(ibuf = ospf_recv_packet (ospf->fd, &ifp, ospf->ibuf)))
-    return -1;
   /* This raw packet is known to be at least as big as its IP header. */
   
   /* Note that there should not be alignment problems with this assignment
@@ -2927,6 +3126,88 @@ ospf_read (struct thread *thread)
   return 0;
 }
 
+#ifdef HAVE_RECVMMSG
+/* Receive up to OSPF_READ_BURST packets with a single recvmmsg() and
+ * process them in arrival order.  The first buffer is ospf->ibuf, the
+ * others are allocated on first use.
+ */
+static void
+ospf_recv_burst (struct ospf *ospf)
+{
+  struct mmsghdr mmsg[OSPF_READ_BURST];
+  struct iovec iov[OSPF_READ_BURST];
+  struct stream *ibuf[OSPF_READ_BURST];
+  /* Header and data both require alignment. */
+  char buff[OSPF_READ_BURST][CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+  struct interface *ifp;
+  int i, ret;
+
+  memset (mmsg, 0, sizeof (mmsg));
+  for (i = 0; i < OSPF_READ_BURST; i++)
+    {
+      if (i == 0)
+	ibuf[i] = ospf->ibuf;
+      else
+	{
+	  if (ospf->ibuf_burst[i - 1] == NULL)
+	    ospf->ibuf_burst[i - 1] = stream_new (OSPF_MAX_PACKET_SIZE+1);
+	  ibuf[i] = ospf->ibuf_burst[i - 1];
+	}
+      stream_reset (ibuf[i]);
+
+      iov[i].iov_base = STREAM_DATA (ibuf[i]);
+      iov[i].iov_len = OSPF_MAX_PACKET_SIZE+1;
+      mmsg[i].msg_hdr.msg_iov = &iov[i];
+      mmsg[i].msg_hdr.msg_iovlen = 1;
+      mmsg[i].msg_hdr.msg_control = (caddr_t) buff[i];
+      mmsg[i].msg_hdr.msg_controllen = sizeof (buff[i]);
+    }
+
+  ret = recvmmsg (ospf->fd, mmsg, OSPF_READ_BURST, MSG_DONTWAIT, NULL);
+  if (ret < 0)
+    {
+      if (!ERRNO_IO_RETRY (errno))
+	zlog_warn ("recvmmsg failed: %s", safe_strerror (errno));
+      return;
+    }
+
+  for (i = 0; i < ret; i++)
+    {
+      stream_forward_endp (ibuf[i], mmsg[i].msg_len);
+      if (ospf_recv_check (ibuf[i], &mmsg[i].msg_hdr, mmsg[i].msg_len, &ifp))
+	ospf_read_packet (ospf, ibuf[i], ifp);
+    }
+}
+#endif /* HAVE_RECVMMSG */
+
+/* Starting point of packet process function. */
+int
+ospf_read (struct thread *thread)
+{
+  struct ospf *ospf;
+#ifndef HAVE_RECVMMSG
+  struct stream *ibuf;
+  struct interface *ifp;
+#endif /* HAVE_RECVMMSG */
+
+  /* first of all get interface pointer. */
+  ospf = THREAD_ARG (thread);
+
+  /* prepare for next packet. */
+  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
+
+#ifdef HAVE_RECVMMSG
+  ospf_recv_burst (ospf);
+  return 0;
+#else
+  stream_reset(ospf->ibuf);
+  if (!(ibuf = ospf_recv_packet (ospf->fd, &ifp, ospf->ibuf)))
+    return -1;
+
+  return ospf_read_packet (ospf, ibuf, ifp);
+#endif /* HAVE_RECVMMSG */
+}
+
 /* Make OSPF header. */
 static void
 ospf_make_header (int type, struct ospf_interface *oi, struct stream *s)
@@ -507,6 +507,11 @@ ospf_finish_final (struct ospf *ospf)
 
   close (ospf->fd);
   stream_free(ospf->ibuf);
+#ifdef HAVE_RECVMMSG
+  for (i = 0; i < OSPF_READ_BURST - 1; i++)
+    if (ospf->ibuf_burst[i])
+      stream_free (ospf->ibuf_burst[i]);
+#endif /* HAVE_RECVMMSG */
    
   LSDB_LOOP (OPAQUE_AS_LSDB (ospf), rn, lsa)
     ospf_discard_from_db (ospf, ospf->lsdb, lsa);
@@ -38,6 +38,9 @@
 #define OSPF_IP_TTL             1
 #define OSPF_VL_IP_TTL          100
 
+/* Packets taken from the socket per read wakeup where recvmmsg() exists. */
+#define OSPF_READ_BURST         16
+
 /* Default configuration file name for ospfd. */
 #define OSPF_DEFAULT_CONFIG   "ospfd.conf"
 
@@ -218,6 +221,10 @@ struct ospf
   int fd;
   unsigned int maxsndbuflen;
   struct stream *ibuf;
+#ifdef HAVE_RECVMMSG
+  /* Further receive buffers for recvmmsg() bursts, allocated on demand. */
+  struct stream *ibuf_burst[OSPF_READ_BURST - 1];
+#endif /* HAVE_RECVMMSG */
   struct list *oi_write_q;
   
   /* Distribute lists out of other route sources. */
@@ -492,7 +492,7 @@ rip_interface_delete (int command, struct zclient *zclient,
   
   /* To support pseudo interface do not free interface structure.  */
   /* if_delete(ifp); */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -517,6 +517,8 @@ rip_interface_clean (void)
 	  thread_cancel (ri->t_wakeup);
 	  ri->t_wakeup = NULL;
 	}
+
+      rip_output_cache_free (ri);
     }
 }
 
@@ -554,6 +556,8 @@ rip_interface_reset (void)
       ri->split_horizon = RIP_NO_SPLIT_HORIZON;
       ri->split_horizon_default = RIP_NO_SPLIT_HORIZON;
 
+      rip_output_cache_free (ri);
+
       ri->list[RIP_FILTER_IN] = NULL;
       ri->list[RIP_FILTER_OUT] = NULL;
 
@@ -669,6 +673,7 @@ rip_interface_address_add (int command, struct zclient *zclient,
       rip_enable_apply(ifc->ifp);
       /* Check if this prefix needs to be redistributed */
       rip_apply_address_add(ifc);
+      rip_output_invalidate ();
 
 #ifdef HAVE_SNMP
       rip_ifaddr_add (ifc->ifp, ifc);
@@ -729,6 +734,10 @@ rip_interface_address_delete (int command, struct zclient *zclient,
 
 	}
 
+      /* The cached updates refer to the connected addresses. */
+      rip_output_cache_free (ifc->ifp->info);
+      rip_output_invalidate ();
+
       connected_free (ifc);
 
     }
@@ -1555,6 +1564,7 @@ DEFUN (ip_rip_authentication_mode,
   if (argc == 1)
     {
       ri->auth_type = auth_type;
+      rip_output_invalidate ();
       return CMD_SUCCESS;
     }
 
@@ -1573,6 +1583,7 @@ DEFUN (ip_rip_authentication_mode,
     
   ri->auth_type = auth_type;
   
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1607,6 +1618,7 @@ DEFUN (no_ip_rip_authentication_mode,
   ri->auth_type = RIP_NO_AUTH;
   ri->md5_auth_len = RIP_AUTH_MD5_COMPAT_SIZE;
 
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1668,6 +1680,7 @@ DEFUN (ip_rip_authentication_string,
 
   ri->auth_str = strdup (argv[0]);
 
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1691,6 +1704,7 @@ DEFUN (no_ip_rip_authentication_string,
 
   ri->auth_str = NULL;
 
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1731,6 +1745,7 @@ DEFUN (ip_rip_authentication_key_chain,
 
   ri->key_chain = strdup (argv[0]);
 
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1754,6 +1769,7 @@ DEFUN (no_ip_rip_authentication_key_chain,
 
   ri->key_chain = NULL;
 
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1785,6 +1801,7 @@ DEFUN (ip_rip_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIP_SPLIT_HORIZON;
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1803,6 +1820,7 @@ DEFUN (ip_rip_split_horizon_poisoned_reverse,
   ri = ifp->info;
 
   ri->split_horizon = RIP_SPLIT_HORIZON_POISONED_REVERSE;
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1825,6 +1843,7 @@ DEFUN (no_ip_rip_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIP_NO_SPLIT_HORIZON;
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1851,6 +1870,7 @@ DEFUN (no_ip_rip_split_horizon_poisoned_reverse,
 		break;
   }
 
+  rip_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -2048,6 +2068,7 @@ rip_interface_new_hook (struct interface *ifp)
 static int
 rip_interface_delete_hook (struct interface *ifp)
 {
+  rip_output_cache_free (ifp->info);
   XFREE (MTYPE_RIP_INTERFACE, ifp->info);
   ifp->info = NULL;
   return 0;
@@ -198,6 +198,7 @@ rip_routemap_set (int type, const char *name)
 
   rip->route_map[type].name = strdup (name);
   rip->route_map[type].map = route_map_lookup_by_name (name);
+  rip_output_invalidate ();
 }
 
 static void
@@ -205,6 +206,7 @@ rip_redistribute_metric_set (int type, unsigned int metric)
 {
   rip->route_map[type].metric_config = 1;
   rip->route_map[type].metric = metric;
+  rip_output_invalidate ();
 }
 
 static int
@@ -216,6 +218,7 @@ rip_metric_unset (int type, unsigned int metric)
     return 1;
   rip->route_map[type].metric_config = 0;
   rip->route_map[type].metric = 0;
+  rip_output_invalidate ();
   return 0;
 }
 
@@ -230,6 +233,7 @@ rip_routemap_unset (int type, const char *name)
   free (rip->route_map[type].name);
   rip->route_map[type].name = NULL;
   rip->route_map[type].map = NULL;
+  rip_output_invalidate ();
 
   return 0;
 }
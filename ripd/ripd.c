@@ -62,6 +62,9 @@ long rip_global_route_changes = 0;
 /* RIP queries. */
 long rip_global_queries = 0;
 
+/* Generation of the routes and output policy, see rip_output_invalidate. */
+static unsigned long rip_output_gen = 1;
+
 /* Prototypes. */
 static void rip_event (enum rip_event, int);
 static void rip_output_process (struct connected *, struct sockaddr_in *, int, u_char);
@@ -149,9 +152,35 @@ rip_garbage_collect (struct thread *t)
   /* Free RIP routing information. */
   rip_info_free (rinfo);
 
+  rip_output_invalidate ();
+
   return 0;
 }
 
+/* Set the route change flag on the first entry of RP and record the
+   route in the change journal, so that the next triggered update only
+   has to look at the routes which actually changed. */
+static void
+rip_route_changed (struct route_node *rp)
+{
+  struct rip_info *rinfo;
+  struct route_node *jn;
+
+  rinfo = listgetdata (listhead ((struct list *) rp->info));
+  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+
+  jn = route_node_get (rip->changed, &rp->p);
+  if (jn->info == NULL)
+    {
+      route_lock_node (rp);
+      jn->info = rp;
+    }
+  else
+    route_unlock_node (jn);
+
+  rip_output_invalidate ();
+}
+
 static void rip_timeout_update (struct rip_info *rinfo);
 
 /* Add new route to the ECMP list.
@@ -185,8 +214,8 @@ rip_ecmp_add (struct rip_info *rinfo_new)
     }
 
   /* Set the route change flag on the first entry. */
+  rip_route_changed (rp);
   rinfo = listgetdata (listhead (list));
-  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
 
   /* Signal the output process to trigger an update (see section 2.5). */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -238,7 +267,7 @@ rip_ecmp_replace (struct rip_info *rinfo_new)
     }
 
   /* Set the route change flag. */
-  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+  rip_route_changed (rp);
 
   /* Signal the output process to trigger an update (see section 2.5). */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -287,8 +316,8 @@ rip_ecmp_delete (struct rip_info *rinfo)
     }
 
   /* Set the route change flag on the first entry. */
+  rip_route_changed (rp);
   rinfo = listgetdata (listhead (list));
-  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
 
   /* Signal the output process to trigger an update (see section 2.5). */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -739,8 +768,7 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
                     rip_zebra_ipv4_add (rp);
 
                   /* - Set the route change flag on the first entry. */
-                  rinfo = listgetdata (listhead (list));
-                  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+                  rip_route_changed (rp);
                   rip_event (RIP_TRIGGERED_UPDATE, 0);
                 }
             }
@@ -1679,7 +1707,7 @@ rip_redistribute_delete (int type, int sub_type, struct prefix_ipv4 *p,
               RIP_TIMER_ON (rinfo->t_garbage_collect,
                             rip_garbage_collect, rip->garbage_time);
               RIP_TIMER_OFF (rinfo->t_timeout);
-              rinfo->flags |= RIP_RTF_CHANGED;
+              rip_route_changed (rp);
 
               if (IS_RIP_DEBUG_EVENT)
                 zlog_debug ("Poisone %s/%d on the interface %s with an "
@@ -2176,6 +2204,95 @@ rip_write_rte (int num, struct stream *s, struct prefix_ipv4 *p,
   return ++num;
 }
 
+/* Note that the routes or the output policy changed: the packets cached
+   for full updates have to be built again. */
+void
+rip_output_invalidate (void)
+{
+  rip_output_gen++;
+}
+
+static void
+rip_output_cache_del (void *cache)
+{
+  struct rip_output_cache *c = cache;
+
+  list_delete (c->packets);
+  XFREE (MTYPE_RIP_OUTPUT_CACHE, c);
+}
+
+static void
+rip_output_packet_del (void *s)
+{
+  stream_free (s);
+}
+
+/* Drop the cached updates of an interface. */
+void
+rip_output_cache_free (struct rip_interface *ri)
+{
+  if (ri->output_cache)
+    {
+      list_delete (ri->output_cache);
+      ri->output_cache = NULL;
+    }
+}
+
+/* Find or create the cached update for the connected address IFC. */
+static struct rip_output_cache *
+rip_output_cache_get (struct rip_interface *ri, struct connected *ifc,
+                      u_char version)
+{
+  struct listnode *node;
+  struct rip_output_cache *c;
+
+  if (ri->output_cache == NULL)
+    {
+      ri->output_cache = list_new ();
+      ri->output_cache->del = rip_output_cache_del;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (ri->output_cache, node, c))
+    if (c->ifc == ifc && c->version == version)
+      return c;
+
+  c = XCALLOC (MTYPE_RIP_OUTPUT_CACHE, sizeof (struct rip_output_cache));
+  c->ifc = ifc;
+  c->version = version;
+  c->packets = list_new ();
+  c->packets->del = rip_output_packet_del;
+  listnode_add (ri->output_cache, c);
+
+  return c;
+}
+
+/* The routes to look at for an update: the whole table, or only the
+   change journal for a triggered update. */
+static struct route_node *
+rip_output_route_first (int route_type, struct route_node **jn)
+{
+  if (route_type != rip_changed_route)
+    return route_top (rip->table);
+
+  for (*jn = route_top (rip->changed); *jn; *jn = route_next (*jn))
+    if ((*jn)->info)
+      return (*jn)->info;
+  return NULL;
+}
+
+static struct route_node *
+rip_output_route_next (struct route_node *rp, int route_type,
+                       struct route_node **jn)
+{
+  if (route_type != rip_changed_route)
+    return route_next (rp);
+
+  while ((*jn = route_next (*jn)) != NULL)
+    if ((*jn)->info)
+      return (*jn)->info;
+  return NULL;
+}
+
 /* Send update to the ifp or spcified neighbor. */
 void
 rip_output_process (struct connected *ifc, struct sockaddr_in *to, 
@@ -2199,6 +2316,8 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
   int subnetted = 0;
   struct list *list = NULL;
   struct listnode *listnode = NULL;
+  struct route_node *jn = NULL;
+  struct rip_output_cache *cache = NULL;
 
   /* Logging output event. */
   if (IS_RIP_DEBUG_EVENT)
@@ -2230,6 +2349,30 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
   if (ri->auth_type == RIP_AUTH_MD5)
     rtemax -= 2;
 
+  /* A full update is sent from the packets built last time, unless a
+     route or the output policy changed since.  MD5 digests and key chain
+     passwords vary from one packet to the next, so those are not cached. */
+  if (route_type == rip_all_route &&
+      ri->auth_type != RIP_AUTH_MD5 && ! ri->key_chain)
+    {
+      cache = rip_output_cache_get (ri, ifc, version);
+      if (cache->gen == rip_output_gen)
+        {
+          for (ALL_LIST_ELEMENTS_RO (cache->packets, listnode, s))
+            {
+              ret = rip_send_packet (STREAM_DATA (s), stream_get_endp (s),
+                                     to, ifc);
+              if (ret >= 0 && IS_RIP_DEBUG_SEND)
+                rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
+                                 stream_get_endp (s), "SEND");
+            }
+          ri->sent_updates++;
+          return;
+        }
+      list_delete_all_node (cache->packets);
+      cache->gen = rip_output_gen;
+    }
+
   /* If output interface is in simple password authentication mode
      and string or keychain is specified we need space for auth. data */
   if (ri->auth_type != RIP_NO_AUTH)
@@ -2255,7 +2398,8 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
         subnetted = 1;
     }
 
-  for (rp = route_top (rip->table); rp; rp = route_next (rp))
+  for (rp = rip_output_route_first (route_type, &jn); rp;
+       rp = rip_output_route_next (rp, route_type, &jn))
     if ((list = rp->info) != NULL && listcount (list) != 0)
       {
         rinfo = listgetdata (listhead (list));
@@ -2463,6 +2607,8 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
 	    if (ret >= 0 && IS_RIP_DEBUG_SEND)
 	      rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
 			       stream_get_endp(s), "SEND");
+	    if (cache)
+	      listnode_add (cache->packets, stream_dup (s));
 	    num = 0;
 	    stream_reset (s);
 	  }
@@ -2479,6 +2625,8 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
       if (ret >= 0 && IS_RIP_DEBUG_SEND)
 	rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
 			 stream_get_endp (s), "SEND");
+      if (cache)
+	listnode_add (cache->packets, stream_dup (s));
       num = 0;
       stream_reset (s);
     }
@@ -2649,23 +2797,30 @@ rip_update (struct thread *t)
   return 0;
 }
 
-/* Walk down the RIP routing table then clear changed flag. */
+/* Clear the changed flag of the routes in the change journal and empty
+   the journal. */
 static void
 rip_clear_changed_flag (void)
 {
+  struct route_node *jn;
   struct route_node *rp;
   struct rip_info *rinfo = NULL;
   struct list *list = NULL;
   struct listnode *listnode = NULL;
 
-  for (rp = route_top (rip->table); rp; rp = route_next (rp))
-    if ((list = rp->info) != NULL)
-      for (ALL_LIST_ELEMENTS_RO (list, listnode, rinfo))
-        {
-          UNSET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
-          /* This flag can be set only on the first entry. */
-          break;
-        }
+  for (jn = route_top (rip->changed); jn; jn = route_next (jn))
+    if ((rp = jn->info) != NULL)
+      {
+        /* The flag is set on the first entry, which may have been
+           deleted since; look at all of them. */
+        if ((list = rp->info) != NULL)
+          for (ALL_LIST_ELEMENTS_RO (list, listnode, rinfo))
+            UNSET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+
+        jn->info = NULL;
+        route_unlock_node (rp);
+        route_unlock_node (jn);
+      }
 }
 
 /* Triggered update interval timer. */
@@ -2748,7 +2903,7 @@ rip_redistribute_withdraw (int type)
 	    RIP_TIMER_ON (rinfo->t_garbage_collect, 
 			  rip_garbage_collect, rip->garbage_time);
 	    RIP_TIMER_OFF (rinfo->t_timeout);
-	    rinfo->flags |= RIP_RTF_CHANGED;
+	    rip_route_changed (rp);
 
 	    if (IS_RIP_DEBUG_EVENT) {
               struct prefix_ipv4 *p = (struct prefix_ipv4 *) &rp->p;
@@ -2779,6 +2934,7 @@ rip_create (void)
 
   /* Initialize RIP routig table. */
   rip->table = route_table_init ();
+  rip->changed = route_table_init ();
   rip->route = route_table_init ();
   rip->neighbor = route_table_init ();
 
@@ -3074,6 +3230,7 @@ DEFUN (rip_default_metric,
     {
       rip->default_metric = atoi (argv[0]);
       /* rip_update_default_metric (); */
+      rip_output_invalidate ();
     }
   return CMD_SUCCESS;
 }
@@ -3089,6 +3246,7 @@ DEFUN (no_rip_default_metric,
     {
       rip->default_metric = RIP_DEFAULT_METRIC_DEFAULT;
       /* rip_update_default_metric (); */
+      rip_output_invalidate ();
     }
   return CMD_SUCCESS;
 }
@@ -3475,7 +3633,7 @@ rip_ecmp_disable (void)
         rip_zebra_ipv4_add (rp);
 
         /* Set the route change flag. */
-        SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+        rip_route_changed (rp);
 
         /* Signal the output process to trigger an update. */
         rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -3856,6 +4014,8 @@ rip_distribute_update (struct distribute *dist)
   struct access_list *alist;
   struct prefix_list *plist;
 
+  rip_output_invalidate ();
+
   if (! dist->ifname)
     return;
 
@@ -3928,6 +4088,8 @@ rip_distribute_update_all (struct prefix_list *notused)
   struct interface *ifp;
   struct listnode *node, *nnode;
 
+  rip_output_invalidate ();
+
   for (ALL_LIST_ELEMENTS (iflist, node, nnode, ifp))
     rip_distribute_update_interface (ifp);
 }
@@ -4012,6 +4174,11 @@ rip_clean (void)
 	if (rip->route_map[i].name)
 	  free (rip->route_map[i].name);
 
+      /* Empty the change journal, which holds locks on the RIP table,
+         before freeing either. */
+      rip_clear_changed_flag ();
+      route_table_finish (rip->changed);
+
       XFREE (MTYPE_ROUTE_TABLE, rip->table);
       XFREE (MTYPE_ROUTE_TABLE, rip->route);
       XFREE (MTYPE_ROUTE_TABLE, rip->neighbor);
@@ -4060,6 +4227,8 @@ rip_if_rmap_update (struct if_rmap *if_rmap)
   struct rip_interface *ri;
   struct route_map *rmap;
 
+  rip_output_invalidate ();
+
   ifp = if_lookup_by_name (if_rmap->ifname);
   if (ifp == NULL)
     return;
@@ -4126,6 +4295,17 @@ rip_routemap_update (const char *notused)
     rip_if_rmap_update_interface (ifp);
 
   rip_routemap_update_redistribute ();
+  rip_output_invalidate ();
+}
+
+/* An index or a match or set clause of a route-map was added, changed
+   or deleted: the cached full updates may advertise other routes or
+   other metrics and tags now. */
+/* ARGSUSED */
+static void
+rip_routemap_event (route_map_event_t event, const char *notused)
+{
+  rip_output_invalidate ();
 }
 
 /* Allocate new rip structure and set default value. */
@@ -4196,6 +4376,7 @@ rip_init (void)
 
   route_map_add_hook (rip_routemap_update);
   route_map_delete_hook (rip_routemap_update);
+  route_map_event_hook (rip_routemap_event);
 
   if_rmap_init (RIP_NODE);
   if_rmap_hook_add (rip_if_rmap_update);
@@ -110,6 +110,10 @@ struct rip
   /* RIP routing information base. */
   struct route_table *table;
 
+  /* Change journal: the routes of the table whose change flag is set,
+     for the next triggered update. */
+  struct route_table *changed;
+
   /* RIP only static routing information. */
   struct route_table *route;
   
@@ -296,6 +300,21 @@ struct rip_interface
 
   /* Passive interface. */
   int passive;
+
+  /* Packets of the last full update, per connected address and version. */
+  struct list *output_cache;
+};
+
+/* Packets of a full update for one connected address and RIP version. */
+struct rip_output_cache
+{
+  struct connected *ifc;
+  u_char version;
+
+  /* Value of the route and policy generation they were built for. */
+  unsigned long gen;
+
+  struct list *packets;
 };
 
 /* RIP peer information. */
@@ -436,6 +455,9 @@ extern struct rip_info *rip_ecmp_add (struct rip_info *);
 extern struct rip_info *rip_ecmp_replace (struct rip_info *);
 extern struct rip_info *rip_ecmp_delete (struct rip_info *);
 
+extern void rip_output_invalidate (void);
+extern void rip_output_cache_free (struct rip_interface *);
+
 /* There is only one rip strucutre. */
 extern struct rip *rip;
 
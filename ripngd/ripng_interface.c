@@ -219,6 +219,9 @@ ripng_interface_up (int command, struct zclient *zclient, zebra_size_t length,
   /* Apply distribute list to the all interface. */
   ripng_distribute_update_interface (ifp);
 
+  /* The MTU may have changed. */
+  ripng_output_cache_free (ifp->info);
+
   return 0;
 }
 
@@ -297,7 +300,7 @@ ripng_interface_delete (int command, struct zclient *zclient,
 
   /* To support pseudo interface do not free interface structure.  */
   /* if_delete(ifp); */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -322,6 +325,8 @@ ripng_interface_clean (void)
           thread_cancel (ri->t_wakeup);
           ri->t_wakeup = NULL;
         }
+
+      ripng_output_cache_free (ri);
     }
 }
 
@@ -356,6 +361,8 @@ ripng_interface_reset (void)
         }
 
       ri->passive = 0;
+
+      ripng_output_cache_free (ri);
     }
 }
 
@@ -1017,6 +1024,7 @@ DEFUN (ipv6_ripng_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIPNG_SPLIT_HORIZON;
+  ripng_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1035,6 +1043,7 @@ DEFUN (ipv6_ripng_split_horizon_poisoned_reverse,
   ri = ifp->info;
 
   ri->split_horizon = RIPNG_SPLIT_HORIZON_POISONED_REVERSE;
+  ripng_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1053,6 +1062,7 @@ DEFUN (no_ipv6_ripng_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIPNG_NO_SPLIT_HORIZON;
+  ripng_output_invalidate ();
   return CMD_SUCCESS;
 }
 
@@ -1111,6 +1121,7 @@ ripng_if_new_hook (struct interface *ifp)
 static int
 ripng_if_delete_hook (struct interface *ifp)
 {
+  ripng_output_cache_free (ifp->info);
   XFREE (MTYPE_IF, ifp->info);
   ifp->info = NULL;
   return 0;
@@ -110,11 +110,12 @@ ripng_rte_add(struct list *ripng_rte_list, struct prefix_ipv6 *p,
   listnode_add_sort(ripng_rte_list, data);
 } 
 
-/* Send the RTE with the nexthop support
+/* Send the RTE with the nexthop support.  When CACHE is not NULL, a copy
+ * of every packet sent is appended to it.
  */
 void
 ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
-               struct sockaddr_in6 *to) {
+               struct sockaddr_in6 *to, struct list *cache) {
 
   struct ripng_rte_data *data;
   struct listnode *node, *nnode;
@@ -166,6 +167,8 @@ ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
         if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
           ripng_packet_dump((struct ripng_packet *)STREAM_DATA (s),
 			    stream_get_endp(s), "SEND");
+        if (cache)
+          listnode_add (cache, stream_dup (s));
         num = 0;
         stream_reset (s);
       }
@@ -196,6 +199,8 @@ ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
       if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
         ripng_packet_dump((struct ripng_packet *)STREAM_DATA (s),
 			  stream_get_endp(s), "SEND");
+      if (cache)
+        listnode_add (cache, stream_dup (s));
       num = 0;
       stream_reset (s);
     }
@@ -209,6 +214,8 @@ ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
     if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
       ripng_packet_dump ((struct ripng_packet *)STREAM_DATA (s),
 			 stream_get_endp (s), "SEND");
+    if (cache)
+      listnode_add (cache, stream_dup (s));
     stream_reset (s);
   }
 }
@@ -145,6 +145,7 @@ ripng_offset_list_set (struct vty *vty, const char *alist,
     free (offset->direct[direct].alist_name);
   offset->direct[direct].alist_name = strdup (alist);
   offset->direct[direct].metric = metric;
+  ripng_output_invalidate ();
 
   return CMD_SUCCESS;
 }
@@ -194,6 +195,7 @@ ripng_offset_list_unset (struct vty *vty, const char *alist,
 	    free (offset->ifname);
 	  ripng_offset_list_free (offset);
 	}
+      ripng_output_invalidate ();
     }
   else
     {
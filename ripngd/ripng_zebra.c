@@ -214,6 +214,7 @@ ripng_redistribute_metric_set (int type, int metric)
 {
   ripng->route_map[type].metric_config = 1;
   ripng->route_map[type].metric = metric;
+  ripng_output_invalidate ();
 }
 
 static int
@@ -221,6 +222,7 @@ ripng_redistribute_metric_unset (int type)
 {
   ripng->route_map[type].metric_config = 0;
   ripng->route_map[type].metric = 0;
+  ripng_output_invalidate ();
   return 0;
 }
 
@@ -232,6 +234,7 @@ ripng_redistribute_routemap_set (int type, const char *name)
 
   ripng->route_map[type].name = strdup (name);
   ripng->route_map[type].map = route_map_lookup_by_name (name);
+  ripng_output_invalidate ();
 }
 
 static void
@@ -242,6 +245,7 @@ ripng_redistribute_routemap_unset (int type)
 
   ripng->route_map[type].name = NULL;
   ripng->route_map[type].map = NULL;
+  ripng_output_invalidate ();
 }
 
 /* Redistribution types */
@@ -47,6 +47,9 @@
    ripng->fd must be negative value. */
 struct ripng *ripng = NULL;
 
+/* Generation of the routes and output policy, see ripng_output_process. */
+static unsigned long ripng_output_gen = 1;
+
 enum
 {
   ripng_all_route,
@@ -432,6 +435,8 @@ ripng_garbage_collect (struct thread *t)
   /* Free RIPng routing information. */
   ripng_info_free (rinfo);
 
+  ripng_output_invalidate ();
+
   return 0;
 }
 
@@ -1623,6 +1628,31 @@ ripng_write_rte (int num, struct stream *s, struct prefix_ipv6 *p,
   return ++num;
 }
 
+/* Note that the routes or the output policy changed: the packets cached
+   for full updates have to be built again. */
+void
+ripng_output_invalidate (void)
+{
+  ripng_output_gen++;
+}
+
+static void
+ripng_output_packet_del (void *s)
+{
+  stream_free (s);
+}
+
+/* Drop the cached update of an interface. */
+void
+ripng_output_cache_free (struct ripng_interface *ri)
+{
+  if (ri->output_cache)
+    {
+      list_delete (ri->output_cache);
+      ri->output_cache = NULL;
+    }
+}
+
 /* Send RESPONSE message to specified destination. */
 void
 ripng_output_process (struct interface *ifp, struct sockaddr_in6 *to,
@@ -1637,6 +1667,8 @@ ripng_output_process (struct interface *ifp, struct sockaddr_in6 *to,
   struct list * ripng_rte_list;
   struct list *list = NULL;
   struct listnode *listnode = NULL;
+  struct list *cache = NULL;
+  struct stream *s;
 
   if (IS_RIPNG_DEBUG_EVENT) {
     if (to)
@@ -1648,6 +1680,34 @@ ripng_output_process (struct interface *ifp, struct sockaddr_in6 *to,
 
   /* Get RIPng interface. */
   ri = ifp->info;
+
+  /* A full update is sent from the packets built last time, unless a
+     route or the output policy changed since. */
+  if (route_type == ripng_all_route)
+    {
+      if (ri->output_cache && ri->output_gen == ripng_output_gen)
+        {
+          for (ALL_LIST_ELEMENTS_RO (ri->output_cache, listnode, s))
+            {
+              ret = ripng_send_packet ((caddr_t) STREAM_DATA (s),
+                                       stream_get_endp (s), to, ifp);
+              if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
+                ripng_packet_dump ((struct ripng_packet *)STREAM_DATA (s),
+                                   stream_get_endp (s), "SEND");
+            }
+          return;
+        }
+
+      if (ri->output_cache == NULL)
+        {
+          ri->output_cache = list_new ();
+          ri->output_cache->del = ripng_output_packet_del;
+        }
+      else
+        list_delete_all_node (ri->output_cache);
+      ri->output_gen = ripng_output_gen;
+      cache = ri->output_cache;
+    }
  
   ripng_rte_list = ripng_rte_new();
  
@@ -1862,7 +1922,7 @@ ripng_output_process (struct interface *ifp, struct sockaddr_in6 *to,
     }
 
   /* Flush the list */
-  ripng_rte_send(ripng_rte_list, ifp, to);
+  ripng_rte_send(ripng_rte_list, ifp, to, cache);
   ripng_rte_free(ripng_rte_list);
 }
 
@@ -1964,6 +2024,8 @@ ripng_event (enum ripng_event event, int sock)
 			  sock ? 2 : ripng->update_time + jitter);
       break;
     case RIPNG_TRIGGERED_UPDATE:
+      /* Every route change ends up here. */
+      ripng_output_invalidate ();
       if (ripng->t_triggered_interval)
 	ripng->trigger = 1;
       else if (! ripng->t_triggered_update)
@@ -2348,6 +2410,7 @@ DEFUN (ripng_aggregate_address,
   node->info = (void *)1;
 
   ripng_aggregate_add (&p);
+  ripng_output_invalidate ();
 
   return CMD_SUCCESS;
 }
@@ -2381,6 +2444,7 @@ DEFUN (no_ripng_aggregate_address,
   route_unlock_node (rn);
 
   ripng_aggregate_delete (&p);
+  ripng_output_invalidate ();
 
   return CMD_SUCCESS;
 }
@@ -2394,6 +2458,7 @@ DEFUN (ripng_default_metric,
   if (ripng)
     {
       ripng->default_metric = atoi (argv[0]);
+      ripng_output_invalidate ();
     }
   return CMD_SUCCESS;
 }
@@ -2408,6 +2473,7 @@ DEFUN (no_ripng_default_metric,
   if (ripng)
     {
       ripng->default_metric = RIPNG_DEFAULT_METRIC_DEFAULT;
+      ripng_output_invalidate ();
     }
   return CMD_SUCCESS;
 }
@@ -2814,6 +2880,8 @@ ripng_distribute_update (struct distribute *dist)
   struct access_list *alist;
   struct prefix_list *plist;
 
+  ripng_output_invalidate ();
+
   if (! dist->ifname)
     return;
 
@@ -2885,6 +2953,8 @@ ripng_distribute_update_all (struct prefix_list *notused)
   struct interface *ifp;
   struct listnode *node;
 
+  ripng_output_invalidate ();
+
   for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
     ripng_distribute_update_interface (ifp);
 }
@@ -3012,6 +3082,8 @@ ripng_if_rmap_update (struct if_rmap *if_rmap)
   struct ripng_interface *ri;
   struct route_map *rmap;
 
+  ripng_output_invalidate ();
+
   ifp = if_lookup_by_name (if_rmap->ifname);
   if (ifp == NULL)
     return;
@@ -3077,6 +3149,15 @@ ripng_routemap_update (const char *unused)
     ripng_if_rmap_update_interface (ifp);
 
   ripng_routemap_update_redistribute ();
+  ripng_output_invalidate ();
+}
+
+/* An index or a match or set clause of a route-map was added, changed
+   or deleted, the cached updates may no longer be what it gives. */
+static void
+ripng_routemap_event (route_map_event_t event, const char *unused)
+{
+  ripng_output_invalidate ();
 }
 
 /* Initialize ripng structure and set commands. */
@@ -3151,6 +3232,7 @@ ripng_init ()
 
   route_map_add_hook (ripng_routemap_update);
   route_map_delete_hook (ripng_routemap_update);
+  route_map_event_hook (ripng_routemap_event);
 
   if_rmap_init (RIPNG_NODE);
   if_rmap_hook_add (ripng_if_rmap_update);
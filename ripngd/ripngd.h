@@ -286,6 +286,11 @@ struct ripng_interface
 
   /* Passive interface. */
   int passive;
+
+  /* Packets of the last full update and the route and policy
+     generation they were built for. */
+  struct list *output_cache;
+  unsigned long output_gen;
 };
 
 /* RIPng peer information. */
@@ -382,6 +387,8 @@ extern void ripng_offset_clean (void);
 extern struct ripng_info * ripng_info_new (void);
 extern void ripng_info_free (struct ripng_info *rinfo);
 extern void ripng_event (enum ripng_event, int);
+extern void ripng_output_invalidate (void);
+extern void ripng_output_cache_free (struct ripng_interface *);
 extern int ripng_request (struct interface *ifp);
 extern void ripng_redistribute_add (int, int, struct prefix_ipv6 *,
                                     ifindex_t, struct in6_addr *);
@@ -0,0 +1,312 @@
+/*
+ * Adj-RIB-In table test.
+ *
+ * Random set, unset and lookup operations on the open addressed
+ * Adj-RIB-In tables of two peers, checked against a plain array.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <zebra.h>
+
+#include "vty.h"
+#include "prefix.h"
+#include "privs.h"
+#include "memory.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+#include "prng.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+static int failed = 0;
+
+#define NPEERS      2
+#define NNODES      3000
+#define NATTRS      8
+#define NOPS        400000
+
+static struct prng *prng;
+static struct bgp_table *table;
+static struct bgp_node *nodes[NNODES];
+static struct peer peers[NPEERS];
+static struct attr *attrs[NATTRS];
+
+/* Attribute index each peer has for each node, -1 for none. */
+static int ref[NPEERS][NNODES];
+static unsigned long ref_count[NPEERS];
+
+#define TEST_FAIL(...)                                                \
+  do {                                                                \
+    failed++;                                                         \
+    printf (__VA_ARGS__);                                             \
+    printf ("\n");                                                    \
+  } while (0)
+
+static struct bgp_adj_in_table *
+test_table (struct peer *peer)
+{
+  return peer->adj_in[AFI_IP][SAFI_UNICAST];
+}
+
+static void
+test_init (void)
+{
+  struct prefix p;
+  struct attr attr;
+  int i, j;
+
+  bgp_attr_init ();
+  prng = prng_new (0);
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  for (i = 0; i < NNODES; i++)
+    {
+      p.u.prefix4.s_addr = htonl (0x0a000000 | (i << 8));
+      nodes[i] = bgp_node_get (table, &p);
+    }
+
+  for (i = 0; i < NATTRS; i++)
+    {
+      memset (&attr, 0, sizeof (attr));
+      attr.med = i;
+      attr.flag = ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+      attrs[i] = bgp_attr_intern (&attr);
+    }
+
+  for (i = 0; i < NPEERS; i++)
+    for (j = 0; j < NNODES; j++)
+      ref[i][j] = -1;
+}
+
+/* Compare a peer's table with the reference.  Every used slot must be
+   found by a lookup of its node, which fails when a deletion left a gap
+   in a probe sequence. */
+static void
+test_verify_peer (int pi)
+{
+  struct peer *peer = &peers[pi];
+  struct bgp_adj_in_table *ait = test_table (peer);
+  struct bgp_adj_in *adj;
+  unsigned long i, used = 0;
+  int n;
+
+  if (! ait)
+    {
+      if (ref_count[pi])
+	TEST_FAIL ("peer %d: no table for %lu entries", pi, ref_count[pi]);
+      return;
+    }
+  if (ait->count != ref_count[pi] || ait->count == 0)
+    TEST_FAIL ("peer %d: count %lu, expected %lu", pi, ait->count,
+	       ref_count[pi]);
+  if (ait->count * 4 > BGP_ADJ_IN_SLOTS (ait) * 3)
+    TEST_FAIL ("peer %d: %lu entries in %lu slots", pi, ait->count,
+	       BGP_ADJ_IN_SLOTS (ait));
+
+  for (i = 0; i < BGP_ADJ_IN_SLOTS (ait); i++)
+    if (ait->slots[i].rn)
+      {
+	used++;
+	if (bgp_adj_in_lookup (ait->slots[i].rn, peer) != &ait->slots[i])
+	  TEST_FAIL ("peer %d: slot %lu not found by lookup", pi, i);
+      }
+  if (used != ait->count)
+    TEST_FAIL ("peer %d: %lu used slots, count %lu", pi, used, ait->count);
+
+  for (n = 0; n < NNODES; n++)
+    {
+      adj = bgp_adj_in_lookup (nodes[n], peer);
+      if (ref[pi][n] < 0 ? adj != NULL
+			 : (! adj || adj->rn != nodes[n]
+			    || adj->attr != attrs[ref[pi][n]]))
+	TEST_FAIL ("peer %d: node %d lookup differs", pi, n);
+    }
+}
+
+static void
+test_verify (void)
+{
+  unsigned long count, bytes, total = 0;
+  unsigned int want;
+  int pi, n;
+
+  for (pi = 0; pi < NPEERS; pi++)
+    {
+      test_verify_peer (pi);
+      total += ref_count[pi];
+    }
+
+  /* Each entry holds a lock on its node, on top of bgp_node_get()'s. */
+  for (n = 0; n < NNODES; n++)
+    {
+      want = 1;
+      for (pi = 0; pi < NPEERS; pi++)
+	want += ref[pi][n] >= 0;
+      if (nodes[n]->lock != want)
+	TEST_FAIL ("node %d: lock %u, expected %u", n, nodes[n]->lock, want);
+    }
+
+  bgp_adj_in_stats (&count, &bytes);
+  if (count != total || (total == 0) != (bytes == 0))
+    TEST_FAIL ("stats: %lu entries %lu bytes, expected %lu entries",
+	       count, bytes, total);
+}
+
+static void
+test_set (int pi, int n, int a)
+{
+  bgp_adj_in_set (nodes[n], &peers[pi], attrs[a]);
+  if (ref[pi][n] < 0)
+    ref_count[pi]++;
+  ref[pi][n] = a;
+}
+
+static void
+test_unset (int pi, int n)
+{
+  int ret = bgp_adj_in_unset (nodes[n], &peers[pi]);
+
+  if (ret != (ref[pi][n] >= 0))
+    TEST_FAIL ("peer %d: unset node %d returned %d", pi, n, ret);
+  if (ref[pi][n] >= 0)
+    ref_count[pi]--;
+  ref[pi][n] = -1;
+}
+
+/* Random operations, with phases leaning towards sets or unsets so the
+   tables grow and shrink along the way. */
+static void
+test_random (void)
+{
+  struct bgp_adj_in *adj;
+  int op, pi, n, bias = 0;
+  u_char max_bits = 0;
+
+  for (op = 0; op < NOPS; op++)
+    {
+      if (op % 50000 == 0)
+	bias = (op / 50000) % 2 ? 1 : 3;
+
+      pi = prng_rand (prng) % NPEERS;
+      n = prng_rand (prng) % NNODES;
+
+      switch (prng_rand (prng) % 5)
+	{
+	case 0:
+	case 1:
+	case 2:
+	  if ((int) (prng_rand (prng) % 4) < bias)
+	    test_set (pi, n, prng_rand (prng) % NATTRS);
+	  else
+	    test_unset (pi, n);
+	  break;
+	default:
+	  adj = bgp_adj_in_lookup (nodes[n], &peers[pi]);
+	  if ((adj != NULL) != (ref[pi][n] >= 0)
+	      || (adj && adj->attr != attrs[ref[pi][n]]))
+	    TEST_FAIL ("peer %d: lookup of node %d differs", pi, n);
+	  break;
+	}
+
+      if (test_table (&peers[pi]) && test_table (&peers[pi])->bits > max_bits)
+	max_bits = test_table (&peers[pi])->bits;
+
+      if (op % 10000 == 0)
+	test_verify ();
+    }
+  test_verify ();
+
+  if (max_bits <= BGP_ADJ_IN_MIN_BITS + 4)
+    TEST_FAIL ("tables did not grow (%u bits)", max_bits);
+
+  printf ("random: %d operations, up to %lu slots\n", NOPS, 1UL << max_bits);
+}
+
+/* Shrink one peer's table by unsetting, drop the other's whole. */
+static void
+test_empty (void)
+{
+  struct bgp_adj_in_table *ait;
+  u_char bits;
+  int n, pi, a;
+
+  for (n = 0; n < NNODES; n++)
+    for (pi = 0; pi < NPEERS; pi++)
+      test_set (pi, n, n % NATTRS);
+  test_verify ();
+
+  bits = test_table (&peers[0])->bits;
+  for (n = 0; n < NNODES - 10; n++)
+    test_unset (0, n);
+  test_verify ();
+  ait = test_table (&peers[0]);
+  if (! ait || ait->bits >= bits || BGP_ADJ_IN_SLOTS (ait) > 16 * ait->count)
+    TEST_FAIL ("peer 0: table did not shrink");
+
+  for (; n < NNODES; n++)
+    test_unset (0, n);
+  if (test_table (&peers[0]))
+    TEST_FAIL ("peer 0: empty table not freed");
+
+  bgp_adj_in_free (&peers[1], AFI_IP, SAFI_UNICAST);
+  for (n = 0; n < NNODES; n++)
+    ref[1][n] = -1;
+  ref_count[1] = 0;
+  test_verify ();
+
+  /* Only our own references to the attributes are left. */
+  for (a = 0; a < NATTRS; a++)
+    if (attrs[a]->refcnt != 1)
+      TEST_FAIL ("attr %d: refcnt %lu", a, attrs[a]->refcnt);
+
+  printf ("empty: back to no tables\n");
+}
+
+static void
+test_finish (void)
+{
+  int i;
+
+  for (i = 0; i < NATTRS; i++)
+    bgp_attr_unintern (&attrs[i]);
+  for (i = 0; i < NNODES; i++)
+    bgp_unlock_node (nodes[i]);
+  bgp_table_unlock (table);
+  prng_free (prng);
+}
+
+int
+main (void)
+{
+  test_init ();
+  test_random ();
+  test_empty ();
+  test_finish ();
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
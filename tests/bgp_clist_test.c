@@ -0,0 +1,310 @@
+/*
+ * Community-list matching test.
+ *
+ * Checks the results of community-lists against the plain way of
+ * computing them: regexec() on the community string for expanded lists,
+ * community_match() and community_cmp() on every entry for standard ones.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <zebra.h>
+
+#include "vty.h"
+#include "privs.h"
+#include "memory.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_regex.h"
+#include "bgpd/bgp_clist.h"
+#include "prng.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+static int failed = 0;
+
+static struct prng *prng;
+static struct community_list_handler *ch;
+
+#define NCOMS       500
+#define NPATTERNS   400
+
+static struct community *coms[NCOMS];
+
+static const char *test_as[] = { "0", "1", "10", "100", "6500", "65000",
+				 "65001", "65535" };
+static const char *test_val[] = { "0", "1", "10", "100", "1000", "65000",
+				  "65535" };
+static const char *test_wellknown[] = { "internet", "no-export",
+					"no-advertise", "local-AS" };
+
+/* Expanded entries not of the simple form, which regexec() still does. */
+static const char *test_regexps[] = { ".*", "^$", "_", "65000:1.*",
+				      "(65000|65001):100", "^6500[01]:",
+				      "no-export", "_no-advertise$", NULL };
+
+#define RANDOM_ELEM(a) ((a)[prng_rand (prng) % array_size (a)])
+
+static void
+test_value_str (char *buf, size_t size)
+{
+  if (prng_rand (prng) % 8 == 0)
+    snprintf (buf, size, "%s", RANDOM_ELEM (test_wellknown));
+  else
+    snprintf (buf, size, "%s:%s", RANDOM_ELEM (test_as),
+	      RANDOM_ELEM (test_val));
+}
+
+/* An interned community of up to 4 values, or NULL. */
+static struct community *
+test_community (void)
+{
+  char buf[128], val[32];
+  unsigned int n, i;
+  struct community *com;
+
+  n = prng_rand (prng) % 5;
+  if (n == 0)
+    return NULL;
+
+  buf[0] = '\0';
+  for (i = 0; i < n; i++)
+    {
+      test_value_str (val, sizeof (val));
+      if (i)
+	strcat (buf, " ");
+      strcat (buf, val);
+    }
+  com = community_str2com (buf);
+  assert (com);
+  return community_intern (com);
+}
+
+/* A regexp of the simple form, a piece of some value with or without
+   anchors. */
+static void
+test_pattern_str (char *buf, size_t size)
+{
+  static const char *heads[] = { "", "^", "_" };
+  static const char *tails[] = { "", "$", "_" };
+  char val[32];
+  size_t len, start, n;
+
+  snprintf (val, sizeof (val), "%s:%s", RANDOM_ELEM (test_as),
+	    RANDOM_ELEM (test_val));
+  len = strlen (val);
+  start = prng_rand (prng) % len;
+  n = 1 + prng_rand (prng) % (len - start);
+  snprintf (buf, size, "%s%.*s%s", RANDOM_ELEM (heads), (int) n, val + start,
+	    RANDOM_ELEM (tails));
+}
+
+static int
+test_regexec (regex_t *reg, const char *str)
+{
+  return regexec (reg, str, 0, NULL, 0) == 0;
+}
+
+static void
+test_expanded_one (const char *pattern, int simple)
+{
+  struct community_list *list;
+  struct community_entry *entry;
+  struct community *com, *del, *one;
+  char name[] = "test-expanded";
+  int i, j, want, got, keep;
+  u_int32_t val;
+
+  community_list_set (ch, name, pattern, COMMUNITY_PERMIT,
+		      COMMUNITY_LIST_EXPANDED);
+  list = community_list_lookup (ch, name, COMMUNITY_LIST_MASTER);
+  assert (list && list->head);
+  entry = list->head;
+
+  if ((entry->pattern.len != 0) != simple)
+    {
+      failed++;
+      printf ("%s: %s as a pattern\n", pattern,
+	      simple ? "not compiled" : "wrongly compiled");
+    }
+
+  for (i = 0; i < NCOMS; i++)
+    {
+      com = coms[i];
+      want = test_regexec (entry->reg,
+			   com && com->size ? community_str (com) : "");
+
+      /* Twice, the second result comes from the cache. */
+      for (j = 0; j < 2; j++)
+	{
+	  got = community_list_match (com, list);
+	  if (got != want)
+	    {
+	      failed++;
+	      printf ("%s: match \"%s\" gave %d\n", pattern,
+		      com ? community_str (com) : "", got);
+	    }
+	  got = community_list_exact_match (com, list);
+	  if (got != want)
+	    {
+	      failed++;
+	      printf ("%s: exact match \"%s\" gave %d\n", pattern,
+		      com ? community_str (com) : "", got);
+	    }
+	}
+
+      /* Value by value, as for "set comm-list delete". */
+      if (! com)
+	continue;
+      del = community_list_match_delete (community_dup (com), list);
+      for (j = 0; j < com->size; j++)
+	{
+	  val = htonl (community_val_get (com, j));
+	  one = community_parse (&val, sizeof (val));
+	  keep = ! test_regexec (entry->reg, community_str (one));
+	  if (keep != community_include (del, community_val_get (com, j)))
+	    {
+	      failed++;
+	      printf ("%s: delete from \"%s\" got \"%s\"\n", pattern,
+		      community_str (com), community_str (del));
+	    }
+	  community_unintern (&one);
+	}
+      community_free (del);
+    }
+
+  community_list_unset (ch, name, NULL, COMMUNITY_PERMIT,
+			COMMUNITY_LIST_EXPANDED);
+}
+
+/* Expanded community-lists, compiled to patterns or not, against
+   regexec(). */
+static void
+test_expanded (void)
+{
+  char pattern[64];
+  int i;
+
+  for (i = 0; test_regexps[i]; i++)
+    test_expanded_one (test_regexps[i], 0);
+
+  for (i = 0; i < NPATTERNS; i++)
+    {
+      test_pattern_str (pattern, sizeof (pattern));
+      test_expanded_one (pattern, 1);
+    }
+
+  printf ("expanded: %d patterns x %d communities\n",
+	  i + (int) array_size (test_regexps) - 1, NCOMS);
+}
+
+/* community_list_match() the plain way, entry by entry. */
+static int
+test_standard_ref (struct community *com, struct community_list *list,
+		   int exact)
+{
+  struct community_entry *entry;
+
+  for (entry = list->head; entry; entry = entry->next)
+    if (community_include (entry->u.com, COMMUNITY_INTERNET)
+	|| (exact ? community_cmp (com, entry->u.com)
+		  : community_match (com, entry->u.com)))
+      return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+  return 0;
+}
+
+/* A standard community-list grown entry by entry, checking every
+   community after each addition, so the cache is flushed as it should. */
+static void
+test_standard (void)
+{
+  struct community_list *list;
+  struct community *com;
+  char name[] = "test-standard";
+  char buf[128], val[32];
+  int i, j, k, n, exact, got, want;
+
+  for (n = 0; n < 60; n++)
+    {
+      buf[0] = '\0';
+      for (k = 1 + prng_rand (prng) % 2; k; k--)
+	{
+	  test_value_str (val, sizeof (val));
+	  /* "internet" permits anything, keep it rare. */
+	  if (strcmp (val, "internet") == 0 && n % 20)
+	    snprintf (val, sizeof (val), "65000:%d", n);
+	  strcat (buf, " ");
+	  strcat (buf, val);
+	}
+      community_list_set (ch, name, buf,
+			  prng_rand (prng) % 4 ? COMMUNITY_PERMIT
+					       : COMMUNITY_DENY,
+			  COMMUNITY_LIST_STANDARD);
+      list = community_list_lookup (ch, name, COMMUNITY_LIST_MASTER);
+      assert (list);
+
+      for (i = 0; i < NCOMS; i++)
+	for (exact = 0; exact <= 1; exact++)
+	  for (j = 0; j < 2; j++)
+	    {
+	      com = coms[i];
+	      want = test_standard_ref (com, list, exact);
+	      got = exact ? community_list_exact_match (com, list)
+			  : community_list_match (com, list);
+	      if (got != want)
+		{
+		  failed++;
+		  printf ("standard %d entries: %smatch \"%s\" gave %d\n",
+			  n + 1, exact ? "exact " : "",
+			  com ? community_str (com) : "", got);
+		}
+	    }
+    }
+
+  community_list_unset (ch, name, NULL, COMMUNITY_PERMIT,
+			COMMUNITY_LIST_STANDARD);
+  printf ("standard: %d entries x %d communities\n", n, NCOMS);
+}
+
+int
+main (void)
+{
+  int i;
+
+  community_init ();
+  ch = community_list_init ();
+  prng = prng_new (0);
+
+  for (i = 0; i < NCOMS; i++)
+    coms[i] = test_community ();
+
+  test_expanded ();
+  test_standard ();
+
+  for (i = 0; i < NCOMS; i++)
+    if (coms[i])
+      community_unintern (&coms[i]);
+  community_list_terminate (ch);
+  prng_free (prng);
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
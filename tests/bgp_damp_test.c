@@ -0,0 +1,296 @@
+/*
+ * Route flap dampening test.
+ *
+ * Checks the fixed point decay of penalties against the floating point
+ * formula, and a few routes through suppression and reuse.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <zebra.h>
+#include <math.h>
+
+#include "vty.h"
+#include "prefix.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_damp.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+static int failed = 0;
+
+#define TEST_FAIL(...)                                                \
+  do {                                                                \
+    failed++;                                                         \
+    printf (__VA_ARGS__);                                             \
+    printf ("\n");                                                    \
+  } while (0)
+
+/* Half-life, reuse, suppress and max-suppress-time, in seconds as
+   bgp_damp_enable() takes them. */
+static const struct
+{
+  time_t half;
+  unsigned int reuse;
+  unsigned int suppress;
+  time_t max;
+} test_params[] =
+{
+  { DEFAULT_HALF_LIFE * 60, DEFAULT_REUSE, DEFAULT_SUPPRESS,
+    DEFAULT_HALF_LIFE * 60 * 4 },
+  { 60, 500, 1000, 300 },
+  { 45 * 60, 750, 2000, 255 * 60 },
+  { 7 * 60, 1500, 3000, 20 * 60 },
+};
+
+#define NROUTES     3
+
+static struct bgp bgp;
+static struct peer peer;
+static struct bgp_table *table;
+static struct bgp_node *nodes[NROUTES];
+static struct bgp_info binfos[NROUTES];
+
+static void
+test_init (void)
+{
+  struct prefix p;
+  int i;
+
+  bgp_master_init ();
+
+  peer.bgp = &bgp;
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  for (i = 0; i < NROUTES; i++)
+    {
+      p.u.prefix4.s_addr = htonl (0x0a000000 | (i << 8));
+      nodes[i] = bgp_node_get (table, &p);
+      binfos[i].peer = &peer;
+      binfos[i].flags = BGP_INFO_VALID;
+    }
+}
+
+static struct bgp_damp_config *
+test_enable (unsigned int n)
+{
+  bgp_damp_enable (&bgp, AFI_IP, SAFI_UNICAST, test_params[n].half,
+		   test_params[n].reuse, test_params[n].suppress,
+		   test_params[n].max);
+  assert (bgp.damp[AFI_IP][SAFI_UNICAST]);
+  return bgp.damp[AFI_IP][SAFI_UNICAST];
+}
+
+/* Every entry of the decay array, applied to penalties up to the
+   ceiling, against penalty * 2^(-t / half-life) in floating point. */
+static void
+test_decay (void)
+{
+  struct bgp_damp_config *damp;
+  unsigned int n, i, p, checked = 0;
+  time_t tdiff;
+  double want, slack;
+  int got;
+
+  for (n = 0; n < array_size (test_params); n++)
+    {
+      damp = test_enable (n);
+
+      for (i = 0; i <= damp->decay_array_size; i++)
+	for (p = 1; p <= damp->ceiling; p += 1 + p / 16)
+	  {
+	    /* Anywhere within the step, the array has DELTA_T granularity. */
+	    tdiff = i * DELTA_T + (p % DELTA_T);
+	    got = bgp_damp_decay (damp, tdiff, p);
+	    if (i == 0)
+	      want = p;
+	    else if (i >= damp->decay_array_size)
+	      want = 0;
+	    else
+	      want = p * pow (0.5, (double) i * DELTA_T / damp->half_life);
+
+	    /* Truncated like the floating point code did, give or take the
+	       rounding of the array entries to BGP_DAMP_DECAY_SHIFT bits. */
+	    slack = (double) p / (1 << BGP_DAMP_DECAY_SHIFT);
+	    if (got < 0 || got > want + slack || got <= want - 1 - slack)
+	      TEST_FAIL ("half-life %ld: penalty %u after %lds decayed to %d,"
+			 " expected %.2f", (long) damp->half_life, p,
+			 (long) tdiff, got, want);
+	    checked++;
+	  }
+
+      bgp_damp_disable (&bgp, AFI_IP, SAFI_UNICAST);
+    }
+
+  printf ("decay: %u penalties checked\n", checked);
+}
+
+/* Age a route's history as if the daemon had stalled for secs. */
+static void
+test_stall (struct bgp_damp_info *bdi, time_t secs)
+{
+  bdi->t_updated -= secs;
+  bdi->start_time -= secs;
+  if (bdi->suppress_time)
+    bdi->suppress_time -= secs;
+}
+
+static struct bgp_damp_info *
+test_bdi (int i)
+{
+  return binfos[i].extra ? binfos[i].extra->damp_info : NULL;
+}
+
+/* Run the reuse timer now, with every reuse list come due. */
+static void
+test_reuse_timer (struct bgp_damp_config *damp)
+{
+  int (*func) (struct thread *);
+  struct thread t;
+
+  assert (damp->t_reuse);
+  func = damp->t_reuse->func;
+  thread_cancel (damp->t_reuse);
+  damp->t_reuse = NULL;
+
+  memset (&t, 0, sizeof (t));
+  t.arg = damp;
+  damp->reuse_time = bgp_clock ()
+		     - (time_t) damp->reuse_list_size * DELTA_REUSE;
+  func (&t);
+}
+
+/* Flap routes until suppressed, then let them come back through an
+   update, the reuse timer and the max-suppress-time limit. */
+static void
+test_flap (void)
+{
+  struct bgp_damp_config *damp;
+  struct bgp_damp_info *bdi;
+  time_t half;
+  int i, ret;
+
+  damp = test_enable (0);
+  half = damp->half_life;
+
+  /* Two withdraws and an attribute change exceed the suppress value. */
+  for (i = 0; i < NROUTES; i++)
+    {
+      bgp_damp_withdraw (&binfos[i], nodes[i], AFI_IP, SAFI_UNICAST, 0);
+      ret = bgp_damp_update (&binfos[i], nodes[i], AFI_IP, SAFI_UNICAST);
+      if (ret != BGP_DAMP_USED
+	  || CHECK_FLAG (binfos[i].flags, BGP_INFO_DAMPED))
+	TEST_FAIL ("route %d: suppressed after one flap", i);
+      bgp_damp_withdraw (&binfos[i], nodes[i], AFI_IP, SAFI_UNICAST, 1);
+      if (CHECK_FLAG (binfos[i].flags, BGP_INFO_DAMPED))
+	TEST_FAIL ("route %d: suppressed at penalty %u", i,
+		   test_bdi (i)->penalty);
+      bgp_damp_withdraw (&binfos[i], nodes[i], AFI_IP, SAFI_UNICAST, 0);
+
+      bdi = test_bdi (i);
+      if (! bdi || bdi->flap != 3 || bdi->penalty < damp->suppress_value
+	  || ! CHECK_FLAG (binfos[i].flags, BGP_INFO_DAMPED)
+	  || ! CHECK_FLAG (binfos[i].flags, BGP_INFO_HISTORY))
+	TEST_FAIL ("route %d: not suppressed after three flaps", i);
+    }
+
+  /* Route 0 is announced again while still suppressed, and again once
+     its penalty has decayed below the reuse limit. */
+  ret = bgp_damp_update (&binfos[0], nodes[0], AFI_IP, SAFI_UNICAST);
+  if (ret != BGP_DAMP_SUPPRESSED
+      || ! CHECK_FLAG (binfos[0].flags, BGP_INFO_DAMPED))
+    TEST_FAIL ("route 0: reused at penalty %u", test_bdi (0)->penalty);
+  test_stall (test_bdi (0), 2 * half);
+  ret = bgp_damp_update (&binfos[0], nodes[0], AFI_IP, SAFI_UNICAST);
+  bdi = test_bdi (0);
+  if (ret != BGP_DAMP_USED || CHECK_FLAG (binfos[0].flags, BGP_INFO_DAMPED)
+      || ! bdi || bdi->penalty >= damp->reuse_limit)
+    TEST_FAIL ("route 0: not reused by an update after a stall");
+
+  /* Routes 1 and 2 stay withdrawn, the reuse timer frees route 1's
+     history once it has decayed enough, route 2 is not due yet. */
+  test_stall (test_bdi (1), 4 * half);
+  test_stall (test_bdi (2), half / 2);
+  test_reuse_timer (damp);
+  if (test_bdi (1) || CHECK_FLAG (binfos[1].flags, BGP_INFO_DAMPED)
+      || ! CHECK_FLAG (binfos[1].flags, BGP_INFO_REMOVED))
+    TEST_FAIL ("route 1: history not released by the reuse timer");
+  bdi = test_bdi (2);
+  if (! bdi || ! CHECK_FLAG (binfos[2].flags, BGP_INFO_DAMPED)
+      || bdi->penalty < damp->reuse_limit || bdi->index < 0
+      || (unsigned int) bdi->index >= damp->reuse_list_size)
+    TEST_FAIL ("route 2: reused early by the reuse timer");
+
+  /* However high the penalty, max-suppress-time ends suppression. */
+  for (i = 0; i < 20; i++)
+    bgp_damp_withdraw (&binfos[2], nodes[2], AFI_IP, SAFI_UNICAST, 0);
+  bdi = test_bdi (2);
+  if (bdi->penalty > damp->ceiling)
+    TEST_FAIL ("route 2: penalty %u over the ceiling %u", bdi->penalty,
+	       damp->ceiling);
+  bdi->suppress_time -= damp->max_suppress_time;
+  bgp_damp_scan (&binfos[2], AFI_IP, SAFI_UNICAST);
+  if (CHECK_FLAG (binfos[2].flags, BGP_INFO_DAMPED)
+      || bdi->penalty != damp->reuse_limit)
+    TEST_FAIL ("route 2: still suppressed after max-suppress-time");
+
+  bgp_damp_disable (&bgp, AFI_IP, SAFI_UNICAST);
+  for (i = 0; i < NROUTES; i++)
+    if (test_bdi (i))
+      TEST_FAIL ("route %d: history left after disabling", i);
+
+  printf ("flap: suppressed and reused\n");
+}
+
+static void
+test_finish (void)
+{
+  int i;
+
+  for (i = 0; i < NROUTES; i++)
+    {
+      if (binfos[i].extra)
+	XFREE (MTYPE_BGP_ROUTE_EXTRA, binfos[i].extra);
+      bgp_unlock_node (nodes[i]);
+    }
+  bgp_table_unlock (table);
+  thread_master_free (bm->master);
+}
+
+int
+main (void)
+{
+  test_init ();
+  test_decay ();
+  test_flap ();
+  test_finish ();
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
@@ -0,0 +1,523 @@
+/*
+ * Offline benchmark of the bgpd receive path.
+ *
+ * Replays the BGP4MP UPDATE records of an MRT file (as written by
+ * "dump bgp updates" or a route collector) through libbgp, feeding each
+ * message to bgp_update_receive() as though it had been read from the
+ * peer named in the record.  Attribute parsing, input policy, best path
+ * selection and adj-out generation towards the output peers all run as
+ * they do in bgpd, on the same thread master, without any sockets.
+ *
+ * At the end the update rate, the CPU spent in each thread function
+ * (accounted with thread_consumed_time, as "show thread cpu" does) and
+ * the allocation statistics of every memory type in use are printed.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "command.h"
+#include "vty.h"
+#include "log.h"
+#include "sockunion.h"
+#include "workqueue.h"
+#include "zclient.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_zebra.h"
+
+extern struct zclient *zclient;
+
+/* need this to link in libbgp */
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+#define MRT_HEADER_SIZE 12
+
+/* Thread functions accounted separately. */
+#define REPLAY_FUNC_MAX 64
+
+static struct
+{
+  const char *funcname;
+  unsigned long calls;
+  unsigned long cpu;
+  unsigned long real;
+} replay_func[REPLAY_FUNC_MAX];
+
+static struct
+{
+  FILE *fp;
+  struct bgp *bgp;
+  unsigned long max_updates;
+
+  unsigned long records;
+  unsigned long updates;
+  unsigned long skipped;
+  struct timeval start;
+  struct timeval fed;
+  struct timeval drained;
+
+  struct stream *s;
+} replay;
+
+/* Take a peer through the end of the FSM as if its OPEN exchange had
+ * just completed with unicast negotiated, so that bgp_establish() sets
+ * it up exactly as in bgpd.  Its transport goes to /dev/null and it
+ * never expects keepalives. */
+static void
+replay_peer_establish (struct peer *peer, int as4)
+{
+  struct thread event;
+  afi_t afi;
+
+  if (peer->status == Established)
+    return;
+
+  if (peer->fd < 0 && (peer->fd = open ("/dev/null", O_RDWR)) < 0)
+    return;
+  if (as4)
+    SET_FLAG (peer->cap, PEER_CAP_AS4_ADV | PEER_CAP_AS4_RCV);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (peer->afc[afi][SAFI_UNICAST])
+      peer->afc_nego[afi][SAFI_UNICAST] = 1;
+
+  peer->v_holdtime = 0;
+  peer->v_keepalive = 0;
+  peer->v_routeadv = 1;
+  bgp_fsm_change_status (peer, OpenConfirm);
+
+  memset (&event, 0, sizeof (event));
+  event.arg = peer;
+  event.u.val = Receive_KEEPALIVE_message;
+  bgp_event (&event);
+}
+
+/* The peer an MRT record was received from, created on first sight with
+ * the remote AS of the record unless the configuration has it. */
+static struct peer *
+replay_peer_get (union sockunion *su, as_t as, int as4)
+{
+  struct peer *peer;
+
+  peer = peer_lookup (replay.bgp, su);
+  if (! peer)
+    {
+      if (peer_remote_as (replay.bgp, su, &as, AFI_IP, SAFI_UNICAST) < 0
+	  || (peer = peer_lookup (replay.bgp, su)) == NULL)
+	return NULL;
+      if (su->sa.sa_family == AF_INET6)
+	peer_activate (peer, AFI_IP6, SAFI_UNICAST);
+
+      /* Collector peers are rarely on a connected subnet. */
+      peer_flag_set (peer, PEER_FLAG_DISABLE_CONNECTED_CHECK);
+    }
+  replay_peer_establish (peer, as4);
+  return peer;
+}
+
+/* Read one MRT record into replay.s.  Returns the record type and fills
+ * in subtype, or -1 at the end of the file. */
+static int
+replay_read_record (int *subtype)
+{
+  u_char hdr[MRT_HEADER_SIZE];
+  u_int32_t len;
+  int type;
+
+  if (fread (hdr, sizeof (hdr), 1, replay.fp) != 1)
+    return -1;
+
+  type = (hdr[4] << 8) | hdr[5];
+  *subtype = (hdr[6] << 8) | hdr[7];
+  len = ((u_int32_t) hdr[8] << 24) | (hdr[9] << 16) | (hdr[10] << 8) | hdr[11];
+
+  stream_reset (replay.s);
+  if (len > STREAM_SIZE (replay.s))
+    {
+      if (fseek (replay.fp, len, SEEK_CUR) < 0)
+	return -1;
+      return 0;
+    }
+  if (len && fread (STREAM_DATA (replay.s), len, 1, replay.fp) != 1)
+    return -1;
+  stream_forward_endp (replay.s, len);
+
+  replay.records++;
+  return type;
+}
+
+/* Hand one BGP4MP message record to its peer.  Returns 1 if it was an
+ * UPDATE. */
+static int
+replay_message (int type, int subtype)
+{
+  struct stream *s = replay.s;
+  union sockunion su;
+  struct peer *peer;
+  as_t peer_as;
+  u_int16_t afi;
+  u_int16_t length;
+  size_t size;
+  int as4;
+
+  if (type == MSG_PROTOCOL_BGP4MP_ET)
+    stream_forward_getp (s, 4);
+
+  as4 = (subtype == BGP4MP_MESSAGE_AS4);
+  if (as4)
+    {
+      peer_as = stream_getl (s);
+      stream_forward_getp (s, 4 + 2);
+    }
+  else
+    {
+      peer_as = stream_getw (s);
+      stream_forward_getp (s, 2 + 2);
+    }
+  afi = stream_getw (s);
+
+  memset (&su, 0, sizeof (su));
+  if (afi == AFI_IP)
+    {
+      su.sin.sin_family = AF_INET;
+      stream_get (&su.sin.sin_addr, s, 4);
+      stream_forward_getp (s, 4);
+    }
+#ifdef HAVE_IPV6
+  else if (afi == AFI_IP6)
+    {
+      su.sin6.sin6_family = AF_INET6;
+      stream_get (&su.sin6.sin6_addr, s, 16);
+      stream_forward_getp (s, 16);
+    }
+#endif /* HAVE_IPV6 */
+  else
+    return 0;
+
+  /* The BGP message itself. */
+  size = STREAM_READABLE (s);
+  if (size < BGP_HEADER_SIZE)
+    return 0;
+  length = stream_getw_from (s, stream_get_getp (s) + BGP_MARKER_SIZE);
+  if (length != size || length > BGP_MAX_PACKET_SIZE
+      || stream_getc_from (s, stream_get_getp (s) + BGP_MARKER_SIZE + 2)
+         != BGP_MSG_UPDATE)
+    return 0;
+
+  peer = replay_peer_get (&su, peer_as, as4);
+  if (! peer || peer->status != Established)
+    return 0;
+
+  stream_reset (peer->ibuf);
+  stream_put (peer->ibuf, STREAM_PNT (s), size);
+  stream_forward_getp (peer->ibuf, BGP_HEADER_SIZE);
+  peer->packet_size = size;
+
+  peer->readtime = bgp_clock ();
+  bgp_update_receive (peer, size - BGP_HEADER_SIZE);
+
+  peer->packet_size = 0;
+  if (peer->ibuf)
+    stream_reset (peer->ibuf);
+  return 1;
+}
+
+static int replay_drain (struct thread *);
+
+/* Feed the next UPDATE, one per wakeup as bgp_read() takes one packet
+ * per wakeup, so the process queue and adj-out run interleaved as in
+ * bgpd. */
+static int
+replay_update (struct thread *thread)
+{
+  int type, subtype;
+
+  while (replay.updates < replay.max_updates
+	 && (type = replay_read_record (&subtype)) >= 0)
+    {
+      if ((type == MSG_PROTOCOL_BGP4MP || type == MSG_PROTOCOL_BGP4MP_ET)
+	  && (subtype == BGP4MP_MESSAGE || subtype == BGP4MP_MESSAGE_AS4)
+	  && replay_message (type, subtype))
+	{
+	  replay.updates++;
+	  thread_add_background (bm->master, replay_update, NULL, 0);
+	  return 0;
+	}
+      replay.skipped++;
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &replay.fed);
+  thread_add_timer_msec (bm->master, replay_drain, NULL, 100);
+  return 0;
+}
+
+static int
+replay_pending (void)
+{
+  struct listnode *node;
+  struct peer *peer;
+  afi_t afi;
+
+  if ((bm->process_main_queue
+       && work_queue_is_scheduled (bm->process_main_queue))
+      || (bm->process_rsclient_queue
+	  && work_queue_is_scheduled (bm->process_rsclient_queue)))
+    return 1;
+
+  for (ALL_LIST_ELEMENTS_RO (replay.bgp->peer, node, peer))
+    for (afi = AFI_IP; afi < AFI_MAX; afi++)
+      if (peer->sync[afi][SAFI_UNICAST]
+	  && (BGP_ADV_FIFO_HEAD (&peer->sync[afi][SAFI_UNICAST]->update)
+	      || BGP_ADV_FIFO_HEAD (&peer->sync[afi][SAFI_UNICAST]->withdraw)))
+	return 1;
+  return 0;
+}
+
+static unsigned long
+replay_msec (struct timeval *a, struct timeval *b)
+{
+  return (b->tv_sec - a->tv_sec) * 1000 + (b->tv_usec - a->tv_usec) / 1000;
+}
+
+static void
+replay_report (void)
+{
+  struct listnode *node;
+  struct peer *peer;
+  struct mlist *ml;
+  struct memory_list *m;
+  struct rusage ru;
+  unsigned long fed, drained;
+  afi_t afi;
+  int i;
+
+  fed = replay_msec (&replay.start, &replay.fed);
+  drained = replay_msec (&replay.start, &replay.drained);
+
+  printf ("Records read:        %lu (%lu not replayed)\n",
+	  replay.records, replay.skipped);
+  printf ("UPDATEs replayed:    %lu\n", replay.updates);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (replay.bgp->rib[afi][SAFI_UNICAST])
+      printf ("%s unicast nodes:  %lu\n", afi == AFI_IP ? "IPv4" : "IPv6",
+	      bgp_table_count (replay.bgp->rib[afi][SAFI_UNICAST]));
+  printf ("Receive:             %lu.%03lu s, %.0f updates/s\n",
+	  fed / 1000, fed % 1000,
+	  fed ? replay.updates * 1000.0 / fed : 0.0);
+  printf ("Until adj-out idle:  %lu.%03lu s, %.0f updates/s\n",
+	  drained / 1000, drained % 1000,
+	  drained ? replay.updates * 1000.0 / drained : 0.0);
+
+  printf ("\n%-40s %10s %10s\n", "Peer", "UPDATEs in", "out");
+  for (ALL_LIST_ELEMENTS_RO (replay.bgp->peer, node, peer))
+    printf ("%-40s %10u %10u\n", peer->host, peer->update_in,
+	    peer->update_out);
+
+  printf ("\n%-28s %10s %12s %12s\n", "Thread function", "Calls",
+	  "CPU ms", "Real ms");
+  for (i = 0; i < REPLAY_FUNC_MAX && replay_func[i].funcname; i++)
+    printf ("%-28s %10lu %12lu %12lu\n", replay_func[i].funcname,
+	    replay_func[i].calls, replay_func[i].cpu / 1000,
+	    replay_func[i].real / 1000);
+
+  printf ("\n%-32s %12s %12s %12s\n", "Memory type", "Current", "Peak",
+	  "Allocations");
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index && mtype_stats_total (m->index))
+	printf ("%-32s %12lu %12lu %12lu\n", m->format,
+		mtype_stats_alloc (m->index), mtype_stats_peak (m->index),
+		mtype_stats_total (m->index));
+
+  if (getrusage (RUSAGE_SELF, &ru) == 0)
+    printf ("\nMaximum resident set size: %ld KiB\n", ru.ru_maxrss);
+}
+
+/* Wait for the process queues and the output peers to go idle. */
+static int
+replay_drain (struct thread *thread)
+{
+  if (replay_pending ())
+    {
+      thread_add_timer_msec (bm->master, replay_drain, NULL, 100);
+      return 0;
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &replay.drained);
+  replay_report ();
+  exit (0);
+}
+
+/* thread_call() with the time spent accounted per thread function. */
+static void
+replay_call (struct thread *thread)
+{
+  RUSAGE_T before, after;
+  unsigned long real, cpu;
+  int i;
+
+  GETRUSAGE (&before);
+  thread_call (thread);
+  GETRUSAGE (&after);
+  real = thread_consumed_time (&after, &before, &cpu);
+
+  for (i = 0; i < REPLAY_FUNC_MAX; i++)
+    if (! replay_func[i].funcname
+	|| ! strcmp (replay_func[i].funcname, thread->funcname))
+      {
+	replay_func[i].funcname = thread->funcname;
+	replay_func[i].calls++;
+	replay_func[i].cpu += cpu;
+	replay_func[i].real += real;
+	break;
+      }
+}
+
+static void
+usage (const char *progname, int status)
+{
+  fprintf (stderr,
+	   "Usage: %s [-f bgpd.conf] [-o outputs] [-n updates] FILE\n\n"
+	   "Replay the BGP4MP UPDATEs of MRT file FILE through bgpd.\n\n"
+	   "-f  configuration to load; its neighbors are output peers\n"
+	   "-o  number of output peers to create, default 1\n"
+	   "-n  stop after this many UPDATEs\n", progname);
+  exit (status);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct thread thread;
+  const char *config = NULL;
+  struct listnode *node;
+  struct peer *peer;
+  unsigned long outputs = 1;
+  unsigned long i;
+  int opt;
+
+  replay.max_updates = ULONG_MAX;
+  while ((opt = getopt (argc, argv, "f:o:n:h")) != -1)
+    switch (opt)
+      {
+      case 'f':
+	config = optarg;
+	break;
+      case 'o':
+	outputs = strtoul (optarg, NULL, 10);
+	break;
+      case 'n':
+	replay.max_updates = strtoul (optarg, NULL, 10);
+	break;
+      case 'h':
+	usage (argv[0], 0);
+	break;
+      default:
+	usage (argv[0], 1);
+	break;
+      }
+  if (optind != argc - 1)
+    usage (argv[0], 1);
+
+  if ((replay.fp = fopen (argv[optind], "r")) == NULL)
+    {
+      fprintf (stderr, "%s: %s\n", argv[optind], safe_strerror (errno));
+      exit (1);
+    }
+  replay.s = stream_new (BGP_MAX_PACKET_SIZE + 4096);
+
+  zlog_default = openzlog ("bgpmrtreplay", ZLOG_BGP,
+			   LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  cmd_init (1);
+  vty_init (bm->master);
+  memory_init ();
+  vrf_init ();
+  bgp_init ();
+
+  /* Routes stay in the RIB; nothing is sent to zebra. */
+  zclient_stop (zclient);
+
+  if (config)
+    {
+      vty_read_config ((char *) config, NULL);
+      replay.bgp = bgp_get_default ();
+      if (! replay.bgp)
+	{
+	  fprintf (stderr, "%s: no router bgp configured\n", config);
+	  exit (1);
+	}
+    }
+  else
+    {
+      as_t as = 64496;
+      struct in_addr id;
+
+      inet_aton ("192.0.2.254", &id);
+      bgp_get (&replay.bgp, &as, NULL);
+      bgp_router_id_set (replay.bgp, &id);
+
+      for (i = 0; i < outputs; i++)
+	{
+	  union sockunion su;
+	  as_t remote_as = 65000 + i;
+
+	  memset (&su, 0, sizeof (su));
+	  su.sin.sin_family = AF_INET;
+	  su.sin.sin_addr.s_addr = htonl (0xc6336400 + i + 1); /* 198.51.100/24 */
+	  peer_remote_as (replay.bgp, &su, &remote_as, AFI_IP, SAFI_UNICAST);
+	}
+    }
+
+  /* Whatever is configured so far receives the replayed routes. */
+  for (ALL_LIST_ELEMENTS_RO (replay.bgp->peer, node, peer))
+    {
+      peer->nexthop.v4.s_addr = htonl (0xc0000201); /* 192.0.2.1 */
+      replay_peer_establish (peer, 1);
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &replay.start);
+  thread_add_background (bm->master, replay_update, NULL, 0);
+
+  while (thread_fetch (bm->master, &thread))
+    replay_call (&thread);
+
+  return 0;
+}
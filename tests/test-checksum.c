@@ -469,6 +469,66 @@ in_cksum_rfc(void *parg, int count)
 }
 
 
+/* Throughput of the library checksums against the reference copies
+   above, run with "testchecksum bench". */
+static double
+bench_rate (int (*f) (u_char *, size_t), u_char *buffer, size_t len)
+{
+  struct timeval start, end;
+  double secs;
+  long i, iters;
+
+  iters = (256L << 20) / len;
+  gettimeofday (&start, NULL);
+  for (i = 0; i < iters; i++)
+    f (buffer, len);
+  gettimeofday (&end, NULL);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  return secs > 0 ? (double) (iters * len) / secs / (1 << 20) : 0;
+}
+
+static int
+bench_in_cksum_rfc (u_char *buffer, size_t len)
+{
+  return in_cksum_rfc (buffer, len);
+}
+
+static int
+bench_in_cksum (u_char *buffer, size_t len)
+{
+  return in_cksum (buffer, len);
+}
+
+static int
+bench_ospfd (u_char *buffer, size_t len)
+{
+  return ospfd_checksum (buffer, len, len - sizeof (u_int16_t));
+}
+
+static int
+bench_fletcher (u_char *buffer, size_t len)
+{
+  return fletcher_checksum (buffer, len, len - sizeof (u_int16_t));
+}
+
+static void
+bench (u_char *buffer)
+{
+  static const size_t sizes[] = { 64, 1500, 8192, 60000 };
+  unsigned int i;
+
+  for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      printf ("%6zu bytes: in_cksum %8.1f MB/s (reference %8.1f MB/s)\n",
+	      sizes[i], bench_rate (bench_in_cksum, buffer, sizes[i]),
+	      bench_rate (bench_in_cksum_rfc, buffer, sizes[i]));
+      printf ("%6zu bytes: fletcher %8.1f MB/s (reference %8.1f MB/s)\n",
+	      sizes[i], bench_rate (bench_fletcher, buffer, sizes[i]),
+	      bench_rate (bench_ospfd, buffer, sizes[i]));
+    }
+}
+
 int
 main(int argc, char **argv)
 {
@@ -477,13 +537,22 @@ main(int argc, char **argv)
 #define BUFSIZE MAXDATALEN + sizeof(u_int16_t)
   u_char buffer[BUFSIZE];
   int exercise = 0;
+  int i;
 #define EXERCISESTEP 257
   
   srandom (time (NULL));
   
+  if (argc > 1 && strcmp (argv[1], "bench") == 0)
+    {
+      for (i = 0; i < MAXDATALEN; i++)
+        buffer[i] = random ();
+      bench (buffer);
+      return 0;
+    }
+
   while (1) {
     u_int16_t ospfd, isisd, lib, in_csum, in_csum_res, in_csum_rfc;
-    int i,j;
+    int j;
 
     exercise += EXERCISESTEP;
     exercise %= MAXDATALEN;
@@ -503,6 +572,12 @@ main(int argc, char **argv)
 	      "in_csum_rfc %x, len:%d\n", 
 	      in_csum, in_csum_res, in_csum_rfc, exercise);
 
+    /* in_cksum must not care about the alignment of its buffer */
+    if (exercise > 1
+        && in_cksum (buffer + 1, exercise - 1)
+           != (u_int16_t) in_cksum_rfc (buffer + 1, exercise - 1))
+      printf ("verify: unaligned in_chksum failed, len:%d\n", exercise - 1);
+
     ospfd = ospfd_checksum (buffer, exercise + sizeof(u_int16_t), exercise);
     if (verify (buffer, exercise + sizeof(u_int16_t)))
       printf ("verify: ospfd failed\n");
@@ -0,0 +1,190 @@
+/*
+ * Benchmark of configuration loading through lib/command.c
+ *
+ * Installs the commands of all daemons (from vtysh's extracted command
+ * list, as testcommands does) and times executing a generated
+ * configuration the way vty_read_config() does: each line is split into
+ * words and matched strictly against the commands of its node.  The
+ * configuration is modelled on large generated bgpd.conf files: prefix
+ * lists, neighbor statements and route-maps, plus some interface
+ * addresses.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#define REALLY_NEED_PLAIN_GETOPT 1
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "memory.h"
+#include "vector.h"
+#include "vty.h"
+
+extern vector cmdvec;
+extern void test_init_cmd(void); /* provided in test-commands-defun.c */
+
+struct thread_master *master; /* dummy for libzebra*/
+
+/* One per node type which cmd_init() doesn't install itself. */
+static struct cmd_node test_nodes[VTY_NODE + 1];
+
+static unsigned long executed;
+
+static int
+test_callback(struct cmd_element *cmd, struct vty *vty, int argc, const char *argv[])
+{
+  executed++;
+  return CMD_SUCCESS;
+}
+
+static void
+test_init(void)
+{
+  unsigned int node;
+  unsigned int i;
+  struct cmd_node *cnode;
+  struct cmd_element *cmd;
+
+  cmd_init(1);
+
+  for (node = 0; node <= VTY_NODE; node++)
+    if (vector_lookup(cmdvec, node) == NULL)
+      {
+        test_nodes[node].node = node;
+        test_nodes[node].prompt = "%s(config)# ";
+        install_node(&test_nodes[node], NULL);
+      }
+
+  test_init_cmd();
+
+  for (node = 0; node < vector_active(cmdvec); node++)
+    if ((cnode = vector_slot(cmdvec, node)) != NULL)
+      for (i = 0; i < vector_active(cnode->cmd_vector); i++)
+        if ((cmd = vector_slot(cnode->cmd_vector, i)) != NULL)
+          {
+            cmd->daemon = 0;
+            cmd->func = test_callback;
+          }
+  vty_init_vtysh();
+}
+
+/* Generate line n of the configuration and the node it belongs to. */
+static enum node_type
+test_line(unsigned int n, char *buf, size_t size)
+{
+  unsigned int a = (n >> 16) & 0xff, b = (n >> 8) & 0xff, c = n & 0xff;
+
+  switch (n % 8)
+    {
+    case 0:
+    case 1:
+    case 2:
+      snprintf(buf, size, "ip prefix-list PL-%u seq %u permit 10.%u.%u.0/24 le 32",
+               n / 64, n % 64 + 5, a, b);
+      return CONFIG_NODE;
+    case 3:
+      snprintf(buf, size, "neighbor 192.%u.%u.%u remote-as %u",
+               a, b, c, 64512 + n % 1000);
+      return BGP_NODE;
+    case 4:
+      snprintf(buf, size, "neighbor 192.%u.%u.%u description customer %u",
+               a, b, c, n);
+      return BGP_NODE;
+    case 5:
+      snprintf(buf, size, "neighbor 192.%u.%u.%u route-map RM-%u in",
+               a, b, c, n / 64);
+      return BGP_IPV4_NODE;
+    case 6:
+      snprintf(buf, size, "match ip address prefix-list PL-%u", n / 64);
+      return RMAP_NODE;
+    default:
+      snprintf(buf, size, "ip address 172.%u.%u.%u/31", a, b, c & 0xfe);
+      return INTERFACE_NODE;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+  int opt;
+  struct vty *vty;
+  unsigned int lines;
+  unsigned int n;
+  unsigned long failed;
+  char buf[256];
+  vector vline;
+  int ret;
+  struct timeval tv_start, tv_stop;
+  unsigned long t_load;
+
+  lines = 300000;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'n':
+          lines = atoi(optarg);
+          break;
+        default:
+          fprintf(stderr, "Usage: %s [-n <lines>]\n", argv[0]);
+          exit(1);
+          break;
+        }
+    }
+
+  test_init();
+
+  vty = vty_new();
+  vty->type = VTY_TERM;
+
+  failed = 0;
+  quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv_start);
+
+  for (n = 0; n < lines; n++)
+    {
+      vty->node = test_line(n, buf, sizeof(buf));
+      vline = cmd_make_strvec(buf);
+      ret = cmd_execute_command_strict(vline, vty, NULL);
+      cmd_free_strvec(vline);
+      if (ret != CMD_SUCCESS)
+        {
+          if (!failed)
+            fprintf(stderr, "'%s'@%d: rv==%d\n", buf, vty->node, ret);
+          failed++;
+        }
+    }
+
+  quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv_stop);
+
+  t_load = 1000 * (tv_stop.tv_sec - tv_start.tv_sec);
+  t_load += (tv_stop.tv_usec - tv_start.tv_usec) / 1000;
+
+  printf("Loading %u configuration lines took %ld.%03ld seconds.\n",
+         lines, t_load / 1000, t_load % 1000);
+  if (failed)
+    printf("%lu lines failed to execute.\n", failed);
+  fflush(stdout);
+
+  vty_close(vty);
+  cmd_terminate();
+  return failed || executed != lines;
+}
@@ -0,0 +1,256 @@
+/*
+ * Hash table test.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "hash.h"
+
+struct thread_master *master;
+
+#define NVALUES 4096
+
+/* The entries are pointers into values, whether one is in the table
+   is tracked in present. */
+static unsigned int values[NVALUES];
+static int present[NVALUES];
+static int seen[NVALUES];
+
+static unsigned int
+test_hash_key (void *data)
+{
+  return *(unsigned int *) data * 2654435761U;
+}
+
+/* Identity key, so that the chained table gets long chains. */
+static unsigned int
+test_hash_key_weak (void *data)
+{
+  return *(unsigned int *) data;
+}
+
+static int
+test_hash_cmp (const void *a, const void *b)
+{
+  return *(const unsigned int *) a == *(const unsigned int *) b;
+}
+
+static struct hash *
+test_hash_create (int open)
+{
+  if (open)
+    return hash_create_open (16, test_hash_key, test_hash_cmp);
+  return hash_create_size (256, test_hash_key_weak, test_hash_cmp);
+}
+
+static int
+test_hash_expanding (struct hash *hash)
+{
+  return hash->old_index != NULL || hash->old_slots != NULL;
+}
+
+static void
+test_hash_seen (struct hash_backet *backet, void *arg)
+{
+  unsigned int *v = backet->data;
+
+  assert (v >= values && v < values + NVALUES);
+  assert (present[v - values]);
+  seen[v - values]++;
+}
+
+/* Check the table holds exactly the present values, iterating first so
+   that lookups do not move the table on. */
+static void
+verify_hash (struct hash *hash)
+{
+  unsigned int i, n = 0;
+  void *found;
+
+  memset (seen, 0, sizeof (seen));
+  hash_iterate (hash, test_hash_seen, NULL);
+
+  for (i = 0; i < NVALUES; i++)
+    {
+      found = hash_lookup (hash, &values[i]);
+      assert (seen[i] == present[i]);
+      assert (found == (present[i] ? &values[i] : NULL));
+      n += present[i];
+    }
+  assert (hash->count == n);
+}
+
+static void
+test_hash_add (struct hash *hash, unsigned int i)
+{
+  void *ret;
+
+  ret = hash_get (hash, &values[i], hash_alloc_intern);
+  assert (ret == &values[i]);
+  present[i] = 1;
+}
+
+static void
+test_hash_del (struct hash *hash, unsigned int i)
+{
+  void *ret;
+
+  ret = hash_release (hash, &values[i]);
+  assert (ret == &values[i]);
+  ret = hash_release (hash, &values[i]);
+  assert (ret == NULL);
+  present[i] = 0;
+}
+
+static void
+test_hash_reset (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < NVALUES; i++)
+    values[i] = i * 7 + 1;
+  memset (present, 0, sizeof (present));
+}
+
+/* Fill a table, checking it while expansions are part way through, then
+   empty it again. */
+static void
+test_grow (int open)
+{
+  struct hash *hash;
+  unsigned int i, size;
+  int migrations = 0;
+
+  test_hash_reset ();
+  hash = test_hash_create (open);
+  size = hash->size;
+
+  for (i = 0; i < NVALUES; i++)
+    {
+      test_hash_add (hash, i);
+      /* Adding it again finds the same entry. */
+      test_hash_add (hash, i);
+      if (test_hash_expanding (hash) && (i & 15) == 0)
+	{
+	  verify_hash (hash);
+	  migrations++;
+	}
+    }
+  assert (migrations > 0);
+  assert (hash->size > size);
+  verify_hash (hash);
+
+  for (i = 0; i < NVALUES; i += 2)
+    test_hash_del (hash, i);
+  verify_hash (hash);
+  for (i = 1; i < NVALUES; i += 2)
+    test_hash_del (hash, i);
+  verify_hash (hash);
+  assert (hash->count == 0);
+
+  hash_clean (hash, NULL);
+  hash_free (hash);
+
+  printf ("Verified growing %s table\n", open ? "open" : "chained");
+}
+
+struct test_release_arg
+{
+  struct hash *hash;
+  int open;
+};
+
+/* Release every third entry visited.  Open tables also allow releasing
+   entries other than the current one, so the one after it goes too. */
+static void
+test_hash_release_some (struct hash_backet *backet, void *arg)
+{
+  struct test_release_arg *ra = arg;
+  unsigned int *v = backet->data;
+  unsigned int i = v - values, j;
+
+  test_hash_seen (backet, NULL);
+  if (i % 3)
+    return;
+
+  test_hash_del (ra->hash, i);
+  if (ra->open && (j = i + 1) < NVALUES && present[j] && ! seen[j])
+    {
+      /* Neither found nor visited after this. */
+      test_hash_del (ra->hash, j);
+    }
+}
+
+/* Release entries from within hash_iterate(), with and without an
+   expansion under way. */
+static void
+test_release_iterating (int open)
+{
+  struct test_release_arg ra;
+  unsigned int i, n;
+  int expanding;
+
+  for (expanding = 0; expanding <= 1; expanding++)
+    {
+      test_hash_reset ();
+      ra.hash = test_hash_create (open);
+      ra.open = open;
+
+      for (n = 0; n < NVALUES; )
+	{
+	  test_hash_add (ra.hash, n++);
+	  if (expanding && n > NVALUES / 4 && test_hash_expanding (ra.hash))
+	    break;
+	}
+      while (! expanding && test_hash_expanding (ra.hash))
+	hash_lookup (ra.hash, &values[0]);
+      assert (test_hash_expanding (ra.hash) == expanding);
+
+      memset (seen, 0, sizeof (seen));
+      hash_iterate (ra.hash, test_hash_release_some, &ra);
+
+      for (i = 0; i < n; i++)
+	assert (seen[i] == 1 || (! present[i] && i % 3 == 1 && open));
+      assert (ra.hash->released == 0);
+      verify_hash (ra.hash);
+
+      /* The table still works normally afterwards. */
+      for (i = 0; i < n; i++)
+	if (! present[i])
+	  test_hash_add (ra.hash, i);
+      verify_hash (ra.hash);
+
+      hash_clean (ra.hash, NULL);
+      hash_free (ra.hash);
+    }
+
+  printf ("Verified releasing while iterating %s table\n",
+	  open ? "open" : "chained");
+}
+
+int
+main (void)
+{
+  test_grow (0);
+  test_grow (1);
+  test_release_iterating (0);
+  test_release_iterating (1);
+  return 0;
+}
@@ -1,6 +1,6 @@
 /*
  * Test program which measures the time it takes to schedule and
- * remove timers.
+ * remove timers, with and without the timer wheel.
  *
  * Copyright (C) 2013 by Open Source Routing.
  * Copyright (C) 2013 by Internet Systems Consortium, Inc. ("ISC")
@@ -42,17 +42,31 @@ static int dummy_func(struct thread *thread)
   return 0;
 }
 
-int main(int argc, char **argv)
+/* Run the same schedule and remove workload against the timer heap
+ * alone, or with the timer wheel in front of it. */
+static void run_backend(const char *name, int wheel)
 {
   struct prng *prng;
   int i;
   struct thread **timers;
+  long *intervals;
+  int *indices;
   struct timeval tv_start, tv_lap, tv_stop;
   unsigned long t_schedule, t_remove;
 
   master = thread_master_create();
+  thread_master_timer_wheel(master, wheel);
   prng = prng_new(0);
   timers = calloc(SCHEDULE_TIMERS, sizeof(*timers));
+  intervals = calloc(SCHEDULE_TIMERS, sizeof(*intervals));
+  indices = calloc(REMOVE_TIMERS, sizeof(*indices));
+
+  /* draw the workload up front so only the timer operations are
+   * measured */
+  for (i = 0; i < SCHEDULE_TIMERS; i++)
+    intervals[i] = prng_rand(prng) % (100 * SCHEDULE_TIMERS);
+  for (i = 0; i < REMOVE_TIMERS; i++)
+    indices[i] = prng_rand(prng) % SCHEDULE_TIMERS;
 
   /* create thread structures so they won't be allocated during the
    * time measurement */
@@ -64,13 +78,8 @@ int main(int argc, char **argv)
   quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv_start);
 
   for (i = 0; i < SCHEDULE_TIMERS; i++)
-    {
-      long interval_msec;
-
-      interval_msec = prng_rand(prng) % (100 * SCHEDULE_TIMERS);
-      timers[i] = thread_add_timer_msec(master, dummy_func,
-                                        NULL, interval_msec);
-    }
+    timers[i] = thread_add_timer_msec(master, dummy_func,
+                                      NULL, intervals[i]);
 
   quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv_lap);
 
@@ -78,7 +87,7 @@ int main(int argc, char **argv)
     {
       int index;
 
-      index = prng_rand(prng) % SCHEDULE_TIMERS;
+      index = indices[i];
       if (timers[index])
         thread_cancel(timers[index]);
       timers[index] = NULL;
@@ -92,14 +101,22 @@ int main(int argc, char **argv)
   t_remove = 1000 * (tv_stop.tv_sec - tv_lap.tv_sec);
   t_remove += (tv_stop.tv_usec - tv_lap.tv_usec) / 1000;
 
-  printf("Scheduling %d random timers took %ld.%03ld seconds.\n",
-         SCHEDULE_TIMERS, t_schedule/1000, t_schedule%1000);
-  printf("Removing %d random timers took %ld.%03ld seconds.\n",
-         REMOVE_TIMERS, t_remove/1000, t_remove%1000);
+  printf("%s: Scheduling %d random timers took %ld.%03ld seconds.\n",
+         name, SCHEDULE_TIMERS, t_schedule/1000, t_schedule%1000);
+  printf("%s: Removing %d random timers took %ld.%03ld seconds.\n",
+         name, REMOVE_TIMERS, t_remove/1000, t_remove%1000);
   fflush(stdout);
 
   free(timers);
+  free(intervals);
+  free(indices);
   thread_master_free(master);
   prng_free(prng);
+}
+
+int main(int argc, char **argv)
+{
+  run_backend("heap", 0);
+  run_backend("wheel", 1);
   return 0;
 }
@@ -0,0 +1,242 @@
+/*
+ * Zebra RIB test.
+ *
+ * Two recursive routes, each resolving through a route within the
+ * other's prefix, must settle rather than keep queueing each other, and
+ * still follow real changes of how their gateways resolve.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <zebra.h>
+
+#include "command.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "vrf.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+
+/* need these to link in zebra */
+struct zebra_t zebrad = { .rtm_table_default = 0, };
+struct thread_master *master = NULL;
+pid_t pid;
+
+extern int rib_process_hold_time;
+
+static int failed = 0;
+
+#define TEST_FAIL(...)                                                \
+  do {                                                                \
+    failed++;                                                         \
+    printf (__VA_ARGS__);                                             \
+    printf ("\n");                                                    \
+  } while (0)
+
+/* Work queue runs after which the queue counts as never draining. */
+#define MAX_RUNS    200
+
+static struct interface *ifp1, *ifp2;
+
+static int
+test_vrf_new (vrf_id_t vrf_id, void **info)
+{
+  if (! *info)
+    *info = zebra_vrf_alloc (vrf_id);
+  return 0;
+}
+
+static void
+test_init (void)
+{
+  zebrad.master = thread_master_create ();
+  cmd_init (1);
+  rib_process_hold_time = 0;
+  rib_init ();
+  vrf_add_hook (VRF_NEW_HOOK, test_vrf_new);
+  vrf_init ();
+
+  ifp1 = if_get_by_name_vrf ("eth1", VRF_DEFAULT);
+  if_set_index (ifp1, 1);
+  ifp1->flags = IFF_UP | IFF_RUNNING;
+  ifp2 = if_get_by_name_vrf ("eth2", VRF_DEFAULT);
+  if_set_index (ifp2, 2);
+  ifp2->flags = IFF_UP | IFF_RUNNING;
+}
+
+/* Process the queued route nodes, as long as the queue drains within
+   MAX_RUNS runs.  Returns the number of runs, or -1. */
+static int
+test_run (void)
+{
+  struct thread thread;
+  int runs;
+
+  for (runs = 0; zebrad.mq->size; runs++)
+    {
+      if (runs == MAX_RUNS)
+	return -1;
+      thread_fetch (zebrad.master, &thread);
+      thread_call (&thread);
+    }
+  return runs;
+}
+
+static void
+test_prefix (struct prefix_ipv4 *p, const char *str)
+{
+  int ret = str2prefix_ipv4 (str, p);
+
+  assert (ret);
+}
+
+static void
+test_add_static (const char *str, struct interface *ifp)
+{
+  struct prefix_ipv4 p;
+
+  test_prefix (&p, str);
+  rib_add_ipv4 (ZEBRA_ROUTE_STATIC, 0, &p, NULL, NULL, ifp->ifindex,
+		VRF_DEFAULT, 0, 0, 0, 1, SAFI_UNICAST);
+}
+
+static void
+test_delete_static (const char *str, struct interface *ifp)
+{
+  struct prefix_ipv4 p;
+
+  test_prefix (&p, str);
+  rib_delete_ipv4 (ZEBRA_ROUTE_STATIC, 0, &p, NULL, ifp->ifindex,
+		   VRF_DEFAULT, SAFI_UNICAST);
+}
+
+static void
+test_add_ibgp (const char *str, const char *gate)
+{
+  struct prefix_ipv4 p;
+  struct in_addr addr;
+
+  test_prefix (&p, str);
+  inet_pton (AF_INET, gate, &addr);
+  rib_add_ipv4 (ZEBRA_ROUTE_BGP, ZEBRA_FLAG_INTERNAL, &p, &addr, NULL, 0,
+		VRF_DEFAULT, 0, 0, 0, 200, SAFI_UNICAST);
+}
+
+static struct route_node *
+test_lookup (const char *str)
+{
+  struct prefix_ipv4 p;
+
+  test_prefix (&p, str);
+  return route_node_lookup (zebra_vrf_table (AFI_IP, SAFI_UNICAST,
+					     VRF_DEFAULT),
+			    (struct prefix *) &p);
+}
+
+static void
+test_requeue (const char *str)
+{
+  struct route_node *rn = test_lookup (str);
+
+  assert (rn);
+  rib_queue_add (&zebrad, rn);
+  route_unlock_node (rn);
+}
+
+/* The interface the route to 'str' goes out of in the FIB, through its
+   resolved nexthop, 0 if it is not in the FIB that way. */
+static ifindex_t
+test_fib_ifindex (const char *str)
+{
+  struct route_node *rn = test_lookup (str);
+  struct rib *rib;
+  struct nexthop *nh;
+  ifindex_t ifindex = 0;
+
+  if (! rn)
+    return 0;
+
+  RNODE_FOREACH_RIB (rn, rib)
+    if (CHECK_FLAG (rib->status, RIB_ENTRY_SELECTED_FIB))
+      for (nh = rib->nexthop; nh; nh = nh->next)
+	if (nexthop_has_fib_child (nh))
+	  ifindex = nh->resolved->ifindex;
+  route_unlock_node (rn);
+  return ifindex;
+}
+
+static void
+test_check (const char *what, ifindex_t want_a, ifindex_t want_b)
+{
+  int runs = test_run ();
+  ifindex_t a, b;
+
+  if (runs < 0)
+    TEST_FAIL ("%s: route nodes still queued after %d runs", what, MAX_RUNS);
+
+  a = test_fib_ifindex ("10.0.0.0/8");
+  b = test_fib_ifindex ("20.0.0.0/8");
+  if (a != want_a || b != want_b)
+    TEST_FAIL ("%s: routes out of %d and %d, expected %d and %d", what,
+	       a, b, want_a, want_b);
+}
+
+/* 10.0.0.0/8 goes via 20.1.1.1, within 20.0.0.0/8, which goes via
+   10.1.1.1, within 10.0.0.0/8.  Both resolve through the more specific
+   interface routes below the other. */
+static void
+test_mutual (void)
+{
+  test_add_static ("10.1.1.0/24", ifp1);
+  test_add_static ("20.1.1.0/24", ifp1);
+  test_add_ibgp ("10.0.0.0/8", "20.1.1.1");
+  test_add_ibgp ("20.0.0.0/8", "10.1.1.1");
+  test_check ("added", 1, 1);
+
+  /* Processing either again changes nothing. */
+  test_requeue ("10.0.0.0/8");
+  test_check ("requeued", 1, 1);
+
+  /* A gateway which moves to another interface is followed.  The static
+     route on eth2 replaces the one on eth1. */
+  test_add_static ("20.1.1.0/24", ifp2);
+  test_check ("moved", 2, 1);
+
+  /* Without a route to it, the first loses its gateway, and the
+     second, whose gateway is within it, still resolves. */
+  test_delete_static ("20.1.1.0/24", ifp2);
+  test_check ("lost", 0, 1);
+
+  test_add_static ("20.1.1.0/24", ifp1);
+  test_check ("back", 1, 1);
+
+  printf ("mutual: recursive routes settled\n");
+}
+
+int
+main (void)
+{
+  test_init ();
+  test_mutual ();
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
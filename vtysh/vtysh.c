@@ -26,12 +26,16 @@
 #include <sys/wait.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <poll.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
 
 #include "command.h"
 #include "memory.h"
+#include "buffer.h"
+#include "linklist.h"
+#include "network.h"
 #include "vtysh/vtysh.h"
 #include "log.h"
 #include "bgpd/bgp_vty.h"
@@ -423,15 +427,284 @@ vtysh_execute (const char *line)
   return vtysh_execute_func (line, 1);
 }
 
+/*
+ * Configuration files are pushed to the daemons without waiting for the
+ * result of each line.  The lines for each daemon are queued and written
+ * out in blocks as its socket takes them, to all daemons at once, while
+ * the replies (the output of a line, three NULs and the status) are
+ * matched up with the lines in the order they were sent.  Failures are
+ * reported with their line number once the whole file is done.
+ */
+#define VTYSH_PUSH_BLOCK	16384	/* queued bytes written out at once */
+#define VTYSH_PUSH_WINDOW	4096	/* lines in flight per daemon */
+
+struct vtysh_push_line
+{
+  unsigned int lineno;
+  char *text;
+};
+
+struct vtysh_push
+{
+  struct buffer *obuf;		/* lines not yet written */
+  struct buffer *output;	/* output of the line being replied to */
+  struct vtysh_push_line *inflight;	/* sent, not replied, circular */
+  unsigned int size;
+  unsigned int head;
+  unsigned int count;
+  int nulls;			/* NULs seen of the reply trailer */
+  size_t queued;		/* bytes queued since last written out */
+  unsigned long lines;
+  unsigned long errors;
+  struct timeval start;
+};
+
+static struct vtysh_push vtysh_push[array_size(vtysh_client)];
+
+struct vtysh_push_error
+{
+  const char *name;
+  unsigned int lineno;
+  int ret;
+  char *text;
+  char *output;
+};
+
+/* Failures of all daemons, by line number */
+static struct list *vtysh_push_errors;
+
+static int
+vtysh_push_error_cmp (void *a, void *b)
+{
+  struct vtysh_push_error *ea = a, *eb = b;
+
+  return ea->lineno < eb->lineno ? -1 : ea->lineno > eb->lineno;
+}
+
+static void
+vtysh_push_error_free (void *arg)
+{
+  struct vtysh_push_error *err = arg;
+
+  XFREE (MTYPE_TMP, err->text);
+  if (err->output)
+    XFREE (MTYPE_TMP, err->output);
+  XFREE (MTYPE_TMP, err);
+}
+
+/* Queue a line for daemon i. */
+static void
+vtysh_push_line (u_int i, unsigned int lineno, const char *line)
+{
+  struct vtysh_push *push = &vtysh_push[i];
+  struct vtysh_push_line *inflight;
+  unsigned int n;
+
+  if (push->obuf == NULL)
+    {
+      push->obuf = buffer_new (0);
+      push->output = buffer_new (0);
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &push->start);
+    }
+
+  if (push->count == push->size)
+    {
+      inflight = XMALLOC (MTYPE_TMP,
+			  (push->size * 2 + 64) * sizeof (*inflight));
+      for (n = 0; n < push->count; n++)
+	inflight[n] = push->inflight[(push->head + n) % push->size];
+      if (push->inflight)
+	XFREE (MTYPE_TMP, push->inflight);
+      push->inflight = inflight;
+      push->size = push->size * 2 + 64;
+      push->head = 0;
+    }
+
+  n = (push->head + push->count++) % push->size;
+  push->inflight[n].lineno = lineno;
+  push->inflight[n].text = XSTRDUP (MTYPE_TMP, line);
+
+  buffer_put (push->obuf, line, strlen (line) + 1);
+  push->queued += strlen (line) + 1;
+  push->lines++;
+}
+
+/* The status of the oldest line in flight to daemon i came back. */
+static void
+vtysh_push_done (u_int i, int ret)
+{
+  struct vtysh_push *push = &vtysh_push[i];
+  struct vtysh_push_line *line = &push->inflight[push->head];
+  struct vtysh_push_error *err;
+  char *output;
+
+  if (ret != CMD_SUCCESS && ret != CMD_ERR_NOTHING_TODO)
+    {
+      err = XCALLOC (MTYPE_TMP, sizeof (struct vtysh_push_error));
+      err->name = vtysh_client[i].name;
+      err->lineno = line->lineno;
+      err->ret = ret;
+      err->text = line->text;
+      err->output = buffer_getstr (push->output);
+      listnode_add_sort (vtysh_push_errors, err);
+      push->errors++;
+    }
+  else
+    {
+      /* Output of successful lines is shown as it comes */
+      if (! buffer_empty (push->output))
+	{
+	  output = buffer_getstr (push->output);
+	  fputs (output, stdout);
+	  XFREE (MTYPE_TMP, output);
+	}
+      XFREE (MTYPE_TMP, line->text);
+    }
+  buffer_reset (push->output);
+
+  push->head = (push->head + 1) % push->size;
+  push->count--;
+}
+
+/* Split what daemon i sent into line output and statuses. */
+static void
+vtysh_push_reply (u_int i, const char *buf, size_t nbytes)
+{
+  struct vtysh_push *push = &vtysh_push[i];
+  const char *p, *end = buf + nbytes;
+
+  for (p = buf; p < end; )
+    {
+      if (push->nulls == 3)
+	{
+	  push->nulls = 0;
+	  if (push->count)
+	    vtysh_push_done (i, (u_char) *p);
+	  p++;
+	}
+      else if (*p == '\0')
+	{
+	  push->nulls++;
+	  p++;
+	}
+      else
+	{
+	  const char *text = p;
+
+	  while (p < end && *p != '\0')
+	    p++;
+	  buffer_put (push->output, text, p - text);
+	  push->nulls = 0;
+	}
+    }
+}
+
+/* Drop what is pending for daemon i after its connection failed. */
+static void
+vtysh_push_abort (u_int i)
+{
+  struct vtysh_push *push = &vtysh_push[i];
+
+  vclient_close (&vtysh_client[i]);
+  buffer_reset (push->obuf);
+  while (push->count)
+    {
+      XFREE (MTYPE_TMP, push->inflight[push->head].text);
+      push->head = (push->head + 1) % push->size;
+      push->count--;
+    }
+}
+
+/* Write out and read back what can be, waiting for the sockets if
+ * wait is set.  Returns how many lines are still in flight. */
+static unsigned int
+vtysh_push_io (int wait)
+{
+  struct pollfd pfd[array_size(vtysh_client)];
+  u_int idx[array_size(vtysh_client)];
+  struct vtysh_push *push;
+  char buf[8192];
+  unsigned int inflight = 0;
+  int nfds = 0, n;
+  ssize_t nbytes;
+  u_int i;
+
+  for (i = 0; i < array_size(vtysh_client); i++)
+    {
+      push = &vtysh_push[i];
+      push->queued = 0;
+      if (vtysh_client[i].fd < 0 || push->count == 0)
+	continue;
+      inflight += push->count;
+      pfd[nfds].fd = vtysh_client[i].fd;
+      pfd[nfds].events = POLLIN;
+      if (! buffer_empty (push->obuf))
+	pfd[nfds].events |= POLLOUT;
+      pfd[nfds].revents = 0;
+      idx[nfds++] = i;
+    }
+
+  if (nfds == 0)
+    return 0;
+
+  if (poll (pfd, nfds, wait ? -1 : 0) < 0)
+    return (errno == EINTR) ? inflight : 0;
+
+  for (n = 0; n < nfds; n++)
+    {
+      i = idx[n];
+      push = &vtysh_push[i];
+
+      if (pfd[n].revents & POLLOUT)
+	if (buffer_flush_available (push->obuf, vtysh_client[i].fd)
+	    == BUFFER_ERROR)
+	  {
+	    vtysh_push_abort (i);
+	    continue;
+	  }
+
+      if (pfd[n].revents & (POLLIN | POLLHUP | POLLERR))
+	{
+	  nbytes = read (vtysh_client[i].fd, buf, sizeof (buf));
+	  if (nbytes > 0)
+	    vtysh_push_reply (i, buf, nbytes);
+	  else if (nbytes == 0 || ! ERRNO_IO_RETRY (errno))
+	    vtysh_push_abort (i);
+	}
+    }
+
+  return inflight;
+}
+
 /* Configration make from file. */
 int
 vtysh_config_from_file (struct vty *vty, FILE *fp)
 {
   int ret;
   struct cmd_element *cmd;
+  unsigned int lineno = 0;
+  struct vtysh_push *push;
+  struct vtysh_push_error *err;
+  struct listnode *node;
+  struct timeval now;
+  unsigned long elapsed;
+  int flags[array_size(vtysh_client)];
+  u_int i;
+
+  vtysh_push_errors = list_new ();
+  vtysh_push_errors->cmp = vtysh_push_error_cmp;
+  vtysh_push_errors->del = vtysh_push_error_free;
+
+  for (i = 0; i < array_size(vtysh_client); i++)
+    if (vtysh_client[i].fd >= 0)
+      {
+	flags[i] = fcntl (vtysh_client[i].fd, F_GETFL);
+	set_nonblocking (vtysh_client[i].fd);
+      }
 
   while (fgets (vty->buf, VTY_BUFSIZ, fp))
     {
+      lineno++;
       ret = command_config_read_one_line (vty, &cmd, 1);
 
       switch (ret)
@@ -451,27 +724,68 @@ vtysh_config_from_file (struct vty *vty, FILE *fp)
 	  break;
 	case CMD_SUCCESS_DAEMON:
 	  {
-	    u_int i;
-	    int cmd_stat = CMD_SUCCESS;
-
 	    for (i = 0; i < array_size(vtysh_client); i++)
-	      {
-	        if (cmd->daemon & vtysh_client[i].flag)
-		  {
-		    cmd_stat = vtysh_client_execute (&vtysh_client[i],
-						     vty->buf, stdout);
-		    if (cmd_stat != CMD_SUCCESS)
+	      if ((cmd->daemon & vtysh_client[i].flag)
+		  && vtysh_client[i].fd >= 0)
+		{
+		  vtysh_push_line (i, lineno, vty->buf);
+
+		  /* Keep a bounded number of lines in flight */
+		  while (vtysh_push[i].count > VTYSH_PUSH_WINDOW)
+		    if (vtysh_push_io (1) == 0)
 		      break;
-		  }
-	      }
-	    if (cmd_stat != CMD_SUCCESS)
-	      break;
+		}
 
 	    if (cmd->func)
 	      (*cmd->func) (cmd, vty, 0, NULL);
 	  }
 	}
+
+      /* Send a node once it's complete, or a block's worth of lines */
+      for (i = 0; i < array_size(vtysh_client); i++)
+	if (vtysh_push[i].obuf
+	    && (vty->node == CONFIG_NODE
+		|| vtysh_push[i].queued >= VTYSH_PUSH_BLOCK))
+	  {
+	    vtysh_push_io (0);
+	    break;
+	  }
     }
+
+  while (vtysh_push_io (1))
+    ;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  for (i = 0; i < array_size(vtysh_client); i++)
+    {
+      push = &vtysh_push[i];
+      if (vtysh_client[i].fd >= 0)
+	fcntl (vtysh_client[i].fd, F_SETFL, flags[i]);
+      if (push->obuf == NULL)
+	continue;
+      if (push->count)
+	vtysh_push_abort (i);
+
+      elapsed = (now.tv_sec - push->start.tv_sec) * 1000
+	+ (now.tv_usec - push->start.tv_usec) / 1000;
+      fprintf (stdout, "%s: %lu lines in %lu.%03lu seconds, %lu failed\n",
+	       vtysh_client[i].name, push->lines,
+	       elapsed / 1000, elapsed % 1000, push->errors);
+
+      buffer_free (push->obuf);
+      buffer_free (push->output);
+      if (push->inflight)
+	XFREE (MTYPE_TMP, push->inflight);
+      memset (push, 0, sizeof (struct vtysh_push));
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (vtysh_push_errors, node, err))
+    fprintf (stdout, "%s: line %u: %s%s",
+	     err->name, err->lineno, err->text,
+	     err->output ? err->output : "");
+  list_delete (vtysh_push_errors);
+  vtysh_push_errors = NULL;
+
   return CMD_SUCCESS;
 }
 
@@ -138,7 +138,7 @@ if_get_index (struct interface *ifp)
 {
 #if defined(HAVE_IF_NAMETOINDEX)
   /* Modern systems should have if_nametoindex(3). */
-  ifp->ifindex = if_nametoindex(ifp->name);
+  if_set_index (ifp, if_nametoindex(ifp->name));
 #elif defined(SIOCGIFINDEX) && !defined(HAVE_BROKEN_ALIASES)
   /* Fall-back for older linuxes. */
   int ret;
@@ -151,15 +151,15 @@ if_get_index (struct interface *ifp)
   if (ret < 0)
     {
       /* Linux 2.0.X does not have interface index. */
-      ifp->ifindex = if_fake_index++;
+      if_set_index (ifp, if_fake_index++);
       return ifp->ifindex;
     }
 
   /* OK we got interface index. */
 #ifdef ifr_ifindex
-  ifp->ifindex = ifreq.ifr_ifindex;
+  if_set_index (ifp, ifreq.ifr_ifindex);
 #else
-  ifp->ifindex = ifreq.ifr_index;
+  if_set_index (ifp, ifreq.ifr_index);
 #endif
 
 #else
@@ -171,7 +171,7 @@ if_get_index (struct interface *ifp)
 #endif
   /* This branch probably won't provide usable results, but anyway... */
   static int if_fake_index = 1;
-  ifp->ifindex = if_fake_index++;
+  if_set_index (ifp, if_fake_index++);
 #endif
 
   return ifp->ifindex;
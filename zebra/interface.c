@@ -481,7 +481,7 @@ if_delete_update (struct interface *ifp)
 		  /* Remove from interface address list (unconditionally). */
 		  if (!CHECK_FLAG (ifc->conf, ZEBRA_IFC_CONFIGURED))
 		    {
-		      listnode_delete (ifp->connected, ifc);
+		      connected_delete (ifp, ifc);
 		      connected_free (ifc);
                     }
                   else
@@ -507,7 +507,7 @@ if_delete_update (struct interface *ifp)
 		last = node;
 	      else
 		{
-		  listnode_delete (ifp->connected, ifc);
+		  connected_delete (ifp, ifc);
 		  connected_free (ifc);
 		}
 	    }
@@ -525,7 +525,7 @@ if_delete_update (struct interface *ifp)
      while processing the deletion.  Each client daemon is responsible
      for setting ifindex to IFINDEX_INTERNAL after processing the
      interface deletion message. */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 }
 
 /* Interface is up. */
@@ -1406,7 +1406,7 @@ ip_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1477,7 +1477,7 @@ ip_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_QUEUED)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -1585,7 +1585,7 @@ ipv6_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1656,7 +1656,7 @@ ipv6_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_QUEUED)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -30,11 +30,30 @@
 #include "zebra/connected.h"
 #include "zebra/rib.h"
 
-int kernel_route_rib (struct prefix *a, struct rib *old, struct rib *new) { return 0; }
+/* Installs always succeed: flag the nexthops the way a kernel which took
+   the route would have them. */
+int kernel_route_rib (struct prefix *a, struct rib *old, struct rib *new)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+
+  if (new)
+    for (ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing))
+      if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+  return 0;
+}
 
 int kernel_add_route (struct prefix_ipv4 *a, struct in_addr *b, int c, int d)
 { return 0; }
 
+int kernel_nhg_supported (void) { return 0; }
+int kernel_nexthop_add (vrf_id_t a, struct nhg_member *b) { return -1; }
+int kernel_nexthop_group_add (struct nhg_entry *a, int b) { return -1; }
+int kernel_nexthop_delete (vrf_id_t a, u_int32_t b) { return -1; }
+void kernel_nexthop_sweep (void) { }
+
 int kernel_address_add_ipv4 (struct interface *a, struct connected *b)
 {
   zlog_debug ("%s", __func__);
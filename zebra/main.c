@@ -60,6 +60,9 @@ int retain_mode = 0;
 /* Don't delete kernel route. */
 int keep_kernel_mode = 0;
 
+/* Seconds clients get to replay their routes on a warm restart. */
+int warm_restart_time = 0;
+
 #ifdef HAVE_NETLINK
 /* Receive buffer size for netlink socket */
 u_int32_t nl_rcvbufsize = 0;
@@ -78,6 +81,7 @@ struct option longopts[] =
   { "vty_addr",    required_argument, NULL, 'A'},
   { "vty_port",    required_argument, NULL, 'P'},
   { "retain",      no_argument,       NULL, 'r'},
+  { "warm_restart", required_argument, NULL, 'w'},
   { "dryrun",      no_argument,       NULL, 'C'},
 #ifdef HAVE_NETLINK
   { "nl-bufsize",  required_argument, NULL, 's'},
@@ -139,6 +143,9 @@ usage (char *progname, int status)
 	      "-P, --vty_port     Set vty's port number\n"\
 	      "-r, --retain       When program terminates, retain added route "\
 				  "by zebra.\n"\
+	      "-w, --warm_restart Keep old routes which installed by zebra "\
+				  "for this many\n"\
+	      "                   seconds, while clients resend theirs.\n"\
 	      "-u, --user         User to run as\n"\
 	      "-g, --group	  Group to run as\n", progname);
 #ifdef HAVE_NETLINK
@@ -310,9 +317,9 @@ main (int argc, char **argv)
       int opt;
   
 #ifdef HAVE_NETLINK  
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vs:C", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:rw:u:g:vs:C", longopts, 0);
 #else
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:rw:u:g:vC", longopts, 0);
 #endif /* HAVE_NETLINK */
 
       if (opt == EOF)
@@ -360,6 +367,14 @@ main (int argc, char **argv)
 	case 'r':
 	  retain_mode = 1;
 	  break;
+	case 'w':
+	  warm_restart_time = atoi (optarg);
+	  if (warm_restart_time <= 0)
+	    {
+	      fprintf (stderr, "Invalid warm restart time: %s\n", optarg);
+	      usage (progname, 1);
+	    }
+	  break;
 #ifdef HAVE_NETLINK
 	case 's':
 	  nl_rcvbufsize = atoi (optarg);
@@ -466,7 +481,9 @@ main (int argc, char **argv)
   *  will be equal to the current getpid(). To know about such routes,
   * we have to have route_read() called before.
   */
-  if (! keep_kernel_mode)
+  if (warm_restart_time)
+    rib_warm_restart (warm_restart_time);
+  else if (! keep_kernel_mode)
     rib_sweep_route ();
 
   /* Needed for BSD routing socket. */
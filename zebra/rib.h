@@ -39,6 +39,8 @@ union g_addr {
 #endif /* HAVE_IPV6 */
 };
 
+struct nhg_entry;
+
 struct rib
 {
   /* Link list. */
@@ -84,6 +86,11 @@ struct rib
 #define RIB_ENTRY_REMOVED	(1 << 0)
 #define RIB_ENTRY_CHANGED	(1 << 1)
 #define RIB_ENTRY_SELECTED_FIB	(1 << 2)
+#define RIB_ENTRY_NHG_FIB	(1 << 3)
+#define RIB_ENTRY_STALE		(1 << 4) /* Left in the kernel by a previous zebra. */
+
+  /* Shared nexthop group this route is installed with, if any. */
+  struct nhg_entry *nhe;
 
   /* Nexthop information. */
   u_char nexthop_num;
@@ -99,10 +106,33 @@ struct rib
  * sub-queue 4: any other origin (if any)
  */
 #define MQ_SIZE 5
+
+/* Wait-time histogram buckets: <1ms, <10ms, <100ms, <1s, <10s, more. */
+#define MQ_WAIT_BUCKETS 6
+
+struct meta_queue_stats
+{
+  u_int32_t max_depth;            /* high-water mark of the sub-queue */
+  u_long processed;               /* route nodes handed to rib_process */
+  u_long wait[MQ_WAIT_BUCKETS];   /* time spent queued, see above */
+  u_long wait_max;                /* longest time spent queued, in ms */
+};
+
+/* Sub-queues with a zero quantum are served in strict priority order,
+ * ahead of all others.  The remaining ones share the rest of the work
+ * queue's time in weighted round-robin, 'quantum' route nodes per
+ * turn.  With no quantum configured this is plain strict priority.
+ */
 struct meta_queue
 {
   struct list *subq[MQ_SIZE];
   u_int32_t size; /* sum of lengths of all subqueues */
+
+  u_int32_t quantum[MQ_SIZE];
+  u_int32_t deficit[MQ_SIZE];
+  u_char current;
+
+  struct meta_queue_stats stats[MQ_SIZE];
 };
 
 /*
@@ -132,6 +162,12 @@ typedef struct rib_dest_t_
    */
   TAILQ_ENTRY(rib_dest_t_) fpm_q_entries;
 
+  /*
+   * Nexthop cache entries the routes were last resolved through, see
+   * nhcache_get ().
+   */
+  struct list *nhcache;
+
 } rib_dest_t;
 
 #define RIB_ROUTE_QUEUED(x)	(1 << (x))
@@ -352,6 +388,9 @@ struct zebra_vrf
   /* Static route configuration.  */
   struct route_table *stable[AFI_MAX][SAFI_MAX];
 
+  /* Recursive nexthop resolution cache, see zebra_rib.c.  */
+  struct route_table *nhcache[AFI_MAX];
+
 #ifdef HAVE_NETLINK
   struct nlsock netlink;     /* kernel messages */
   struct nlsock netlink_cmd; /* command channel */
@@ -478,8 +517,11 @@ extern struct rib *rib_match_ipv4_multicast (struct in_addr addr,
 extern struct rib *rib_lookup_ipv4 (struct prefix_ipv4 *, vrf_id_t);
 
 extern void rib_update (vrf_id_t);
+struct zebra_t;
+extern void rib_queue_add (struct zebra_t *, struct route_node *);
 extern void rib_weed_tables (void);
 extern void rib_sweep_route (void);
+extern void rib_warm_restart (int);
 extern void rib_close_table (struct route_table *);
 extern void rib_close (void);
 extern void rib_init (void);
@@ -32,4 +32,12 @@ extern int kernel_add_route (struct prefix_ipv4 *, struct in_addr *, int, int);
 extern int kernel_address_add_ipv4 (struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4 (struct interface *, struct connected *);
 
+struct nhg_entry;
+struct nhg_member;
+extern int kernel_nhg_supported (void);
+extern int kernel_nexthop_add (vrf_id_t, struct nhg_member *);
+extern int kernel_nexthop_group_add (struct nhg_entry *, int);
+extern int kernel_nexthop_delete (vrf_id_t, u_int32_t);
+extern void kernel_nexthop_sweep (void);
+
 #endif /* _ZEBRA_RT_H */
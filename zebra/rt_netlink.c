@@ -45,8 +45,14 @@
 #include "zebra/interface.h"
 #include "zebra/debug.h"
 
+#include "zebra/zebra_nhg.h"
+
 #include "rt_netlink.h"
 
+#ifdef RTM_NEWNEXTHOP
+#include <linux/nexthop.h>
+#endif /* RTM_NEWNEXTHOP */
+
 static const struct message nlmsg_str[] = {
   {RTM_NEWROUTE, "RTM_NEWROUTE"},
   {RTM_DELROUTE, "RTM_DELROUTE"},
@@ -57,6 +63,11 @@ static const struct message nlmsg_str[] = {
   {RTM_NEWADDR,  "RTM_NEWADDR"},
   {RTM_DELADDR,  "RTM_DELADDR"},
   {RTM_GETADDR,  "RTM_GETADDR"},
+#ifdef RTM_NEWNEXTHOP
+  {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+  {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+  {RTM_GETNEXTHOP, "RTM_GETNEXTHOP"},
+#endif /* RTM_NEWNEXTHOP */
   {0, NULL}
 };
 
@@ -66,6 +77,10 @@ extern struct zebra_privs_t zserv_privs;
 
 extern u_int32_t nl_rcvbufsize;
 
+extern int keep_kernel_mode;
+
+extern int warm_restart_time;
+
 /* Note: on netlink systems, there should be a 1-to-1 mapping between interface
    names and ifindex values. */
 static void
@@ -90,7 +105,7 @@ set_ifindex(struct interface *ifp, ifindex_t ifi_index)
 	  if_delete_update(oifp);
         }
     }
-  ifp->ifindex = ifi_index;
+  if_set_index (ifp, ifi_index);
 }
 
 #ifndef SO_RCVBUFFORCE
@@ -358,7 +373,11 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *,
 	      if (nl == &zvrf->netlink_cmd
 		  && ((msg_type == RTM_DELROUTE &&
 		       (-errnum == ENODEV || -errnum == ESRCH))
-		      || (msg_type == RTM_NEWROUTE && -errnum == EEXIST)))
+		      || (msg_type == RTM_NEWROUTE && -errnum == EEXIST)
+#ifdef RTM_DELNEXTHOP
+		      || (msg_type == RTM_DELNEXTHOP && -errnum == ENOENT)
+#endif /* RTM_DELNEXTHOP */
+		      ))
 		{
 		  if (IS_ZEBRA_DEBUG_KERNEL)
 		    zlog_debug ("%s: error: %s type=%s(%u), seq=%u, pid=%u",
@@ -1668,6 +1687,8 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib)
   int recursing;
   int nexthop_num;
   int discard;
+  int nhg = 0;
+  int ret;
   int family = PREFIX_FAMILY(p);
   const char *routedesc;
 
@@ -1747,6 +1768,14 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib)
       goto skip;
     }
 
+  /* Routes installed through a kernel nexthop object are deleted by
+   * prefix alone. */
+  if (cmd == RTM_DELROUTE && CHECK_FLAG (rib->status, RIB_ENTRY_NHG_FIB))
+    {
+      req.r.rtm_scope = RT_SCOPE_NOWHERE;
+      goto skip;
+    }
+
   /* Count overall nexthops so we can decide whether to use singlepath
    * or multipath case. */
   nexthop_num = 0;
@@ -1766,6 +1795,44 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib)
       nexthop_num++;
     }
 
+#ifdef RTM_NEWNEXTHOP
+  if (cmd == RTM_NEWROUTE && rib->nhe && rib->nhe->installed)
+    {
+      union g_addr *src = NULL;
+
+      /* Reference the shared nexthop group instead. */
+      addattr32 (&req.n, sizeof req, RTA_NH_ID, rib->nhe->id);
+      nhg = 1;
+
+      nexthop_num = 0;
+      for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+        {
+          if (nexthop_num >= rib->nhe->member_num)
+            break;
+          if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+              || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+            continue;
+          if (! src && nexthop->src.ipv4.s_addr
+              && (nexthop->type == NEXTHOP_TYPE_IPV4
+                  || nexthop->type == NEXTHOP_TYPE_IPV4_IFINDEX
+                  || nexthop->type == NEXTHOP_TYPE_IFINDEX))
+            src = &nexthop->src;
+          SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+          nexthop_num++;
+        }
+      if (src)
+        addattr_l (&req.n, sizeof req, RTA_PREFSRC, &src->ipv4, bytelen);
+
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        {
+          char buf[PREFIX_STRLEN];
+          zlog_debug ("netlink_route_multipath(): %s vrf %u via nexthop "
+                      "group %u", prefix2str (p, buf, sizeof(buf)),
+                      zvrf->vrf_id, rib->nhe->id);
+        }
+    }
+  else
+#endif /* RTM_NEWNEXTHOP */
   /* Singlepath case. */
   if (nexthop_num == 1 || MULTIPATH_NUM == 1)
     {
@@ -1856,7 +1923,13 @@ skip:
   snl.nl_family = AF_NETLINK;
 
   /* Talk to netlink socket. */
-  return netlink_talk (&req.n, &zvrf->netlink_cmd, zvrf);
+  ret = netlink_talk (&req.n, &zvrf->netlink_cmd, zvrf);
+
+  if (nhg && ret == 0)
+    SET_FLAG (rib->status, RIB_ENTRY_NHG_FIB);
+  else
+    UNSET_FLAG (rib->status, RIB_ENTRY_NHG_FIB);
+  return ret;
 }
 
 int
@@ -1873,6 +1946,246 @@ kernel_route_rib (struct prefix *p, struct rib *old, struct rib *new)
   return netlink_route_multipath (RTM_NEWROUTE, p, new);
 }
 
+#ifdef RTM_NEWNEXTHOP
+/* Whether the kernel has nexthop objects, as found out by
+   netlink_nexthop_read (); -1 until then. */
+static int nexthop_objects = -1;
+
+/* The nexthop objects left behind by a previous zebra.  After a warm
+   restart they are kept until kernel_nexthop_sweep (), as the routes
+   still forwarding until then point at them. */
+static struct
+{
+  vrf_id_t vrf_id;
+  u_int32_t id;
+} *nexthop_stale;
+static int nexthop_stale_num;
+static int nexthop_stale_max;
+
+static int
+netlink_nexthop_table (struct sockaddr_nl *snl, struct nlmsghdr *h,
+                       vrf_id_t vrf_id)
+{
+  int len;
+  struct nhmsg *nhm;
+  struct rtattr *tb[NHA_MAX + 1];
+  u_int32_t id;
+
+  if (h->nlmsg_type != RTM_NEWNEXTHOP)
+    return 0;
+
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct nhmsg));
+  if (len < 0)
+    return -1;
+
+  nhm = NLMSG_DATA (h);
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, NHA_MAX, (struct rtattr *)
+                        ((char *) nhm + NLMSG_ALIGN (sizeof (struct nhmsg))),
+                        len);
+
+  if (nhm->nh_protocol != RTPROT_ZEBRA || ! tb[NHA_ID])
+    return 0;
+
+  id = *(u_int32_t *) RTA_DATA (tb[NHA_ID]);
+  zebra_nhg_id_floor (id);
+
+  if (nexthop_stale_num == nexthop_stale_max)
+    {
+      nexthop_stale_max = nexthop_stale_max ? nexthop_stale_max * 2 : 64;
+      nexthop_stale = XREALLOC (MTYPE_TMP, nexthop_stale,
+                                nexthop_stale_max * sizeof (*nexthop_stale));
+    }
+  nexthop_stale[nexthop_stale_num].vrf_id = vrf_id;
+  nexthop_stale[nexthop_stale_num++].id = id;
+  return 0;
+}
+
+/* Find out whether the kernel supports nexthop objects, and remove those
+   a previous zebra left behind.  Only called bootstrap time. */
+static void
+netlink_nexthop_read (struct zebra_vrf *zvrf)
+{
+  struct nlsock *nl = &zvrf->netlink_cmd;
+  struct sockaddr_nl snl;
+  int ret;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+  } req;
+
+  if (nl->sock < 0)
+    return;
+
+  memset (&snl, 0, sizeof snl);
+  snl.nl_family = AF_NETLINK;
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_type = RTM_GETNEXTHOP;
+  req.n.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST;
+  req.n.nlmsg_pid = nl->snl.nl_pid;
+  req.n.nlmsg_seq = ++nl->seq;
+
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  ret = sendto (nl->sock, (void *) &req, req.n.nlmsg_len, 0,
+                (struct sockaddr *) &snl, sizeof snl);
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  if (ret >= 0)
+    ret = netlink_parse_info (netlink_nexthop_table, nl, zvrf);
+
+  if (nexthop_objects != 0)
+    nexthop_objects = (ret >= 0);
+  if (ret < 0)
+    {
+      zlog_info ("Kernel nexthop objects not available, "
+                 "installing routes with their own nexthops");
+      return;
+    }
+
+  /* After a warm restart the routes using them are reconciled first. */
+  if (warm_restart_time)
+    return;
+  if (keep_kernel_mode)
+    nexthop_stale_num = 0;
+  else
+    kernel_nexthop_sweep ();
+}
+
+int
+kernel_nhg_supported (void)
+{
+  return nexthop_objects > 0;
+}
+
+static int
+netlink_nexthop (int cmd, int flags, struct nhg_entry *nhe,
+                 struct nhg_member *member, vrf_id_t vrf_id, u_int32_t id)
+{
+  static const union g_addr any;
+  struct zebra_vrf *zvrf = vrf_info_lookup (vrf_id);
+  struct nexthop_grp grp[MULTIPATH_NUM];
+  int bytelen;
+  int i;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[NL_PKT_BUF_SIZE];
+  } req;
+
+  if (! zvrf || nexthop_objects <= 0)
+    return -1;
+
+  memset (&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = flags | NLM_F_REQUEST;
+  req.n.nlmsg_type = cmd;
+  req.nhm.nh_family = AF_UNSPEC;
+  if (cmd == RTM_NEWNEXTHOP)
+    req.nhm.nh_protocol = RTPROT_ZEBRA;
+
+  addattr32 (&req.n, sizeof req, NHA_ID, id);
+
+  if (member)
+    {
+      /* A single nexthop. */
+      bytelen = (member->family == AF_INET ? 4 : 16);
+      req.nhm.nh_family = member->family;
+      if (member->onlink)
+        req.nhm.nh_flags |= RTNH_F_ONLINK;
+      addattr32 (&req.n, sizeof req, NHA_OIF, member->ifindex);
+      if (memcmp (&member->gate, &any, bytelen))
+        addattr_l (&req.n, sizeof req, NHA_GATEWAY, &member->gate, bytelen);
+    }
+  else if (nhe)
+    {
+      /* A group of them, with equal weights. */
+      memset (grp, 0, sizeof grp);
+      for (i = 0; i < nhe->member_num; i++)
+        grp[i].id = nhe->member[i].id;
+      addattr_l (&req.n, sizeof req, NHA_GROUP, grp,
+                 nhe->member_num * sizeof (struct nexthop_grp));
+    }
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("netlink_nexthop(): %s id %u vrf %u",
+                lookup (nlmsg_str, cmd), id, vrf_id);
+
+  return netlink_talk (&req.n, &zvrf->netlink_cmd, zvrf);
+}
+
+int
+kernel_nexthop_add (vrf_id_t vrf_id, struct nhg_member *member)
+{
+  return netlink_nexthop (RTM_NEWNEXTHOP, NLM_F_CREATE | NLM_F_REPLACE,
+                          NULL, member, vrf_id, member->id);
+}
+
+/* With 'replace' set the group must exist already, so that a group the
+   kernel removed is noticed. */
+int
+kernel_nexthop_group_add (struct nhg_entry *nhe, int replace)
+{
+  return netlink_nexthop (RTM_NEWNEXTHOP,
+                          replace ? NLM_F_REPLACE
+                                  : NLM_F_CREATE | NLM_F_REPLACE,
+                          nhe, NULL, nhe->vrf_id, nhe->id);
+}
+
+int
+kernel_nexthop_delete (vrf_id_t vrf_id, u_int32_t id)
+{
+  return netlink_nexthop (RTM_DELNEXTHOP, 0, NULL, NULL, vrf_id, id);
+}
+
+/* Remove the nexthop objects a previous zebra left behind. */
+void
+kernel_nexthop_sweep (void)
+{
+  int i;
+
+  for (i = 0; i < nexthop_stale_num; i++)
+    kernel_nexthop_delete (nexthop_stale[i].vrf_id, nexthop_stale[i].id);
+  nexthop_stale_num = 0;
+}
+#else /* ! RTM_NEWNEXTHOP */
+int
+kernel_nhg_supported (void)
+{
+  return 0;
+}
+
+int
+kernel_nexthop_add (vrf_id_t vrf_id, struct nhg_member *member)
+{
+  return -1;
+}
+
+int
+kernel_nexthop_group_add (struct nhg_entry *nhe, int replace)
+{
+  return -1;
+}
+
+int
+kernel_nexthop_delete (vrf_id_t vrf_id, u_int32_t id)
+{
+  return -1;
+}
+
+void
+kernel_nexthop_sweep (void)
+{
+}
+#endif /* RTM_NEWNEXTHOP */
+
 /* Interface address modification. */
 static int
 netlink_address (int cmd, int family, struct interface *ifp,
@@ -1997,6 +2310,10 @@ kernel_init (struct zebra_vrf *zvrf)
   netlink_socket (&zvrf->netlink, groups, zvrf->vrf_id);
   netlink_socket (&zvrf->netlink_cmd, 0, zvrf->vrf_id);
 
+#ifdef RTM_NEWNEXTHOP
+  netlink_nexthop_read (zvrf);
+#endif /* RTM_NEWNEXTHOP */
+
   /* Register kernel socket. */
   if (zvrf->netlink.sock > 0)
     {
@@ -395,3 +395,33 @@ kernel_route_rib (struct prefix *p, struct rib *old, struct rib *new)
 
   return route;
 }
+
+/* Routing sockets have no nexthop objects. */
+int
+kernel_nhg_supported (void)
+{
+  return 0;
+}
+
+int
+kernel_nexthop_add (vrf_id_t vrf_id, struct nhg_member *member)
+{
+  return -1;
+}
+
+int
+kernel_nexthop_group_add (struct nhg_entry *nhe, int replace)
+{
+  return -1;
+}
+
+int
+kernel_nexthop_delete (vrf_id_t vrf_id, u_int32_t id)
+{
+  return -1;
+}
+
+void
+kernel_nexthop_sweep (void)
+{
+}
@@ -122,7 +122,7 @@ DEFUN (test_interface_state,
   ifp = vty->index;
   if (ifp->ifindex == IFINDEX_INTERNAL)
     {
-      ifp->ifindex = ++test_ifindex;
+      if_set_index (ifp, ++test_ifindex);
       ifp->mtu = 1500;
       ifp->flags = IFF_BROADCAST|IFF_MULTICAST;
     }
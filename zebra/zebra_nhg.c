@@ -0,0 +1,586 @@
+/*
+ * Zebra shared nexthop groups.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "table.h"
+#include "memory.h"
+#include "command.h"
+#include "log.h"
+#include "hash.h"
+#include "jhash.h"
+#include "vrf.h"
+
+#include "zebra/rib.h"
+#include "zebra/rt.h"
+#include "zebra/zserv.h"
+#include "zebra/debug.h"
+#include "zebra/zebra_nhg.h"
+
+extern struct zebra_t zebrad;
+
+/* All nexthop groups, keyed by vrf, afi and configured nexthops. */
+static struct hash *nhg_hash;
+
+/* Bumped whenever nexthop resolution may have changed.  A group whose
+ * generation is older than this may have its members replaced by the
+ * next route which uses it; otherwise a route which resolves differently
+ * (route-map, lookup of itself) keeps its own nexthops instead.
+ */
+static unsigned long nhg_generation = 1;
+
+/* Last kernel nexthop object id handed out. */
+static u_int32_t nhg_last_id;
+
+u_int32_t
+zebra_nhg_id_alloc (void)
+{
+  if (++nhg_last_id == 0)
+    nhg_last_id = 1;
+  return nhg_last_id;
+}
+
+/* Make sure ids already in use in the kernel are not handed out. */
+void
+zebra_nhg_id_floor (u_int32_t id)
+{
+  if (id > nhg_last_id)
+    nhg_last_id = id;
+}
+
+void
+zebra_nhg_resolution_changed (void)
+{
+  nhg_generation++;
+}
+
+static unsigned int
+nhg_hash_key (void *data)
+{
+  struct nhg_entry *nhe = data;
+
+  return jhash (nhe->nexthop, nhe->nexthop_num * sizeof (struct nhg_member),
+                jhash_3words (nhe->vrf_id, nhe->afi, nhe->internal, 0));
+}
+
+static int
+nhg_hash_cmp (const void *a, const void *b)
+{
+  const struct nhg_entry *nhe1 = a;
+  const struct nhg_entry *nhe2 = b;
+
+  return nhe1->vrf_id == nhe2->vrf_id
+         && nhe1->afi == nhe2->afi
+         && nhe1->internal == nhe2->internal
+         && nhe1->nexthop_num == nhe2->nexthop_num
+         && ! memcmp (nhe1->nexthop, nhe2->nexthop,
+                      nhe1->nexthop_num * sizeof (struct nhg_member));
+}
+
+static unsigned int
+nhg_dep_hash_key (void *data)
+{
+  return (unsigned int) ((uintptr_t) data >> 4);
+}
+
+static int
+nhg_dep_hash_cmp (const void *a, const void *b)
+{
+  return a == b;
+}
+
+static void
+nhg_dep_unlock (void *data)
+{
+  route_unlock_node (data);
+}
+
+static void *
+nhg_alloc (void *arg)
+{
+  struct nhg_entry *lookup = arg;
+  struct nhg_entry *nhe;
+
+  nhe = XCALLOC (MTYPE_NHG, sizeof (struct nhg_entry));
+  nhe->vrf_id = lookup->vrf_id;
+  nhe->afi = lookup->afi;
+  nhe->internal = lookup->internal;
+  nhe->nexthop_num = lookup->nexthop_num;
+  memcpy (nhe->nexthop, lookup->nexthop,
+          nhe->nexthop_num * sizeof (struct nhg_member));
+  /* Most groups serve a handful of prefixes, the hash grows for the
+     ones shared more widely. */
+  nhe->deps = hash_create_size (8, nhg_dep_hash_key, nhg_dep_hash_cmp);
+  return nhe;
+}
+
+/* Fill in 'm' from 'nexthop'.  For a key the nexthop is taken as
+ * configured, otherwise as resolved.  Returns 0 if the nexthop cannot be
+ * part of a group.
+ */
+static int
+nhg_member_set (struct nhg_member *m, struct nexthop *nexthop, int family,
+                int key)
+{
+  memset (m, 0, sizeof (struct nhg_member));
+  m->family = family;
+  m->onlink = CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ONLINK) ? 1 : 0;
+
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IFINDEX:
+      m->ifindex = nexthop->ifindex;
+      break;
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      if (family != AF_INET)
+        return 0;
+      m->gate.ipv4 = nexthop->gate.ipv4;
+      if (! key || nexthop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
+        m->ifindex = nexthop->ifindex;
+      break;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      if (family != AF_INET6)
+        return 0;
+      m->gate.ipv6 = nexthop->gate.ipv6;
+      if (! key || nexthop->type == NEXTHOP_TYPE_IPV6_IFINDEX)
+        m->ifindex = nexthop->ifindex;
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      return 0;
+    }
+
+  /* Kernel nexthop objects need an outgoing interface. */
+  return key || m->ifindex != 0;
+}
+
+static int
+nhg_member_same (struct nhg_member *m1, struct nhg_member *m2)
+{
+  return m1->family == m2->family
+         && m1->onlink == m2->onlink
+         && m1->ifindex == m2->ifindex
+         && ! memcmp (&m1->gate, &m2->gate, sizeof (union g_addr));
+}
+
+/* Id of the member of 'set' equal to 'm', or 0. */
+static u_int32_t
+nhg_member_id (struct nhg_member *set, int num, struct nhg_member *m)
+{
+  int i;
+
+  for (i = 0; i < num; i++)
+    if (nhg_member_same (&set[i], m))
+      return set[i].id;
+  return 0;
+}
+
+/* Build the key of the group for 'rib'. */
+static int
+nhg_key (struct nhg_entry *lookup, struct rib *rib, afi_t afi)
+{
+  struct nexthop *nexthop;
+
+  memset (lookup, 0, sizeof (struct nhg_entry));
+  lookup->vrf_id = rib->vrf_id;
+  lookup->afi = afi;
+  lookup->internal = CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL) ? 1 : 0;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      if (lookup->nexthop_num >= MULTIPATH_NUM
+          || ! nhg_member_set (&lookup->nexthop[lookup->nexthop_num],
+                               nexthop, afi2family (afi), 1))
+        return -1;
+      lookup->nexthop_num++;
+    }
+  return lookup->nexthop_num ? 0 : -1;
+}
+
+/* Collect the forwarding nexthops of 'rib', the same way
+ * netlink_route_multipath does.  Returns their number, or -1 if one of
+ * them cannot be part of a group.
+ */
+static int
+nhg_forwarding (struct rib *rib, int family, struct nhg_member *member)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+  int num = 0;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (num >= MULTIPATH_NUM)
+        break;
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+      if (! nhg_member_set (&member[num], nexthop, family, 0))
+        return -1;
+      num++;
+    }
+  return num;
+}
+
+static int
+nhg_members_same (struct nhg_entry *nhe, struct nhg_member *member, int num)
+{
+  int i;
+
+  if (nhe->member_num != num)
+    return 0;
+  for (i = 0; i < num; i++)
+    if (! nhg_member_same (&nhe->member[i], &member[i]))
+      return 0;
+  return 1;
+}
+
+/* Remove from the kernel the members of 'set' whose id is not used by
+ * 'keep'.
+ */
+static void
+nhg_kernel_delete_members (vrf_id_t vrf_id, struct nhg_member *set, int num,
+                           struct nhg_member *keep, int keep_num)
+{
+  int i, j;
+
+  for (i = 0; i < num; i++)
+    {
+      for (j = 0; j < keep_num; j++)
+        if (keep[j].id == set[i].id)
+          break;
+      if (j == keep_num && set[i].id)
+        kernel_nexthop_delete (vrf_id, set[i].id);
+    }
+}
+
+/* Install the members of 'nhe' which have no id yet. */
+static int
+nhg_kernel_add_members (struct nhg_entry *nhe)
+{
+  int i;
+
+  for (i = 0; i < nhe->member_num; i++)
+    if (! nhe->member[i].id)
+      {
+        nhe->member[i].id = zebra_nhg_id_alloc ();
+        if (kernel_nexthop_add (nhe->vrf_id, &nhe->member[i]) < 0)
+          return -1;
+      }
+  return 0;
+}
+
+/* Push the new members of 'nhe' to the kernel.  The group is replaced
+ * in place when possible, so that all the routes using it follow in one
+ * operation.  Returns 1 if the group had to be created again under a
+ * new id, which the routes have to be pointed at.
+ */
+static int
+nhg_kernel_update (struct nhg_entry *nhe, struct nhg_member *old, int old_num)
+{
+  u_int32_t old_id = nhe->id;
+  int i;
+
+  if (nhe->installed)
+    {
+      for (i = 0; i < nhe->member_num; i++)
+        nhe->member[i].id = nhg_member_id (old, old_num, &nhe->member[i]);
+
+      if (nhg_kernel_add_members (nhe) == 0
+          && kernel_nexthop_group_add (nhe, 1) == 0)
+        {
+          nhg_kernel_delete_members (nhe->vrf_id, old, old_num,
+                                     nhe->member, nhe->member_num);
+          return 0;
+        }
+
+      /* The kernel lost the group or some of its members, e.g. when
+         their interface went down. */
+      nhg_kernel_delete_members (nhe->vrf_id, nhe->member, nhe->member_num,
+                                 old, old_num);
+    }
+
+  for (i = 0; i < nhe->member_num; i++)
+    nhe->member[i].id = 0;
+  nhe->id = zebra_nhg_id_alloc ();
+  nhe->installed = (nhg_kernel_add_members (nhe) == 0
+                    && kernel_nexthop_group_add (nhe, 0) == 0);
+  if (! nhe->installed)
+    {
+      nhg_kernel_delete_members (nhe->vrf_id, nhe->member, nhe->member_num,
+                                 NULL, 0);
+      zlog_warn ("%s: can't install nexthop group %u in the kernel",
+                 __func__, nhe->id);
+    }
+
+  if (old_num)
+    {
+      kernel_nexthop_delete (nhe->vrf_id, old_id);
+      nhg_kernel_delete_members (nhe->vrf_id, old, old_num, NULL, 0);
+    }
+  return 1;
+}
+
+struct nhg_requeue_arg
+{
+  struct nhg_entry *nhe;
+  struct route_node *self;
+  int rebuilt;
+};
+
+/* Have the routes of 'rn' which use the group go through the kernel
+ * update again, so that those which no longer match it leave it.
+ */
+static void
+nhg_dep_requeue (struct hash_backet *backet, void *arg)
+{
+  struct nhg_requeue_arg *args = arg;
+  struct route_node *rn = backet->data;
+  struct nexthop *nexthop, *tnexthop;
+  struct rib *rib;
+  int recursing;
+
+  RNODE_FOREACH_RIB (rn, rib)
+    {
+      if (rib->nhe != args->nhe)
+        continue;
+      if (args->rebuilt)
+        UNSET_FLAG (rib->status, RIB_ENTRY_NHG_FIB);
+      if (rn == args->self)
+        continue;
+      for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+        UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+    }
+  if (rn != args->self && rnode_to_ribs (rn))
+    rib_queue_add (&zebrad, rn);
+}
+
+static void
+nhg_update (struct nhg_entry *nhe, struct nhg_member *member, int num,
+            struct route_node *self)
+{
+  struct nhg_member old[MULTIPATH_NUM];
+  struct nhg_requeue_arg args;
+  int old_num = nhe->installed ? nhe->member_num : 0;
+
+  memcpy (old, nhe->member, sizeof (old));
+  memcpy (nhe->member, member, num * sizeof (struct nhg_member));
+  nhe->member_num = num;
+
+  if (IS_ZEBRA_DEBUG_RIB)
+    zlog_debug ("%s: nexthop group %u vrf %u now has %d members",
+                __func__, nhe->id, nhe->vrf_id, num);
+
+  args.nhe = nhe;
+  args.self = self;
+  args.rebuilt = nhg_kernel_update (nhe, old, old_num);
+
+  hash_iterate (nhe->deps, nhg_dep_requeue, &args);
+  hash_clean (nhe->deps, nhg_dep_unlock);
+}
+
+/* Find the group 'rib' should be installed with, and make it reference
+ * that group.  The group which 'rib' referenced before is returned when
+ * it changed, for the caller to release once the kernel is updated.
+ */
+struct nhg_entry *
+zebra_nhg_bind (struct route_node *rn, struct rib *rib)
+{
+  rib_table_info_t *info = rn->table->info;
+  struct nhg_entry lookup;
+  struct nhg_entry *nhe = NULL;
+  struct nhg_entry *prev = rib->nhe;
+  struct nhg_member member[MULTIPATH_NUM];
+  int num;
+
+  if (! kernel_nhg_supported ()
+      || CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE)
+      || CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT)
+      || nhg_key (&lookup, rib, info->afi) < 0
+      || (num = nhg_forwarding (rib, PREFIX_FAMILY (&rn->p), member)) <= 0)
+    goto out;
+
+  nhe = hash_get (nhg_hash, &lookup, nhg_alloc);
+
+  if (! nhg_members_same (nhe, member, num)
+      || (! nhe->installed && nhe->generation != nhg_generation))
+    {
+      if (nhe->member_num && nhe->generation == nhg_generation)
+        {
+          /* Settled by another route already. */
+          nhe = NULL;
+          goto out;
+        }
+      nhg_update (nhe, member, num, rn);
+    }
+  nhe->generation = nhg_generation;
+
+  if (! hash_lookup (nhe->deps, rn))
+    {
+      hash_get (nhe->deps, rn, hash_alloc_intern);
+      route_lock_node (rn);
+    }
+
+ out:
+  if (nhe == prev)
+    return NULL;
+
+  if (nhe)
+    nhe->refcnt++;
+  rib->nhe = nhe;
+  return prev;
+}
+
+static void
+nhg_free (struct nhg_entry *nhe)
+{
+  if (nhe->installed)
+    {
+      kernel_nexthop_delete (nhe->vrf_id, nhe->id);
+      nhg_kernel_delete_members (nhe->vrf_id, nhe->member, nhe->member_num,
+                                 NULL, 0);
+    }
+  hash_release (nhg_hash, nhe);
+  hash_clean (nhe->deps, nhg_dep_unlock);
+  hash_free (nhe->deps);
+  XFREE (MTYPE_NHG, nhe);
+}
+
+/* Drop the reference a route of 'rn' held on 'nhe'.  The node stops
+ * depending on the group once none of its routes use it any more.
+ */
+void
+zebra_nhg_release (struct route_node *rn, struct nhg_entry *nhe)
+{
+  struct rib *rib;
+
+  assert (nhe->refcnt > 0);
+
+  RNODE_FOREACH_RIB (rn, rib)
+    if (rib->nhe == nhe)
+      break;
+  if (! rib && hash_release (nhe->deps, rn))
+    route_unlock_node (rn);
+
+  if (--nhe->refcnt == 0)
+    nhg_free (nhe);
+}
+
+/* 'rib', a route of 'rn', is no longer in the kernel through its group. */
+void
+zebra_nhg_unbind (struct route_node *rn, struct rib *rib)
+{
+  struct nhg_entry *nhe = rib->nhe;
+
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHG_FIB);
+  if (nhe)
+    {
+      rib->nhe = NULL;
+      zebra_nhg_release (rn, nhe);
+    }
+}
+
+/* Whether the kernel route for 'rib' already points at its group, and
+ * has no attributes of its own which would need updating.
+ */
+int
+zebra_nhg_fib_current (struct rib *rib)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+
+  if (! rib->nhe || ! rib->nhe->installed
+      || ! CHECK_FLAG (rib->status, RIB_ENTRY_NHG_FIB))
+    return 0;
+
+  if (rib->mtu || rib->nexthop_mtu)
+    return 0;
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    if (nexthop->src.ipv4.s_addr)
+      return 0;
+  return 1;
+}
+
+static void
+nhg_show_member (struct vty *vty, const char *what, struct nhg_member *m,
+                 vrf_id_t vrf_id)
+{
+  char buf[INET6_ADDRSTRLEN];
+
+  vty_out (vty, "    %s", what);
+  if (m->id)
+    vty_out (vty, " %u", m->id);
+  if (m->family == AF_INET && m->gate.ipv4.s_addr)
+    vty_out (vty, " via %s", inet_ntop (AF_INET, &m->gate, buf, sizeof buf));
+#ifdef HAVE_IPV6
+  else if (m->family == AF_INET6 && ! IN6_IS_ADDR_UNSPECIFIED (&m->gate.ipv6))
+    vty_out (vty, " via %s", inet_ntop (AF_INET6, &m->gate, buf, sizeof buf));
+#endif /* HAVE_IPV6 */
+  if (m->ifindex)
+    vty_out (vty, " %s", ifindex2ifname_vrf (m->ifindex, vrf_id));
+  if (m->onlink)
+    vty_out (vty, " onlink");
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+static void
+nhg_show_entry (struct hash_backet *backet, void *arg)
+{
+  struct vty *vty = arg;
+  struct nhg_entry *nhe = backet->data;
+  int i;
+
+  vty_out (vty, "Group %u, vrf %u, %s, %lu routes, %s%s",
+           nhe->id, nhe->vrf_id, nhe->afi == AFI_IP ? "ipv4" : "ipv6",
+           nhe->refcnt,
+           nhe->installed ? "installed" : "not installed", VTY_NEWLINE);
+  for (i = 0; i < nhe->nexthop_num; i++)
+    nhg_show_member (vty, "nexthop", &nhe->nexthop[i], nhe->vrf_id);
+  for (i = 0; i < nhe->member_num; i++)
+    nhg_show_member (vty, "member", &nhe->member[i], nhe->vrf_id);
+}
+
+DEFUN (show_zebra_nexthop_group,
+       show_zebra_nexthop_group_cmd,
+       "show zebra nexthop-group",
+       SHOW_STR
+       "Zebra information\n"
+       "Shared nexthop groups\n")
+{
+  vty_out (vty, "%lu nexthop groups, kernel nexthop objects %s%s",
+           nhg_hash->count,
+           kernel_nhg_supported () ? "in use" : "not available", VTY_NEWLINE);
+  hash_iterate (nhg_hash, nhg_show_entry, vty);
+  return CMD_SUCCESS;
+}
+
+void
+zebra_nhg_init (void)
+{
+  nhg_hash = hash_create (nhg_hash_key, nhg_hash_cmp);
+
+  install_element (VIEW_NODE, &show_zebra_nexthop_group_cmd);
+  install_element (ENABLE_NODE, &show_zebra_nexthop_group_cmd);
+}
@@ -0,0 +1,85 @@
+/*
+ * Zebra shared nexthop groups.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "hash.h"
+#include "zebra/rib.h"
+
+/* One forwarding nexthop of a group, as programmed into the kernel. */
+struct nhg_member
+{
+  /* Kernel nexthop object id. */
+  u_int32_t id;
+
+  u_char family;
+  u_char onlink;
+  union g_addr gate;
+  ifindex_t ifindex;
+};
+
+/* A nexthop group shared by all the routes which were given the same
+ * nexthops.  The group is identified by those nexthops as configured,
+ * and its members are what they currently resolve to.  Members and the
+ * group itself are installed as kernel nexthop objects, which the
+ * routes then reference by id.
+ *
+ * Routes keep their own nexthop chain besides the group: it carries the
+ * per-route ACTIVE/FIB flags and route-map outcome.  A group therefore
+ * adds to zebra's memory, its two member arrays and dependents hash, and
+ * saves kernel updates rather than memory.
+ */
+struct nhg_entry
+{
+  /* Key. */
+  vrf_id_t vrf_id;
+  afi_t afi;
+  u_char internal;
+  u_char nexthop_num;
+  struct nhg_member nexthop[MULTIPATH_NUM];
+
+  /* Number of routes referencing this group. */
+  unsigned long refcnt;
+
+  /* Kernel nexthop object id of the group itself. */
+  u_int32_t id;
+
+  /* Resolved state. */
+  u_char installed;
+  unsigned long generation;
+  u_char member_num;
+  struct nhg_member member[MULTIPATH_NUM];
+
+  /* Route nodes to requeue when the members change. */
+  struct hash *deps;
+};
+
+extern void zebra_nhg_init (void);
+extern struct nhg_entry *zebra_nhg_bind (struct route_node *, struct rib *);
+extern void zebra_nhg_unbind (struct route_node *, struct rib *);
+extern void zebra_nhg_release (struct route_node *, struct nhg_entry *);
+extern int zebra_nhg_fib_current (struct rib *);
+extern void zebra_nhg_resolution_changed (void);
+extern u_int32_t zebra_nhg_id_alloc (void);
+extern void zebra_nhg_id_floor (u_int32_t);
+
+#endif /* _ZEBRA_NHG_H */
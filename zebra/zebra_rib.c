@@ -35,6 +35,7 @@
 #include "prefix.h"
 #include "routemap.h"
 #include "vrf.h"
+#include "hash.h"
 
 #include "zebra/rib.h"
 #include "zebra/rt.h"
@@ -42,6 +43,7 @@
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
 #include "zebra/zebra_fpm.h"
+#include "zebra/zebra_nhg.h"
 
 /* Default rtm_table for all clients */
 extern struct zebra_t zebrad;
@@ -76,6 +78,16 @@ static const struct
 /* RPF lookup behaviour */
 static enum multicast_mode ipv4_multicast_mode = MCAST_NO_CONFIG;
 
+/* Warm restart: the window clients get to replay their routes, and the
+   kernel routes of a previous zebra still awaiting reconciliation. */
+static struct thread *rib_warm_restart_thread;
+static unsigned long rib_stale_count;
+static unsigned long rib_stale_adopted;
+static unsigned long rib_stale_replaced;
+static unsigned long rib_stale_removed;
+
+static void rib_warm_restart_done (void);
+
 static void __attribute__((format (printf, 4, 5)))
 _rnode_zlog(const char *_func, struct route_node *rn, int priority,
 	    const char *msgfmt, ...)
@@ -337,50 +349,211 @@ nexthop_has_fib_child(struct nexthop *nexthop)
   return 0;
 }
 
-/* If force flag is not set, do not modify falgs at all for uninstall
-   the route from FIB. */
+/* Recursive nexthop resolution cache.
+ *
+ * Resolving a nexthop gateway means a longest-prefix walk of the unicast
+ * RIB, while a full BGP table only has a handful of distinct nexthops.
+ * The outcome of that walk is therefore cached per (afi, vrf, gateway), in
+ * a table of host prefixes hanging off the zebra_vrf.  Since the walk only
+ * looks at nodes covering the gateway, the entries below a prefix are
+ * dropped whenever the FIB state of that prefix changes, and the route
+ * nodes which used them are queued to be processed again.
+ */
+#define NHCACHE_UNRESOLVED      0
+#define NHCACHE_CONNECTED       1 /* gateway is on a connected route */
+#define NHCACHE_RECURSIVE       2 /* via the FIB nexthops of another route */
+
+struct nhcache_entry
+{
+  u_char result;
+
+  /* Length of the prefix the walk stopped at, 0 if there was none. */
+  u_char matchlen;
+
+  /* NHCACHE_CONNECTED: interface of the connected route, if it had one. */
+  u_char has_ifindex;
+  ifindex_t ifindex;
+
+  /* NHCACHE_RECURSIVE: nexthops to copy into nexthop->resolved. */
+  struct nexthop *resolved;
+  u_int32_t mtu;
+
+  /* Route nodes whose resolution depends on this entry, each of which
+     lists the entry in its dest's nhcache list. */
+  struct hash *deps;
+
+  /* Node of the entry in the cache table. */
+  struct route_node *cn;
+};
+
+static unsigned int
+nhcache_dep_hash_key (void *data)
+{
+  return (unsigned int) ((uintptr_t) data >> 4);
+}
+
 static int
-nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
-		     struct route_node *top)
+nhcache_dep_hash_cmp (const void *a, const void *b)
+{
+  return a == b;
+}
+
+struct nhcache_dep_arg
+{
+  struct nhcache_entry *entry;
+  int requeue;
+};
+
+static void
+nhcache_dep_detach (struct hash_backet *backet, void *arg)
+{
+  struct nhcache_dep_arg *dep_arg = arg;
+  struct route_node *rn = backet->data;
+  rib_dest_t *dest = rib_dest_from_rnode (rn);
+
+  if (dest && dest->nhcache)
+    listnode_delete (dest->nhcache, dep_arg->entry);
+  if (dep_arg->requeue && rnode_to_ribs (rn))
+    rib_queue_add (&zebrad, rn);
+}
+
+static void
+nhcache_dep_unlock (void *data)
+{
+  route_unlock_node (data);
+}
+
+/* Free a cache entry, which the caller has taken out of the cache table,
+ * and let go of the route nodes depending on it, requeueing them if asked.
+ */
+static void
+nhcache_entry_free (struct nhcache_entry *entry, int requeue)
+{
+  struct nhcache_dep_arg dep_arg = { entry, requeue };
+
+  hash_iterate (entry->deps, nhcache_dep_detach, &dep_arg);
+  hash_clean (entry->deps, nhcache_dep_unlock);
+  hash_free (entry->deps);
+  nexthops_free (entry->resolved);
+  XFREE (MTYPE_RIB_NHCACHE, entry);
+}
+
+/* Drop the dependencies of 'rn' on cache entries, before its routes are
+ * resolved again or its dest goes away.  Entries nothing depends on any
+ * more are removed from the cache.
+ */
+static void
+nhcache_deps_release (struct route_node *rn)
+{
+  rib_dest_t *dest = rib_dest_from_rnode (rn);
+  struct listnode *node;
+  struct nhcache_entry *entry;
+
+  if (! dest || ! dest->nhcache)
+    return;
+
+  while ((node = listhead (dest->nhcache)) != NULL)
+    {
+      entry = listgetdata (node);
+      list_delete_node (dest->nhcache, node);
+
+      hash_release (entry->deps, rn);
+      route_unlock_node (rn);
+
+      if (entry->deps->count == 0)
+	{
+	  entry->cn->info = NULL;
+	  route_unlock_node (entry->cn);
+	  nhcache_entry_free (entry, 0);
+	}
+    }
+}
+
+/* Build the resolved nexthop through 'newhop' for gateway 'p'.  See
+ * nexthop_active_ipv4 and nexthop_active_ipv6 for how it is constructed.
+ */
+static struct nexthop *
+nhcache_resolved_hop (struct prefix *p, struct nexthop *newhop)
 {
-  struct prefix_ipv4 p;
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *match;
-  int resolved;
-  struct nexthop *newhop;
   struct nexthop *resolved_hop;
 
-  if (nexthop->type == NEXTHOP_TYPE_IPV4)
-    nexthop->ifindex = 0;
+  resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof (struct nexthop));
+  SET_FLAG (resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
 
-  if (set)
+  if (p->family == AF_INET)
     {
-      UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-      nexthops_free(nexthop->resolved);
-      nexthop->resolved = NULL;
-      rib->nexthop_mtu = 0;
+      /* If the resolving route specifies a gateway, use it */
+      if (newhop->type == NEXTHOP_TYPE_IPV4
+	  || newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX
+	  || newhop->type == NEXTHOP_TYPE_IPV4_IFNAME)
+	{
+	  resolved_hop->type = newhop->type;
+	  resolved_hop->gate.ipv4 = newhop->gate.ipv4;
+	  resolved_hop->ifindex = newhop->ifindex;
+	}
+
+      /* If the resolving route is an interface route, it
+       * means the gateway we are looking up is connected
+       * to that interface. Therefore, the resolved route
+       * should have the original gateway as nexthop as it
+       * is directly connected. */
+      if (newhop->type == NEXTHOP_TYPE_IFINDEX
+	  || newhop->type == NEXTHOP_TYPE_IFNAME)
+	{
+	  resolved_hop->type = NEXTHOP_TYPE_IPV4_IFINDEX;
+	  resolved_hop->gate.ipv4 = p->u.prefix4;
+	  resolved_hop->ifindex = newhop->ifindex;
+	}
     }
+  else
+    {
+      if (newhop->type == NEXTHOP_TYPE_IPV6
+	  || newhop->type == NEXTHOP_TYPE_IPV6_IFINDEX
+	  || newhop->type == NEXTHOP_TYPE_IPV6_IFNAME)
+	{
+	  resolved_hop->type = newhop->type;
+	  resolved_hop->gate.ipv6 = newhop->gate.ipv6;
 
-  /* Make lookup prefix. */
-  memset (&p, 0, sizeof (struct prefix_ipv4));
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = nexthop->gate.ipv4;
+	  if (newhop->ifindex)
+	    {
+	      resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
+	      resolved_hop->ifindex = newhop->ifindex;
+	    }
+	}
 
-  /* Lookup table.  */
-  table = zebra_vrf_table (AFI_IP, SAFI_UNICAST, rib->vrf_id);
-  if (! table)
-    return 0;
+      if (newhop->type == NEXTHOP_TYPE_IFINDEX
+	  || newhop->type == NEXTHOP_TYPE_IFNAME)
+	{
+	  resolved_hop->flags |= NEXTHOP_FLAG_ONLINK;
+	  resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
+	  resolved_hop->gate.ipv6 = p->u.prefix6;
+	  resolved_hop->ifindex = newhop->ifindex;
+	}
+    }
 
-  rn = route_node_match (table, (struct prefix *) &p);
+  return resolved_hop;
+}
+
+/* Walk the RIB for host prefix 'p' and record the outcome in a new cache
+ * entry.  Unlike the callers, this does not stop at the node of the route
+ * being resolved; nhcache_is_self takes care of that.
+ */
+static struct nhcache_entry *
+nhcache_resolve (struct route_table *table, struct prefix *p)
+{
+  struct nhcache_entry *entry;
+  struct route_node *rn;
+  struct rib *match;
+  struct nexthop *newhop;
+
+  entry = XCALLOC (MTYPE_RIB_NHCACHE, sizeof (struct nhcache_entry));
+  entry->result = NHCACHE_UNRESOLVED;
+  entry->deps = hash_create (nhcache_dep_hash_key, nhcache_dep_hash_cmp);
+
+  rn = route_node_match (table, p);
   while (rn)
     {
       route_unlock_node (rn);
-      
-      /* If lookup self prefix return immediately. */
-      if (rn == top)
-	return 0;
 
       /* Pick up selected route. */
       RNODE_FOREACH_RIB (rn, match)
@@ -393,7 +566,7 @@ nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
 
       /* If there is no selected route or matched route is EGP, go up
          tree. */
-      if (! match 
+      if (! match
 	  || match->type == ZEBRA_ROUTE_BGP)
 	{
 	  do {
@@ -401,100 +574,262 @@ nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
 	  } while (rn && rn->info == NULL);
 	  if (rn)
 	    route_lock_node (rn);
+	  continue;
 	}
-      else
-	{
-	  /* If the longest prefix match for the nexthop yields
-	   * a blackhole, mark it as inactive. */
-	  if (CHECK_FLAG (match->flags, ZEBRA_FLAG_BLACKHOLE)
-	      || CHECK_FLAG (match->flags, ZEBRA_FLAG_REJECT))
-	    return 0;
 
-	  if (match->type == ZEBRA_ROUTE_CONNECT)
-	    {
-	      /* Directly point connected route. */
-	      newhop = match->nexthop;
-	      if (newhop && nexthop->type == NEXTHOP_TYPE_IPV4)
-		nexthop->ifindex = newhop->ifindex;
-	      
-	      return 1;
-	    }
-	  else if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL))
-	    {
-	      resolved = 0;
-	      for (newhop = match->nexthop; newhop; newhop = newhop->next)
-		if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB)
-		    && ! CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_RECURSIVE))
-		  {
-		    if (set)
-		      {
-			SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-
-			resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof (struct nexthop));
-			SET_FLAG (resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
-			/* If the resolving route specifies a gateway, use it */
-			if (newhop->type == NEXTHOP_TYPE_IPV4
-			    || newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IPV4_IFNAME)
-			  {
-			    resolved_hop->type = newhop->type;
-			    resolved_hop->gate.ipv4 = newhop->gate.ipv4;
-			    resolved_hop->ifindex = newhop->ifindex;
-			  }
-
-			/* If the resolving route is an interface route, it
-			 * means the gateway we are looking up is connected
-			 * to that interface. Therefore, the resolved route
-			 * should have the original gateway as nexthop as it
-			 * is directly connected. */
-			if (newhop->type == NEXTHOP_TYPE_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IFNAME)
-			  {
-			    resolved_hop->type = NEXTHOP_TYPE_IPV4_IFINDEX;
-			    resolved_hop->gate.ipv4 = nexthop->gate.ipv4;
-			    resolved_hop->ifindex = newhop->ifindex;
-			  }
-
-			_nexthop_add(&nexthop->resolved, resolved_hop);
-		      }
-		    resolved = 1;
-		  }
-              if (resolved && set)
-                rib->nexthop_mtu = match->mtu;
-	      return resolved;
-	    }
-	  else
+      entry->matchlen = rn->p.prefixlen;
+
+      /* If the longest prefix match for the nexthop yields
+       * a blackhole, mark it as inactive. */
+      if (CHECK_FLAG (match->flags, ZEBRA_FLAG_BLACKHOLE)
+	  || CHECK_FLAG (match->flags, ZEBRA_FLAG_REJECT))
+	break;
+
+      if (match->type == ZEBRA_ROUTE_CONNECT)
+	{
+	  /* Directly point connected route. */
+	  entry->result = NHCACHE_CONNECTED;
+	  if ((newhop = match->nexthop) != NULL)
 	    {
-	      return 0;
+	      entry->has_ifindex = 1;
+	      entry->ifindex = newhop->ifindex;
 	    }
+	  break;
+	}
+
+      for (newhop = match->nexthop; newhop; newhop = newhop->next)
+	if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB)
+	    && ! CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_RECURSIVE))
+	  _nexthop_add (&entry->resolved, nhcache_resolved_hop (p, newhop));
+
+      if (entry->resolved)
+	{
+	  entry->result = NHCACHE_RECURSIVE;
+	  entry->mtu = match->mtu;
 	}
+      break;
     }
-  return 0;
+
+  return entry;
+}
+
+/* Find or create the cache entry for gateway 'p' in the unicast RIB
+ * 'table', and record 'top' as depending on it.
+ */
+static struct nhcache_entry *
+nhcache_get (struct route_table *table, struct prefix *p,
+             struct route_node *top)
+{
+  rib_table_info_t *info = table->info;
+  struct route_table *cache = info->zvrf->nhcache[info->afi];
+  struct route_node *cn;
+  struct nhcache_entry *entry;
+
+  rib_dest_t *dest = rib_dest_from_rnode (top);
+
+  cn = route_node_get (cache, p);
+  if ((entry = cn->info) == NULL)
+    {
+      cn->info = entry = nhcache_resolve (table, p);
+      entry->cn = cn;
+    }
+  else
+    route_unlock_node (cn);
+
+  if (dest && ! hash_lookup (entry->deps, top))
+    {
+      hash_get (entry->deps, top, hash_alloc_intern);
+      route_lock_node (top);
+      if (! dest->nhcache)
+	dest->nhcache = list_new ();
+      listnode_add (dest->nhcache, entry);
+    }
+  return entry;
+}
+
+/* The walk in nhcache_resolve visits every node covering the gateway,
+ * from the most specific one up to the one it stopped at.  Tell whether
+ * 'top' was among them, i.e. the route would resolve through itself.
+ */
+static int
+nhcache_is_self (struct nhcache_entry *entry, struct route_table *table,
+                 struct route_node *top, struct prefix *p)
+{
+  return top->table == table
+         && top->p.prefixlen >= entry->matchlen
+         && prefix_match (&top->p, p);
+}
+
+/* Drop the cache entries for gateways covered by 'rn', whose FIB state
+ * just changed, and requeue the route nodes which depended on them.
+ */
+static void
+rib_nhcache_invalidate (struct route_node *rn)
+{
+  rib_table_info_t *info = rn->table->info;
+  struct route_table *cache;
+  struct route_node *cn, *ctop;
+
+  if (info->safi != SAFI_UNICAST)
+    return;
+  cache = info->zvrf->nhcache[info->afi];
+  if (! cache || ! cache->top)
+    return;
+
+  ctop = route_node_get (cache, &rn->p);
+  for (cn = route_lock_node (ctop); cn; cn = route_next_until (cn, ctop))
+    if (cn->info)
+      {
+	nhcache_entry_free (cn->info, 1);
+	cn->info = NULL;
+	route_unlock_node (cn);
+	zebra_nhg_resolution_changed ();
+      }
+  route_unlock_node (ctop);
+}
+
+/* Drop all cache entries of a table, without requeueing anything. */
+static void
+rib_nhcache_flush (struct route_table *table)
+{
+  rib_table_info_t *info = table->info;
+  struct route_table *cache;
+  struct route_node *cn;
+
+  if (info->safi != SAFI_UNICAST)
+    return;
+  cache = info->zvrf->nhcache[info->afi];
+
+  for (cn = route_top (cache); cn; cn = route_next (cn))
+    if (cn->info)
+      {
+	nhcache_entry_free (cn->info, 0);
+	cn->info = NULL;
+	route_unlock_node (cn);
+      }
+}
+
+/* Copy the resolved nexthops of a cache entry. */
+static struct nexthop *
+nhcache_copy_resolved (struct nhcache_entry *entry)
+{
+  struct nexthop *nh, *copy, *head = NULL;
+
+  for (nh = entry->resolved; nh; nh = nh->next)
+    {
+      copy = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+      copy->type = nh->type;
+      copy->flags = nh->flags;
+      copy->ifindex = nh->ifindex;
+      copy->gate = nh->gate;
+      _nexthop_add (&head, copy);
+    }
+  return head;
+}
+
+/* Make recursive 'nexthop' resolve through cache 'entry', or not at all
+ * if 'entry' is NULL.  An unchanged resolution keeps its nexthops and so
+ * their FIB flags, which is how rib_process tells that the route is still
+ * in the kernel.  A changed one flags 'rib' RIB_ENTRY_CHANGED, so that the
+ * route is installed again.
+ */
+static void
+nexthop_resolved_update (struct rib *rib, struct nexthop *nexthop,
+                         struct nhcache_entry *entry)
+{
+  struct nexthop *nh, *rh = NULL;
+
+  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE) && entry)
+    {
+      for (nh = nexthop->resolved, rh = entry->resolved; nh && rh;
+           nh = nh->next, rh = rh->next)
+        if (nh->type != rh->type
+            || nh->ifindex != rh->ifindex
+            || memcmp (&nh->gate, &rh->gate, sizeof (nh->gate))
+            || CHECK_FLAG (nh->flags, NEXTHOP_FLAG_ONLINK)
+               != CHECK_FLAG (rh->flags, NEXTHOP_FLAG_ONLINK))
+          break;
+      if (! nh && ! rh)
+        return;
+    }
+  else if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE) && ! entry)
+    return;
+
+  nexthops_free (nexthop->resolved);
+  nexthop->resolved = NULL;
+  if (entry)
+    {
+      SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+      nexthop->resolved = nhcache_copy_resolved (entry);
+    }
+  else
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+  SET_FLAG (rib->status, RIB_ENTRY_CHANGED);
 }
 
 /* If force flag is not set, do not modify falgs at all for uninstall
    the route from FIB. */
 static int
-nexthop_active_ipv6 (struct rib *rib, struct nexthop *nexthop, int set,
+nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
 		     struct route_node *top)
 {
-  struct prefix_ipv6 p;
+  struct prefix_ipv4 p;
   struct route_table *table;
-  struct route_node *rn;
-  struct rib *match;
-  int resolved;
-  struct nexthop *newhop;
-  struct nexthop *resolved_hop;
+  struct nhcache_entry *entry, *via = NULL;
+  int active = 0;
 
-  if (nexthop->type == NEXTHOP_TYPE_IPV6)
+  if (nexthop->type == NEXTHOP_TYPE_IPV4)
     nexthop->ifindex = 0;
 
+  /* Make lookup prefix. */
+  memset (&p, 0, sizeof (struct prefix_ipv4));
+  p.family = AF_INET;
+  p.prefixlen = IPV4_MAX_PREFIXLEN;
+  p.prefix = nexthop->gate.ipv4;
+
+  /* Lookup table.  */
+  table = zebra_vrf_table (AFI_IP, SAFI_UNICAST, rib->vrf_id);
+  entry = table ? nhcache_get (table, (struct prefix *) &p, top) : NULL;
+
+  /* A lookup of the route's own prefix does not count. */
+  if (entry && ! nhcache_is_self (entry, table, top, (struct prefix *) &p))
+    switch (entry->result)
+      {
+      case NHCACHE_CONNECTED:
+	if (entry->has_ifindex && nexthop->type == NEXTHOP_TYPE_IPV4)
+	  nexthop->ifindex = entry->ifindex;
+	active = 1;
+	break;
+      case NHCACHE_RECURSIVE:
+	if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL))
+	  via = entry;
+	active = (via != NULL);
+	break;
+      default:
+	break;
+      }
+
   if (set)
     {
-      UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-      nexthops_free(nexthop->resolved);
-      nexthop->resolved = NULL;
+      nexthop_resolved_update (rib, nexthop, via);
+      rib->nexthop_mtu = via ? via->mtu : 0;
     }
+  return active;
+}
+
+/* If force flag is not set, do not modify falgs at all for uninstall
+   the route from FIB. */
+static int
+nexthop_active_ipv6 (struct rib *rib, struct nexthop *nexthop, int set,
+		     struct route_node *top)
+{
+  struct prefix_ipv6 p;
+  struct route_table *table;
+  struct nhcache_entry *entry, *via = NULL;
+  int active = 0;
+
+  if (nexthop->type == NEXTHOP_TYPE_IPV6)
+    nexthop->ifindex = 0;
 
   /* Make lookup prefix. */
   memset (&p, 0, sizeof (struct prefix_ipv6));
@@ -504,107 +839,29 @@ nexthop_active_ipv6 (struct rib *rib, struct nexthop *nexthop, int set,
 
   /* Lookup table.  */
   table = zebra_vrf_table (AFI_IP6, SAFI_UNICAST, rib->vrf_id);
-  if (! table)
-    return 0;
-
-  rn = route_node_match (table, (struct prefix *) &p);
-  while (rn)
-    {
-      route_unlock_node (rn);
-      
-      /* If lookup self prefix return immediately. */
-      if (rn == top)
-	return 0;
-
-      /* Pick up selected route. */
-      RNODE_FOREACH_RIB (rn, match)
-	{
-	  if (CHECK_FLAG (match->status, RIB_ENTRY_REMOVED))
-	    continue;
-	  if (CHECK_FLAG (match->status, RIB_ENTRY_SELECTED_FIB))
-	    break;
-	}
+  entry = table ? nhcache_get (table, (struct prefix *) &p, top) : NULL;
 
-      /* If there is no selected route or matched route is EGP, go up
-         tree. */
-      if (! match
-	  || match->type == ZEBRA_ROUTE_BGP)
-	{
-	  do {
-	    rn = rn->parent;
-	  } while (rn && rn->info == NULL);
-	  if (rn)
-	    route_lock_node (rn);
-	}
-      else
-	{
-	  /* If the longest prefix match for the nexthop yields
-	   * a blackhole, mark it as inactive. */
-	  if (CHECK_FLAG (match->flags, ZEBRA_FLAG_BLACKHOLE)
-	      || CHECK_FLAG (match->flags, ZEBRA_FLAG_REJECT))
-	    return 0;
-
-	  if (match->type == ZEBRA_ROUTE_CONNECT)
-	    {
-	      /* Directly point connected route. */
-	      newhop = match->nexthop;
+  /* A lookup of the route's own prefix does not count. */
+  if (entry && ! nhcache_is_self (entry, table, top, (struct prefix *) &p))
+    switch (entry->result)
+      {
+      case NHCACHE_CONNECTED:
+	if (entry->has_ifindex && nexthop->type == NEXTHOP_TYPE_IPV6)
+	  nexthop->ifindex = entry->ifindex;
+	active = 1;
+	break;
+      case NHCACHE_RECURSIVE:
+	if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL))
+	  via = entry;
+	active = (via != NULL);
+	break;
+      default:
+	break;
+      }
 
-	      if (newhop && nexthop->type == NEXTHOP_TYPE_IPV6)
-		nexthop->ifindex = newhop->ifindex;
-	      
-	      return 1;
-	    }
-	  else if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL))
-	    {
-	      resolved = 0;
-	      for (newhop = match->nexthop; newhop; newhop = newhop->next)
-		if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB)
-		    && ! CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_RECURSIVE))
-		  {
-		    if (set)
-		      {
-			SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-
-			resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof (struct nexthop));
-			SET_FLAG (resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
-			/* See nexthop_active_ipv4 for a description how the
-			 * resolved nexthop is constructed. */
-			if (newhop->type == NEXTHOP_TYPE_IPV6
-			    || newhop->type == NEXTHOP_TYPE_IPV6_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IPV6_IFNAME)
-			  {
-			    resolved_hop->type = newhop->type;
-			    resolved_hop->gate.ipv6 = newhop->gate.ipv6;
-
-			    if (newhop->ifindex)
-			      {
-				resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
-				resolved_hop->ifindex = newhop->ifindex;
-			      }
-			  }
-
-			if (newhop->type == NEXTHOP_TYPE_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IFNAME)
-			  {
-				resolved_hop->flags |= NEXTHOP_FLAG_ONLINK;
-				resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
-				resolved_hop->gate.ipv6 = nexthop->gate.ipv6;
-				resolved_hop->ifindex = newhop->ifindex;
-			  }
-
-			_nexthop_add(&nexthop->resolved, resolved_hop);
-		      }
-		    resolved = 1;
-		  }
-	      return resolved;
-	    }
-	  else
-	    {
-	      return 0;
-	    }
-	}
-    }
-  return 0;
+  if (set)
+    nexthop_resolved_update (rib, nexthop, via);
+  return active;
 }
 
 struct rib *
@@ -939,6 +1196,11 @@ rib_match_ipv6 (struct in6_addr *addr, vrf_id_t vrf_id)
 #define RIB_SYSTEM_ROUTE(R) \
         ((R)->type == ZEBRA_ROUTE_KERNEL || (R)->type == ZEBRA_ROUTE_CONNECT)
 
+/* A route installed by a previous zebra, as found by route_read (). */
+#define RIB_STALE_ROUTE(R) \
+        ((R)->type == ZEBRA_ROUTE_KERNEL \
+         && CHECK_FLAG ((R)->flags, ZEBRA_FLAG_SELFROUTE))
+
 /* This function verifies reachability of one given nexthop, which can be
  * numbered or unnumbered, IPv4 or IPv6. The result is unconditionally stored
  * in nexthop->flags field. If the 4th parameter, 'set', is non-zero,
@@ -1101,16 +1363,18 @@ rib_update_kernel (struct route_node *rn, struct rib *old, struct rib *new)
   int ret = 0;
   struct nexthop *nexthop, *tnexthop;
   rib_table_info_t *info = rn->table->info;
+  struct nhg_entry *prev = NULL;
   int recursing;
+  int num;
 
   if (info->safi != SAFI_UNICAST)
     {
-      if (new)
-        for (ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing))
-          SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
       if (old)
         for (ALL_NEXTHOPS_RO(old->nexthop, nexthop, tnexthop, recursing))
           UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      if (new)
+        for (ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing))
+          SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
       return 0;
     }
 
@@ -1120,16 +1384,39 @@ rib_update_kernel (struct route_node *rn, struct rib *old, struct rib *new)
    */
   zfpm_trigger_update (rn, "updating in kernel");
 
-  ret = kernel_route_rib (&rn->p, old, new);
+  if (new)
+    prev = zebra_nhg_bind (rn, new);
+
+  if (new && (! old || old == new) && ! prev && zebra_nhg_fib_current (new))
+    {
+      /* The kernel route already points at the nexthop group, which has
+         been updated in place if its members changed. */
+      num = 0;
+      for (ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing))
+        if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+            && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE)
+            && num++ < new->nhe->member_num)
+          SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+    }
+  else
+    ret = kernel_route_rib (&rn->p, old, new);
+
+  if (prev)
+    zebra_nhg_release (rn, prev);
+  if (old && old != new)
+    zebra_nhg_unbind (rn, old);
 
   /* This condition is never met, if we are using rt_socket.c */
   if (ret < 0 && new)
       for (ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing))
         UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
+  /* A route replaced by itself keeps the flags set just now, but for
+     the nexthops which are no longer active. */
   if (old)
     for (ALL_NEXTHOPS_RO(old->nexthop, nexthop, tnexthop, recursing))
-      UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      if (old != new || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
   return ret;
 }
@@ -1201,6 +1488,10 @@ rib_gc_dest (struct route_node *rn)
   if (IS_ZEBRA_DEBUG_RIB)
     rnode_debug (rn, "removing dest from table");
 
+  nhcache_deps_release (rn);
+  if (dest->nhcache)
+    list_free (dest->nhcache);
+
   dest->rnode = NULL;
   XFREE (MTYPE_RIB_DEST, dest);
   rn->info = NULL;
@@ -1254,6 +1545,76 @@ rib_choose_best (struct rib *current, struct rib *alternate)
   return current;
 }
 
+/* Whether a kernel nexthop read back by route_read () is the one the
+   active nexthop 'nexthop' would be installed as. */
+static int
+rib_stale_nexthop_same (struct nexthop *stale, struct nexthop *nexthop)
+{
+  if (stale->ifindex != nexthop->ifindex)
+    return 0;
+
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IFINDEX:
+    case NEXTHOP_TYPE_IFNAME:
+      return stale->type == NEXTHOP_TYPE_IFINDEX;
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFNAME:
+      return (stale->type == NEXTHOP_TYPE_IPV4
+              || stale->type == NEXTHOP_TYPE_IPV4_IFINDEX)
+        && IPV4_ADDR_SAME (&stale->gate.ipv4, &nexthop->gate.ipv4)
+        && IPV4_ADDR_SAME (&stale->src.ipv4, &nexthop->src.ipv4);
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      return (stale->type == NEXTHOP_TYPE_IPV6
+              || stale->type == NEXTHOP_TYPE_IPV6_IFINDEX)
+        && IPV6_ADDR_SAME (&stale->gate.ipv6, &nexthop->gate.ipv6);
+#endif /* HAVE_IPV6 */
+    default:
+      return 0;
+    }
+}
+
+/* Whether the kernel route a previous zebra left behind already
+   forwards the way 'rib' would once installed. */
+static int
+rib_stale_match (struct rib *stale, struct rib *rib)
+{
+  struct nexthop *nexthop, *tnexthop, *snexthop;
+  int recursing;
+  u_int32_t mtu;
+  int num = 0;
+
+  if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE)
+      || CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
+    return 0;
+
+  mtu = rib->mtu;
+  if (! mtu || (rib->nexthop_mtu && rib->nexthop_mtu < mtu))
+    mtu = rib->nexthop_mtu;
+  if (mtu != stale->mtu)
+    return 0;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+
+      for (snexthop = stale->nexthop; snexthop; snexthop = snexthop->next)
+        if (rib_stale_nexthop_same (snexthop, nexthop))
+          break;
+      if (! snexthop)
+        return 0;
+      num++;
+    }
+
+  return num == stale->nexthop_num;
+}
+
 /* Core function for processing routing information base. */
 static void
 rib_process (struct route_node *rn)
@@ -1264,7 +1625,9 @@ rib_process (struct route_node *rn)
   struct rib *new_selected = NULL;
   struct rib *old_fib = NULL;
   struct rib *new_fib = NULL;
+  struct rib *stale = NULL;
   int installed = 0;
+  int fib_hold = 0;
   struct nexthop *nexthop = NULL, *tnexthop;
   int recursing;
   rib_table_info_t *info;
@@ -1273,6 +1636,10 @@ rib_process (struct route_node *rn)
 
   info = rn->table->info;
 
+  /* The routes are resolved again below, recording the cache entries
+     they go through now. */
+  nhcache_deps_release (rn);
+
   RNODE_FOREACH_RIB (rn, rib)
     {
       /* Currently installed rib. */
@@ -1287,6 +1654,14 @@ rib_process (struct route_node *rn)
           old_fib = rib;
         }
 
+      /* Routes a previous zebra left in the kernel take no part in
+         selection, see rib_warm_restart (). */
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_STALE))
+        {
+          stale = rib;
+          continue;
+        }
+
       /* Skip deleted entries from selection */
       if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
         continue;
@@ -1325,8 +1700,58 @@ rib_process (struct route_node *rn)
   if (new_selected && new_selected != new_fib)
      nexthop_active_update (rn, new_selected, 1);
 
+  /* While clients replay their routes, the kernel route a previous
+   * zebra left behind is taken over if it matches the new FIB entry,
+   * and otherwise left alone until the window closes.  Then it is
+   * replaced by the new FIB entry, or withdrawn if there is none.
+   */
+  if (stale && rib_warm_restart_thread)
+    {
+      if (CHECK_FLAG (stale->status, RIB_ENTRY_REMOVED))
+        ;
+      else if (new_fib && ! RIB_SYSTEM_ROUTE (new_fib)
+               && rib_stale_match (stale, new_fib))
+        {
+          SET_FLAG (stale->status, RIB_ENTRY_REMOVED);
+          rib_stale_adopted++;
+
+          /* With nexthop objects the route must still be pointed at
+             a group of ours, which the replace below does in place. */
+          if (! kernel_nhg_supported ())
+            {
+              for (ALL_NEXTHOPS_RO(new_fib->nexthop, nexthop, tnexthop,
+                                   recursing))
+                if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+                    && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+                  SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+              if (old_fib)
+                UNSET_FLAG (old_fib->status, RIB_ENTRY_SELECTED_FIB);
+              SET_FLAG (new_fib->status, RIB_ENTRY_SELECTED_FIB);
+
+              if (info->safi == SAFI_UNICAST)
+                zfpm_trigger_update (rn, "taking over kernel route");
+              rib_nhcache_invalidate (rn);
+              fib_hold = 1;
+            }
+        }
+      else
+        fib_hold = 1;
+    }
+  else if (stale)
+    {
+      if (! new_fib || RIB_SYSTEM_ROUTE (new_fib))
+        {
+          rib_update_kernel (rn, stale, NULL);
+          rib_stale_removed++;
+        }
+      else
+        rib_stale_replaced++;
+    }
+
   /* Update kernel if FIB entry has changed */
-  if (old_fib != new_fib
+  if (fib_hold)
+    ;
+  else if (old_fib != new_fib
       || (new_fib && CHECK_FLAG (new_fib->status, RIB_ENTRY_CHANGED)))
     {
         if (old_fib && old_fib != new_fib)
@@ -1346,6 +1771,8 @@ rib_process (struct route_node *rn)
 
         if (info->safi == SAFI_UNICAST)
           zfpm_trigger_update (rn, "updating existing route");
+
+        rib_nhcache_invalidate (rn);
     }
   else if (old_fib == new_fib && new_fib && ! RIB_SYSTEM_ROUTE (new_fib))
     {
@@ -1360,7 +1787,17 @@ rib_process (struct route_node *rn)
             break;
           }
       if (! installed)
-        rib_update_kernel (rn, NULL, new_fib);
+        {
+          rib_update_kernel (rn, NULL, new_fib);
+          /* Only a route which did make it into the FIB changes how the
+             gateways below it resolve. */
+          for (ALL_NEXTHOPS_RO(new_fib->nexthop, nexthop, tnexthop, recursing))
+            if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+              {
+                rib_nhcache_invalidate (rn);
+                break;
+              }
+        }
     }
 
   /* Redistribute SELECTED entry */
@@ -1404,20 +1841,56 @@ rib_process (struct route_node *rn)
   rib_gc_dest (rn);
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more, 
- * than one RN record; operate only in the specified sub-queue.
+/* An entry on one of the meta-queue's sub-queues. */
+struct meta_queue_item
+{
+  struct route_node *rn;
+  struct timeval queued;
+};
+
+/* Account the time a route node spent on sub-queue 'qindex'. */
+static void
+meta_queue_account_wait (struct meta_queue *mq, u_char qindex,
+                         struct timeval *queued)
+{
+  struct meta_queue_stats *stats = &mq->stats[qindex];
+  unsigned long wait;
+  unsigned long limit;
+  int bucket;
+
+  wait = timeval_elapsed (recent_relative_time (), *queued) / 1000;
+  for (bucket = 0, limit = 1;
+       bucket < MQ_WAIT_BUCKETS - 1 && wait >= limit;
+       bucket++, limit *= 10)
+    ;
+  stats->wait[bucket]++;
+  if (wait > stats->wait_max)
+    stats->wait_max = wait;
+  stats->processed++;
+}
+
+/* Take the head of the specified sub-queue and process it by
+ * rib_process().  Return 1 if there was a record picked from it, 0 if
+ * the sub-queue was empty.  Don't process more than one RN record.
  */
 static unsigned int
-process_subq (struct list * subq, u_char qindex)
+process_subq (struct meta_queue *mq, u_char qindex)
 {
+  struct list *subq = mq->subq[qindex];
   struct listnode *lnode  = listhead (subq);
+  struct meta_queue_item *item;
   struct route_node *rnode;
 
   if (!lnode)
     return 0;
 
-  rnode = listgetdata (lnode);
+  item = listgetdata (lnode);
+  rnode = item->rn;
+  meta_queue_account_wait (mq, qindex, &item->queued);
+  list_delete_node (subq, lnode);
+  XFREE (MTYPE_RIB_QUEUE, item);
+  mq->size--;
+
   rib_process (rnode);
 
   if (rnode->info)
@@ -1432,26 +1905,40 @@ process_subq (struct list * subq, u_char qindex)
     }
 #endif
   route_unlock_node (rnode);
-  list_delete_node (subq, lnode);
   return 1;
 }
 
-/* Dispatch the meta queue by picking, processing and unlocking the next RN from
- * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and data
- * is pointed to the meta queue structure.
+/* Dispatch the meta queue by picking, processing and unlocking the next RN.
+ * Sub-queues without a quantum are tried first, lowest index first.  The
+ * weighted ones are then served round-robin: the current sub-queue keeps
+ * its turn until it has used up its quantum or runs empty.  wq is equal
+ * to zebra->ribq and data is pointed to the meta queue structure.
  */
 static wq_item_status
 meta_queue_process (struct work_queue *dummy, void *data)
 {
   struct meta_queue * mq = data;
-  unsigned i;
+  unsigned i, n;
 
   for (i = 0; i < MQ_SIZE; i++)
-    if (process_subq (mq->subq[i], i))
-      {
-	mq->size--;
-	break;
-      }
+    if (!mq->quantum[i] && process_subq (mq, i))
+      goto done;
+
+  /* One extra step, so that the current sub-queue gets a fresh
+     quantum if it is the only one with work left. */
+  for (n = 0; n <= MQ_SIZE; n++)
+    {
+      i = mq->current;
+      if (mq->deficit[i] && process_subq (mq, i))
+	{
+	  mq->deficit[i]--;
+	  break;
+	}
+      mq->current = (i + 1) % MQ_SIZE;
+      mq->deficit[mq->current] = mq->quantum[mq->current];
+    }
+
+done:
   return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
@@ -1480,6 +1967,7 @@ static void
 rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 {
   struct rib *rib;
+  struct meta_queue_item *item;
 
   RNODE_FOREACH_RIB (rn, rib)
     {
@@ -1495,11 +1983,18 @@ rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 	  continue;
 	}
 
+      item = XMALLOC (MTYPE_RIB_QUEUE, sizeof (struct meta_queue_item));
+      item->rn = rn;
+      item->queued = recent_relative_time ();
+
       SET_FLAG (rib_dest_from_rnode (rn)->flags, RIB_ROUTE_QUEUED (qindex));
-      listnode_add (mq->subq[qindex], rn);
+      listnode_add (mq->subq[qindex], item);
       route_lock_node (rn);
       mq->size++;
 
+      if (mq->subq[qindex]->count > mq->stats[qindex].max_depth)
+	mq->stats[qindex].max_depth = mq->subq[qindex]->count;
+
       if (IS_ZEBRA_DEBUG_RIB_Q)
 	rnode_debug (rn, "queued rn %p into sub-queue %u",
                      (void *)rn, qindex);
@@ -1507,7 +2002,7 @@ rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 }
 
 /* Add route_node to work queue and schedule processing */
-static void
+void
 rib_queue_add (struct zebra_t *zebra, struct route_node *rn)
 {
   assert (zebra && rn);
@@ -1719,6 +2214,11 @@ rib_unlink (struct route_node *rn, struct rib *rib)
       dest->routes = rib->next;
     }
 
+  zebra_nhg_unbind (rn, rib);
+
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_STALE) && ! --rib_stale_count)
+    rib_warm_restart_done ();
+
   /* free RIB and nexthops */
   nexthops_free(rib->nexthop);
   XFREE (MTYPE_RIB, rib);
@@ -2185,6 +2685,7 @@ rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
 	    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
 	  UNSET_FLAG (fib->status, RIB_ENTRY_SELECTED_FIB);
+	  rib_nhcache_invalidate (rn);
 	}
       else
 	{
@@ -2764,6 +3265,7 @@ rib_delete_ipv6 (int type, int flags, struct prefix_ipv6 *p,
 	    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
 	  UNSET_FLAG (fib->status, RIB_ENTRY_SELECTED_FIB);
+	  rib_nhcache_invalidate (rn);
 	}
       else
 	{
@@ -2951,6 +3453,8 @@ rib_update (vrf_id_t vrf_id)
   struct route_node *rn;
   struct route_table *table;
   
+  zebra_nhg_resolution_changed ();
+
   table = zebra_vrf_table (AFI_IP, SAFI_UNICAST, vrf_id);
   if (table)
     for (rn = route_top (table); rn; rn = route_next (rn))
@@ -3044,6 +3548,93 @@ rib_sweep_route (void)
       }
 }
 
+/* Set or, with 'expire', end the warm restart state of the self
+   installed routes in 'table'. */
+static void
+rib_warm_restart_table (struct route_table *table, int expire)
+{
+  struct route_node *rn;
+  struct rib *rib;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB (rn, rib)
+	{
+	  if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED)
+	      || ! RIB_STALE_ROUTE (rib))
+	    continue;
+
+	  if (expire)
+	    rib_delnode (rn, rib);
+	  else
+	    {
+	      SET_FLAG (rib->status, RIB_ENTRY_STALE);
+	      rib_stale_count++;
+	    }
+	}
+}
+
+static void
+rib_warm_restart_tables (int expire)
+{
+  vrf_iter_t iter;
+  struct zebra_vrf *zvrf;
+
+  for (iter = vrf_first (); iter != VRF_ITER_INVALID; iter = vrf_next (iter))
+    if ((zvrf = vrf_iter2info (iter)) != NULL)
+      {
+        rib_warm_restart_table (zvrf->table[AFI_IP][SAFI_UNICAST], expire);
+        rib_warm_restart_table (zvrf->table[AFI_IP6][SAFI_UNICAST], expire);
+      }
+}
+
+/* All self installed routes have been reconciled with the RIB. */
+static void
+rib_warm_restart_done (void)
+{
+  THREAD_OFF (rib_warm_restart_thread);
+
+  zlog_info ("Warm restart done: %lu routes taken over, %lu replaced, "
+             "%lu removed", rib_stale_adopted, rib_stale_replaced,
+             rib_stale_removed);
+
+  /* Nothing points at the nexthop objects of the previous zebra now. */
+  kernel_nexthop_sweep ();
+}
+
+static int
+rib_warm_restart_expire (struct thread *thread)
+{
+  rib_warm_restart_thread = NULL;
+
+  zlog_info ("Warm restart window closed, reconciling %lu routes",
+             rib_stale_count);
+  rib_warm_restart_tables (1);
+  return 0;
+}
+
+/* Instead of sweeping the routes a previous zebra left in the kernel,
+   keep them forwarding for 'seconds' while clients replay theirs.  A
+   replayed route matching the kernel is taken over without touching
+   the kernel, and when the time is up the rest are replaced or
+   withdrawn.  Only called bootstrap time. */
+void
+rib_warm_restart (int seconds)
+{
+  rib_warm_restart_tables (0);
+
+  if (! rib_stale_count)
+    {
+      rib_warm_restart_done ();
+      return;
+    }
+
+  zlog_info ("Warm restart: keeping %lu kernel routes for %d seconds",
+             rib_stale_count, seconds);
+  rib_warm_restart_thread =
+    thread_add_timer (zebrad.master, rib_warm_restart_expire, NULL, seconds);
+}
+
 /* Remove specific by protocol routes from 'table'. */
 static unsigned long
 rib_score_proto_table (u_char proto, struct route_table *table)
@@ -3106,6 +3697,9 @@ rib_close_table (struct route_table *table)
 	  if (! RIB_SYSTEM_ROUTE (rib))
 	    rib_update_kernel (rn, rib, NULL);
         }
+
+  if (table)
+    rib_nhcache_flush (table);
 }
 
 /* Close all RIB tables.  */
@@ -3128,6 +3722,7 @@ void
 rib_init (void)
 {
   rib_queue_init (&zebrad);
+  zebra_nhg_init ();
 }
 
 /*
@@ -3278,6 +3873,8 @@ zebra_vrf_alloc (vrf_id_t vrf_id)
   zebra_vrf_table_create (zvrf, AFI_IP6, SAFI_MULTICAST);
   zvrf->stable[AFI_IP][SAFI_MULTICAST] = route_table_init ();
   zvrf->stable[AFI_IP6][SAFI_MULTICAST] = route_table_init ();
+  zvrf->nhcache[AFI_IP] = route_table_init ();
+  zvrf->nhcache[AFI_IP6] = route_table_init ();
 
   /* Set VRF ID */
   zvrf->vrf_id = vrf_id;
@@ -31,6 +31,8 @@
 
 #include "zebra/zserv.h"
 
+extern struct zebra_t zebrad;
+
 static int do_show_ip_route(struct vty *vty, safi_t safi, vrf_id_t vrf_id);
 static void vty_show_ip_route_detail (struct vty *vty, struct route_node *rn,
                                       int mcast);
@@ -2486,6 +2488,133 @@ DEFUN (show_ip_protocol,
     return CMD_SUCCESS;
 }
 
+/* Names of the RIB meta-queue sub-queues, by queue index. */
+static const char *meta_queue_name[MQ_SIZE] =
+{
+  "connected", "static", "igp", "bgp", "other"
+};
+
+#define META_QUEUE_NAME_STR "(connected|static|igp|bgp|other)"
+#define META_QUEUE_NAME_HELP \
+  "Connected and kernel routes\n" \
+  "Static routes\n" \
+  "RIP, RIPng, OSPF, OSPFv3, IS-IS and Babel routes\n" \
+  "BGP routes\n" \
+  "Routes of any other origin\n"
+
+static int
+meta_queue_index (const char *name)
+{
+  int i;
+
+  for (i = 0; i < MQ_SIZE; i++)
+    if (strcmp (name, meta_queue_name[i]) == 0)
+      return i;
+  return -1;
+}
+
+DEFUN (zebra_queue_quantum,
+       zebra_queue_quantum_cmd,
+       "zebra queue " META_QUEUE_NAME_STR " quantum <1-100000>",
+       "Zebra information\n"
+       "RIB processing queue\n"
+       META_QUEUE_NAME_HELP
+       "Serve this sub-queue in weighted round-robin\n"
+       "Number of route nodes processed per turn\n")
+{
+  struct meta_queue *mq = zebrad.mq;
+  int qindex;
+  u_int32_t quantum;
+
+  if ((qindex = meta_queue_index (argv[0])) < 0)
+    return CMD_WARNING;
+  VTY_GET_INTEGER_RANGE ("quantum", quantum, argv[1], 1, 100000);
+
+  mq->quantum[qindex] = quantum;
+  if (mq->deficit[qindex] > quantum)
+    mq->deficit[qindex] = quantum;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_queue_quantum,
+       no_zebra_queue_quantum_cmd,
+       "no zebra queue " META_QUEUE_NAME_STR " quantum",
+       NO_STR
+       "Zebra information\n"
+       "RIB processing queue\n"
+       META_QUEUE_NAME_HELP
+       "Serve this sub-queue in strict priority order\n")
+{
+  struct meta_queue *mq = zebrad.mq;
+  int qindex;
+
+  if ((qindex = meta_queue_index (argv[0])) < 0)
+    return CMD_WARNING;
+
+  mq->quantum[qindex] = 0;
+  mq->deficit[qindex] = 0;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_zebra_queue_quantum,
+       no_zebra_queue_quantum_val_cmd,
+       "no zebra queue " META_QUEUE_NAME_STR " quantum <1-100000>",
+       NO_STR
+       "Zebra information\n"
+       "RIB processing queue\n"
+       META_QUEUE_NAME_HELP
+       "Serve this sub-queue in strict priority order\n"
+       "Number of route nodes processed per turn\n")
+
+DEFUN (show_zebra_queue,
+       show_zebra_queue_cmd,
+       "show zebra queue",
+       SHOW_STR
+       "Zebra information\n"
+       "RIB processing queue\n")
+{
+  struct meta_queue *mq = zebrad.mq;
+  int i;
+
+  vty_out (vty, "%-10s %8s %8s %10s %10s %8s %8s %8s %8s %8s %8s %8s%s",
+           "Sub-queue", "Quantum", "Depth", "Max depth", "Processed",
+           "<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s", "Max ms",
+           VTY_NEWLINE);
+  for (i = 0; i < MQ_SIZE; i++)
+    {
+      struct meta_queue_stats *stats = &mq->stats[i];
+      char quantum[16];
+
+      if (mq->quantum[i])
+        snprintf (quantum, sizeof (quantum), "%u", mq->quantum[i]);
+      else
+        strcpy (quantum, "strict");
+
+      vty_out (vty, "%-10s %8s %8u %10u %10lu %8lu %8lu %8lu %8lu %8lu %8lu "
+               "%8lu%s",
+               meta_queue_name[i], quantum, mq->subq[i]->count,
+               stats->max_depth, stats->processed,
+               stats->wait[0], stats->wait[1], stats->wait[2],
+               stats->wait[3], stats->wait[4], stats->wait[5],
+               stats->wait_max, VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (clear_zebra_queue_stats,
+       clear_zebra_queue_stats_cmd,
+       "clear zebra queue stats",
+       CLEAR_STR
+       "Zebra information\n"
+       "RIB processing queue\n"
+       "Statistics\n")
+{
+  struct meta_queue *mq = zebrad.mq;
+
+  memset (mq->stats, 0, sizeof (mq->stats));
+  return CMD_SUCCESS;
+}
+
 #ifdef HAVE_IPV6
 /* General fucntion for IPv6 static route. */
 static int
@@ -3827,6 +3956,11 @@ static int config_write_vty(struct vty *vty)
       vty_out (vty, "ip protocol %s route-map %s%s", "any",
                proto_rm[AFI_IP][ZEBRA_ROUTE_MAX], VTY_NEWLINE);
 
+  for (i = 0; i < MQ_SIZE; i++)
+    if (zebrad.mq->quantum[i])
+      vty_out (vty, "zebra queue %s quantum %u%s", meta_queue_name[i],
+               zebrad.mq->quantum[i], VTY_NEWLINE);
+
   return 1;
 }   
 
@@ -3854,6 +3988,12 @@ zebra_vty_init (void)
   install_element (CONFIG_NODE, &no_ip_protocol_cmd);
   install_element (VIEW_NODE, &show_ip_protocol_cmd);
   install_element (ENABLE_NODE, &show_ip_protocol_cmd);
+  install_element (CONFIG_NODE, &zebra_queue_quantum_cmd);
+  install_element (CONFIG_NODE, &no_zebra_queue_quantum_cmd);
+  install_element (CONFIG_NODE, &no_zebra_queue_quantum_val_cmd);
+  install_element (VIEW_NODE, &show_zebra_queue_cmd);
+  install_element (ENABLE_NODE, &show_zebra_queue_cmd);
+  install_element (ENABLE_NODE, &clear_zebra_queue_stats_cmd);
   install_element (CONFIG_NODE, &ip_route_cmd);
   install_element (CONFIG_NODE, &ip_route_flags_cmd);
   install_element (CONFIG_NODE, &ip_route_flags2_cmd);
@@ -55,16 +55,6 @@ extern struct zebra_privs_t zserv_privs;
 
 static void zebra_client_close (struct zserv *client);
 
-static int
-zserv_delayed_close(struct thread *thread)
-{
-  struct zserv *client = THREAD_ARG(thread);
-
-  client->t_suicide = NULL;
-  zebra_client_close(client);
-  return 0;
-}
-
 /* When client connects, it sends hello message
  * with promise to send zebra routes of specific type.
  * Zebra stores a socket fd of the client into
@@ -80,11 +70,6 @@ zserv_flush_data(struct thread *thread)
   struct zserv *client = THREAD_ARG(thread);
 
   client->t_write = NULL;
-  if (client->t_suicide)
-    {
-      zebra_client_close(client);
-      return -1;
-    }
   switch (buffer_flush_available(client->wb, client->sock))
     {
     case BUFFER_ERROR:
@@ -105,23 +90,23 @@ zserv_flush_data(struct thread *thread)
 static int
 zebra_server_send_message(struct zserv *client)
 {
-  if (client->t_suicide)
-    return -1;
+  /* Write straight away when nothing is queued.  Once the socket is
+     full, buffer_write() only queues, and the rest of a burst goes out
+     in as few writev() calls as zserv_flush_data needs. */
   switch (buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf),
 		       stream_get_endp(client->obuf)))
     {
     case BUFFER_ERROR:
-      zlog_warn("%s: buffer_write failed to zserv client fd %d, closing",
-      		 __func__, client->sock);
-      /* Schedule a delayed close since many of the functions that call this
-         one do not check the return code.  They do not allow for the
-	 possibility that an I/O error may have caused the client to be
-	 deleted. */
-      client->t_suicide = thread_add_event(zebrad.master, zserv_delayed_close,
-					   client, 0);
+      /* Many callers do not check the return code and go on using the
+	 client, so do not close it here.  Queue the message instead:
+	 zserv_flush_data fails to write it again and closes the client
+	 from its own thread. */
+      buffer_put (client->wb, STREAM_DATA(client->obuf),
+		  stream_get_endp(client->obuf));
+      THREAD_WRITE_ON(zebrad.master, client->t_write,
+		      zserv_flush_data, client, client->sock);
       return -1;
     case BUFFER_EMPTY:
-      THREAD_OFF(client->t_write);
       break;
     case BUFFER_PENDING:
       THREAD_WRITE_ON(zebrad.master, client->t_write,
@@ -1289,6 +1274,8 @@ zebra_client_close (struct zserv *client)
     stream_free (client->ibuf);
   if (client->obuf)
     stream_free (client->obuf);
+  if (client->rbuf)
+    stream_free (client->rbuf);
   if (client->wb)
     buffer_free(client->wb);
 
@@ -1297,8 +1284,6 @@ zebra_client_close (struct zserv *client)
     thread_cancel (client->t_read);
   if (client->t_write)
     thread_cancel (client->t_write);
-  if (client->t_suicide)
-    thread_cancel (client->t_suicide);
 
   /* Free client structure. */
   listnode_delete (zebrad.client_list, client);
@@ -1318,6 +1303,7 @@ zebra_client_create (int sock)
   client->sock = sock;
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  client->rbuf = stream_new (ZSERV_RBUF_SIZE);
   client->wb = buffer_new(0);
 
   /* Set table number. */
@@ -1337,108 +1323,161 @@ zebra_client_create (int sock)
   zebra_event (ZEBRA_READ, sock, client);
 }
 
-/* Handler of zebra service request. */
+/* Move the next complete message, if any, from the client's read
+   buffer into client->ibuf.  Returns 1 if a message was fetched, 0 if
+   more data must be read first and -1 if the stream is malformed. */
 static int
-zebra_client_read (struct thread *thread)
+zserv_fetch_message (struct zserv *client)
 {
-  int sock;
-  struct zserv *client;
-  size_t already;
-  uint16_t length, command;
+  struct stream *rbuf = client->rbuf;
+  size_t getp = stream_get_getp (rbuf);
+  size_t avail = STREAM_READABLE (rbuf);
+  uint16_t length;
   uint8_t marker, version;
-  vrf_id_t vrf_id;
-
-  /* Get thread data.  Reset reading thread because I'm running. */
-  sock = THREAD_FD (thread);
-  client = THREAD_ARG (thread);
-  client->t_read = NULL;
-
-  if (client->t_suicide)
-    {
-      zebra_client_close(client);
-      return -1;
-    }
-
-  /* Read length and command (if we don't have it already). */
-  if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed socket [%d]", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
 
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(client->ibuf, 0);
+  if (avail < ZEBRA_HEADER_SIZE)
+    return 0;
 
-  /* Fetch header values */
-  length = stream_getw (client->ibuf);
-  marker = stream_getc (client->ibuf);
-  version = stream_getc (client->ibuf);
-  vrf_id = stream_getw (client->ibuf);
-  command = stream_getw (client->ibuf);
+  length = stream_getw_from (rbuf, getp);
+  marker = stream_getc_from (rbuf, getp + 2);
+  version = stream_getc_from (rbuf, getp + 3);
 
   if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
     {
       zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, sock, marker, version);
-      zebra_client_close (client);
+               __func__, client->sock, marker, version);
       return -1;
     }
   if (length < ZEBRA_HEADER_SIZE) 
     {
       zlog_warn("%s: socket %d message length %u is less than header size %d",
-	        __func__, sock, length, ZEBRA_HEADER_SIZE);
-      zebra_client_close (client);
+	        __func__, client->sock, length, ZEBRA_HEADER_SIZE);
       return -1;
     }
   if (length > STREAM_SIZE(client->ibuf))
     {
       zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
-	        __func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
-      zebra_client_close (client);
+	        __func__, client->sock, length,
+	        (u_long)STREAM_SIZE(client->ibuf));
       return -1;
     }
 
-  /* Read rest of data. */
-  if (already < length)
+  if (avail < length)
+    return 0;
+
+  stream_reset (client->ibuf);
+  stream_put (client->ibuf, STREAM_DATA (rbuf) + getp, length);
+  stream_forward_getp (rbuf, length);
+  return 1;
+}
+
+/* Shift any partial message to the front of the read buffer, making
+   room for the next read. */
+static void
+zserv_rbuf_compact (struct stream *rbuf)
+{
+  size_t getp = stream_get_getp (rbuf);
+  size_t left = STREAM_READABLE (rbuf);
+
+  if (getp == 0)
+    return;
+  if (left)
+    memmove (STREAM_DATA (rbuf), STREAM_DATA (rbuf) + getp, left);
+  stream_set_getp (rbuf, 0);
+  stream_set_endp (rbuf, left);
+}
+
+static void zebra_client_dispatch (struct zserv *, uint16_t, uint16_t,
+                                   vrf_id_t);
+
+/* Handler of zebra service request.  Each call reads as much as the
+ * socket has to offer in one go, then processes at most
+ * ZSERV_CLIENT_QUANTUM of the buffered messages.  If messages are
+ * still left over, the client is rescheduled as an event, so that it
+ * goes to the back of the line behind the other clients and the RIB
+ * work queue instead of monopolising the event loop.
+ */
+static int
+zebra_client_read (struct thread *thread)
+{
+  int sock;
+  struct zserv *client;
+  int count;
+  int ret;
+
+  /* Get thread data.  Reset reading thread because I'm running. */
+  sock = THREAD_FD (thread);
+  client = THREAD_ARG (thread);
+  client->t_read = NULL;
+
+  /* Only go to the socket when the buffer holds no complete message,
+     i.e. we were woken up by select() rather than by our own event. */
+  if ((ret = zserv_fetch_message (client)) == 0)
     {
       ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
+
+      zserv_rbuf_compact (client->rbuf);
+      nbyte = stream_read_try (client->rbuf, sock,
+			       STREAM_WRITEABLE (client->rbuf));
+      client->read_calls++;
+      if (nbyte == 0 || nbyte == -1)
 	{
 	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed [%d] when reading zebra data", sock);
+	    zlog_debug ("connection closed socket [%d]", sock);
 	  zebra_client_close (client);
 	  return -1;
 	}
-      if (nbyte != (ssize_t)(length-already))
-        {
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
+      ret = (nbyte > 0) ? zserv_fetch_message (client) : 0;
+    }
+
+  for (count = 0; ret > 0; )
+    {
+      uint16_t length, command;
+      vrf_id_t vrf_id;
+
+      /* Fetch header values */
+      length = stream_getw (client->ibuf);
+      stream_forward_getp (client->ibuf, 2);	/* marker, version */
+      vrf_id = stream_getw (client->ibuf);
+      command = stream_getw (client->ibuf);
+
+      zebra_client_dispatch (client, length - ZEBRA_HEADER_SIZE,
+                             command, vrf_id);
+      client->msg_count++;
+
+      if (++count >= ZSERV_CLIENT_QUANTUM)
+	break;
+      ret = zserv_fetch_message (client);
     }
 
-  length -= ZEBRA_HEADER_SIZE;
+  if (ret < 0)
+    {
+      zebra_client_close (client);
+      return -1;
+    }
+
+  stream_reset (client->ibuf);
+
+  if (count >= ZSERV_CLIENT_QUANTUM)
+    {
+      client->yield_count++;
+      client->t_read = thread_add_event (zebrad.master, zebra_client_read,
+					 client, sock);
+    }
+  else
+    zebra_event (ZEBRA_READ, sock, client);
+  return 0;
+}
 
+/* Hand a single message, already in client->ibuf with the header
+   consumed, to its command handler. */
+static void
+zebra_client_dispatch (struct zserv *client, uint16_t length,
+                       uint16_t command, vrf_id_t vrf_id)
+{
   /* Debug packet information. */
   if (IS_ZEBRA_DEBUG_EVENT)
-    zlog_debug ("zebra message comes from socket [%d]", sock);
+    zlog_debug ("zebra message comes from socket [%d]", client->sock);
 
   if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
     zlog_debug ("zebra message received [%s] %d in VRF %u",
@@ -1508,17 +1547,6 @@ zebra_client_read (struct thread *thread)
       zlog_info ("Zebra received unknown command %d", command);
       break;
     }
-
-  if (client->t_suicide)
-    {
-      /* No need to wait for thread callback, just kill immediately. */
-      zebra_client_close(client);
-      return -1;
-    }
-
-  stream_reset (client->ibuf);
-  zebra_event (ZEBRA_READ, sock, client);
-  return 0;
 }
 
 
@@ -1778,7 +1806,9 @@ DEFUN (show_zebra_client,
   struct zserv *client;
 
   for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
-    vty_out (vty, "Client fd %d%s", client->sock, VTY_NEWLINE);
+    vty_out (vty, "Client fd %d, %lu messages in %lu reads, "
+	     "%lu yields%s", client->sock, client->msg_count,
+	     client->read_calls, client->yield_count, VTY_NEWLINE);
   
   return CMD_SUCCESS;
 }
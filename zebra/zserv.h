@@ -30,6 +30,13 @@
 /* Default port information. */
 #define ZEBRA_VTY_PORT                2601
 
+/* Size of the per-client socket read buffer. */
+#define ZSERV_RBUF_SIZE               (16 * ZEBRA_MAX_PACKET_SIZ)
+
+/* Maximum number of messages taken from one client before the
+   event loop gets to serve the other clients. */
+#define ZSERV_CLIENT_QUANTUM          64
+
 /* Default configuration filename. */
 #define DEFAULT_CONFIG_FILE "zebra.conf"
 
@@ -43,6 +50,10 @@ struct zserv
   struct stream *ibuf;
   struct stream *obuf;
 
+  /* Raw bytes read from the socket, possibly holding several
+     messages, which are then handed to ibuf one at a time. */
+  struct stream *rbuf;
+
   /* Buffer of data waiting to be written to client. */
   struct buffer *wb;
 
@@ -50,9 +61,6 @@ struct zserv
   struct thread *t_read;
   struct thread *t_write;
 
-  /* Thread for delayed close. */
-  struct thread *t_suicide;
-
   /* default routing table this client munges */
   int rtm_table;
 
@@ -67,6 +75,11 @@ struct zserv
 
   /* Router-id information. */
   vrf_bitmap_t ridinfo;
+
+  /* Statistics. */
+  u_long read_calls;
+  u_long msg_count;
+  u_long yield_count;
 };
 
 /* Zebra instance */